@@ -32,6 +32,15 @@ namespace bsc {
 		factory.send_remote(k);
 	}
 
+	/**
+	\brief Send the kernel unless the local upstream queue is full.
+	\return false, if the kernel was not sent and is still owned by the caller
+	*/
+	inline bool
+	try_send(kernel* k) {
+		return factory.try_send(k);
+	}
+
 	template<Target target=Target::Local>
 	void
 	upstream(kernel* lhs, kernel* rhs) {
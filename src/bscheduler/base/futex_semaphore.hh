@@ -0,0 +1,168 @@
+#ifndef BSCHEDULER_BASE_FUTEX_SEMAPHORE_HH
+#define BSCHEDULER_BASE_FUTEX_SEMAPHORE_HH
+
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+
+namespace bsc {
+
+	/**
+	\brief Semaphore that spins briefly and then sleeps on a futex.
+	\details
+	The semaphore is an event count: each notification increments
+	the epoch, and a waiter sleeps only if the epoch has not changed
+	since it last checked the predicate. Notifiers make the system call
+	only if there are sleeping threads. The interface is the same as
+	for \c sys::thread_semaphore, so the semaphore may be used with any
+	lock type, including the lock for \link null_mutex\endlink.
+	*/
+	class futex_semaphore {
+
+	public:
+		typedef std::uint32_t epoch_type;
+
+	private:
+		std::atomic<epoch_type> _epoch {0};
+		std::atomic<epoch_type> _nwaiters {0};
+		unsigned _nspins = 100;
+
+	public:
+
+		futex_semaphore() = default;
+
+		futex_semaphore(const futex_semaphore&) = delete;
+
+		futex_semaphore&
+		operator=(const futex_semaphore&) = delete;
+
+		/// Wait until any notification.
+		template <class Lock>
+		inline void
+		wait(Lock& lock) {
+			const epoch_type old = this->_epoch.load();
+			lock.unlock();
+			this->wait_epoch(old, nullptr);
+			lock.lock();
+		}
+
+		/// Wait until \p pred returns true.
+		template <class Lock, class Pred>
+		inline void
+		wait(Lock& lock, Pred pred) {
+			while (!this->wait_once(lock, pred, nullptr)) {}
+		}
+
+		/**
+		\brief Wait until \p pred returns true or timeout.
+		\return the value of \p pred
+		*/
+		template <class Lock, class Clock, class Duration, class Pred>
+		inline bool
+		wait_until(
+			Lock& lock,
+			const std::chrono::time_point<Clock,Duration>& tp,
+			Pred pred
+		) {
+			using namespace std::chrono;
+			bool success = false;
+			while (!success) {
+				const auto now = Clock::now();
+				if (now >= tp) {
+					success = pred();
+					break;
+				}
+				const auto ns = duration_cast<nanoseconds>(tp - now).count();
+				::timespec timeout{};
+				timeout.tv_sec = ns / 1000000000L;
+				timeout.tv_nsec = ns % 1000000000L;
+				success = this->wait_once(lock, pred, &timeout);
+			}
+			return success;
+		}
+
+		/// Wake up at least one waiting thread.
+		inline void
+		notify_one() noexcept {
+			this->notify(1);
+		}
+
+		/// Wake up all waiting threads.
+		inline void
+		notify_all() noexcept {
+			this->notify(INT32_MAX);
+		}
+
+		/// The number of spin iterations before going to sleep.
+		inline void
+		nspins(unsigned rhs) noexcept {
+			this->_nspins = rhs;
+		}
+
+	private:
+
+		template <class Lock, class Pred>
+		inline bool
+		wait_once(Lock& lock, Pred pred, const ::timespec* timeout) {
+			// register as a waiter before checking the predicate,
+			// pairs with the increment of the epoch in notify()
+			++this->_nwaiters;
+			const epoch_type old = this->_epoch.load();
+			bool success = pred();
+			if (!success) {
+				lock.unlock();
+				this->wait_epoch(old, timeout);
+				lock.lock();
+			}
+			--this->_nwaiters;
+			return success;
+		}
+
+		inline void
+		wait_epoch(epoch_type old, const ::timespec* timeout) noexcept {
+			for (unsigned i=0; i<this->_nspins; ++i) {
+				if (this->_epoch.load(std::memory_order_relaxed) != old) {
+					return;
+				}
+				#if defined(__x86_64__) || defined(__i386__)
+				__builtin_ia32_pause();
+				#endif
+			}
+			// returns immediately if the epoch has changed
+			::syscall(
+				SYS_futex,
+				reinterpret_cast<epoch_type*>(&this->_epoch),
+				FUTEX_WAIT_PRIVATE,
+				old,
+				timeout,
+				nullptr,
+				0
+			);
+		}
+
+		inline void
+		notify(int nthreads) noexcept {
+			++this->_epoch;
+			if (this->_nwaiters.load() != 0) {
+				::syscall(
+					SYS_futex,
+					reinterpret_cast<epoch_type*>(&this->_epoch),
+					FUTEX_WAKE_PRIVATE,
+					nthreads,
+					nullptr,
+					nullptr,
+					0
+				);
+			}
+		}
+
+	};
+
+}
+
+#endif // vim:filetype=cpp
@@ -0,0 +1,207 @@
+#ifndef BSCHEDULER_BASE_INDEXED_QUEUE_HH
+#define BSCHEDULER_BASE_INDEXED_QUEUE_HH
+
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <unordered_map>
+
+namespace bsc {
+
+	/**
+	\brief Queue of pointers with constant-time lookup and removal by id.
+	\details
+	Elements are pointers to objects with \c id() and \c has_id() methods
+	(usually kernels). The elements are kept in insertion order, so that
+	the queue can be drained with \link queue_pop_iterator\endlink.
+	Elements with ids are also indexed by id. The id is copied to the queue
+	on insertion, so that the element may be deleted before it is removed
+	from the queue, and must not be changed while the element is in the
+	queue. If several elements have the same id, \link find\endlink returns
+	the one that was inserted first. The queue does not own the elements.
+	\tparam T element type
+	*/
+	template <class T>
+	class indexed_queue {
+
+	public:
+		/// Element pointer type.
+		typedef T* value_type;
+		/// Element identifier type.
+		typedef typename T::id_type id_type;
+		/// Size type.
+		typedef std::size_t size_type;
+
+	private:
+		typedef std::uint64_t sequence_type;
+
+		struct entry {
+			value_type value;
+			id_type id;
+			bool indexed;
+			sequence_type sequence;
+		};
+
+		typedef std::list<entry> list_type;
+		typedef typename list_type::iterator list_iterator;
+		typedef std::unordered_multimap<id_type,list_iterator> index_type;
+
+	public:
+
+		/// Bidirectional iterator over elements in insertion order.
+		class iterator {
+
+		private:
+			list_iterator _pos;
+
+		public:
+
+			iterator() = default;
+
+			inline explicit
+			iterator(list_iterator pos) noexcept:
+			_pos(pos)
+			{}
+
+			inline value_type&
+			operator*() const noexcept {
+				return this->_pos->value;
+			}
+
+			inline iterator&
+			operator++() noexcept {
+				++this->_pos;
+				return *this;
+			}
+
+			inline iterator&
+			operator--() noexcept {
+				--this->_pos;
+				return *this;
+			}
+
+			inline bool
+			operator==(const iterator& rhs) const noexcept {
+				return this->_pos == rhs._pos;
+			}
+
+			inline bool
+			operator!=(const iterator& rhs) const noexcept {
+				return !this->operator==(rhs);
+			}
+
+			friend class indexed_queue;
+
+		};
+
+	private:
+		list_type _elements;
+		index_type _index;
+		sequence_type _sequence = 0;
+
+	public:
+
+		indexed_queue() = default;
+
+		indexed_queue(indexed_queue&&) = default;
+
+		indexed_queue&
+		operator=(indexed_queue&&) = default;
+
+		indexed_queue(const indexed_queue&) = delete;
+
+		indexed_queue&
+		operator=(const indexed_queue&) = delete;
+
+		/// Insert element \p x at the end of the queue.
+		void
+		push(const value_type& x) {
+			const bool indexed = x->has_id();
+			this->_elements.push_back(
+				entry{x, indexed ? x->id() : id_type(), indexed, this->_sequence++}
+			);
+			if (indexed) {
+				list_iterator last = this->_elements.end();
+				--last;
+				this->_index.emplace(last->id, last);
+			}
+		}
+
+		/// Returns the first element (the queue must not be empty).
+		inline value_type&
+		front() noexcept {
+			return this->_elements.front().value;
+		}
+
+		/// Returns the first element (the queue must not be empty).
+		inline const value_type&
+		front() const noexcept {
+			return this->_elements.front().value;
+		}
+
+		/// Removes the first element (the queue must not be empty).
+		inline void
+		pop() {
+			this->erase(this->begin());
+		}
+
+		/**
+		\brief Returns the element with id \p id in \f$O(1)\f$
+		or \link end\endlink, if it was not found.
+		*/
+		iterator
+		find(id_type id) {
+			auto range = this->_index.equal_range(id);
+			if (range.first == range.second) {
+				return this->end();
+			}
+			list_iterator result = range.first->second;
+			for (auto it=range.first; it!=range.second; ++it) {
+				if (it->second->sequence < result->sequence) {
+					result = it->second;
+				}
+			}
+			return iterator(result);
+		}
+
+		/// Remove element at position \p pos in \f$O(1)\f$.
+		iterator
+		erase(iterator pos) {
+			list_iterator it = pos._pos;
+			if (it->indexed) {
+				auto range = this->_index.equal_range(it->id);
+				for (auto jt=range.first; jt!=range.second; ++jt) {
+					if (jt->second == it) {
+						this->_index.erase(jt);
+						break;
+					}
+				}
+			}
+			return iterator(this->_elements.erase(it));
+		}
+
+		inline iterator
+		begin() noexcept {
+			return iterator(this->_elements.begin());
+		}
+
+		inline iterator
+		end() noexcept {
+			return iterator(this->_elements.end());
+		}
+
+		inline bool
+		empty() const noexcept {
+			return this->_elements.empty();
+		}
+
+		inline size_type
+		size() const noexcept {
+			return this->_elements.size();
+		}
+
+	};
+
+}
+
+#endif // vim:filetype=cpp
@@ -0,0 +1,134 @@
+#ifndef BSCHEDULER_BASE_INTRUSIVE_QUEUE_HH
+#define BSCHEDULER_BASE_INTRUSIVE_QUEUE_HH
+
+#include <cstddef>
+
+namespace bsc {
+
+	/**
+	\brief Queue of pointers that are linked through the elements themselves.
+	\details
+	The queue does not allocate memory: the link to the next element is
+	stored in the element. The element type must provide \c next() and
+	\c next(ptr) methods. An element may be in at most one intrusive
+	queue at a time. The queue does not own the elements.
+
+	The link of the first element is stored in the queue itself, so that
+	the first element may be pushed to another queue (e.g. when it is
+	processed by \link queue_pop_iterator\endlink) before it is removed
+	from this one.
+	\tparam T element type
+	*/
+	template <class T>
+	class intrusive_queue {
+
+	public:
+		/// Element pointer type.
+		typedef T* value_type;
+		/// Size type.
+		typedef std::size_t size_type;
+
+	private:
+		value_type _head = nullptr;
+		/// The element that follows the first one.
+		value_type _head_next = nullptr;
+		value_type _tail = nullptr;
+		size_type _size = 0;
+
+	public:
+
+		intrusive_queue() = default;
+
+		/// Move-constructor.
+		inline
+		intrusive_queue(intrusive_queue&& rhs) noexcept:
+		_head(rhs._head),
+		_head_next(rhs._head_next),
+		_tail(rhs._tail),
+		_size(rhs._size) {
+			rhs.clear();
+		}
+
+		/// Move-assignment.
+		inline intrusive_queue&
+		operator=(intrusive_queue&& rhs) noexcept {
+			this->_head = rhs._head;
+			this->_head_next = rhs._head_next;
+			this->_tail = rhs._tail;
+			this->_size = rhs._size;
+			rhs.clear();
+			return *this;
+		}
+
+		intrusive_queue(const intrusive_queue&) = delete;
+
+		intrusive_queue&
+		operator=(const intrusive_queue&) = delete;
+
+		/// Append element to the end of the queue.
+		inline void
+		push(value_type x) noexcept {
+			if (!this->_tail) {
+				this->_head = x;
+				this->_head_next = nullptr;
+			} else if (this->_tail == this->_head) {
+				this->_head_next = x;
+			} else {
+				this->_tail->next(x);
+			}
+			x->next(nullptr);
+			this->_tail = x;
+			++this->_size;
+		}
+
+		/// Returns the first element in the queue.
+		inline value_type&
+		front() noexcept {
+			return this->_head;
+		}
+
+		/// Returns the first element in the queue.
+		inline const value_type&
+		front() const noexcept {
+			return this->_head;
+		}
+
+		/// Removes the first element from the queue.
+		inline void
+		pop() noexcept {
+			this->_head = this->_head_next;
+			if (this->_head) {
+				this->_head_next = static_cast<value_type>(this->_head->next());
+			} else {
+				this->_tail = nullptr;
+			}
+			--this->_size;
+		}
+
+		/// Returns true, if the queue is empty.
+		inline bool
+		empty() const noexcept {
+			return !this->_head;
+		}
+
+		/// Returns the number of elements in the queue.
+		inline size_type
+		size() const noexcept {
+			return this->_size;
+		}
+
+	private:
+
+		inline void
+		clear() noexcept {
+			this->_head = nullptr;
+			this->_head_next = nullptr;
+			this->_tail = nullptr;
+			this->_size = 0;
+		}
+
+	};
+
+}
+
+#endif // vim:filetype=cpp
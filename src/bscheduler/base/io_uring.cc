@@ -0,0 +1,252 @@
+#include "io_uring.hh"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <utility>
+
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <unistdx/base/bad_call>
+#include <unistdx/base/check>
+
+namespace {
+
+	template <class T>
+	inline T*
+	offset(void* base, unsigned n) noexcept {
+		return reinterpret_cast<T*>(static_cast<char*>(base) + n);
+	}
+
+	inline void*
+	map_ring(int fd, size_t size, off_t offset) {
+		void* addr = ::mmap(
+			nullptr,
+			size,
+			PROT_READ | PROT_WRITE,
+			MAP_SHARED | MAP_POPULATE,
+			fd,
+			offset
+		);
+		if (addr == MAP_FAILED) {
+			throw sys::bad_call();
+		}
+		return addr;
+	}
+
+}
+
+bsc::io_uring
+::io_uring(unsigned entries) {
+	#if defined(SYS_io_uring_setup)
+	::io_uring_params params;
+	std::memset(&params, 0, sizeof(params));
+	UNISTDX_CHECK(
+		this->_fd = ::syscall(SYS_io_uring_setup, entries, &params)
+	);
+	try {
+		this->map(params);
+	} catch (...) {
+		this->close();
+		throw;
+	}
+	#else
+	errno = ENOSYS;
+	throw sys::bad_call();
+	#endif
+}
+
+void
+bsc::io_uring
+::map(const ::io_uring_params& params) {
+	this->_features = params.features;
+	this->_sqring_size = params.sq_off.array + params.sq_entries*sizeof(unsigned);
+	this->_cqring_size =
+		params.cq_off.cqes + params.cq_entries*sizeof(completion_type);
+	const bool single_mmap = params.features & IORING_FEAT_SINGLE_MMAP;
+	if (single_mmap) {
+		this->_sqring_size = this->_cqring_size =
+			std::max(this->_sqring_size, this->_cqring_size);
+	}
+	this->_sqring = map_ring(this->_fd, this->_sqring_size, IORING_OFF_SQ_RING);
+	if (single_mmap) {
+		this->_cqring = this->_sqring;
+	} else {
+		this->_cqring = map_ring(this->_fd, this->_cqring_size, IORING_OFF_CQ_RING);
+	}
+	this->_sqes_size = params.sq_entries*sizeof(submission_type);
+	this->_sqes = static_cast<submission_type*>(
+		map_ring(this->_fd, this->_sqes_size, IORING_OFF_SQES)
+	);
+	this->_sqhead = offset<unsigned>(this->_sqring, params.sq_off.head);
+	this->_sqtail = offset<unsigned>(this->_sqring, params.sq_off.tail);
+	this->_sqarray = offset<unsigned>(this->_sqring, params.sq_off.array);
+	this->_sqmask = *offset<unsigned>(this->_sqring, params.sq_off.ring_mask);
+	this->_sqentries = params.sq_entries;
+	this->_sqlocaltail = *this->_sqtail;
+	this->_cqhead = offset<unsigned>(this->_cqring, params.cq_off.head);
+	this->_cqtail = offset<unsigned>(this->_cqring, params.cq_off.tail);
+	this->_cqmask = *offset<unsigned>(this->_cqring, params.cq_off.ring_mask);
+	this->_cqes = offset<completion_type>(this->_cqring, params.cq_off.cqes);
+}
+
+bsc::io_uring::submission_type*
+bsc::io_uring
+::get_submission() noexcept {
+	const unsigned head = __atomic_load_n(this->_sqhead, __ATOMIC_ACQUIRE);
+	if (this->_sqlocaltail - head >= this->_sqentries) {
+		return nullptr;
+	}
+	const unsigned i = this->_sqlocaltail & this->_sqmask;
+	submission_type* sqe = this->_sqes + i;
+	std::memset(sqe, 0, sizeof(submission_type));
+	this->_sqarray[i] = i;
+	++this->_sqlocaltail;
+	return sqe;
+}
+
+bool
+bsc::io_uring
+::prepare_poll(
+	fd_type fd,
+	std::uint32_t events,
+	user_data_type user_data,
+	bool multishot
+) noexcept {
+	submission_type* sqe = this->get_submission();
+	if (!sqe) {
+		return false;
+	}
+	sqe->opcode = IORING_OP_POLL_ADD;
+	sqe->fd = fd;
+	sqe->poll32_events = events;
+	#if defined(IORING_POLL_ADD_MULTI)
+	if (multishot) {
+		sqe->len = IORING_POLL_ADD_MULTI;
+	}
+	#endif
+	sqe->user_data = user_data;
+	return true;
+}
+
+bool
+bsc::io_uring
+::prepare_poll_remove(user_data_type target, user_data_type user_data) noexcept {
+	submission_type* sqe = this->get_submission();
+	if (!sqe) {
+		return false;
+	}
+	sqe->opcode = IORING_OP_POLL_REMOVE;
+	sqe->fd = -1;
+	sqe->addr = target;
+	sqe->user_data = user_data;
+	return true;
+}
+
+unsigned
+bsc::io_uring
+::submit(unsigned min_complete, const ::timespec* timeout) {
+	const unsigned old_head = __atomic_load_n(this->_sqhead, __ATOMIC_ACQUIRE);
+	const unsigned to_submit = this->_sqlocaltail - old_head;
+	__atomic_store_n(this->_sqtail, this->_sqlocaltail, __ATOMIC_RELEASE);
+	if (to_submit == 0 && min_complete == 0) {
+		return 0;
+	}
+	unsigned flags = 0;
+	const void* arg = nullptr;
+	size_t argsize = 0;
+	#if defined(IORING_ENTER_EXT_ARG)
+	::io_uring_getevents_arg ext;
+	#endif
+	if (min_complete != 0) {
+		flags |= IORING_ENTER_GETEVENTS;
+		#if defined(IORING_ENTER_EXT_ARG)
+		if (timeout) {
+			std::memset(&ext, 0, sizeof(ext));
+			ext.ts = reinterpret_cast<std::uintptr_t>(timeout);
+			flags |= IORING_ENTER_EXT_ARG;
+			arg = &ext;
+			argsize = sizeof(ext);
+		}
+		#endif
+	}
+	if (this->enter(to_submit, min_complete, flags, arg, argsize) == -1) {
+		// the timeout and signals are not errors
+		if (errno != ETIME && errno != EINTR && errno != EAGAIN &&
+			errno != EBUSY) {
+			throw sys::bad_call();
+		}
+	}
+	return __atomic_load_n(this->_sqhead, __ATOMIC_ACQUIRE) - old_head;
+}
+
+int
+bsc::io_uring
+::enter(
+	unsigned to_submit,
+	unsigned min_complete,
+	unsigned flags,
+	const void* arg,
+	size_t argsize
+) noexcept {
+	#if defined(SYS_io_uring_enter)
+	return ::syscall(
+		SYS_io_uring_enter,
+		this->_fd,
+		to_submit,
+		min_complete,
+		flags,
+		arg,
+		argsize
+	);
+	#else
+	errno = ENOSYS;
+	return -1;
+	#endif
+}
+
+void
+bsc::io_uring
+::close() noexcept {
+	if (this->_sqes) {
+		::munmap(this->_sqes, this->_sqes_size);
+		this->_sqes = nullptr;
+	}
+	if (this->_cqring && this->_cqring != this->_sqring) {
+		::munmap(this->_cqring, this->_cqring_size);
+	}
+	this->_cqring = nullptr;
+	if (this->_sqring) {
+		::munmap(this->_sqring, this->_sqring_size);
+		this->_sqring = nullptr;
+	}
+	if (this->_fd != -1) {
+		::close(this->_fd);
+		this->_fd = -1;
+	}
+}
+
+void
+bsc::io_uring
+::swap(io_uring& rhs) noexcept {
+	std::swap(this->_fd, rhs._fd);
+	std::swap(this->_features, rhs._features);
+	std::swap(this->_sqring, rhs._sqring);
+	std::swap(this->_sqring_size, rhs._sqring_size);
+	std::swap(this->_cqring, rhs._cqring);
+	std::swap(this->_cqring_size, rhs._cqring_size);
+	std::swap(this->_sqes, rhs._sqes);
+	std::swap(this->_sqes_size, rhs._sqes_size);
+	std::swap(this->_sqhead, rhs._sqhead);
+	std::swap(this->_sqtail, rhs._sqtail);
+	std::swap(this->_sqarray, rhs._sqarray);
+	std::swap(this->_sqmask, rhs._sqmask);
+	std::swap(this->_sqentries, rhs._sqentries);
+	std::swap(this->_sqlocaltail, rhs._sqlocaltail);
+	std::swap(this->_cqhead, rhs._cqhead);
+	std::swap(this->_cqtail, rhs._cqtail);
+	std::swap(this->_cqmask, rhs._cqmask);
+	std::swap(this->_cqes, rhs._cqes);
+}
@@ -0,0 +1,194 @@
+#ifndef BSCHEDULER_BASE_IO_URING_HH
+#define BSCHEDULER_BASE_IO_URING_HH
+
+#include <linux/io_uring.h>
+#include <time.h>
+
+#include <cstddef>
+#include <cstdint>
+
+namespace bsc {
+
+	/**
+	\brief Submission and completion queues of Linux \c io_uring.
+	\details
+	A thin wrapper around the system calls, that does not depend on
+	\c liburing. Submissions are accumulated in the queue and are
+	passed to the kernel in batches by \link submit\endlink, that
+	optionally waits for completions in the same system call.
+	The queues are not thread-safe.
+	*/
+	class io_uring {
+
+	public:
+		typedef int fd_type;
+		typedef ::io_uring_sqe submission_type;
+		typedef ::io_uring_cqe completion_type;
+		typedef std::uint64_t user_data_type;
+
+	private:
+		fd_type _fd = -1;
+		unsigned _features = 0;
+		void* _sqring = nullptr;
+		size_t _sqring_size = 0;
+		void* _cqring = nullptr;
+		size_t _cqring_size = 0;
+		submission_type* _sqes = nullptr;
+		size_t _sqes_size = 0;
+		unsigned* _sqhead = nullptr;
+		unsigned* _sqtail = nullptr;
+		unsigned* _sqarray = nullptr;
+		unsigned _sqmask = 0;
+		unsigned _sqentries = 0;
+		/// Tail of the submissions that were not passed to the kernel yet.
+		unsigned _sqlocaltail = 0;
+		unsigned* _cqhead = nullptr;
+		unsigned* _cqtail = nullptr;
+		unsigned _cqmask = 0;
+		completion_type* _cqes = nullptr;
+
+	public:
+
+		io_uring() = default;
+
+		/**
+		\brief Create the queues with at least \p entries submissions.
+		\throws sys::bad_call if \c io_uring is not supported by the kernel
+		or is disabled
+		*/
+		explicit
+		io_uring(unsigned entries);
+
+		inline
+		io_uring(io_uring&& rhs) noexcept {
+			this->swap(rhs);
+		}
+
+		inline io_uring&
+		operator=(io_uring&& rhs) noexcept {
+			this->swap(rhs);
+			return *this;
+		}
+
+		io_uring(const io_uring&) = delete;
+		io_uring& operator=(const io_uring&) = delete;
+
+		inline
+		~io_uring() {
+			this->close();
+		}
+
+		/**
+		\brief Returns the next free submission or nullptr,
+		if the queue is full.
+		\details
+		The submission is zeroed.
+		*/
+		submission_type*
+		get_submission() noexcept;
+
+		/**
+		\brief Poll \p fd for \p events.
+		\details
+		Multishot poll produces a completion on every change of the file
+		state (like edge-triggered \c epoll) until it is removed.
+		\return false, if the queue is full
+		*/
+		bool
+		prepare_poll(
+			fd_type fd,
+			std::uint32_t events,
+			user_data_type user_data,
+			bool multishot
+		) noexcept;
+
+		/// Remove the poll that was submitted with \p target user data.
+		bool
+		prepare_poll_remove(
+			user_data_type target,
+			user_data_type user_data
+		) noexcept;
+
+		/**
+		\brief Pass all prepared submissions to the kernel and wait for
+		at least \p min_complete completions or \p timeout.
+		\return the number of submissions that were consumed by the kernel
+		\throws sys::bad_call
+		*/
+		unsigned
+		submit(unsigned min_complete=0, const ::timespec* timeout=nullptr);
+
+		/**
+		\brief Call \p func for each completion in the queue
+		and remove the completions.
+		\return the number of completions
+		*/
+		template <class Function>
+		unsigned
+		for_each_completion(Function func) {
+			unsigned head = *this->_cqhead;
+			const unsigned tail = __atomic_load_n(this->_cqtail, __ATOMIC_ACQUIRE);
+			unsigned n = 0;
+			while (head != tail) {
+				func(static_cast<const completion_type&>(
+					this->_cqes[head & this->_cqmask]
+				));
+				++head;
+				++n;
+			}
+			__atomic_store_n(this->_cqhead, head, __ATOMIC_RELEASE);
+			return n;
+		}
+
+		/// Returns the number of prepared submissions that were not consumed.
+		inline unsigned
+		num_pending() const noexcept {
+			return this->_sqlocaltail - __atomic_load_n(this->_sqhead, __ATOMIC_ACQUIRE);
+		}
+
+		inline unsigned
+		features() const noexcept {
+			return this->_features;
+		}
+
+		/// Returns true, if the kernel has all features from \c IORING_FEAT_* \p mask.
+		inline bool
+		has_features(unsigned mask) const noexcept {
+			return (this->_features & mask) == mask;
+		}
+
+		inline fd_type
+		fd() const noexcept {
+			return this->_fd;
+		}
+
+		inline bool
+		is_open() const noexcept {
+			return this->_fd != -1;
+		}
+
+		void
+		close() noexcept;
+
+		void
+		swap(io_uring& rhs) noexcept;
+
+	private:
+
+		void
+		map(const ::io_uring_params& params);
+
+		int
+		enter(
+			unsigned to_submit,
+			unsigned min_complete,
+			unsigned flags,
+			const void* arg,
+			size_t argsize
+		) noexcept;
+
+	};
+
+}
+
+#endif // vim:filetype=cpp
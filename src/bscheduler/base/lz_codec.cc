@@ -0,0 +1,220 @@
+#include "lz_codec.hh"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+
+#include <bscheduler/base/error.hh>
+
+namespace {
+
+	/// Minimal length of back reference.
+	constexpr const size_t min_match = 4;
+	/// Maximal back reference distance.
+	constexpr const size_t max_offset = 65535;
+	/// The number of trailing bytes that are always encoded as literals.
+	constexpr const size_t last_literals = 5;
+	constexpr const unsigned hash_bits = 14;
+
+	inline std::uint32_t
+	read32(const char* p) noexcept {
+		std::uint32_t x;
+		std::memcpy(&x, p, sizeof(x));
+		return x;
+	}
+
+	inline unsigned
+	hash(std::uint32_t x) noexcept {
+		return (x * 2654435761u) >> (32 - hash_bits);
+	}
+
+	inline std::uint64_t
+	read64(const char* p) noexcept {
+		std::uint64_t x;
+		std::memcpy(&x, p, sizeof(x));
+		return x;
+	}
+
+	/// Returns the number of equal bytes in \p a and \p b before \p last.
+	inline size_t
+	match_length(const char* a, const char* b, const char* last) noexcept {
+		const char* first = b;
+		while (b + sizeof(std::uint64_t) <= last) {
+			const std::uint64_t diff = read64(a) ^ read64(b);
+			if (diff != 0) {
+				#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+				return (b - first) + (__builtin_ctzll(diff) >> 3);
+				#else
+				return (b - first) + (__builtin_clzll(diff) >> 3);
+				#endif
+			}
+			a += sizeof(std::uint64_t);
+			b += sizeof(std::uint64_t);
+		}
+		while (b < last && *a == *b) {
+			++a;
+			++b;
+		}
+		return b - first;
+	}
+
+	/// Append length that did not fit into 4 bits of the token.
+	inline void
+	put_length(std::vector<char>& dst, size_t n) {
+		while (n >= 255) {
+			dst.push_back(char(255));
+			n -= 255;
+		}
+		dst.push_back(char(n));
+	}
+
+	void
+	put_sequence(
+		std::vector<char>& dst,
+		const char* literals,
+		size_t nliterals,
+		size_t offset,
+		size_t match_length
+	) {
+		const bool has_match = match_length != 0;
+		const size_t m = has_match ? match_length - min_match : 0;
+		const unsigned token =
+			(std::min<size_t>(nliterals, 15) << 4) |
+			std::min<size_t>(m, 15);
+		dst.push_back(char(token));
+		if (nliterals >= 15) {
+			put_length(dst, nliterals - 15);
+		}
+		dst.insert(dst.end(), literals, literals + nliterals);
+		if (has_match) {
+			dst.push_back(char(offset & 0xff));
+			dst.push_back(char(offset >> 8));
+			if (m >= 15) {
+				put_length(dst, m - 15);
+			}
+		}
+	}
+
+	/**
+	Hash table of the compressor that is reused by all calls in the thread.
+	Entries store positions relative to the \c base that grows with every
+	call, so that entries from the previous calls are ignored without
+	clearing the table.
+	*/
+	struct hash_table {
+		std::vector<std::uint32_t> entries =
+			std::vector<std::uint32_t>(size_t(1) << hash_bits, 0);
+		/// Entries below the base were written by the previous calls.
+		std::uint32_t base = 1;
+	};
+
+	thread_local hash_table table;
+
+	inline size_t
+	get_length(const unsigned char*& p, const unsigned char* last) {
+		size_t n = 0;
+		unsigned char b;
+		do {
+			if (p == last) {
+				BSCHEDULER_THROW(error, "truncated lz data");
+			}
+			b = *p++;
+			n += b;
+		} while (b == 255);
+		return n;
+	}
+
+}
+
+size_t
+bsc::lz::compress(const char* src, size_t n, std::vector<char>& dst) {
+	const size_t old_size = dst.size();
+	dst.reserve(old_size + max_compressed_size(n));
+	const char* anchor = src;
+	if (n > min_match + last_literals) {
+		if (n >= std::numeric_limits<std::uint32_t>::max() - table.base) {
+			std::fill(table.entries.begin(), table.entries.end(), 0);
+			table.base = 1;
+		}
+		const std::uint32_t base = table.base;
+		const char* first = src;
+		const char* last = src + n - last_literals;
+		const char* p = src + 1;
+		// skip incompressible data faster
+		size_t nmisses = 0;
+		while (p + min_match <= last) {
+			const std::uint32_t x = read32(p);
+			const unsigned h = hash(x);
+			const std::uint32_t entry = table.entries[h];
+			table.entries[h] = base + std::uint32_t(p - first);
+			const size_t offset = (p - first) - size_t(entry - base);
+			if (entry < base || offset == 0 || offset > max_offset ||
+			    read32(p - offset) != x) {
+				p += 1 + (nmisses++ >> 6);
+				continue;
+			}
+			const char* candidate = p - offset;
+			nmisses = 0;
+			const size_t length = min_match +
+				match_length(candidate + min_match, p + min_match, last);
+			put_sequence(dst, anchor, p - anchor, offset, length);
+			p += length;
+			anchor = p;
+		}
+		table.base = base + std::uint32_t(n);
+	}
+	put_sequence(dst, anchor, src + n - anchor, 0, 0);
+	return dst.size() - old_size;
+}
+
+void
+bsc::lz::decompress(const char* src, size_t n, char* dst, size_t dst_size) {
+	const unsigned char* p = reinterpret_cast<const unsigned char*>(src);
+	const unsigned char* last = p + n;
+	char* out = dst;
+	char* out_last = dst + dst_size;
+	while (p != last) {
+		const unsigned token = *p++;
+		size_t nliterals = token >> 4;
+		if (nliterals == 15) {
+			nliterals += get_length(p, last);
+		}
+		if (size_t(last - p) < nliterals || size_t(out_last - out) < nliterals) {
+			BSCHEDULER_THROW(error, "bad lz literals");
+		}
+		std::memcpy(out, p, nliterals);
+		out += nliterals;
+		p += nliterals;
+		if (p == last) {
+			break;
+		}
+		if (last - p < 2) {
+			BSCHEDULER_THROW(error, "truncated lz data");
+		}
+		const size_t offset = size_t(p[0]) | (size_t(p[1]) << 8);
+		p += 2;
+		size_t length = token & 15;
+		if (length == 15) {
+			length += get_length(p, last);
+		}
+		length += min_match;
+		if (offset == 0 || size_t(out - dst) < offset ||
+		    size_t(out_last - out) < length) {
+			BSCHEDULER_THROW(error, "bad lz match");
+		}
+		const char* from = out - offset;
+		if (offset >= length) {
+			std::memcpy(out, from, length);
+		} else {
+			// the source and destination overlap
+			for (size_t i=0; i<length; ++i) {
+				out[i] = from[i];
+			}
+		}
+		out += length;
+	}
+	if (out != out_last) {
+		BSCHEDULER_THROW(error, "bad lz data size");
+	}
+}
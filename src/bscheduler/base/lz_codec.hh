@@ -0,0 +1,46 @@
+#ifndef BSCHEDULER_BASE_LZ_CODEC_HH
+#define BSCHEDULER_BASE_LZ_CODEC_HH
+
+#include <cstddef>
+#include <vector>
+
+namespace bsc {
+
+	/**
+	\brief Fast byte-oriented LZ77 compression.
+	\details
+	The format is similar to LZ4 block format: a sequence of
+	literal runs followed by back references with 16-bit offsets.
+	There is no entropy coding, the codec favours speed over ratio.
+	The output does not contain the size of the original data,
+	it has to be transferred separately.
+	*/
+	namespace lz {
+
+		/// Returns maximal size of compressed data for input of \p n bytes.
+		inline constexpr size_t
+		max_compressed_size(size_t n) noexcept {
+			return n + n/255 + 16;
+		}
+
+		/**
+		\brief Compress \p n bytes from \p src and append the result to \p dst.
+		\return the number of bytes appended
+		*/
+		size_t
+		compress(const char* src, size_t n, std::vector<char>& dst);
+
+		/**
+		\brief Decompress \p n bytes from \p src into \p dst of size
+		\p dst_size.
+		\throws bsc::error if the data is malformed or does not
+		decompress into exactly \p dst_size bytes
+		*/
+		void
+		decompress(const char* src, size_t n, char* dst, size_t dst_size);
+
+	}
+
+}
+
+#endif // vim:filetype=cpp
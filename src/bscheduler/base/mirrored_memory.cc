@@ -0,0 +1,90 @@
+#include "mirrored_memory.hh"
+
+#include <cerrno>
+
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <unistdx/base/bad_call>
+#include <unistdx/base/check>
+
+namespace {
+
+	inline int
+	memfd_create(const char* name) {
+		#if defined(SYS_memfd_create)
+		return ::syscall(SYS_memfd_create, name, 1u /* MFD_CLOEXEC */);
+		#else
+		errno = ENOSYS;
+		return -1;
+		#endif
+	}
+
+	inline size_t
+	round_up_to_page_size(size_t n) {
+		const size_t page_size = ::sysconf(_SC_PAGESIZE);
+		if (n == 0) {
+			n = 1;
+		}
+		return (n + page_size - 1) / page_size * page_size;
+	}
+
+}
+
+bsc::mirrored_memory
+::mirrored_memory(size_t size) {
+	size = round_up_to_page_size(size);
+	int fd = -1;
+	UNISTDX_CHECK(fd = memfd_create("bscheduler-buffer"));
+	void* addr = MAP_FAILED;
+	try {
+		UNISTDX_CHECK(::ftruncate(fd, size));
+		// reserve address space for both mappings
+		addr = ::mmap(
+			nullptr,
+			2*size,
+			PROT_NONE,
+			MAP_PRIVATE | MAP_ANONYMOUS,
+			-1,
+			0
+		);
+		if (addr == MAP_FAILED) {
+			throw sys::bad_call();
+		}
+		char* first = static_cast<char*>(addr);
+		for (char* ptr : {first, first + size}) {
+			void* ret = ::mmap(
+				ptr,
+				size,
+				PROT_READ | PROT_WRITE,
+				MAP_SHARED | MAP_FIXED,
+				fd,
+				0
+			);
+			if (ret == MAP_FAILED) {
+				throw sys::bad_call();
+			}
+		}
+	} catch (...) {
+		if (addr != MAP_FAILED) {
+			::munmap(addr, 2*size);
+		}
+		::close(fd);
+		throw;
+	}
+	// the mappings keep the memory alive
+	::close(fd);
+	this->_data = static_cast<char*>(addr);
+	this->_size = size;
+}
+
+void
+bsc::mirrored_memory
+::close() noexcept {
+	if (this->_data) {
+		::munmap(this->_data, 2*this->_size);
+		this->_data = nullptr;
+		this->_size = 0;
+	}
+}
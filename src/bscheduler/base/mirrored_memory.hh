@@ -0,0 +1,91 @@
+#ifndef BSCHEDULER_BASE_MIRRORED_MEMORY_HH
+#define BSCHEDULER_BASE_MIRRORED_MEMORY_HH
+
+#include <cstddef>
+#include <utility>
+
+namespace bsc {
+
+	/**
+	\brief Memory region that is mapped twice at adjacent virtual addresses.
+	\details
+	The byte at offset \c i and the byte at offset <tt>i + size()</tt>
+	are the same byte, so any range of at most \link size\endlink bytes
+	that starts in the first half is contiguous, even if it wraps
+	around the end of the region. This allows ring buffers to expose
+	their contents as a plain array.
+
+	The memory is allocated with \c memfd_create, the size is
+	rounded up to the multiple of the page size.
+	*/
+	class mirrored_memory {
+
+	private:
+		char* _data = nullptr;
+		size_t _size = 0;
+
+	public:
+
+		mirrored_memory() = default;
+
+		/**
+		\throws sys::bad_call if the memory can not be allocated or mapped
+		*/
+		explicit
+		mirrored_memory(size_t size);
+
+		inline
+		mirrored_memory(mirrored_memory&& rhs) noexcept {
+			this->swap(rhs);
+		}
+
+		inline mirrored_memory&
+		operator=(mirrored_memory&& rhs) noexcept {
+			this->swap(rhs);
+			return *this;
+		}
+
+		mirrored_memory(const mirrored_memory&) = delete;
+		mirrored_memory& operator=(const mirrored_memory&) = delete;
+
+		inline
+		~mirrored_memory() {
+			this->close();
+		}
+
+		/// Returns the beginning of the first mapping.
+		inline char*
+		data() noexcept {
+			return this->_data;
+		}
+
+		inline const char*
+		data() const noexcept {
+			return this->_data;
+		}
+
+		/// Returns the size of one mapping.
+		inline size_t
+		size() const noexcept {
+			return this->_size;
+		}
+
+		inline bool
+		empty() const noexcept {
+			return this->_size == 0;
+		}
+
+		void
+		close() noexcept;
+
+		inline void
+		swap(mirrored_memory& rhs) noexcept {
+			std::swap(this->_data, rhs._data);
+			std::swap(this->_size, rhs._size);
+		}
+
+	};
+
+}
+
+#endif // vim:filetype=cpp
@@ -0,0 +1,260 @@
+#ifndef BSCHEDULER_BASE_MPMC_QUEUE_HH
+#define BSCHEDULER_BASE_MPMC_QUEUE_HH
+
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <thread>
+
+#include <bscheduler/base/container_traits.hh>
+
+namespace bsc {
+
+	/**
+	\brief Bounded lock-free multi-producer/multi-consumer queue.
+	\details
+	This is a ring buffer where each cell carries a sequence number
+	that tells producers and consumers whether the cell is free or
+	occupied (D. Vyukov's algorithm). Capacity is rounded up to the
+	power of two. Methods \c try_push, \c try_pop, \c push may be
+	called concurrently from any number of threads; \c front and \c pop
+	are provided for compatibility with \link queue_traits\endlink and
+	are safe only when there are no concurrent consumers.
+	*/
+	template <class T>
+	class mpmc_queue {
+
+	public:
+		/// Element type.
+		typedef T value_type;
+		/// Size type.
+		typedef std::size_t size_type;
+
+	private:
+
+		struct cell {
+			std::atomic<size_type> sequence;
+			T value;
+		};
+
+		typedef std::unique_ptr<cell[]> cell_array;
+
+		enum { cache_line_size = 64 };
+
+	private:
+		cell_array _cells;
+		size_type _mask = 0;
+		char _padding0[cache_line_size];
+		std::atomic<size_type> _head {0};
+		char _padding1[cache_line_size];
+		std::atomic<size_type> _tail {0};
+		char _padding2[cache_line_size];
+
+	public:
+
+		/// Construct queue with capacity of at least \p capacity elements.
+		inline explicit
+		mpmc_queue(size_type capacity=default_capacity()) {
+			this->init(capacity);
+		}
+
+		/// Move-constructor (not thread-safe).
+		inline
+		mpmc_queue(mpmc_queue&& rhs) noexcept:
+		_cells(std::move(rhs._cells)),
+		_mask(rhs._mask),
+		_head(rhs._head.load()),
+		_tail(rhs._tail.load())
+		{}
+
+		/// Move-assignment (not thread-safe).
+		inline mpmc_queue&
+		operator=(mpmc_queue&& rhs) noexcept {
+			this->_cells = std::move(rhs._cells);
+			this->_mask = rhs._mask;
+			this->_head = rhs._head.load();
+			this->_tail = rhs._tail.load();
+			return *this;
+		}
+
+		mpmc_queue(const mpmc_queue&) = delete;
+
+		mpmc_queue&
+		operator=(const mpmc_queue&) = delete;
+
+		/**
+		\brief Insert element to the queue.
+		\return false, if the queue is full
+		*/
+		bool
+		try_push(const T& x) noexcept {
+			size_type pos = this->_head.load(std::memory_order_relaxed);
+			cell* c;
+			for (;;) {
+				c = &this->_cells[pos & this->_mask];
+				const size_type seq = c->sequence.load(std::memory_order_acquire);
+				const std::ptrdiff_t diff = std::ptrdiff_t(seq) - std::ptrdiff_t(pos);
+				if (diff == 0) {
+					if (this->_head.compare_exchange_weak(
+						pos,
+						pos+1,
+						std::memory_order_relaxed
+					)) {
+						break;
+					}
+				} else if (diff < 0) {
+					return false;
+				} else {
+					pos = this->_head.load(std::memory_order_relaxed);
+				}
+			}
+			c->value = x;
+			c->sequence.store(pos+1, std::memory_order_release);
+			return true;
+		}
+
+		/**
+		\brief Remove the first element from the queue.
+		\return false, if the queue is empty
+		*/
+		bool
+		try_pop(T& x) noexcept {
+			size_type pos = this->_tail.load(std::memory_order_relaxed);
+			cell* c;
+			for (;;) {
+				c = &this->_cells[pos & this->_mask];
+				const size_type seq = c->sequence.load(std::memory_order_acquire);
+				const std::ptrdiff_t diff =
+					std::ptrdiff_t(seq) - std::ptrdiff_t(pos+1);
+				if (diff == 0) {
+					if (this->_tail.compare_exchange_weak(
+						pos,
+						pos+1,
+						std::memory_order_relaxed
+					)) {
+						break;
+					}
+				} else if (diff < 0) {
+					return false;
+				} else {
+					pos = this->_tail.load(std::memory_order_relaxed);
+				}
+			}
+			x = c->value;
+			c->sequence.store(pos + this->_mask + 1, std::memory_order_release);
+			return true;
+		}
+
+		/// Insert element to the queue, wait while the queue is full.
+		inline void
+		push(const T& x) noexcept {
+			while (!this->try_push(x)) {
+				std::this_thread::yield();
+			}
+		}
+
+		/// Returns the first element (no concurrent consumers allowed).
+		inline T&
+		front() noexcept {
+			return this->_cells[this->_tail.load() & this->_mask].value;
+		}
+
+		/// Removes the first element (no concurrent consumers allowed).
+		inline void
+		pop() noexcept {
+			T tmp;
+			this->try_pop(tmp);
+		}
+
+		/// Returns true, if the queue is empty (approximate).
+		inline bool
+		empty() const noexcept {
+			return this->size() == 0;
+		}
+
+		/// Returns the number of elements in the queue (approximate).
+		inline size_type
+		size() const noexcept {
+			const size_type t = this->_tail.load(std::memory_order_acquire);
+			const size_type h = this->_head.load(std::memory_order_acquire);
+			return h > t ? h - t : 0;
+		}
+
+		/// Returns the maximal number of elements in the queue.
+		inline size_type
+		capacity() const noexcept {
+			return this->_mask + 1;
+		}
+
+		/// Default queue capacity.
+		inline static constexpr size_type
+		default_capacity() noexcept {
+			return size_type(1) << 16;
+		}
+
+	private:
+
+		void
+		init(size_type capacity) {
+			size_type n = 2;
+			while (n < capacity) {
+				n <<= 1;
+			}
+			this->_cells.reset(new cell[n]);
+			for (size_type i=0; i<n; ++i) {
+				this->_cells[i].sequence.store(i, std::memory_order_relaxed);
+			}
+			this->_mask = n-1;
+		}
+
+	};
+
+	/**
+	\brief Container traits for \link mpmc_queue\endlink.
+	\ingroup traits
+	\details
+	In addition to the usual methods, provides \c try_push and \c try_pop
+	that do not block and may be used concurrently.
+	*/
+	template <class T>
+	struct queue_traits<mpmc_queue<T>>:
+	public container_traits<mpmc_queue<T>> {
+
+		using typename container_traits<mpmc_queue<T>>::container_type;
+		using typename container_traits<mpmc_queue<T>>::value_type;
+
+		/// Push element to the container, wait while it is full.
+		inline static void
+		push(container_type& cnt, const value_type& rhs) {
+			cnt.push(rhs);
+		}
+
+		/// Push element to the container, if it is not full.
+		inline static bool
+		try_push(container_type& cnt, const value_type& rhs) {
+			return cnt.try_push(rhs);
+		}
+
+		/// Remove the first element from the container, if it is not empty.
+		inline static bool
+		try_pop(container_type& cnt, value_type& rhs) {
+			return cnt.try_pop(rhs);
+		}
+
+		/// Returns the first element in the container.
+		inline static value_type&
+		front(container_type& cnt) {
+			return cnt.front();
+		}
+
+		/// Removes the first element in the container.
+		inline static void
+		pop(container_type& cnt) {
+			cnt.pop();
+		}
+
+	};
+
+}
+
+#endif // vim:filetype=cpp
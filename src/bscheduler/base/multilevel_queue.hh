@@ -0,0 +1,142 @@
+#ifndef BSCHEDULER_BASE_MULTILEVEL_QUEUE_HH
+#define BSCHEDULER_BASE_MULTILEVEL_QUEUE_HH
+
+#include <algorithm>
+#include <cstddef>
+
+namespace bsc {
+
+	/**
+	\brief Queue with a separate sub-queue for each priority level.
+	\details
+	Elements are pointers to objects with \c priority() method, that returns
+	enumeration or integer in \f$[0,N)\f$ (the larger, the higher).
+	Priorities out of range are clamped. Sub-queues are served in weighted
+	round-robin order: each level may dequeue up to
+	\f$2^{2l}\f$ elements (\link weight\endlink) before the
+	lower levels get their turn, and the weights are restored when all
+	non-empty levels exhaust them. Higher priorities overtake queued elements
+	of lower priorities, but lower priorities are never starved.
+	Like any other queue in pipelines, the queue is not thread-safe.
+	\tparam Queue sub-queue type
+	\tparam N the number of priority levels
+	*/
+	template <class Queue, size_t N>
+	class multilevel_queue {
+
+		static_assert(N > 0, "bad number of levels");
+
+	public:
+		/// Sub-queue type.
+		typedef Queue queue_type;
+		/// Element type.
+		typedef typename Queue::value_type value_type;
+		/// Size type.
+		typedef size_t size_type;
+
+	private:
+		queue_type _queues[N];
+		/// How many elements each level may dequeue before others' turn.
+		size_type _credits[N];
+		size_type _size = 0;
+
+	public:
+
+		inline
+		multilevel_queue() {
+			this->refill();
+		}
+
+		multilevel_queue(multilevel_queue&&) = default;
+
+		multilevel_queue&
+		operator=(multilevel_queue&&) = default;
+
+		multilevel_queue(const multilevel_queue&) = delete;
+
+		multilevel_queue&
+		operator=(const multilevel_queue&) = delete;
+
+		/// Insert element to the sub-queue of its priority level.
+		inline void
+		push(const value_type& x) {
+			this->_queues[level(x)].push(x);
+			++this->_size;
+		}
+
+		/// Returns the next element (the queue must not be empty).
+		inline value_type&
+		front() {
+			return this->_queues[this->current()].front();
+		}
+
+		/// Removes the next element (the queue must not be empty).
+		inline void
+		pop() {
+			const size_type l = this->current();
+			this->_queues[l].pop();
+			--this->_credits[l];
+			--this->_size;
+		}
+
+		inline bool
+		empty() const noexcept {
+			return this->_size == 0;
+		}
+
+		inline size_type
+		size() const noexcept {
+			return this->_size;
+		}
+
+		/// Returns the number of elements with priority level \p l.
+		inline size_type
+		size(size_type l) const {
+			return this->_queues[l].size();
+		}
+
+		/// The number of elements that level \p l dequeues in its turn.
+		inline static constexpr size_type
+		weight(size_type l) noexcept {
+			return size_type(1) << (2*l);
+		}
+
+		/// Returns the number of priority levels.
+		inline static constexpr size_type
+		levels() noexcept {
+			return N;
+		}
+
+	private:
+
+		inline static size_type
+		level(const value_type& x) {
+			return std::min(size_type(x->priority()), N-1);
+		}
+
+		/// Returns the highest non-empty level that has not used its turn.
+		size_type
+		current() {
+			for (int attempt=0; attempt<2; ++attempt) {
+				for (size_type l=N; l-- > 0; ) {
+					if (this->_credits[l] > 0 && !this->_queues[l].empty()) {
+						return l;
+					}
+				}
+				this->refill();
+			}
+			return 0;
+		}
+
+		inline void
+		refill() noexcept {
+			for (size_type l=0; l<N; ++l) {
+				this->_credits[l] = weight(l);
+			}
+		}
+
+	};
+
+}
+
+#endif // vim:filetype=cpp
@@ -0,0 +1,30 @@
+#ifndef BSCHEDULER_BASE_NULL_MUTEX_HH
+#define BSCHEDULER_BASE_NULL_MUTEX_HH
+
+namespace bsc {
+
+	/**
+	\brief Mutex that does nothing.
+	\details
+	Used as a mutex type for pipelines with lock-free kernel queues.
+	*/
+	class null_mutex {
+
+	public:
+
+		inline void
+		lock() noexcept {}
+
+		inline void
+		unlock() noexcept {}
+
+		inline bool
+		try_lock() noexcept {
+			return true;
+		}
+
+	};
+
+}
+
+#endif // vim:filetype=cpp
@@ -0,0 +1,140 @@
+#include "numa.hh"
+
+#include <algorithm>
+#include <fstream>
+#include <iterator>
+#include <ostream>
+#include <sstream>
+
+#include <sched.h>
+
+#include <unistdx/base/check>
+#include <unistdx/it/intersperse_iterator>
+
+#include <bscheduler/base/error.hh>
+
+thread_local bsc::numa_node_id bsc::this_thread::numa_node = bsc::no_numa_node;
+
+namespace {
+
+	const char* sysfs_node_dir = "/sys/devices/system/node/";
+
+	bool
+	read_cpu_list(const std::string& filename, std::vector<unsigned>& result) {
+		std::ifstream in(filename);
+		std::string str;
+		if (!(in >> str)) {
+			return false;
+		}
+		result = bsc::parse_cpu_list(str);
+		return true;
+	}
+
+	std::vector<unsigned>
+	available_cpus() {
+		std::vector<unsigned> result;
+		::cpu_set_t set;
+		CPU_ZERO(&set);
+		UNISTDX_CHECK(::sched_getaffinity(0, sizeof(set), &set));
+		for (unsigned i=0; i<CPU_SETSIZE; ++i) {
+			if (CPU_ISSET(i, &set)) {
+				result.emplace_back(i);
+			}
+		}
+		return result;
+	}
+
+	std::vector<unsigned>
+	intersection(
+		const std::vector<unsigned>& lhs,
+		const std::vector<unsigned>& rhs
+	) {
+		std::vector<unsigned> result;
+		std::set_intersection(
+			lhs.begin(), lhs.end(),
+			rhs.begin(), rhs.end(),
+			std::back_inserter(result)
+		);
+		return result;
+	}
+
+}
+
+std::ostream&
+bsc::operator<<(std::ostream& out, const numa_node& rhs) {
+	out << "node" << rhs.id << '=';
+	std::copy(
+		rhs.cpus.begin(),
+		rhs.cpus.end(),
+		sys::intersperse_iterator<unsigned,char>(out, ',')
+	);
+	return out;
+}
+
+std::vector<unsigned>
+bsc::parse_cpu_list(const std::string& str) {
+	std::vector<unsigned> result;
+	std::istringstream in(str);
+	in >> std::noskipws;
+	unsigned first = 0, last = 0;
+	char ch = 0;
+	while (in >> first) {
+		last = first;
+		if (in.peek() == '-') {
+			in.get();
+			if (!(in >> last) || last < first) {
+				BSCHEDULER_THROW(error, "bad cpu list");
+			}
+		}
+		for (unsigned i=first; i<=last; ++i) {
+			result.emplace_back(i);
+		}
+		if (!in.get(ch)) {
+			break;
+		}
+		if (ch != ',') {
+			BSCHEDULER_THROW(error, "bad cpu list");
+		}
+	}
+	if (!in.eof()) {
+		BSCHEDULER_THROW(error, "bad cpu list");
+	}
+	std::sort(result.begin(), result.end());
+	result.erase(std::unique(result.begin(), result.end()), result.end());
+	return result;
+}
+
+std::vector<bsc::numa_node>
+bsc::numa_nodes() {
+	std::vector<numa_node> result;
+	const std::vector<unsigned> cpus = available_cpus();
+	std::vector<unsigned> ids;
+	if (read_cpu_list(std::string(sysfs_node_dir) + "online", ids)) {
+		for (unsigned id : ids) {
+			std::vector<unsigned> node_cpus;
+			std::ostringstream filename;
+			filename << sysfs_node_dir << "node" << id << "/cpulist";
+			if (read_cpu_list(filename.str(), node_cpus)) {
+				numa_node node(id, intersection(node_cpus, cpus));
+				if (!node.empty()) {
+					result.emplace_back(std::move(node));
+				}
+			}
+		}
+	}
+	if (result.empty()) {
+		result.emplace_back(0, cpus);
+	}
+	return result;
+}
+
+void
+bsc::pin_this_thread(const numa_node& rhs, numa_node_id index) {
+	::cpu_set_t set;
+	CPU_ZERO(&set);
+	for (unsigned cpu : rhs.cpus) {
+		CPU_SET(cpu, &set);
+	}
+	UNISTDX_CHECK(::sched_setaffinity(0, sizeof(set), &set));
+	this_thread::numa_node = index;
+}
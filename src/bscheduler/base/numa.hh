@@ -0,0 +1,90 @@
+#ifndef BSCHEDULER_BASE_NUMA_HH
+#define BSCHEDULER_BASE_NUMA_HH
+
+#include <iosfwd>
+#include <limits>
+#include <string>
+#include <vector>
+
+namespace bsc {
+
+	/// NUMA node identifier.
+	typedef unsigned numa_node_id;
+
+	/// Identifier of unknown NUMA node.
+	constexpr const numa_node_id no_numa_node =
+		std::numeric_limits<numa_node_id>::max();
+
+	/**
+	\brief NUMA node and its processors.
+	\details
+	Processors are numbered as in the operating system.
+	*/
+	struct numa_node {
+		/// Operating system node number.
+		numa_node_id id = 0;
+		/// Processors of the node.
+		std::vector<unsigned> cpus;
+
+		numa_node() = default;
+
+		inline
+		numa_node(numa_node_id id, std::vector<unsigned> cpus):
+		id(id),
+		cpus(std::move(cpus))
+		{}
+
+		/// Returns true, if the node has no processors.
+		inline bool
+		empty() const noexcept {
+			return this->cpus.empty();
+		}
+
+	};
+
+	std::ostream&
+	operator<<(std::ostream& out, const numa_node& rhs);
+
+	/**
+	\brief Parse processor list in Linux format (e.g. "0-3,8,10-11").
+	\throws bsc::error if the list is malformed
+	*/
+	std::vector<unsigned>
+	parse_cpu_list(const std::string& str);
+
+	/**
+	\brief Returns NUMA nodes that have processors available to the process.
+	\details
+	The nodes are read from \c /sys/devices/system/node. Processors that are
+	not in the process affinity mask are omitted, as well as nodes without
+	such processors (memory-only nodes). If NUMA topology is not available,
+	all available processors are returned as one node.
+	*/
+	std::vector<numa_node>
+	numa_nodes();
+
+	/**
+	\brief Bind the calling thread to the processors of the node \p rhs.
+	\details
+	Also sets \link this_thread::numa_node\endlink to \p index.
+	\throws sys::bad_call
+	*/
+	void
+	pin_this_thread(const numa_node& rhs, numa_node_id index);
+
+	namespace this_thread {
+
+		/**
+		\brief Index of the node to which the current thread is bound
+		or \link no_numa_node\endlink.
+		\details
+		This is an index in the array of nodes of the current process,
+		not the operating system node number.
+		*/
+		extern thread_local numa_node_id numa_node;
+
+	}
+
+}
+
+#endif // vim:filetype=cpp
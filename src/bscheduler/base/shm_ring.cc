@@ -0,0 +1,224 @@
+#include "shm_ring.hh"
+
+#include <cerrno>
+#include <new>
+
+#include <fcntl.h>
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <unistdx/base/bad_call>
+#include <unistdx/base/check>
+
+namespace {
+
+	/// Headers of both rings occupy the first page.
+	constexpr const size_t headers_size = 4096;
+
+	static_assert(
+		2*sizeof(bsc::shm_ring_header) <= headers_size,
+		"bad headers size"
+	);
+
+	inline size_t
+	round_up_to_power_of_two(size_t n) noexcept {
+		size_t result = headers_size;
+		while (result < n) {
+			result <<= 1;
+		}
+		return result;
+	}
+
+	inline int
+	memfd_create(const char* name) {
+		#if defined(SYS_memfd_create)
+		return ::syscall(SYS_memfd_create, name, 1u /* MFD_CLOEXEC */);
+		#else
+		errno = ENOSYS;
+		return -1;
+		#endif
+	}
+
+}
+
+bsc::shm_channel
+::shm_channel(
+	fd_type memory,
+	fd_type parent_event,
+	fd_type child_event,
+	role_type role,
+	fd_type lifeline
+):
+_memory(memory),
+_events{parent_event, child_event},
+_role(role) {
+	this->_lifelines[role == role_type::parent ? 0 : 1] = lifeline;
+	struct ::stat st;
+	UNISTDX_CHECK(::fstat(this->_memory, &st));
+	this->_size = st.st_size;
+	this->map(false);
+}
+
+bsc::shm_channel
+bsc::shm_channel
+::create(size_t capacity) {
+	shm_channel result;
+	capacity = round_up_to_power_of_two(capacity);
+	result._role = role_type::parent;
+	UNISTDX_CHECK(result._memory = memfd_create("bscheduler-ring"));
+	result._size = headers_size + 2*capacity;
+	UNISTDX_CHECK(::ftruncate(result._memory, result._size));
+	for (fd_type& fd : result._events) {
+		UNISTDX_CHECK(fd = ::eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK));
+	}
+	UNISTDX_CHECK(
+		::socketpair(
+			AF_UNIX,
+			SOCK_STREAM | SOCK_CLOEXEC | SOCK_NONBLOCK,
+			0,
+			result._lifelines
+		)
+	);
+	result.map(true);
+	return result;
+}
+
+void
+bsc::shm_channel
+::map(bool init) {
+	if (this->_size <= headers_size) {
+		errno = EINVAL;
+		throw sys::bad_call();
+	}
+	void* addr = ::mmap(
+		nullptr,
+		this->_size,
+		PROT_READ | PROT_WRITE,
+		MAP_SHARED,
+		this->_memory,
+		0
+	);
+	if (addr == MAP_FAILED) {
+		throw sys::bad_call();
+	}
+	this->_addr = addr;
+	const size_t capacity = (this->_size - headers_size) / 2;
+	char* first = static_cast<char*>(addr);
+	shm_ring_header* headers = reinterpret_cast<shm_ring_header*>(first);
+	if (init) {
+		new (headers) shm_ring_header;
+		new (headers + 1) shm_ring_header;
+	}
+	// ring 0 goes from parent to child, ring 1 from child to parent
+	shm_ring down(headers, first + headers_size, capacity);
+	shm_ring up(headers + 1, first + headers_size + capacity, capacity);
+	if (init) {
+		down.reset();
+		up.reset();
+	}
+	if (this->_role == role_type::parent) {
+		this->_out = down;
+		this->_in = up;
+	} else {
+		this->_in = down;
+		this->_out = up;
+	}
+}
+
+size_t
+bsc::shm_channel
+::write(const char* s, size_t n) {
+	bool was_empty = false;
+	const size_t m = this->_out.write(s, n, was_empty);
+	if (was_empty) {
+		this->ring(this->peer_doorbell());
+	}
+	if (m < n && this->_out.wait_for_space()) {
+		// the consumer has freed some space after the write
+		this->ring(this->doorbell());
+	}
+	return m;
+}
+
+size_t
+bsc::shm_channel
+::read(char* s, size_t n) {
+	this->consume(this->doorbell());
+	bool notify_producer = false;
+	const size_t m = this->_in.read(s, n, notify_producer);
+	if (notify_producer) {
+		this->ring(this->peer_doorbell());
+	}
+	if (!this->_in.empty()) {
+		// the buffer is full, read the rest on the next event
+		this->ring(this->doorbell());
+	}
+	return m;
+}
+
+void
+bsc::shm_channel
+::ring(fd_type fd) noexcept {
+	const std::uint64_t one = 1;
+	// the counter never overflows in practice, errors are ignored
+	ssize_t ret = ::write(fd, &one, sizeof(one));
+	static_cast<void>(ret);
+}
+
+void
+bsc::shm_channel
+::consume(fd_type fd) noexcept {
+	std::uint64_t count = 0;
+	ssize_t ret = ::read(fd, &count, sizeof(count));
+	static_cast<void>(ret);
+}
+
+void
+bsc::shm_channel
+::unset_close_on_exec() {
+	// the parent's end of the lifeline is closed on exec
+	for (fd_type fd : {
+		this->_memory,
+		this->_events[0],
+		this->_events[1],
+		this->_lifelines[1]
+	}) {
+		UNISTDX_CHECK(::fcntl(fd, F_SETFD, 0));
+	}
+}
+
+void
+bsc::shm_channel
+::close_in_parent() noexcept {
+	if (this->_lifelines[1] != -1) {
+		::close(this->_lifelines[1]);
+		this->_lifelines[1] = -1;
+	}
+}
+
+void
+bsc::shm_channel
+::close() noexcept {
+	if (this->_addr) {
+		::munmap(this->_addr, this->_size);
+		this->_addr = nullptr;
+	}
+	for (fd_type* fd : {
+		&this->_memory,
+		&this->_events[0],
+		&this->_events[1],
+		&this->_lifelines[0],
+		&this->_lifelines[1]
+	}) {
+		if (*fd != -1) {
+			::close(*fd);
+			*fd = -1;
+		}
+	}
+	this->_in = shm_ring();
+	this->_out = shm_ring();
+}
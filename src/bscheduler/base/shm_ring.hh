@@ -0,0 +1,386 @@
+#ifndef BSCHEDULER_BASE_SHM_RING_HH
+#define BSCHEDULER_BASE_SHM_RING_HH
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <utility>
+
+namespace bsc {
+
+	/**
+	\brief Positions of single-producer/single-consumer ring in shared memory.
+	\details
+	Positions grow monotonically, the offset in the buffer is
+	position modulo capacity. Producer and consumer positions
+	are in separate cache lines.
+	*/
+	struct shm_ring_header {
+		/// Consumer position.
+		alignas(64) std::atomic<std::uint64_t> head;
+		/// Producer position.
+		alignas(64) std::atomic<std::uint64_t> tail;
+		/// Non-zero, if the producer waits for free space.
+		alignas(64) std::atomic<std::uint32_t> producer_waits;
+	};
+
+	static_assert(
+		ATOMIC_LLONG_LOCK_FREE == 2,
+		"shared memory ring needs lock-free atomics"
+	);
+
+	/**
+	\brief Single-producer/single-consumer byte ring.
+	\details
+	The ring does not own the memory: the header and the buffer
+	are usually mapped into both processes. Capacity must be
+	a power of two.
+
+	The producer and the consumer notify each other only when
+	the other side may sleep: \link write\endlink reports that the ring
+	was empty and \link read\endlink reports that the producer waits
+	for free space. Each side publishes its update, issues
+	sequentially consistent fence and then checks the state of the
+	other side. Since the two fences are totally ordered, either the
+	side that publishes sees the update of the side that is going to
+	sleep and notifies it, or the side that is going to sleep sees
+	the update in its own re-check (\link empty\endlink after
+	\link read\endlink, the return value of \link wait_for_space\endlink)
+	and does not sleep.
+	*/
+	class shm_ring {
+
+	public:
+		typedef std::uint64_t position_type;
+
+	private:
+		shm_ring_header* _header = nullptr;
+		char* _data = nullptr;
+		size_t _capacity = 0;
+
+	public:
+
+		shm_ring() = default;
+
+		inline
+		shm_ring(shm_ring_header* header, char* data, size_t capacity) noexcept:
+		_header(header),
+		_data(data),
+		_capacity(capacity)
+		{}
+
+		/// Initialise the header of new ring.
+		inline void
+		reset() noexcept {
+			this->_header->head.store(0);
+			this->_header->tail.store(0);
+			this->_header->producer_waits.store(0);
+		}
+
+		/**
+		\brief Write at most \p n bytes.
+		\param[out] was_empty true, if the consumer has read all bytes
+		written before this call and needs to be notified
+		\return the number of bytes written
+		*/
+		size_t
+		write(const char* s, size_t n, bool& was_empty) noexcept {
+			const position_type tail =
+				this->_header->tail.load(std::memory_order_relaxed);
+			const position_type head =
+				this->_header->head.load(std::memory_order_acquire);
+			const size_t m = std::min<size_t>(n, this->_capacity - (tail - head));
+			was_empty = false;
+			if (m == 0) {
+				return 0;
+			}
+			const size_t i = this->offset(tail);
+			const size_t first = std::min(m, this->_capacity - i);
+			std::memcpy(this->_data + i, s, first);
+			std::memcpy(this->_data, s + first, m - first);
+			this->_header->tail.store(tail + m, std::memory_order_release);
+			// pairs with the fence in read
+			std::atomic_thread_fence(std::memory_order_seq_cst);
+			was_empty =
+				this->_header->head.load(std::memory_order_relaxed) == tail;
+			return m;
+		}
+
+		/**
+		\brief Read at most \p n bytes.
+		\param[out] notify_producer true, if the producer waited for
+		free space and needs to be notified
+		\return the number of bytes read
+		*/
+		size_t
+		read(char* s, size_t n, bool& notify_producer) noexcept {
+			const position_type head =
+				this->_header->head.load(std::memory_order_relaxed);
+			const position_type tail =
+				this->_header->tail.load(std::memory_order_acquire);
+			const size_t m = std::min<size_t>(n, tail - head);
+			notify_producer = false;
+			if (m == 0) {
+				return 0;
+			}
+			const size_t i = this->offset(head);
+			const size_t first = std::min(m, this->_capacity - i);
+			std::memcpy(s, this->_data + i, first);
+			std::memcpy(s + first, this->_data, m - first);
+			this->_header->head.store(head + m, std::memory_order_release);
+			// pairs with the fences in write and wait_for_space
+			std::atomic_thread_fence(std::memory_order_seq_cst);
+			if (this->_header->producer_waits.load(std::memory_order_relaxed)) {
+				this->_header->producer_waits.store(0, std::memory_order_relaxed);
+				notify_producer = true;
+			}
+			return m;
+		}
+
+		/**
+		\brief Tell the consumer that the producer waits for free space.
+		\return true, if the space has already become available
+		*/
+		inline bool
+		wait_for_space() noexcept {
+			this->_header->producer_waits.store(1, std::memory_order_relaxed);
+			// pairs with the fence in read
+			std::atomic_thread_fence(std::memory_order_seq_cst);
+			return this->free_space() != 0;
+		}
+
+		/**
+		\brief Returns the number of bytes available to the consumer.
+		\details
+		The consumer calls this method after \link read\endlink to check
+		if the producer has written more bytes before the fence.
+		*/
+		inline size_t
+		size() const noexcept {
+			return this->_header->tail.load(std::memory_order_acquire) -
+				this->_header->head.load(std::memory_order_acquire);
+		}
+
+		inline bool
+		empty() const noexcept {
+			return this->size() == 0;
+		}
+
+		/// Returns the number of bytes available to the producer.
+		inline size_t
+		free_space() const noexcept {
+			return this->_capacity - this->size();
+		}
+
+		inline size_t
+		capacity() const noexcept {
+			return this->_capacity;
+		}
+
+	private:
+
+		inline size_t
+		offset(position_type pos) const noexcept {
+			return pos & (this->_capacity - 1);
+		}
+
+	};
+
+	/**
+	\brief Two shared memory rings and two event file descriptors
+	that connect parent and child process.
+	\details
+	The memory is allocated with \c memfd_create, and
+	each process polls its own \c eventfd ("doorbell"), that is rung
+	by the other process when new data arrives or free space
+	becomes available. The parent creates the channel with
+	\link create\endlink, the child adopts the inherited
+	file descriptors with the constructor.
+
+	Neither the memory nor the doorbells tell that the other process
+	has exited. Each process also holds one end of a socket pair
+	("lifeline") that is never written to: it becomes readable with
+	end-of-file, when the other process exits.
+	*/
+	class shm_channel {
+
+	public:
+		typedef int fd_type;
+
+		enum class role_type {
+			parent,
+			child
+		};
+
+	private:
+		fd_type _memory = -1;
+		fd_type _events[2] = {-1, -1};
+		fd_type _lifelines[2] = {-1, -1};
+		void* _addr = nullptr;
+		size_t _size = 0;
+		role_type _role = role_type::parent;
+		shm_ring _in;
+		shm_ring _out;
+
+	public:
+
+		shm_channel() = default;
+
+		/**
+		\brief Adopt file descriptors inherited from the parent process.
+		\throws sys::bad_call if the memory can not be mapped
+		*/
+		shm_channel(
+			fd_type memory,
+			fd_type parent_event,
+			fd_type child_event,
+			role_type role,
+			fd_type lifeline=-1
+		);
+
+		inline
+		shm_channel(shm_channel&& rhs) noexcept {
+			this->swap(rhs);
+		}
+
+		inline shm_channel&
+		operator=(shm_channel&& rhs) noexcept {
+			this->swap(rhs);
+			return *this;
+		}
+
+		shm_channel(const shm_channel&) = delete;
+		shm_channel& operator=(const shm_channel&) = delete;
+
+		inline
+		~shm_channel() {
+			this->close();
+		}
+
+		/**
+		\brief Create the channel with rings of \p capacity bytes
+		in each direction.
+		\details
+		Capacity is rounded up to the power of two.
+		\throws sys::bad_call if memfd or eventfd are not available
+		*/
+		static shm_channel
+		create(size_t capacity);
+
+		/**
+		\brief Write at most \p n bytes to the outgoing ring.
+		\details
+		Rings the doorbell of the other process, if it may sleep.
+		*/
+		size_t
+		write(const char* s, size_t n);
+
+		/**
+		\brief Read at most \p n bytes from the incoming ring.
+		\details
+		Consumes notifications from this process' doorbell and rings
+		it again, if some bytes are left in the ring.
+		*/
+		size_t
+		read(char* s, size_t n);
+
+		/// Returns the file descriptor to poll for incoming data and free space.
+		inline fd_type
+		doorbell() const noexcept {
+			return this->_events[this->_role == role_type::parent ? 0 : 1];
+		}
+
+		inline fd_type
+		memory_fd() const noexcept {
+			return this->_memory;
+		}
+
+		inline fd_type
+		parent_event_fd() const noexcept {
+			return this->_events[0];
+		}
+
+		inline fd_type
+		child_event_fd() const noexcept {
+			return this->_events[1];
+		}
+
+		/**
+		\brief Returns the file descriptor that becomes readable with
+		end-of-file, when the other process exits.
+		\details
+		Returns -1, if the other side did not pass the lifeline.
+		*/
+		inline fd_type
+		lifeline() const noexcept {
+			return this->_lifelines[this->_role == role_type::parent ? 0 : 1];
+		}
+
+		inline fd_type
+		child_lifeline_fd() const noexcept {
+			return this->_lifelines[1];
+		}
+
+		inline bool
+		is_open() const noexcept {
+			return this->_addr != nullptr;
+		}
+
+		inline size_t
+		capacity() const noexcept {
+			return this->_in.capacity();
+		}
+
+		/// Let child process inherit file descriptors on \c exec.
+		void
+		unset_close_on_exec();
+
+		/**
+		\brief Close the child's end of the lifeline in the parent process.
+		\details
+		Must be called after the child process has been forked,
+		otherwise the parent does not see the exit of the child.
+		*/
+		void
+		close_in_parent() noexcept;
+
+		void
+		close() noexcept;
+
+		inline void
+		swap(shm_channel& rhs) noexcept {
+			std::swap(this->_memory, rhs._memory);
+			std::swap(this->_events[0], rhs._events[0]);
+			std::swap(this->_events[1], rhs._events[1]);
+			std::swap(this->_lifelines[0], rhs._lifelines[0]);
+			std::swap(this->_lifelines[1], rhs._lifelines[1]);
+			std::swap(this->_addr, rhs._addr);
+			std::swap(this->_size, rhs._size);
+			std::swap(this->_role, rhs._role);
+			std::swap(this->_in, rhs._in);
+			std::swap(this->_out, rhs._out);
+		}
+
+	private:
+
+		void
+		map(bool init);
+
+		void
+		ring(fd_type fd) noexcept;
+
+		void
+		consume(fd_type fd) noexcept;
+
+		inline fd_type
+		peer_doorbell() const noexcept {
+			return this->_events[this->_role == role_type::parent ? 1 : 0];
+		}
+
+	};
+
+}
+
+#endif // vim:filetype=cpp
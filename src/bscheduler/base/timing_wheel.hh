@@ -0,0 +1,331 @@
+#ifndef BSCHEDULER_BASE_TIMING_WHEEL_HH
+#define BSCHEDULER_BASE_TIMING_WHEEL_HH
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <limits>
+#include <unordered_map>
+#include <vector>
+
+namespace bsc {
+
+	/**
+	\brief Hierarchical timing wheel.
+	\details
+	Elements are pointers to objects with \c at(), \c id() and \c has_id()
+	methods (usually kernels). Time is divided into ticks. There are
+	\link nlevels\endlink levels with \link nslots\endlink slots each,
+	a slot of the level \f$l\f$ spans \f$nslots^l\f$ ticks. An element
+	is inserted in the slot of the lowest level that covers its expiry
+	time in \f$O(1)\f$, and is moved to the lower level when the wheel
+	reaches the slot ("cascade"). Elements that are scheduled too far in
+	the future wait in the last level and are cascaded repeatedly.
+	Elements with ids can be removed before they expire.
+	The wheel is not thread-safe.
+	\tparam T element type
+	*/
+	template <class T>
+	class timing_wheel {
+
+	public:
+		/// Element type.
+		typedef T value_type;
+		/// Clock type.
+		typedef typename T::clock_type clock_type;
+		/// Time point type.
+		typedef typename clock_type::time_point time_point;
+		/// Duration type.
+		typedef typename clock_type::duration duration;
+		/// Element identifier type.
+		typedef typename T::id_type id_type;
+		/// Tick counter type.
+		typedef std::uint64_t tick_type;
+
+		enum: unsigned {
+			/// The number of bits in a slot index.
+			slot_bits = 8,
+			/// The number of slots in each level.
+			nslots = 1u << slot_bits,
+			/// The number of levels.
+			nlevels = 4
+		};
+
+	private:
+		struct location {
+			unsigned level;
+			unsigned slot;
+		};
+
+		typedef std::vector<T*> bucket_type;
+		typedef std::unordered_map<id_type,location> location_map;
+
+	private:
+		bucket_type _buckets[nlevels][nslots];
+		/// Elements that have expired, but were not yet removed from the wheel.
+		bucket_type _expired;
+		/// Locations of the elements with ids.
+		location_map _locations;
+		time_point _start;
+		duration _tick;
+		/// The current tick.
+		tick_type _now = 0;
+		size_t _size = 0;
+
+	public:
+
+		/// Construct the wheel with resolution \p tick.
+		inline explicit
+		timing_wheel(
+			duration tick=std::chrono::milliseconds(1),
+			time_point start=clock_type::now()
+		):
+		_start(start),
+		_tick(std::max(tick, duration(1)))
+		{}
+
+		timing_wheel(timing_wheel&&) = default;
+
+		timing_wheel&
+		operator=(timing_wheel&&) = default;
+
+		timing_wheel(const timing_wheel&) = delete;
+
+		timing_wheel&
+		operator=(const timing_wheel&) = delete;
+
+		/// Insert element \p x in \f$O(1)\f$.
+		void
+		insert(T* x) {
+			const tick_type t = this->ticks_ceil(x->at());
+			if (t <= this->_now) {
+				this->expire(x);
+			} else {
+				this->place(x, t);
+			}
+			++this->_size;
+		}
+
+		/**
+		\brief Remove the element with the specified id.
+		\return the element or nullptr, if it was not found
+		*/
+		T*
+		remove(id_type id) {
+			T* result = nullptr;
+			auto pos = this->_locations.find(id);
+			if (pos != this->_locations.end()) {
+				const location loc = pos->second;
+				bucket_type& bucket = loc.level == nlevels
+					? this->_expired
+					: this->_buckets[loc.level][loc.slot];
+				auto it = std::find_if(
+					bucket.begin(),
+					bucket.end(),
+					[id] (T* rhs) { return rhs->id() == id; }
+				);
+				if (it != bucket.end()) {
+					result = *it;
+					*it = bucket.back();
+					bucket.pop_back();
+					--this->_size;
+				}
+				this->_locations.erase(pos);
+			}
+			return result;
+		}
+
+		/**
+		\brief Advance the wheel to the time point \p t and move expired
+		elements to \p result.
+		*/
+		template <class It>
+		void
+		advance(time_point t, It result) {
+			const tick_type target = this->ticks_floor(t);
+			while (this->_now < target) {
+				// skip ticks where nothing happens
+				const tick_type next = this->next_event();
+				if (next > target) {
+					this->_now = target;
+				} else {
+					this->_now = next-1;
+					this->step();
+				}
+			}
+			for (T* x : this->_expired) {
+				if (x->has_id()) {
+					this->_locations.erase(x->id());
+				}
+				*result = x;
+				++result;
+			}
+			this->_size -= this->_expired.size();
+			this->_expired.clear();
+		}
+
+		/**
+		\brief Returns the time point at which the wheel should be advanced.
+		\details
+		This is either the expiry time of the nearest slot of the first level,
+		or the time of the nearest cascade. The wheel must not be empty.
+		*/
+		time_point
+		next_expiry() const noexcept {
+			return this->time_of(
+				this->_expired.empty() ? this->next_event() : this->_now
+			);
+		}
+
+		/// Move all elements to \p result.
+		template <class It>
+		void
+		clear(It result) {
+			for (unsigned i=0; i<nlevels; ++i) {
+				for (bucket_type& bucket : this->_buckets[i]) {
+					for (T* x : bucket) {
+						*result = x;
+						++result;
+					}
+					bucket.clear();
+				}
+			}
+			for (T* x : this->_expired) {
+				*result = x;
+				++result;
+			}
+			this->_expired.clear();
+			this->_locations.clear();
+			this->_size = 0;
+		}
+
+		/// Returns true, if there are no elements in the wheel.
+		inline bool
+		empty() const noexcept {
+			return this->_size == 0;
+		}
+
+		/// Returns the number of elements in the wheel.
+		inline size_t
+		size() const noexcept {
+			return this->_size;
+		}
+
+		/// Returns the resolution of the wheel.
+		inline duration
+		tick() const noexcept {
+			return this->_tick;
+		}
+
+	private:
+
+		inline tick_type
+		ticks_floor(time_point t) const noexcept {
+			return t <= this->_start ? 0 : (t - this->_start) / this->_tick;
+		}
+
+		inline tick_type
+		ticks_ceil(time_point t) const noexcept {
+			return t <= this->_start
+				? 0
+				: (t - this->_start + this->_tick - duration(1)) / this->_tick;
+		}
+
+		inline time_point
+		time_of(tick_type t) const noexcept {
+			return this->_start + this->_tick*t;
+		}
+
+		/// Returns the nearest tick at which elements expire or cascade.
+		tick_type
+		next_event() const noexcept {
+			tick_type next = std::numeric_limits<tick_type>::max();
+			for (tick_type i=1; i<nslots; ++i) {
+				const tick_type t = this->_now + i;
+				if (!this->_buckets[0][t & (nslots-1)].empty()) {
+					next = t;
+					break;
+				}
+			}
+			for (unsigned level=1; level<nlevels; ++level) {
+				const unsigned shift = slot_bits*level;
+				tick_type t = ((this->_now >> shift) + 1) << shift;
+				for (tick_type i=0; i<nslots && t<next; ++i) {
+					if (!this->_buckets[level][(t >> shift) & (nslots-1)].empty()) {
+						next = t;
+						break;
+					}
+					t += tick_type(1) << shift;
+				}
+			}
+			return next;
+		}
+
+		void
+		place(T* x, tick_type t) {
+			const tick_type max_delta =
+				(tick_type(1) << (slot_bits*nlevels)) - 1;
+			tick_type delta = t - this->_now;
+			if (delta > max_delta) {
+				delta = max_delta;
+				t = this->_now + max_delta;
+			}
+			unsigned level = 0;
+			while (delta >= (tick_type(1) << (slot_bits*(level+1)))) {
+				++level;
+			}
+			const unsigned slot = (t >> (slot_bits*level)) & (nslots-1);
+			this->_buckets[level][slot].push_back(x);
+			if (x->has_id()) {
+				this->_locations[x->id()] = location{level, slot};
+			}
+		}
+
+		inline void
+		expire(T* x) {
+			this->_expired.push_back(x);
+			if (x->has_id()) {
+				this->_locations[x->id()] = location{nlevels, 0};
+			}
+		}
+
+		void
+		step() {
+			++this->_now;
+			// cascade from the highest level, so that elements
+			// move through all lower levels in the same step
+			for (unsigned level=nlevels-1; level>0; --level) {
+				const tick_type mask = (tick_type(1) << (slot_bits*level)) - 1;
+				if ((this->_now & mask) == 0) {
+					this->cascade(
+						level,
+						(this->_now >> (slot_bits*level)) & (nslots-1)
+					);
+				}
+			}
+			bucket_type& bucket = this->_buckets[0][this->_now & (nslots-1)];
+			for (T* x : bucket) {
+				this->expire(x);
+			}
+			bucket.clear();
+		}
+
+		void
+		cascade(unsigned level, unsigned slot) {
+			bucket_type bucket;
+			bucket.swap(this->_buckets[level][slot]);
+			for (T* x : bucket) {
+				const tick_type t = this->ticks_ceil(x->at());
+				if (t <= this->_now) {
+					this->expire(x);
+				} else {
+					this->place(x, t);
+				}
+			}
+		}
+
+	};
+
+}
+
+#endif // vim:filetype=cpp
@@ -0,0 +1,210 @@
+#ifndef BSCHEDULER_BASE_WORK_STEALING_DEQUE_HH
+#define BSCHEDULER_BASE_WORK_STEALING_DEQUE_HH
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <type_traits>
+#include <vector>
+
+namespace bsc {
+
+	/**
+	\brief Chase-Lev work-stealing deque.
+	\details
+	The owner thread pushes and pops elements at the bottom end (LIFO),
+	other threads steal elements from the top end (FIFO). Only \c push
+	and \c pop may be called from the owner thread, \c steal may be called
+	from any thread. The underlying circular array grows when it is full;
+	old arrays are kept until the deque is destroyed, because thieves may
+	still read from them.
+	\tparam T trivially copyable element type (usually a pointer)
+	*/
+	template <class T>
+	class work_stealing_deque {
+
+		static_assert(
+			std::is_trivially_copyable<T>::value,
+			"bad element type"
+		);
+
+	public:
+		/// Element type.
+		typedef T value_type;
+		/// Signed index type.
+		typedef std::int64_t index_type;
+		/// Unsigned size type.
+		typedef std::size_t size_type;
+
+	private:
+
+		class circular_array {
+
+		private:
+			size_type _logsize;
+			std::unique_ptr<std::atomic<T>[]> _items;
+
+		public:
+
+			inline explicit
+			circular_array(size_type logsize):
+			_logsize(logsize),
+			_items(new std::atomic<T>[size_type(1) << logsize])
+			{}
+
+			inline size_type
+			size() const noexcept {
+				return size_type(1) << this->_logsize;
+			}
+
+			inline T
+			get(index_type i) const noexcept {
+				return this->_items[i & (this->size()-1)]
+				       .load(std::memory_order_relaxed);
+			}
+
+			inline void
+			put(index_type i, T x) noexcept {
+				this->_items[i & (this->size()-1)]
+				.store(x, std::memory_order_relaxed);
+			}
+
+			inline circular_array*
+			grow(index_type bottom, index_type top) const {
+				circular_array* a = new circular_array(this->_logsize+1);
+				for (index_type i=top; i<bottom; ++i) {
+					a->put(i, this->get(i));
+				}
+				return a;
+			}
+
+		};
+
+		typedef std::unique_ptr<circular_array> array_ptr;
+
+	private:
+		std::atomic<index_type> _top;
+		/// Keep top and bottom indices in separate cache lines.
+		char _padding[64 - sizeof(std::atomic<index_type>)];
+		std::atomic<index_type> _bottom;
+		std::atomic<circular_array*> _array;
+		/// Arrays that were replaced by the bigger ones.
+		std::vector<array_ptr> _garbage;
+
+	public:
+
+		/// Construct deque with initial capacity of \f$2^{logsize}\f$.
+		inline explicit
+		work_stealing_deque(size_type logsize=8):
+		_top(0),
+		_padding(),
+		_bottom(0),
+		_array(new circular_array(logsize))
+		{}
+
+		inline
+		~work_stealing_deque() {
+			delete this->_array.load(std::memory_order_relaxed);
+		}
+
+		work_stealing_deque(const work_stealing_deque&) = delete;
+
+		work_stealing_deque&
+		operator=(const work_stealing_deque&) = delete;
+
+		/// Push element to the bottom of the deque (owner thread only).
+		void
+		push(T x) {
+			index_type b = this->_bottom.load(std::memory_order_relaxed);
+			index_type t = this->_top.load(std::memory_order_acquire);
+			circular_array* a = this->_array.load(std::memory_order_relaxed);
+			if (b - t > index_type(a->size()) - 1) {
+				circular_array* old = a;
+				a = old->grow(b, t);
+				this->_garbage.emplace_back(old);
+				this->_array.store(a, std::memory_order_release);
+			}
+			a->put(b, x);
+			std::atomic_thread_fence(std::memory_order_release);
+			this->_bottom.store(b+1, std::memory_order_relaxed);
+		}
+
+		/**
+		\brief Pop element from the bottom of the deque (owner thread only).
+		\return false, if the deque is empty
+		*/
+		bool
+		pop(T& x) noexcept {
+			index_type b = this->_bottom.load(std::memory_order_relaxed) - 1;
+			circular_array* a = this->_array.load(std::memory_order_relaxed);
+			this->_bottom.store(b, std::memory_order_relaxed);
+			std::atomic_thread_fence(std::memory_order_seq_cst);
+			index_type t = this->_top.load(std::memory_order_relaxed);
+			bool success = false;
+			if (t <= b) {
+				x = a->get(b);
+				success = true;
+				if (t == b) {
+					// the last element, race with thieves
+					if (!this->_top.compare_exchange_strong(
+						t,
+						t+1,
+						std::memory_order_seq_cst,
+						std::memory_order_relaxed
+					)) {
+						success = false;
+					}
+					this->_bottom.store(b+1, std::memory_order_relaxed);
+				}
+			} else {
+				this->_bottom.store(b+1, std::memory_order_relaxed);
+			}
+			return success;
+		}
+
+		/**
+		\brief Steal element from the top of the deque (any thread).
+		\return false, if the deque is empty or another thread
+		has stolen the element first
+		*/
+		bool
+		steal(T& x) noexcept {
+			index_type t = this->_top.load(std::memory_order_acquire);
+			std::atomic_thread_fence(std::memory_order_seq_cst);
+			index_type b = this->_bottom.load(std::memory_order_acquire);
+			bool success = false;
+			if (t < b) {
+				circular_array* a = this->_array.load(std::memory_order_acquire);
+				T tmp = a->get(t);
+				if (this->_top.compare_exchange_strong(
+					t,
+					t+1,
+					std::memory_order_seq_cst,
+					std::memory_order_relaxed
+				)) {
+					x = tmp;
+					success = true;
+				}
+			}
+			return success;
+		}
+
+		/// Returns true, if the deque is empty (approximate).
+		inline bool
+		empty() const noexcept {
+			return this->size() == 0;
+		}
+
+		/// Returns the number of elements in the deque (approximate).
+		inline size_type
+		size() const noexcept {
+			index_type b = this->_bottom.load(std::memory_order_acquire);
+			index_type t = this->_top.load(std::memory_order_acquire);
+			return b > t ? size_type(b - t) : 0;
+		}
+
+	};
+
+}
+
+#endif // vim:filetype=cpp
@@ -1,3 +1,4 @@
+#include <chrono>
 #include <iostream>
 
 #include <unistdx/base/command_line>
@@ -35,13 +36,45 @@ main(int argc, char* argv[]) {
 	#endif
 	using namespace bsc;
 	sys::ipv4_address::rep_type fanout = 10000;
+	size_t probe_window = 1;
 	sys::interface_address<sys::ipv4_address> servers;
 	bool allow_root = false;
+	size_t queue_capacity = 0;
+	size_t client_capacity = 0;
+	unsigned inline_depth = factory.max_inline_depth();
+	size_t compression_threshold = 0;
+	size_t max_packet_size = factory.nic().max_packet_size();
+	bool compact_encoding = false;
+	bool batch_kernels = false;
+	size_t ring_capacity = 0;
+	unsigned nic_shards = 1;
+	io_backend backend = io_backend::epoll;
+	routing_policy routing = routing_policy::round_robin;
+	bool relay_broadcasts = false;
+	unsigned write_latency = 0;
+	size_t write_threshold = 0;
+	size_t bulk_output_limit = factory.nic().bulk_output_limit();
 	sys::input_operator_type options[] = {
 		sys::ignore_first_argument(),
 		sys::make_key_value("fanout", fanout),
+		sys::make_key_value("probe_window", probe_window),
 		sys::make_key_value("servers", servers),
 		sys::make_key_value("allow_root", allow_root),
+		sys::make_key_value("queue_capacity", queue_capacity),
+		sys::make_key_value("client_capacity", client_capacity),
+		sys::make_key_value("inline_depth", inline_depth),
+		sys::make_key_value("compression_threshold", compression_threshold),
+		sys::make_key_value("max_packet_size", max_packet_size),
+		sys::make_key_value("compact_encoding", compact_encoding),
+		sys::make_key_value("batch_kernels", batch_kernels),
+		sys::make_key_value("ring_capacity", ring_capacity),
+		sys::make_key_value("nic_shards", nic_shards),
+		sys::make_key_value("io_backend", backend),
+		sys::make_key_value("routing", routing),
+		sys::make_key_value("relay_broadcasts", relay_broadcasts),
+		sys::make_key_value("write_latency", write_latency),
+		sys::make_key_value("write_threshold", write_threshold),
+		sys::make_key_value("bulk_output_limit", bulk_output_limit),
 		nullptr
 	};
 	sys::parse_arguments(argc, argv, options);
@@ -50,16 +83,39 @@ main(int argc, char* argv[]) {
 	types.register_type<Application_kernel>();
 	types.register_type<probe>();
 	types.register_type<hierarchy_kernel>();
+	factory.upstream().set_capacity(queue_capacity);
+	factory.nic().set_client_capacity(client_capacity);
+	factory.set_max_inline_depth(inline_depth);
+	factory.nic().set_compression_threshold(compression_threshold);
+	factory.nic().set_max_packet_size(max_packet_size);
+	factory.nic().set_compact_encoding(compact_encoding);
+	factory.nic().set_batch_kernels(batch_kernels);
+	factory.nic().set_num_shards(nic_shards);
+	factory.nic().set_routing_policy(routing);
+	factory.nic().set_relay_broadcasts(relay_broadcasts);
+	factory.nic().set_write_coalescing(
+		std::chrono::microseconds(write_latency),
+		write_threshold
+	);
+	factory.nic().set_bulk_output_limit(bulk_output_limit);
+	factory.nic().set_io_backend(backend);
+	#if !defined(BSCHEDULER_PROFILE_NODE_DISCOVERY)
+	factory.child().set_io_backend(backend);
+	factory.external().set_io_backend(backend);
+	#endif
 	factory_guard g;
 	#if !defined(BSCHEDULER_PROFILE_NODE_DISCOVERY)
 	factory.external().add_server(
 		sys::socket_address(BSCHEDULER_UNIX_DOMAIN_SOCKET)
 	);
 	factory.child().allow_root(allow_root);
+	factory.child().set_ring_capacity(ring_capacity);
+	factory.child().set_batch_kernels(batch_kernels);
 	#endif
 	network_master* m = new network_master;
 	m->allow(servers);
 	m->fanout(fanout);
+	m->probe_window(probe_window);
 	{
 		instances_guard g(instances);
 		instances.add(m);
@@ -29,6 +29,7 @@ failure() {
 
 int _num_nodes = 0;
 int _fanout = 1000;
+int _window = 1;
 
 int
 num_nodes() {
@@ -95,6 +96,21 @@ expect_event_count(
 	EXPECT_EQ(expected_count, count);
 }
 
+/// Returns the time it took to find the first principal or -1.
+long
+time_to_converge(int n) {
+	std::ifstream in(get_process_output_filename(n));
+	std::regex expr(R"(^.*set principal to .* in ([0-9]+)ms$)");
+	std::smatch match;
+	std::string line;
+	while (std::getline(in, line)) {
+		if (std::regex_match(line, match, expr)) {
+			return std::stol(match[1].str());
+		}
+	}
+	return -1;
+}
+
 void
 expect_event_sequence(int n, const std::vector<std::string>& regex_strings) {
 	expect_event_sequence(get_process_output_filename(n), regex_strings);
@@ -222,6 +238,27 @@ TEST(Discovery, Fanout2Weights) {
 	}
 }
 
+TEST(Discovery, TimeToConverge) {
+	const int n = num_nodes();
+	long max_time = 0;
+	for (int i=2; i<=n; ++i) {
+		const long t = time_to_converge(i);
+		if (!std::getenv("_FAILURE")) {
+			EXPECT_GE(t, 0) << "node " << i << " has not found principal";
+		}
+		max_time = std::max(max_time, t);
+	}
+	sys::log_message(
+		"tst",
+		"nodes=_ fanout=_ window=_ time-to-converge=_ms",
+		n,
+		_fanout,
+		_window,
+		max_time
+	);
+	::testing::Test::RecordProperty("time-to-converge", max_time);
+}
+
 TEST(Discovery, TestApplication) {
 	if (std::getenv("_SUBMIT")) {
 		int process_no = failure() == "master-failure" ? 2 : 1;
@@ -235,6 +272,9 @@ TEST(Discovery, TestApplication) {
 int main(int argc, char* argv[]) {
 	_num_nodes = std::atoi(std::getenv("_NODES"));
 	_fanout = std::atoi(std::getenv("_FANOUT"));
+	if (const char* window = std::getenv("_WINDOW")) {
+		_window = std::atoi(window);
+	}
 	std::string s = "1-";
 	s += std::getenv("_NODES");
 	sys::argstream args;
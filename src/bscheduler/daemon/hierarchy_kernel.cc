@@ -1,14 +1,22 @@
 #include "hierarchy_kernel.hh"
 
+#include <bscheduler/kernel/wire_format.hh>
+
 void
 bsc::hierarchy_kernel::write(sys::pstream& out) const {
 	bsc::kernel::write(out);
 	out << this->_ifaddr << this->_weight;
+	if (writes_feature(out, wire_feature::node_load)) {
+		out << this->_load;
+	}
 }
 
 void
 bsc::hierarchy_kernel::read(sys::pstream& in) {
 	bsc::kernel::read(in);
 	in >> this->_ifaddr >> this->_weight;
+	if (reads_feature(in, wire_feature::node_load)) {
+		in >> this->_load;
+	}
 }
 
@@ -17,16 +17,23 @@ namespace bsc {
 	private:
 		ifaddr_type _ifaddr;
 		uint32_t _weight = 0;
+		/// The number of kernels queued or in flight on the sending node
+		/// (zero, if the other side does not write it).
+		uint32_t _load = 0;
 
 	public:
 
-		hierarchy_kernel() = default;
+		inline
+		hierarchy_kernel() {
+			this->priority(kernel_priority::high);
+		}
 
 		inline
 		hierarchy_kernel(const ifaddr_type& interface_address, uint32_t weight):
 		_ifaddr(interface_address),
-		_weight(weight)
-		{}
+		_weight(weight) {
+			this->priority(kernel_priority::high);
+		}
 
 		inline const ifaddr_type&
 		interface_address() const noexcept {
@@ -43,6 +50,16 @@ namespace bsc {
 			return this->_weight;
 		}
 
+		inline void
+		load(uint32_t rhs) noexcept {
+			this->_load = rhs;
+		}
+
+		inline uint32_t
+		load() const noexcept {
+			return this->_load;
+		}
+
 		void
 		write(sys::pstream& out) const override;
 
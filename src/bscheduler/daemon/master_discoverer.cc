@@ -1,5 +1,6 @@
 #include "master_discoverer.hh"
 
+#include <algorithm>
 #include <array>
 #include <cassert>
 #include <ostream>
@@ -48,12 +49,13 @@ bsc::master_discoverer
 void
 bsc::master_discoverer
 ::probe_next_node() {
+	if (this->state() != state_type::probing) {
+		this->_probing_start = clock_type::now();
+	}
 	this->setstate(state_type::probing);
-	if (this->_iterator == this->_end) {
-		this->_iterator = iterator(this->interface_address(), this->_fanout);
-		this->log("_: all addresses have been probed", this->interface_address());
-		this->send_timer();
-	} else {
+	// fill the window with the next candidates
+	while (this->_candidates.size() < this->_window &&
+	       this->_iterator != this->_end) {
 		addr_type addr = *this->_iterator;
 		sys::socket_address new_principal(addr, this->port());
 		this->log("_: probe _", this->interface_address(), addr);
@@ -63,8 +65,14 @@ bsc::master_discoverer
 				this->_hierarchy.principal().socket_address(),
 				new_principal
 			);
-		bsc::upstream(this, p);
 		++this->_iterator;
+		this->_candidates.emplace_back(p, this->_iterator);
+		bsc::upstream(this, p);
+	}
+	if (this->_candidates.empty()) {
+		this->_iterator = iterator(this->interface_address(), this->_fanout);
+		this->log("_: all addresses have been probed", this->interface_address());
+		this->send_timer();
 	}
 }
 
@@ -87,8 +95,10 @@ bsc::master_discoverer
 	bool changed = true;
 	if (result == probe_result::add_subordinate) {
 		this->_hierarchy.add_subordinate(src);
+		::bsc::factory.nic().set_hierarchy_link(src, true);
 	} else if (result == probe_result::remove_subordinate) {
 		this->_hierarchy.remove_subordinate(src);
+		::bsc::factory.nic().set_hierarchy_link(src, false);
 	} else {
 		changed = false;
 	}
@@ -124,25 +134,120 @@ bsc::master_discoverer
 void
 bsc::master_discoverer
 ::update_principal(prober* p) {
+	const sys::socket_address& newp = p->new_principal();
 	if (p->return_code() != exit_code::success) {
 		this->log(
 			"_: prober returned from _: _",
 			this->interface_address(),
-			p->new_principal(),
+			newp,
 			p->return_code()
 		);
+	}
+	auto cancelled = std::find(
+		this->_cancelled.begin(),
+		this->_cancelled.end(),
+		p
+	);
+	if (cancelled != this->_cancelled.end()) {
+		this->_cancelled.erase(cancelled);
+		// do not disconnect the address that is probed again
+		const bool probed = std::any_of(
+			this->_candidates.begin(),
+			this->_candidates.end(),
+			[&newp] (const candidate& c) { return c.address == newp; }
+		);
+		if (p->return_code() == exit_code::success && !probed) {
+			this->cancel_candidate(newp);
+		}
+		return;
+	}
+	auto result = std::find_if(
+		this->_candidates.begin(),
+		this->_candidates.end(),
+		[p] (const candidate& c) { return c.kernel == p; }
+	);
+	if (result == this->_candidates.end()) {
+		return;
+	}
+	result->returned = true;
+	result->result = p->return_code();
+	this->choose_principal();
+}
+
+void
+bsc::master_discoverer
+::choose_principal() {
+	// candidates that failed do not affect the choice
+	this->_candidates.erase(
+		std::remove_if(
+			this->_candidates.begin(),
+			this->_candidates.end(),
+			[] (const candidate& c) {
+				return c.returned && c.result != exit_code::success;
+			}
+		),
+		this->_candidates.end()
+	);
+	if (this->_candidates.empty()) {
 		this->probe_next_node();
-	} else {
-		const sys::socket_address& oldp = p->old_principal();
-		const sys::socket_address& newp = p->new_principal();
-		if (oldp) {
-			::bsc::factory.nic().stop_client(oldp);
+		return;
+	}
+	const candidate& first = this->_candidates.front();
+	if (!first.returned) {
+		// wait for better candidates, but keep the window full
+		this->probe_next_node();
+		return;
+	}
+	// the first candidate is the principal, cancel the rest
+	this->set_principal(first.old_principal, first.address);
+	// continue the next scan as sequential probing would do
+	this->_iterator = first.next;
+	for (size_t i=1; i<this->_candidates.size(); ++i) {
+		const candidate& c = this->_candidates[i];
+		if (!c.returned) {
+			this->_cancelled.emplace_back(c.kernel);
+		} else if (c.result == exit_code::success) {
+			this->cancel_candidate(c.address);
 		}
-		this->log("_: set principal to _", this->interface_address(), newp);
-		this->_hierarchy.set_principal(newp);
-		this->broadcast_hierarchy();
-		// try to find better principal after a period of time
-		this->send_timer();
+	}
+	this->_candidates.clear();
+	// try to find better principal after a period of time
+	this->send_timer();
+}
+
+void
+bsc::master_discoverer
+::set_principal(
+	const sys::socket_address& oldp,
+	const sys::socket_address& newp
+) {
+	using namespace std::chrono;
+	if (oldp) {
+		::bsc::factory.nic().stop_client(oldp);
+		::bsc::factory.nic().set_hierarchy_link(oldp, false);
+	}
+	::bsc::factory.nic().set_hierarchy_link(newp, true);
+	const auto dt = duration_cast<milliseconds>(
+		clock_type::now() - this->_probing_start
+	);
+	this->log(
+		"_: set principal to _ in _ms",
+		this->interface_address(),
+		newp,
+		dt.count()
+	);
+	this->_hierarchy.set_principal(newp);
+	this->broadcast_hierarchy();
+}
+
+void
+bsc::master_discoverer
+::cancel_candidate(const sys::socket_address& addr) {
+	// the candidate removes this node from its subordinates
+	// when the connection is closed
+	this->log("_: cancel probe _", this->interface_address(), addr);
+	if (!this->_hierarchy.has_principal(addr)) {
+		::bsc::factory.nic().stop_client(addr);
 	}
 }
 
@@ -179,6 +284,7 @@ bsc::master_discoverer
 		this->log("_: remove subordinate _", this->interface_address(), endp);
 		this->_hierarchy.remove_subordinate(endp);
 	}
+	::bsc::factory.nic().set_hierarchy_link(endp, false);
 }
 
 void
@@ -207,6 +313,7 @@ void
 bsc::master_discoverer
 ::send_weight(const sys::socket_address& dest, weight_type w) {
 	hierarchy_kernel* h = new hierarchy_kernel(this->interface_address(), w);
+	h->load(::bsc::factory.nic().load());
 	h->parent(this);
 	h->set_principal_id(1);
 	h->to(dest);
@@ -224,6 +331,10 @@ bsc::master_discoverer
 		);
 	} else {
 		const sys::socket_address& src = k->from();
+		if (!k->moves_downstream()) {
+			// returned kernels carry the load of this node
+			::bsc::factory.nic().set_client_load(src, k->load());
+		}
 		bool changed = false;
 		if (this->_hierarchy.has_principal(src)) {
 			changed = this->_hierarchy.set_principal_weight(k->weight());
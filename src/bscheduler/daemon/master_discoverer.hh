@@ -1,8 +1,11 @@
 #ifndef BSCHEDULER_DAEMON_MASTER_DISCOVERER_HH
 #define BSCHEDULER_DAEMON_MASTER_DISCOVERER_HH
 
+#include <algorithm>
 #include <chrono>
+#include <deque>
 #include <iosfwd>
+#include <vector>
 
 #include <unistdx/base/log_message>
 #include <unistdx/net/interface_address>
@@ -53,6 +56,26 @@ namespace bsc {
 			probing
 		};
 
+	private:
+		/// Principal candidate that is being probed.
+		struct candidate {
+			/// The prober is a local kernel that returns to the discoverer.
+			const prober* kernel;
+			sys::socket_address old_principal;
+			sys::socket_address address;
+			/// The position of the iterator after this candidate.
+			iterator next;
+			exit_code result = exit_code::undefined;
+			bool returned = false;
+
+			inline
+			candidate(const prober* p, const iterator& it):
+			kernel(p),
+			old_principal(p->old_principal()),
+			address(p->new_principal()),
+			next(it) {}
+		};
+
 	private:
 		/// Time period between subsequent network scans.
 		duration _interval = std::chrono::minutes(1);
@@ -60,6 +83,18 @@ namespace bsc {
 		hierarchy_type _hierarchy;
 		iterator _iterator, _end;
 		state_type _state = state_type::initial;
+		/// The maximal number of candidates that are probed at once.
+		size_t _window = 1;
+		/// Candidates in the order of the iterator.
+		std::deque<candidate> _candidates;
+		/**
+		Probers of the candidates that lost to better ones before
+		they returned. The same address may be probed again
+		while they are in flight, hence they are not matched by address.
+		*/
+		std::vector<const prober*> _cancelled;
+		/// The time when probing was started after the last timer.
+		clock_type::time_point _probing_start;
 
 	public:
 		inline
@@ -79,6 +114,27 @@ namespace bsc {
 		void
 		on_kernel(bsc::kernel* k) override;
 
+		/**
+		\brief Probe up to \p rhs candidates at once.
+		\details
+		Candidates are taken from the iterator in the order of preference.
+		The principal is the first candidate that accepted this node
+		after all preceding candidates failed, and the next scan starts
+		from the candidate that follows it, so the result is the same
+		as with sequential probing, but the timeouts of unreachable
+		candidates overlap. Other candidates that accepted this node
+		are disconnected, and they remove this node from their subordinates.
+		*/
+		inline void
+		probe_window(size_t rhs) noexcept {
+			this->_window = std::max(rhs, size_t(1));
+		}
+
+		inline size_t
+		probe_window() const noexcept {
+			return this->_window;
+		}
+
 	private:
 
 		const ifaddr_type&
@@ -106,6 +162,15 @@ namespace bsc {
 		void
 		update_principal(prober* p);
 
+		void
+		choose_principal();
+
+		void
+		set_principal(const sys::socket_address& oldp, const sys::socket_address& newp);
+
+		void
+		cancel_candidate(const sys::socket_address& addr);
+
 		inline void
 		setstate(state_type rhs) noexcept {
 			this->_state = rhs;
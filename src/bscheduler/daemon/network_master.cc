@@ -132,6 +132,7 @@ bsc::network_master
 	if (this->_ifaddrs.find(ifa) == this->_ifaddrs.end()) {
 		const sys::port_type port = ::bsc::factory.nic().port();
 		master_discoverer* d = new master_discoverer(ifa, port, this->_fanout);
+		d->probe_window(this->_probe_window);
 		this->_ifaddrs.emplace(ifa, d);
 		bsc::upstream(this, d);
 	}
@@ -30,6 +30,8 @@ namespace bsc {
 		map_type _ifaddrs;
 		set_type _allowedifaddrs;
 		uint_type _fanout = 10000;
+		/// The number of principal candidates that are probed at once.
+		size_t _probe_window = 1;
 		network_timer* _timer = nullptr;
 		/// Interface address list update interval.
 		std::chrono::milliseconds _interval = std::chrono::seconds(1);
@@ -47,6 +49,11 @@ namespace bsc {
 			this->_fanout = rhs;
 		}
 
+		inline void
+		probe_window(size_t rhs) noexcept {
+			this->_probe_window = rhs;
+		}
+
 		inline void
 		allow(const ifaddr_type& rhs) {
 			if (rhs) {
@@ -22,7 +22,10 @@ namespace bsc {
 
 	public:
 
-		probe() = default;
+		inline
+		probe() {
+			this->priority(kernel_priority::high);
+		}
 
 		inline
 		probe(
@@ -32,8 +35,9 @@ namespace bsc {
 		):
 		_ifaddr(interface_address),
 		_oldprinc(oldprinc),
-		_newprinc(newprinc)
-		{}
+		_newprinc(newprinc) {
+			this->priority(kernel_priority::high);
+		}
 
 		void
 		write(sys::pstream& out) const override;
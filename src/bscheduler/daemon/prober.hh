@@ -33,8 +33,9 @@ namespace bsc {
 		):
 		_ifaddr(interface_address),
 		_oldprinc(oldprinc),
-		_newprinc(newprinc)
-		{}
+		_newprinc(newprinc) {
+			this->priority(kernel_priority::high);
+		}
 
 		void
 		act() override;
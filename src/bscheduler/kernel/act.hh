@@ -6,8 +6,52 @@
 
 namespace bsc {
 
+	/**
+	\brief The kernel that is being processed by \link act\endlink
+	in the current thread.
+	\details
+	Entries live on the stack of \link act\endlink and form a list
+	from the innermost call to the outermost one.
+	*/
+	struct active_kernel {
+		/// The kernel that is being processed.
+		const kernel* current;
+		/// The principal whose \c react may be called or null pointer.
+		const kernel* principal;
+		const active_kernel* next;
+	};
+
+	namespace this_thread {
+
+		/// The innermost \link act\endlink call of the current thread.
+		extern thread_local const active_kernel* active_kernels;
+
+		/**
+		\brief Returns true, if \c act or \c react of the kernel \p k is
+		being executed by the current thread, or the kernel is processed
+		by one of the enclosing \link act\endlink calls.
+		*/
+		inline bool
+		is_active(const kernel* k) noexcept {
+			for (const active_kernel* a=active_kernels; a; a=a->next) {
+				if (a->current == k || a->principal == k) {
+					return true;
+				}
+			}
+			return false;
+		}
+
+	}
+
 	inline void
 	act(kernel* k) {
+		const kernel* principal = static_cast<const kernel*>(k)->principal();
+		active_kernel entry{k, principal, this_thread::active_kernels};
+		struct guard {
+			const active_kernel* next;
+			~guard() { this_thread::active_kernels = this->next; }
+		} g{entry.next};
+		this_thread::active_kernels = &entry;
 		bool del = false;
 		if (k->return_code() == exit_code::undefined) {
 			if (k->principal()) {
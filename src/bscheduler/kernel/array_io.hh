@@ -0,0 +1,193 @@
+#ifndef BSCHEDULER_KERNEL_ARRAY_IO_HH
+#define BSCHEDULER_KERNEL_ARRAY_IO_HH
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+#include <valarray>
+#include <vector>
+
+#include <unistdx/net/pstream>
+
+#include <bscheduler/base/error.hh>
+
+namespace bsc {
+
+	namespace bits {
+
+		template <size_t Size>
+		struct swappable_integer;
+
+		template <>
+		struct swappable_integer<1> {
+			typedef std::uint8_t type;
+			inline static type swap(type x) noexcept { return x; }
+		};
+
+		template <>
+		struct swappable_integer<2> {
+			typedef std::uint16_t type;
+			inline static type swap(type x) noexcept { return __builtin_bswap16(x); }
+		};
+
+		template <>
+		struct swappable_integer<4> {
+			typedef std::uint32_t type;
+			inline static type swap(type x) noexcept { return __builtin_bswap32(x); }
+		};
+
+		template <>
+		struct swappable_integer<8> {
+			typedef std::uint64_t type;
+			inline static type swap(type x) noexcept { return __builtin_bswap64(x); }
+		};
+
+		/// Returns true, if host byte order is the same as network byte order.
+		inline constexpr bool
+		is_network_byte_order() noexcept {
+			return __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__;
+		}
+
+		/**
+		\brief Copy \p n elements of size \p Size from \p src to \p dst
+		swapping the bytes of each element.
+		\details
+		The loop has no dependencies between iterations and
+		is vectorised by the compiler.
+		*/
+		template <size_t Size>
+		inline void
+		copy_swap(const char* src, char* dst, size_t n) noexcept {
+			typedef swappable_integer<Size> traits;
+			typedef typename traits::type int_type;
+			for (size_t i=0; i<n; ++i) {
+				int_type x;
+				std::memcpy(&x, src + i*Size, Size);
+				x = traits::swap(x);
+				std::memcpy(dst + i*Size, &x, Size);
+			}
+		}
+
+		/// The size of the buffer for byte-swapped elements.
+		enum: size_t { array_chunk_size = 4096 };
+
+		/**
+		\brief Throw, if the rest of the packet is shorter than
+		\p n elements of type \c T.
+		\details
+		The size comes from the other side and is checked before
+		the memory is allocated.
+		*/
+		template <class T>
+		inline void
+		check_array_size(sys::pstream& in, size_t n) {
+			sys::packetbuf* buf = in.rdbuf();
+			const size_t left = buf->ipayload_end() - buf->ipayload_cur();
+			if (n > left/sizeof(T)) {
+				BSCHEDULER_THROW(error, "bad array size");
+			}
+		}
+
+		template <class T>
+		struct is_bulk_type: public std::integral_constant<
+			bool,
+			std::is_arithmetic<T>::value && (
+				sizeof(T) == 1 || sizeof(T) == 2 ||
+				sizeof(T) == 4 || sizeof(T) == 8
+			)
+		> {};
+
+	}
+
+	/**
+	\brief Write array of \p n arithmetic values in one go.
+	\details
+	The result is the same as writing each element with \c operator<<,
+	but the elements are converted to network byte order in chunks and
+	written with a single call per chunk.
+	*/
+	template <class T>
+	void
+	write_array(sys::pstream& out, const T* data, size_t n) {
+		static_assert(bits::is_bulk_type<T>::value, "bad array element type");
+		const char* first = reinterpret_cast<const char*>(data);
+		if (sizeof(T) == 1 || bits::is_network_byte_order()) {
+			out.write(first, n*sizeof(T));
+			return;
+		}
+		char chunk[bits::array_chunk_size];
+		const size_t m = sizeof(chunk) / sizeof(T);
+		while (n > 0) {
+			const size_t k = std::min(n, m);
+			bits::copy_swap<sizeof(T)>(first, chunk, k);
+			out.write(chunk, k*sizeof(T));
+			first += k*sizeof(T);
+			n -= k;
+		}
+	}
+
+	/**
+	\brief Read array of \p n arithmetic values in one go.
+	\details
+	Reads elements written by \link write_array\endlink or
+	by \c operator<< one by one. Vectors and arrays are resized only
+	if the packet has enough bytes for all elements, otherwise
+	\c bsc::error is thrown.
+	*/
+	template <class T>
+	void
+	read_array(sys::pstream& in, T* data, size_t n) {
+		static_assert(bits::is_bulk_type<T>::value, "bad array element type");
+		char* first = reinterpret_cast<char*>(data);
+		in.read(first, n*sizeof(T));
+		if (sizeof(T) != 1 && !bits::is_network_byte_order()) {
+			bits::copy_swap<sizeof(T)>(first, first, n);
+		}
+	}
+
+	/// Write the size of the vector followed by its elements.
+	template <class T>
+	void
+	write_array(sys::pstream& out, const std::vector<T>& rhs) {
+		out << std::uint32_t(rhs.size());
+		write_array(out, rhs.data(), rhs.size());
+	}
+
+	/// Read the vector written by \link write_array\endlink.
+	template <class T>
+	void
+	read_array(sys::pstream& in, std::vector<T>& rhs) {
+		std::uint32_t n = 0;
+		in >> n;
+		bits::check_array_size<T>(in, n);
+		rhs.resize(n);
+		read_array(in, rhs.data(), rhs.size());
+	}
+
+	/// Write the size of the array followed by its elements.
+	template <class T>
+	void
+	write_array(sys::pstream& out, const std::valarray<T>& rhs) {
+		out << std::uint32_t(rhs.size());
+		if (rhs.size() != 0) {
+			write_array(out, &rhs[0], rhs.size());
+		}
+	}
+
+	/// Read the array written by \link write_array\endlink.
+	template <class T>
+	void
+	read_array(sys::pstream& in, std::valarray<T>& rhs) {
+		std::uint32_t n = 0;
+		in >> n;
+		bits::check_array_size<T>(in, n);
+		rhs.resize(n);
+		if (n != 0) {
+			read_array(in, &rhs[0], rhs.size());
+		}
+	}
+
+}
+
+#endif // vim:filetype=cpp
@@ -1,25 +1,36 @@
 #include "foreign_kernel.hh"
 
+#include <bscheduler/base/error.hh>
+
 void
 bsc::foreign_kernel
 ::write(sys::pstream& out) const {
 	out << this->_type;
 	bsc::kernel::write(out);
-	out.write(this->_payload, this->_size);
+	out.write(this->_payload.data(), this->_payload.size());
 }
 
 void
 bsc::foreign_kernel
 ::read(sys::pstream& in) {
 	sys::packetbuf* buf = in.rdbuf();
+	this->read(in, buf->ipayload_end() - buf->ipayload_cur());
+}
+
+void
+bsc::foreign_kernel
+::read(sys::pstream& in, size_type size) {
+	sys::packetbuf* buf = in.rdbuf();
+	const char_type* first = buf->ipayload_cur();
 	in >> this->_type;
 	bsc::kernel::read(in);
-	if (this->_payload) {
-		this->free();
+	const size_type nread = buf->ipayload_cur() - first;
+	if (nread > size) {
+		BSCHEDULER_THROW(error, "bad foreign kernel size");
 	}
-	char_type* first = buf->ipayload_cur();
-	char_type* last = buf->ipayload_end();
-	this->_size = last - first;
-	this->_payload = new char_type[this->_size];
-	in.read(this->_payload, this->_size);
+	const size_type n = size - nread;
+	// allocate new buffer, the old one may be shared;
+	// the packet is in the ring buffer of the connection that is reused
+	this->_payload = payload_slice(n);
+	in.read(this->_payload.data(), n);
 }
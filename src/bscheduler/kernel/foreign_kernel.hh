@@ -3,19 +3,36 @@
 
 #include <bscheduler/kernel/kernel.hh>
 #include <bscheduler/kernel/kernel_type.hh>
+#include <bscheduler/kernel/payload_slice.hh>
 
 namespace bsc {
 
+	/**
+	\brief Kernel of another application that is forwarded without
+	being deserialised.
+	\details
+	The payload is copied out of the input buffer when the kernel is read
+	and copied into the output buffer when it is written, i.e. each hop
+	still makes two copies. The payload is kept in a reference-counted
+	buffer only to share it between kernels (e.g. when the same kernel
+	is relayed to several destinations) without further copies.
+
+	Forwarding without copies is not implemented. It needs both
+	an input buffer whose regions can outlive the packet (the ring of
+	\link basic_ring_fildesbuf\endlink is reused for the next packets
+	as soon as the kernel is read) and an output buffer that can write
+	borrowed slices with \c writev (\c sys::basic_fildesbuf copies
+	everything into its put area).
+	*/
 	class foreign_kernel: public kernel {
 
 	private:
-		typedef char char_type;
-		typedef size_t size_type;
+		typedef payload_slice::char_type char_type;
+		typedef payload_slice::size_type size_type;
 		typedef ::bsc::kernel_type::id_type id_type;
 
 	private:
-		size_type _size = 0;
-		char_type* _payload = nullptr;
+		payload_slice _payload;
 		id_type _type = 0;
 
 	public:
@@ -27,30 +44,34 @@ namespace bsc {
 		foreign_kernel&
 		operator=(const foreign_kernel&) = delete;
 
-		inline
-		~foreign_kernel() {
-			this->free();
-		}
+		~foreign_kernel() = default;
 
 		inline id_type
 		type() const noexcept {
 			return this->_type;
 		}
 
+		/// Returns application-specific fields of the kernel in serialised form.
+		inline const payload_slice&
+		payload() const noexcept {
+			return this->_payload;
+		}
+
+		/// Share the payload of another kernel with this one.
+		inline void
+		payload(const payload_slice& rhs) {
+			this->_payload = rhs;
+		}
+
 		void
 		write(sys::pstream& out) const override;
 
 		void
 		read(sys::pstream& in) override;
 
-	private:
-
-		inline void
-		free() {
-			delete[] this->_payload;
-			this->_payload = nullptr;
-			this->_size = 0;
-		}
+		/// Read the kernel that occupies \p size bytes of the packet.
+		void
+		read(sys::pstream& in, size_type size);
 
 	};
 
@@ -1,6 +1,7 @@
 #include "kernel.hh"
 
 #include <bscheduler/base/error.hh>
+#include <bscheduler/kernel/wire_format.hh>
 #include <unistdx/base/make_object>
 
 namespace {
@@ -21,9 +22,15 @@ bsc::kernel::read(sys::pstream& in) {
 		this->setf(kernel_flag::carries_parent);
 	}
 	assert(not this->_parent);
-	in >> this->_parent_id;
 	assert(not this->_principal);
-	in >> this->_principal_id;
+	if (reads_compact(in)) {
+		// parent is close to the kernel, principal is usually the parent
+		this->_parent_id = read_delta(in, this->id());
+		this->_principal_id = read_delta(in, this->_parent_id);
+	} else {
+		in >> this->_parent_id;
+		in >> this->_principal_id;
+	}
 	this->setf(kernel_flag::parent_is_id);
 	this->setf(kernel_flag::principal_is_id);
 }
@@ -32,20 +39,22 @@ void
 bsc::kernel::write(sys::pstream& out) const {
 	base_kernel::write(out);
 	out << carries_parent();
-	if (this->moves_downstream()) {
-		out << this->_parent_id << this->_principal_id;
-	} else {
-		if (this->isset(kernel_flag::parent_is_id)) {
-			out << this->_parent_id;
-		} else {
-			out << get_id(this->_parent);
+	id_type parent = this->_parent_id;
+	id_type principal = this->_principal_id;
+	if (!this->moves_downstream()) {
+		if (!this->isset(kernel_flag::parent_is_id)) {
+			parent = get_id(this->_parent);
 		}
-		if (this->isset(kernel_flag::principal_is_id)) {
-			out << this->_principal_id;
-		} else {
-			out << get_id(this->_principal);
+		if (!this->isset(kernel_flag::principal_is_id)) {
+			principal = get_id(this->_principal);
 		}
 	}
+	if (writes_compact(out)) {
+		write_delta(out, this->id(), parent);
+		write_delta(out, parent, principal);
+	} else {
+		out << parent << principal;
+	}
 }
 
 void
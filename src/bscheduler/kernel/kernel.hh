@@ -5,6 +5,8 @@
 
 #include <unistdx/net/pstream>
 
+#include <bscheduler/base/numa.hh>
+
 #include "mobile_kernel.hh"
 
 namespace bsc {
@@ -167,6 +169,23 @@ namespace bsc {
 			this->principal(this);
 		}
 
+		/// The next kernel in the intrusive queue.
+		inline kernel*
+		next() const noexcept {
+			return this->_next;
+		}
+
+		inline void
+		next(kernel* rhs) noexcept {
+			this->_next = rhs;
+		}
+
+		/// The NUMA node of the thread that created the kernel.
+		inline numa_node_id
+		numa_node() const noexcept {
+			return this->_node;
+		}
+
 		template<class It>
 		void
 		mark_as_deleted(It result) noexcept {
@@ -190,6 +209,8 @@ namespace bsc {
 			kernel* _principal = nullptr;
 			id_type _principal_id;
 		};
+		kernel* _next = nullptr;
+		numa_node_id _node = this_thread::numa_node;
 
 	};
 
@@ -0,0 +1,313 @@
+#include "kernel_allocator.hh"
+
+#include <algorithm>
+#include <cstdlib>
+#include <new>
+#include <ostream>
+
+#include <bscheduler/config.hh>
+#include <bscheduler/kernel/kernel_base.hh>
+
+namespace {
+
+	/// Per-thread counters are added to the global ones in batches.
+	constexpr const size_t counter_batch_size = 1024;
+
+	/**
+	Set when the cache of the current thread is destroyed. The flag has
+	no destructor, so it can be read after the cache is gone
+	(e.g. when other thread-local objects delete kernels).
+	*/
+	thread_local bool cache_destroyed = false;
+
+	inline void
+	add_count(size_t& local, std::atomic<size_t>& global, bool force=false) {
+		if (force || local == counter_batch_size) {
+			global.fetch_add(local, std::memory_order_relaxed);
+			local = 0;
+		}
+	}
+
+}
+
+class bsc::kernel_allocator::thread_cache {
+
+public:
+	/// Blocks of the local node.
+	free_list lists[nclasses];
+	/// Blocks of other nodes that are returned to them in batches.
+	free_list remote[max_nodes][nclasses];
+	size_t nallocations = 0;
+	size_t ndeallocations = 0;
+
+	~thread_cache() {
+		kernel_allocator& a = get_kernel_allocator();
+		for (size_t i=0; i<nclasses; ++i) {
+			// the thread might have been moved to another node
+			free_list& lst = this->lists[i];
+			while (lst.head) {
+				block* b = lst.head;
+				lst.head = b->next;
+				b->next = nullptr;
+				a.push_batch(owner(b), i, b, b, 1);
+			}
+			lst.size = 0;
+			for (numa_node_id j=0; j<max_nodes; ++j) {
+				a.return_remote(j, i, this->remote[j][i]);
+			}
+		}
+		add_count(this->nallocations, a._nallocations, true);
+		add_count(this->ndeallocations, a._ndeallocations, true);
+		cache_destroyed = true;
+	}
+
+};
+
+void*
+bsc::kernel_allocator::allocate(size_t n) {
+	if (n > max_block_size) {
+		++this->_nlarge;
+		return ::operator new(n);
+	}
+	const size_t cls = size_class(n);
+	if (cache_destroyed) {
+		// thread-local storage is being destroyed
+		return this->allocate_uncached(cls);
+	}
+	thread_cache& cache = local_cache();
+	free_list& lst = cache.lists[cls];
+	if (!lst.head) {
+		const numa_node_id node = local_node();
+		lst.head = this->pop_batch(node, cls, lst.size);
+		if (!lst.head) {
+			lst.head = this->new_slab(node, cls, lst.size);
+		}
+	}
+	block* b = lst.head;
+	lst.head = b->next;
+	--lst.size;
+	++cache.nallocations;
+	add_count(cache.nallocations, this->_nallocations);
+	return b;
+}
+
+void
+bsc::kernel_allocator::deallocate(void* ptr, size_t n) noexcept {
+	if (!ptr) {
+		return;
+	}
+	if (n > max_block_size) {
+		::operator delete(ptr);
+		return;
+	}
+	const size_t cls = size_class(n);
+	block* b = static_cast<block*>(ptr);
+	const numa_node_id node = owner(b);
+	if (cache_destroyed) {
+		b->next = nullptr;
+		this->push_batch(node, cls, b, b, 1);
+		return;
+	}
+	thread_cache& cache = local_cache();
+	if (node != local_node()) {
+		free_list& lst = cache.remote[node][cls];
+		b->next = lst.head;
+		lst.head = b;
+		if (++lst.size == batch_size) {
+			this->return_remote(node, cls, lst);
+		}
+	} else {
+		free_list& lst = cache.lists[cls];
+		b->next = lst.head;
+		lst.head = b;
+		++lst.size;
+		if (lst.size >= 2*batch_size) {
+			block* first = lst.head;
+			block* last = first;
+			for (size_t i=1; i<batch_size; ++i) {
+				last = last->next;
+			}
+			lst.head = last->next;
+			lst.size -= batch_size;
+			this->push_batch(node, cls, first, last, batch_size);
+		}
+	}
+	++cache.ndeallocations;
+	add_count(cache.ndeallocations, this->_ndeallocations);
+}
+
+bsc::kernel_allocator_stats
+bsc::kernel_allocator::stats() const noexcept {
+	kernel_allocator_stats s;
+	s.nallocations = this->_nallocations.load(std::memory_order_relaxed);
+	s.ndeallocations = this->_ndeallocations.load(std::memory_order_relaxed);
+	s.nlarge = this->_nlarge.load(std::memory_order_relaxed);
+	s.nslabs = this->_nslabs.load(std::memory_order_relaxed);
+	s.nbatches = this->_nbatches.load(std::memory_order_relaxed);
+	s.nremote = this->_nremote.load(std::memory_order_relaxed);
+	return s;
+}
+
+auto
+bsc::kernel_allocator::pop_batch(
+	numa_node_id node,
+	size_t cls,
+	size_t& n
+) noexcept -> block* {
+	central_list& central = this->_lists[node][cls];
+	lock_type lock(central.mutex);
+	block* first = central.head;
+	n = 0;
+	if (first) {
+		block* last = first;
+		n = 1;
+		while (n < batch_size && last->next) {
+			last = last->next;
+			++n;
+		}
+		central.head = last->next;
+		last->next = nullptr;
+		++this->_nbatches;
+	}
+	return first;
+}
+
+void
+bsc::kernel_allocator::push_batch(
+	numa_node_id node,
+	size_t cls,
+	block* first,
+	block* last,
+	size_t
+) noexcept {
+	central_list& central = this->_lists[node][cls];
+	lock_type lock(central.mutex);
+	last->next = central.head;
+	central.head = first;
+	++this->_nbatches;
+}
+
+void
+bsc::kernel_allocator::return_remote(
+	numa_node_id node,
+	size_t cls,
+	free_list& lst
+) noexcept {
+	if (!lst.head) {
+		return;
+	}
+	block* last = lst.head;
+	while (last->next) {
+		last = last->next;
+	}
+	this->push_batch(node, cls, lst.head, last, lst.size);
+	this->_nremote.fetch_add(lst.size, std::memory_order_relaxed);
+	lst.head = nullptr;
+	lst.size = 0;
+}
+
+auto
+bsc::kernel_allocator::new_slab(
+	numa_node_id node,
+	size_t cls,
+	size_t& n
+) -> block* {
+	const size_t bs = block_size(cls);
+	// the first block is occupied by the header
+	const size_t nblocks = (slab_size - alignment) / bs;
+	void* ptr = nullptr;
+	if (::posix_memalign(&ptr, slab_size, slab_size) != 0) {
+		throw std::bad_alloc();
+	}
+	char* slab = static_cast<char*>(ptr);
+	new (slab) slab_header{node};
+	char* data = slab + alignment;
+	// touch every page from this thread to place it on the local node
+	for (size_t i=0; i<nblocks; ++i) {
+		block* b = reinterpret_cast<block*>(data + i*bs);
+		b->next = (i+1 == nblocks)
+			? nullptr
+			: reinterpret_cast<block*>(data + (i+1)*bs);
+	}
+	++this->_nslabs;
+	// keep one batch in thread cache and move the rest to central list
+	n = std::min(nblocks, size_t(batch_size));
+	block* first = reinterpret_cast<block*>(data);
+	block* last = reinterpret_cast<block*>(data + (n-1)*bs);
+	if (last->next) {
+		block* rest_last = reinterpret_cast<block*>(data + (nblocks-1)*bs);
+		this->push_batch(node, cls, last->next, rest_last, nblocks-n);
+		last->next = nullptr;
+	}
+	return first;
+}
+
+auto
+bsc::kernel_allocator::allocate_uncached(size_t cls) -> block* {
+	const numa_node_id node = local_node();
+	size_t n = 0;
+	block* first = this->pop_batch(node, cls, n);
+	if (!first) {
+		first = this->new_slab(node, cls, n);
+	}
+	if (block* rest = first->next) {
+		block* last = rest;
+		while (last->next) {
+			last = last->next;
+		}
+		this->push_batch(node, cls, rest, last, n-1);
+		first->next = nullptr;
+	}
+	return first;
+}
+
+auto
+bsc::kernel_allocator::local_cache() noexcept -> thread_cache& {
+	static thread_local thread_cache cache;
+	return cache;
+}
+
+bsc::kernel_allocator&
+bsc::get_kernel_allocator() noexcept {
+	// never destroyed, because thread caches return blocks on thread exit
+	static kernel_allocator* allocator = new kernel_allocator;
+	return *allocator;
+}
+
+bool
+bsc::kernel_pool_enabled() noexcept {
+	#if defined(BSCHEDULER_KERNEL_POOL)
+	return true;
+	#else
+	return false;
+	#endif
+}
+
+std::ostream&
+bsc::operator<<(std::ostream& out, const kernel_allocator_stats& rhs) {
+	return out << "allocations=" << rhs.nallocations
+		<< ",deallocations=" << rhs.ndeallocations
+		<< ",large=" << rhs.nlarge
+		<< ",slabs=" << rhs.nslabs
+		<< ",batches=" << rhs.nbatches
+		<< ",remote=" << rhs.nremote;
+}
+
+void*
+bsc::kernel_base::operator new(size_t n) {
+	#if defined(BSCHEDULER_KERNEL_POOL)
+	return get_kernel_allocator().allocate(n);
+	#else
+	return ::operator new(n);
+	#endif
+}
+
+void
+bsc::kernel_base::operator delete(void* ptr, size_t n) noexcept {
+	#if defined(BSCHEDULER_KERNEL_POOL)
+	get_kernel_allocator().deallocate(ptr, n);
+	#else
+	static_cast<void>(n);
+	::operator delete(ptr);
+	#endif
+}
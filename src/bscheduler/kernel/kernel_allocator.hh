@@ -0,0 +1,206 @@
+#ifndef BSCHEDULER_KERNEL_KERNEL_ALLOCATOR_HH
+#define BSCHEDULER_KERNEL_KERNEL_ALLOCATOR_HH
+
+#include <atomic>
+#include <cstddef>
+#include <iosfwd>
+
+#include <unistdx/base/simple_lock>
+#include <unistdx/base/spin_mutex>
+
+#include <bscheduler/base/numa.hh>
+
+namespace bsc {
+
+	/// Kernel allocator counters.
+	struct kernel_allocator_stats {
+		/// The number of allocations from the pool.
+		size_t nallocations = 0;
+		/// The number of deallocations to the pool.
+		size_t ndeallocations = 0;
+		/// The number of allocations that are too large for the pool.
+		size_t nlarge = 0;
+		/// The number of slabs allocated from the system.
+		size_t nslabs = 0;
+		/// The number of batches moved between threads and central lists.
+		size_t nbatches = 0;
+		/// The number of blocks returned to the central lists of other nodes.
+		size_t nremote = 0;
+	};
+
+	std::ostream&
+	operator<<(std::ostream& out, const kernel_allocator_stats& rhs);
+
+	class kernel_allocator;
+
+	/// Returns the process-wide kernel allocator.
+	kernel_allocator&
+	get_kernel_allocator() noexcept;
+
+	/**
+	\brief Size-class pool allocator for kernels.
+	\details
+	Memory blocks are grouped into size classes, each class has a central
+	free list per NUMA node protected by a spin mutex and a free list
+	in each thread's cache. Threads allocate from and deallocate to their
+	own caches; blocks are moved between caches and central lists in
+	batches, so kernels that are deleted by a different thread than the one
+	that created them return to the creator in bulk. Central lists are
+	refilled from slabs that are never returned to the system.
+
+	Each slab belongs to the node of the thread that allocated it
+	(\link this_thread::numa_node\endlink), the thread writes every page
+	of the slab first, hence the pages are placed on its node. A block that
+	is deleted on a different node is not put into the thread cache, it is
+	returned to the central list of its own node, so a node never reuses
+	memory of another node. Threads that are not bound to a node use the
+	lists of the first node.
+
+	Blocks that are larger than the largest size class are allocated with
+	<code>::operator new</code>. There is only one instance of the allocator
+	per process (\link get_kernel_allocator\endlink), because thread caches
+	are shared.
+	*/
+	class kernel_allocator {
+
+	public:
+		enum: size_t {
+			/// Block alignment and size class granularity.
+			alignment = 16,
+			/// The size of the largest size class.
+			max_block_size = 512,
+			/// The number of size classes.
+			nclasses = max_block_size / alignment,
+			/// The size of the memory chunk allocated from the system.
+			slab_size = 64*1024,
+			/// The number of blocks moved to/from central list at once.
+			batch_size = 32,
+			/// The maximal number of NUMA nodes with separate central lists.
+			max_nodes = 8
+		};
+
+	private:
+		struct block {
+			block* next;
+		};
+
+		/// Stored at the beginning of each slab (slabs are aligned to their size).
+		struct slab_header {
+			numa_node_id node;
+		};
+
+		/// Free list of a thread cache.
+		struct free_list {
+			block* head = nullptr;
+			size_t size = 0;
+		};
+
+		struct central_list {
+			sys::spin_mutex mutex;
+			block* head = nullptr;
+		};
+
+		class thread_cache;
+
+		typedef sys::simple_lock<sys::spin_mutex> lock_type;
+
+	private:
+		central_list _lists[max_nodes][nclasses];
+		std::atomic<size_t> _nallocations{0};
+		std::atomic<size_t> _ndeallocations{0};
+		std::atomic<size_t> _nlarge{0};
+		std::atomic<size_t> _nslabs{0};
+		std::atomic<size_t> _nbatches{0};
+		std::atomic<size_t> _nremote{0};
+
+	private:
+
+		kernel_allocator() = default;
+
+	public:
+
+		kernel_allocator(const kernel_allocator&) = delete;
+
+		kernel_allocator&
+		operator=(const kernel_allocator&) = delete;
+
+		void*
+		allocate(size_t n);
+
+		void
+		deallocate(void* ptr, size_t n) noexcept;
+
+		/// Returns the counters (per-thread counters are added periodically).
+		kernel_allocator_stats
+		stats() const noexcept;
+
+	private:
+
+		inline static size_t
+		size_class(size_t n) noexcept {
+			return n == 0 ? 0 : (n-1) / alignment;
+		}
+
+		inline static size_t
+		block_size(size_t cls) noexcept {
+			return (cls+1) * alignment;
+		}
+
+		/// Returns the node of the central lists for the current thread.
+		inline static numa_node_id
+		local_node() noexcept {
+			const numa_node_id node = this_thread::numa_node;
+			return node == no_numa_node ? 0 : node % max_nodes;
+		}
+
+		/// Returns the node of the slab that contains the block.
+		inline static numa_node_id
+		owner(const block* b) noexcept {
+			const size_t addr = reinterpret_cast<size_t>(b);
+			return reinterpret_cast<const slab_header*>(
+				addr & ~(size_t(slab_size)-1)
+			)->node;
+		}
+
+		/// Move up to \link batch_size\endlink blocks from central list.
+		block*
+		pop_batch(numa_node_id node, size_t cls, size_t& n) noexcept;
+
+		/// Move the list of \p n blocks to central list.
+		void
+		push_batch(
+			numa_node_id node,
+			size_t cls,
+			block* first,
+			block* last,
+			size_t n
+		) noexcept;
+
+		/// Carve a new slab into blocks of the size class,
+		/// return one batch and move the rest to central list.
+		block*
+		new_slab(numa_node_id node, size_t cls, size_t& n);
+
+		/// Move the blocks of the node \p node to its central list.
+		void
+		return_remote(numa_node_id node, size_t cls, free_list& lst) noexcept;
+
+		/// Allocate the block bypassing the thread cache.
+		block*
+		allocate_uncached(size_t cls);
+
+		static thread_cache&
+		local_cache() noexcept;
+
+		friend kernel_allocator&
+		get_kernel_allocator() noexcept;
+
+	};
+
+	/// Returns true, if kernels are allocated by \link kernel_allocator\endlink.
+	bool
+	kernel_pool_enabled() noexcept;
+
+}
+
+#endif // vim:filetype=cpp
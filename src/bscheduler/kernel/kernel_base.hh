@@ -4,6 +4,7 @@
 #include <bitset>
 #include <cassert>
 #include <chrono>
+#include <cstddef>
 
 #ifndef NDEBUG
 #include <unistdx/util/backtrace>
@@ -11,6 +12,7 @@
 
 #include <bscheduler/kernel/exit_code.hh>
 #include <bscheduler/kernel/kernel_flag.hh>
+#include <bscheduler/kernel/kernel_priority.hh>
 
 namespace bsc {
 
@@ -26,6 +28,7 @@ namespace bsc {
 		exit_code _result = exit_code::undefined;
 		time_point _at = time_point(duration::zero());
 		flags_type _flags = 0;
+		kernel_priority _priority = kernel_priority::normal;
 
 	public:
 		virtual
@@ -39,6 +42,13 @@ namespace bsc {
 			this->setf(kernel_flag::deleted);
 		}
 
+		/// Allocates kernels from \link kernel_allocator\endlink, if enabled.
+		static void*
+		operator new(size_t n);
+
+		static void
+		operator delete(void* ptr, size_t n) noexcept;
+
 		inline exit_code
 		return_code() const noexcept {
 			return _result;
@@ -70,6 +80,17 @@ namespace bsc {
 			return this->_at != time_point(duration::zero());
 		}
 
+		// priority
+		inline kernel_priority
+		priority() const noexcept {
+			return this->_priority;
+		}
+
+		inline void
+		priority(kernel_priority rhs) noexcept {
+			this->_priority = rhs;
+		}
+
 		// flags
 		inline flags_type
 		flags() const noexcept {
@@ -0,0 +1,193 @@
+#ifndef BSCHEDULER_KERNEL_KERNEL_FRAME_HH
+#define BSCHEDULER_KERNEL_KERNEL_FRAME_HH
+
+#include <sstream>
+#include <string>
+
+#include <unistdx/io/fildesbuf>
+
+#include <bscheduler/kernel/kernel_header.hh>
+#include <bscheduler/kernel/kernelbuf.hh>
+#include <bscheduler/kernel/kstream.hh>
+
+namespace bsc {
+
+	/**
+	\brief Immutable packet payload (header and kernel) that is serialized
+	once and written to many connections.
+	\details
+	The kernel is serialized in fixed-width encoding and, optionally,
+	in compact encoding, so that the frame can be written to connections
+	with any negotiated encoding. The header is stored separately and is
+	written by each connection, so that the connection may attach
+	its own fields to it (e.g. the load of this node). If compression
+	threshold is set, the packet payload with the header as is is also
+	compressed in advance for each encoding. Optional kernel fields
+	(\link wire_feature::fields\endlink) are never written to frames.
+	The frame does not refer to the kernel after construction and may be
+	shared between threads.
+	*/
+	template <class K>
+	class kernel_frame {
+
+	public:
+		typedef K kernel_type;
+
+	private:
+		typedef sys::basic_fildesbuf<char,std::char_traits<char>,std::stringbuf>
+			memory_fildesbuf;
+		typedef basic_kernelbuf<memory_fildesbuf> memory_kernelbuf;
+		typedef kstream<K> stream_type;
+
+	private:
+		kernel_header _header;
+		std::string _fixed;
+		std::string _compact;
+		/// Compressed header and kernel in fixed-width encoding.
+		std::string _fixed_compressed;
+		/// Compressed header and kernel in compact encoding.
+		std::string _compact_compressed;
+		bool _has_compact = false;
+		bool _has_src_and_dest = false;
+
+	public:
+
+		/**
+		\param k the kernel
+		\param src_and_dest prepend source and destination to the header
+		\param compact serialize the kernel in compact encoding too
+		\param compression_threshold compress the payload of at least
+		this number of bytes (zero disables compression)
+		*/
+		kernel_frame(
+			kernel_type& k,
+			bool src_and_dest,
+			bool compact,
+			size_t compression_threshold=0
+		):
+		_has_compact(compact),
+		_has_src_and_dest(src_and_dest) {
+			if (src_and_dest) {
+				k.header().prepend_source_and_destination();
+			}
+			copy_header(k.header(), this->_header);
+			this->serialize(k, false, this->_fixed);
+			this->compress(false, compression_threshold, this->_fixed_compressed);
+			if (compact) {
+				this->serialize(k, true, this->_compact);
+				this->compress(true, compression_threshold, this->_compact_compressed);
+			}
+		}
+
+		kernel_frame(const kernel_frame&) = delete;
+
+		kernel_frame&
+		operator=(const kernel_frame&) = delete;
+
+		/// Returns true, if the frame has payload in compact encoding.
+		inline bool
+		has_compact() const noexcept {
+			return this->_has_compact;
+		}
+
+		inline bool
+		has_src_and_dest() const noexcept {
+			return this->_has_src_and_dest;
+		}
+
+		/// Returns the header of the kernel.
+		inline const kernel_header&
+		header() const noexcept {
+			return this->_header;
+		}
+
+		/// Returns the kernel without header in the specified encoding.
+		inline const std::string&
+		payload(bool compact) const noexcept {
+			return compact && this->_has_compact ? this->_compact : this->_fixed;
+		}
+
+		/**
+		\brief Returns compressed packet payload (the header without
+		additional fields and the kernel) in the specified encoding.
+		\details
+		The string is empty, if the payload was not compressed.
+		*/
+		inline const std::string&
+		compressed_payload(bool compact) const noexcept {
+			return compact && this->_has_compact
+				? this->_compact_compressed
+				: this->_fixed_compressed;
+		}
+
+	private:
+
+		static void
+		serialize(kernel_type& k, bool compact, std::string& result) {
+			memory_kernelbuf buf;
+			buf.setfd(std::stringbuf{});
+			stream_type stream(&buf);
+			stream.begin_packet();
+			buf.set_opacket_features(
+				compact ? wire_feature::compact_encoding : wire_feature()
+			);
+			stream << k;
+			stream.end_packet();
+			stream.sync();
+			result = strip_packet_header(buf);
+		}
+
+		void
+		compress(bool compact, size_t threshold, std::string& result) const {
+			if (threshold == 0) {
+				return;
+			}
+			memory_kernelbuf buf;
+			buf.setfd(std::stringbuf{});
+			buf.set_compression_threshold(threshold);
+			buf.set_peer_features(wire_feature::compression);
+			stream_type stream(&buf);
+			stream.begin_packet();
+			buf.set_opacket_features(
+				compact ? wire_feature::compact_encoding : wire_feature()
+			);
+			stream << this->_header;
+			const std::string& payload = this->payload(compact);
+			stream.write(payload.data(), payload.size());
+			buf.compress_opacket();
+			const bool compressed = buf.opacket_is_compressed();
+			stream.end_packet();
+			stream.sync();
+			if (compressed) {
+				result = strip_packet_header(buf);
+			}
+		}
+
+		/// Copy the header through its serialized representation.
+		static void
+		copy_header(const kernel_header& from, kernel_header& to) {
+			memory_kernelbuf buf;
+			buf.setfd(std::stringbuf{});
+			stream_type stream(&buf);
+			stream.begin_packet();
+			stream << from;
+			stream.end_packet();
+			stream.sync();
+			if (!stream.read_packet()) {
+				BSCHEDULER_THROW(error, "bad kernel header");
+			}
+			stream >> to;
+		}
+
+		static std::string
+		strip_packet_header(memory_kernelbuf& buf) {
+			std::string result = buf.fd().str();
+			result.erase(0, sizeof(typename memory_kernelbuf::portable_size_type));
+			return result;
+		}
+
+	};
+
+}
+
+#endif // vim:filetype=cpp
@@ -3,6 +3,8 @@
 #include <unistdx/base/make_object>
 #include <ostream>
 
+#include <bscheduler/kernel/wire_format.hh>
+
 std::ostream&
 bsc::operator<<(std::ostream& out, const kernel_header& rhs) {
 	out << sys::make_fields(
@@ -22,15 +24,42 @@ bsc::operator<<(std::ostream& out, const kernel_header& rhs) {
 
 void
 bsc::kernel_header::write_header(sys::pstream& out) const {
-	out << this->_flags;
+	this->write_header(out, this->_flags, this->_load);
+}
+
+void
+bsc::kernel_header::write_header(sys::pstream& out, std::uint32_t load) const {
+	this->write_header(out, this->_flags | flag_type::has_load, load);
+}
+
+void
+bsc::kernel_header::write_header(
+	sys::pstream& out,
+	flag_type flags,
+	std::uint32_t load
+) const {
+	flags &= ~flag_type(flag_type::zero_application);
+	const bool omit_app = !this->has_application() && this->_aid == 0 &&
+		writes_compact(out);
+	if (omit_app) {
+		flags |= flag_type::zero_application;
+	}
+	out << flags;
 	if (this->has_application()) {
 		out << *this->_aptr;
-	} else {
+	} else if (!omit_app) {
 		out << this->_aid;
 	}
 	if (this->has_source_and_destination()) {
 		out << this->_src << this->_dst;
 	}
+	if (flags & flag_type::has_load) {
+		if (writes_compact(out)) {
+			write_varint(out, load);
+		} else {
+			out << load;
+		}
+	}
 }
 
 void
@@ -45,10 +74,22 @@ bsc::kernel_header::read_header(sys::pstream& in) {
 	} else {
 		// forcibly unset flag for security reasons
 		this->_flags &= ~flag_type::owns_application;
-		in >> this->_aid;
+		if ((this->_flags & flag_type::zero_application) && reads_compact(in)) {
+			this->_aid = 0;
+		} else {
+			in >> this->_aid;
+		}
 	}
+	this->_flags &= ~flag_type::zero_application;
 	if (this->has_source_and_destination()) {
 		in >> this->_src >> this->_dst;
 	}
+	if (this->has_load()) {
+		if (reads_compact(in)) {
+			this->_load = static_cast<std::uint32_t>(read_varint(in));
+		} else {
+			in >> this->_load;
+		}
+	}
 }
 
@@ -1,6 +1,7 @@
 #ifndef BSCHEDULER_KERNEL_KERNEL_HEADER_HH
 #define BSCHEDULER_KERNEL_KERNEL_HEADER_HH
 
+#include <cstdint>
 #include <iosfwd>
 #include <memory>
 
@@ -23,6 +24,7 @@ namespace bsc {
 		sys::socket_address _dst {};
 		application_type _aid = this_application::get_id();
 		const application* _aptr = nullptr;
+		std::uint32_t _load = 0;
 
 	public:
 		kernel_header() = default;
@@ -124,15 +126,62 @@ namespace bsc {
 			this->_flags &= ~kernel_header_flag::has_source_and_destination;
 		}
 
+		/// Returns true, if the header is shared by several kernels of the packet.
+		inline bool
+		is_batch() const noexcept {
+			return this->_flags & kernel_header_flag::batch;
+		}
+
+		inline void
+		set_batch() noexcept {
+			this->_flags |= kernel_header_flag::batch;
+		}
+
+		/// Returns true, if the header carries the load of the sending node.
+		inline bool
+		has_load() const noexcept {
+			return this->_flags & kernel_header_flag::has_load;
+		}
+
+		/**
+		\brief The number of kernels that are queued or in flight
+		on the sending node.
+		*/
+		inline std::uint32_t
+		load() const noexcept {
+			return this->_load;
+		}
+
+		inline void
+		set_load(std::uint32_t rhs) noexcept {
+			this->_flags |= kernel_header_flag::has_load;
+			this->_load = rhs;
+		}
+
+		inline void
+		unset_load() noexcept {
+			this->_flags &= ~kernel_header_flag::has_load;
+			this->_load = 0;
+		}
+
 		void
 		write_header(sys::pstream& out) const;
 
+		/// Write the header with the load \p load of the sending node attached.
+		void
+		write_header(sys::pstream& out, std::uint32_t load) const;
+
 		void
 		read_header(sys::pstream& in);
 
 		friend std::ostream&
 		operator<<(std::ostream& out, const kernel_header& rhs);
 
+	private:
+
+		void
+		write_header(sys::pstream& out, flag_type flags, std::uint32_t load) const;
+
 	};
 
 	std::ostream&
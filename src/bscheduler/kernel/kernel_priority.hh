@@ -0,0 +1,44 @@
+#ifndef BSCHEDULER_KERNEL_KERNEL_PRIORITY_HH
+#define BSCHEDULER_KERNEL_KERNEL_PRIORITY_HH
+
+#include <unistdx/net/bstream>
+
+namespace bsc {
+
+	typedef uint8_t kernel_priority_type;
+
+	/**
+	\brief Kernel priority classes.
+	\details
+	Pipelines with multi-level queues execute kernels with higher priority
+	first, but still give some share of threads' time to lower priorities.
+	Control-plane kernels (node discovery, hierarchy and socket events)
+	have high priority. The priority is sent only to the peers that
+	negotiated \link wire_feature::priority\endlink, other peers keep
+	the priority that the kernel's constructor sets.
+	*/
+	enum struct kernel_priority: kernel_priority_type {
+		low = 0,
+		normal = 1,
+		high = 2
+	};
+
+	/// The number of kernel priority classes.
+	constexpr const size_t num_kernel_priorities = 3;
+
+	inline sys::bstream&
+	operator<<(sys::bstream& out, kernel_priority rhs) {
+		return out << kernel_priority_type(rhs);
+	}
+
+	inline sys::bstream&
+	operator>>(sys::bstream& in, kernel_priority& rhs) {
+		kernel_priority_type tmp;
+		in >> tmp;
+		rhs = kernel_priority(tmp);
+		return in;
+	}
+
+}
+
+#endif // vim:filetype=cpp
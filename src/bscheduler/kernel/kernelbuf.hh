@@ -1,15 +1,149 @@
 #ifndef BSCHEDULER_KERNEL_KERNELBUF_HH
 #define BSCHEDULER_KERNEL_KERNELBUF_HH
 
+#include <cstdint>
+#include <string>
 #include <type_traits>
+#include <vector>
 
 #include <unistdx/base/packetbuf>
 #include <unistdx/net/byte_order>
 
+#include <bscheduler/base/error.hh>
+#include <bscheduler/base/lz_codec.hh>
+#include <bscheduler/kernel/ring_fildesbuf.hh>
+#include <bscheduler/kernel/wire_feature.hh>
+
 namespace bsc {
 
+	/**
+	\brief Packet compression interface of \link basic_kernelbuf\endlink.
+	\details
+	Compression is one of the optional \link wire_feature\endlink s:
+	the buffer compresses its packets only after the other side has listed
+	compression in its handshake. The handshake is written and read by
+	\link kernel_protocol\endlink, the buffer only stores its result.
+	Compact encoding of kernel fields is negotiated the same way.
+	Optional kernel fields (\link wire_feature::fields\endlink) are written
+	whenever both sides read them.
+	The features that a packet uses are marked by the flags in its size
+	header, and are never set before the negotiation. A packet with
+	optional fields carries one more header byte with the mask of the
+	fields that it has, so the reader does not assume that the writer
+	used the fields that were negotiated.
+	*/
+	class kernelbuf_base {
+
+	public:
+		virtual
+		~kernelbuf_base() = default;
+
+		/// Returns the features that this side uses, if the other side reads them.
+		virtual wire_feature
+		features() const noexcept = 0;
+
+		/**
+		\brief Returns the features that the other side reads.
+		\details
+		No features are listed until the handshake of the other side
+		is received.
+		*/
+		virtual wire_feature
+		peer_features() const noexcept = 0;
+
+		/// Set the features that the other side listed in its handshake.
+		virtual void
+		set_peer_features(wire_feature rhs) noexcept = 0;
+
+		/// Returns true, if the handshake of this side has been written.
+		virtual bool
+		handshake_sent() const noexcept = 0;
+
+		virtual void
+		set_handshake_sent(bool rhs) noexcept = 0;
+
+		/// Returns true, if outgoing packets are compressed.
+		virtual bool
+		compresses() const noexcept = 0;
+
+		/**
+		\brief Compress payload of the packet that is being written.
+		\details
+		Must be called before \c end_packet. The packet is left intact,
+		if compression is disabled, the payload is smaller than
+		the threshold or does not compress.
+		*/
+		virtual void
+		compress_opacket() = 0;
+
+		/// Returns true, if the packet that is being written has been compressed.
+		virtual bool
+		opacket_is_compressed() const noexcept = 0;
+
+		/**
+		\brief Mark the packet that is being written as compressed.
+		\details
+		Used to write payload that was compressed in advance.
+		Must be called only if the other side reads compressed packets.
+		*/
+		virtual void
+		set_opacket_compressed() noexcept = 0;
+
+		/// Returns true, if the packet that is being read is compressed.
+		virtual bool
+		ipacket_is_compressed() const noexcept = 0;
+
+		/// Decompress payload of the packet that is being read into \p result.
+		virtual void
+		decompress_ipacket(std::string& result) = 0;
+
+		/// Returns the size of the packet that is being written including header.
+		virtual size_t
+		opacket_size() noexcept = 0;
+
+		/**
+		\brief Returns the features that the packet that is being written uses.
+		\details
+		Only the features that change the encoding of kernel fields or
+		add fields are returned (e.g. \link wire_feature::compact_encoding\endlink).
+		*/
+		virtual wire_feature
+		opacket_features() const noexcept = 0;
+
+		/// Returns the features that the packet that is being read uses.
+		virtual wire_feature
+		ipacket_features() const noexcept = 0;
+
+		/**
+		\brief Override encoding of the packet that is being written.
+		\details
+		Must be called after \c begin_packet and before anything is written.
+		Only the features that were negotiated may be set.
+		*/
+		virtual void
+		set_opacket_features(wire_feature rhs) noexcept = 0;
+
+		/**
+		\brief Start size-prefixed record inside the packet that is being written.
+		\details
+		Records are used to put several kernels into one packet.
+		The size of the record is written by \link end_record\endlink.
+		*/
+		virtual void
+		begin_record() = 0;
+
+		/// Write the size of the current record.
+		virtual void
+		end_record() = 0;
+
+		/// Remove the current record from the packet.
+		virtual void
+		cancel_record() noexcept = 0;
+
+	};
+
 	template<class Base>
-	class basic_kernelbuf: public Base {
+	class basic_kernelbuf: public Base, public kernelbuf_base {
 
 	public:
 		typedef Base base_type;
@@ -26,6 +160,42 @@ namespace bsc {
 	private:
 		typedef sys::bytes<portable_size_type, char_type> bytes_type;
 
+		static_assert(
+			wire_feature::fields < 0x100,
+			"the mask of optional fields does not fit into one byte"
+		);
+
+		enum: portable_size_type {
+			compressed_bit = portable_size_type(1) << 31,
+			compact_bit = portable_size_type(1) << 30,
+			fields_bit = portable_size_type(1) << 29,
+			size_mask = fields_bit - 1,
+			/// The size of the mask of optional fields after the size header.
+			fields_size = 1
+		};
+
+	private:
+		/// Minimal payload size of compressed packets (0 disables compression).
+		size_t _compression_threshold = 0;
+		/// Maximal size of decompressed incoming packets.
+		size_t _max_packet_size = size_t(1) << 26;
+		/// Features that the other side reads.
+		wire_feature _peer_features;
+		bool _handshake_sent = false;
+		bool _ocompressed = false;
+		bool _icompressed = false;
+		std::vector<char> _scratch;
+		/// Whether compact encoding is enabled on this side.
+		bool _compact = false;
+		/// Features of the packet that is being written.
+		wire_feature _ofeatures;
+		/// Features of the packet that is being read.
+		wire_feature _ifeatures;
+		/// Offset of the current record from the beginning of the packet.
+		size_t _record = 0;
+		/// The size of the header of the packet that is being written.
+		std::streamsize _oheader = header_size();
+
 	public:
 		basic_kernelbuf() = default;
 		virtual ~basic_kernelbuf() = default;
@@ -35,6 +205,234 @@ namespace bsc {
 		basic_kernelbuf& operator=(basic_kernelbuf&&) = delete;
 		basic_kernelbuf& operator=(const basic_kernelbuf&) = delete;
 
+		/// Compress packets with payload of at least \p rhs bytes.
+		inline void
+		set_compression_threshold(size_t rhs) noexcept {
+			this->_compression_threshold = rhs;
+		}
+
+		inline size_t
+		compression_threshold() const noexcept {
+			return this->_compression_threshold;
+		}
+
+		/**
+		\brief Reject compressed packets that decompress into more than
+		\p rhs bytes.
+		\details
+		The size of decompressed payload comes from the other side,
+		and the memory for it is allocated before the payload is decompressed,
+		so that a small packet could otherwise allocate up to 512 MiB.
+		The default is 64 MiB.
+		*/
+		inline void
+		set_max_packet_size(size_t rhs) noexcept {
+			this->_max_packet_size = rhs;
+		}
+
+		inline size_t
+		max_packet_size() const noexcept {
+			return this->_max_packet_size;
+		}
+
+		inline bool
+		compresses() const noexcept override {
+			return this->_compression_threshold != 0 &&
+				(this->_peer_features & wire_feature::compression);
+		}
+
+		wire_feature
+		features() const noexcept override {
+			wire_feature result;
+			if (this->_compression_threshold != 0) {
+				result |= wire_feature::compression;
+			}
+			if (this->_compact) {
+				result |= wire_feature::compact_encoding;
+			}
+			return result;
+		}
+
+		/// Returns the features that are used by both sides.
+		inline wire_feature
+		negotiated_features() const noexcept {
+			return this->features() & this->_peer_features;
+		}
+
+		inline wire_feature
+		peer_features() const noexcept override {
+			return this->_peer_features;
+		}
+
+		inline void
+		set_peer_features(wire_feature rhs) noexcept override {
+			this->_peer_features = rhs;
+		}
+
+		inline bool
+		handshake_sent() const noexcept override {
+			return this->_handshake_sent;
+		}
+
+		inline void
+		set_handshake_sent(bool rhs) noexcept override {
+			this->_handshake_sent = rhs;
+		}
+
+		/**
+		\brief Forget the result of the negotiation.
+		\details
+		Must be called when the buffer is connected to another peer.
+		*/
+		inline void
+		reset_negotiation() noexcept {
+			this->_peer_features = wire_feature();
+			this->_handshake_sent = false;
+		}
+
+		/**
+		\brief Write kernels in compact encoding, if the other side
+		reads it.
+		\details
+		Packets that are being written keep the encoding that was chosen
+		in \c begin_packet.
+		*/
+		inline void
+		set_compact_encoding(bool rhs) noexcept {
+			this->_compact = rhs;
+		}
+
+		inline bool
+		compact_encoding() const noexcept {
+			return this->_compact;
+		}
+
+		/// Returns optional kernel fields that both sides read.
+		inline wire_feature
+		field_features() const noexcept {
+			return this->_peer_features & wire_feature::fields;
+		}
+
+		/// Returns true, if outgoing packets use compact encoding.
+		inline bool
+		compacts() const noexcept {
+			return this->negotiated_features() & wire_feature::compact_encoding;
+		}
+
+		inline wire_feature
+		opacket_features() const noexcept override {
+			return this->_ofeatures;
+		}
+
+		inline wire_feature
+		ipacket_features() const noexcept override {
+			return this->_ifeatures;
+		}
+
+		inline void
+		set_opacket_features(wire_feature rhs) noexcept override {
+			this->_ofeatures = rhs;
+		}
+
+		/// Set encoding of the packet that is being read (for memory buffers).
+		inline void
+		set_ipacket_features(wire_feature rhs) noexcept {
+			this->_ifeatures = rhs;
+		}
+
+		void
+		compress_opacket() override {
+			if (!this->compresses()) {
+				return;
+			}
+			char_type* first = this->opacket_begin() + this->_oheader;
+			const size_t n = this->pptr() - first;
+			// the other side rejects packets that decompress into more than
+			// its maximal packet size, send them uncompressed
+			if (n < this->_compression_threshold || n > size_mask ||
+			    n > this->_max_packet_size) {
+				return;
+			}
+			this->_scratch.clear();
+			bytes_type original_size(static_cast<portable_size_type>(n));
+			original_size.to_network_format();
+			this->_scratch.insert(
+				this->_scratch.end(),
+				original_size.begin(),
+				original_size.begin() + original_size.size()
+			);
+			lz::compress(first, n, this->_scratch);
+			if (this->_scratch.size() >= n) {
+				return;
+			}
+			traits_type::copy(first, this->_scratch.data(), this->_scratch.size());
+			this->pbump(-static_cast<int>(n - this->_scratch.size()));
+			this->_ocompressed = true;
+		}
+
+		inline bool
+		opacket_is_compressed() const noexcept override {
+			return this->_ocompressed;
+		}
+
+		inline void
+		set_opacket_compressed() noexcept override {
+			this->_ocompressed = true;
+		}
+
+		inline bool
+		ipacket_is_compressed() const noexcept override {
+			return this->_icompressed;
+		}
+
+		void
+		decompress_ipacket(std::string& result) override {
+			const char_type* first = this->ipayload_cur();
+			const char_type* last = this->ipayload_end();
+			if (last - first < this->header_size()) {
+				BSCHEDULER_THROW(error, "bad compressed packet");
+			}
+			bytes_type size(first, this->header_size());
+			size.to_host_format();
+			// the size comes from the other side
+			if (size.value() > size_mask ||
+			    size.value() > this->_max_packet_size) {
+				BSCHEDULER_THROW(error, "bad compressed packet size");
+			}
+			first += this->header_size();
+			result.resize(size.value());
+			if (!result.empty()) {
+				lz::decompress(first, last-first, &result[0], result.size());
+			}
+		}
+
+		inline size_t
+		opacket_size() noexcept override {
+			return this->pptr() - this->opacket_begin();
+		}
+
+		void
+		begin_record() override {
+			this->_record = this->opacket_size();
+			const char_type placeholder[header_size()] = {};
+			this->sputn(placeholder, header_size());
+		}
+
+		void
+		end_record() override {
+			char_type* first = this->opacket_begin() + this->_record;
+			const size_t n = this->pptr() - first - header_size();
+			bytes_type size(static_cast<portable_size_type>(n));
+			size.to_network_format();
+			traits_type::copy(first, size.begin(), size.size());
+		}
+
+		void
+		cancel_record() noexcept override {
+			const size_t n = this->opacket_size() - this->_record;
+			this->pbump(-static_cast<int>(n));
+		}
+
 	private:
 
 		bool
@@ -43,8 +441,34 @@ namespace bsc {
 			if (this->egptr() - this->gptr() >= this->header_size()) {
 				bytes_type size(this->gptr(), this->header_size());
 				size.to_host_format();
+				const portable_size_type value = size.value();
 				hs = this->header_size();
-				payload_size = size.value() - this->header_size();
+				if (value & fields_bit) {
+					hs += fields_size;
+				}
+				if (this->egptr() - this->gptr() < hs) {
+					return false;
+				}
+				this->_icompressed = value & compressed_bit;
+				this->_ifeatures = wire_feature();
+				if (value & compact_bit) {
+					this->_ifeatures |= wire_feature::compact_encoding;
+				}
+				if (value & fields_bit) {
+					// the fields that the other side actually wrote
+					const wire_feature mask(
+						wire_feature::flag_type(
+							traits_type::to_int_type(this->gptr()[header_size()])
+						)
+					);
+					this->_ifeatures |= mask & wire_feature::fields;
+				}
+				payload_size = (value & size_mask) - hs;
+				const std::streamsize n = hs + payload_size;
+				if (this->egptr() - this->gptr() < n) {
+					// read the rest of the packet directly into its final place
+					reserve_ipacket(static_cast<Base&>(*this), n);
+				}
 				success = true;
 			}
 			return success;
@@ -52,15 +476,48 @@ namespace bsc {
 
 		void
 		put_header() override {
+			this->_ofeatures =
+				(this->negotiated_features() & wire_feature::compact_encoding) |
+				this->field_features();
 			this->pbump(this->header_size());
+			this->_oheader = this->header_size();
+			if (this->_ofeatures & wire_feature::fields) {
+				// the mask is written by overwrite_header
+				this->sputc(char_type());
+				this->_oheader += fields_size;
+			}
 		}
 
 		std::streamsize
 		overwrite_header(std::streamsize s) override {
-			bytes_type hdr(s);
+			const bool compressed = this->_ocompressed;
+			this->_ocompressed = false;
+			if (static_cast<size_t>(s) > size_mask) {
+				// the high bits are reserved for the flags
+				BSCHEDULER_THROW(error, "packet is too large");
+			}
+			portable_size_type value = s;
+			if (compressed) {
+				value |= compressed_bit;
+			}
+			if (this->_ofeatures & wire_feature::compact_encoding) {
+				value |= compact_bit;
+			}
+			if (this->_oheader != this->header_size()) {
+				// the fields may have been dropped after the header was put,
+				// the mask is written anyway, because its byte is reserved
+				value |= fields_bit;
+				const wire_feature mask = this->_ofeatures & wire_feature::fields;
+				this->opacket_begin()[header_size()] = traits_type::to_char_type(
+					static_cast<typename traits_type::int_type>(
+						wire_feature::flag_type(mask)
+					)
+				);
+			}
+			bytes_type hdr(value);
 			hdr.to_network_format();
 			traits_type::copy(this->opacket_begin(), hdr.begin(), hdr.size());
-			return this->header_size();
+			return this->_oheader;
 		}
 
 		static constexpr std::streamsize
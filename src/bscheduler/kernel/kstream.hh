@@ -8,6 +8,7 @@
 #include <unistdx/net/pstream>
 
 #include <bscheduler/base/error.hh>
+#include <bscheduler/kernel/array_io.hh>
 #include <bscheduler/kernel/foreign_kernel.hh>
 #include <bscheduler/kernel/kernel_error.hh>
 #include <bscheduler/kernel/kernel_type_registry.hh>
@@ -1,11 +1,29 @@
 #include "mobile_kernel.hh"
 
+#include <bscheduler/kernel/wire_format.hh>
+
 void
 bsc::mobile_kernel::read(sys::pstream& in) {
-	in >> _result >> _id;
+	if (reads_compact(in)) {
+		_result = exit_code(exit_code_type(read_varint(in)));
+		_id = read_varint(in);
+	} else {
+		in >> _result >> _id;
+	}
+	if (reads_feature(in, wire_feature::priority)) {
+		in >> _priority;
+	}
 }
 
 void
 bsc::mobile_kernel::write(sys::pstream& out) const {
-	out << _result << _id;
+	if (writes_compact(out)) {
+		write_varint(out, exit_code_type(_result));
+		write_varint(out, _id);
+	} else {
+		out << _result << _id;
+	}
+	if (writes_feature(out, wire_feature::priority)) {
+		out << _priority;
+	}
 }
@@ -0,0 +1,111 @@
+#ifndef BSCHEDULER_KERNEL_PAYLOAD_SLICE_HH
+#define BSCHEDULER_KERNEL_PAYLOAD_SLICE_HH
+
+#include <cstddef>
+#include <memory>
+#include <stdexcept>
+
+namespace bsc {
+
+	/**
+	\brief Reference-counted slice of an immutable byte buffer.
+	\details
+	Copying the slice or taking a sub-slice does not copy the bytes:
+	all slices share the same buffer, which is freed when the last
+	slice is destroyed. The bytes may be written only through the slice
+	that allocated the buffer, before it is shared.
+	*/
+	class payload_slice {
+
+	public:
+		/// Byte type.
+		typedef char char_type;
+		/// Size type.
+		typedef std::size_t size_type;
+
+	private:
+		std::shared_ptr<char_type> _buffer;
+		size_type _offset = 0;
+		size_type _size = 0;
+
+	public:
+
+		payload_slice() = default;
+
+		/// Allocate uninitialised buffer of \p size bytes.
+		inline explicit
+		payload_slice(size_type size):
+		_buffer(
+			size == 0 ? nullptr : new char_type[size],
+			std::default_delete<char_type[]>()
+		),
+		_size(size)
+		{}
+
+		payload_slice(const payload_slice&) = default;
+
+		payload_slice&
+		operator=(const payload_slice&) = default;
+
+		payload_slice(payload_slice&&) = default;
+
+		payload_slice&
+		operator=(payload_slice&&) = default;
+
+		/// Returns the first byte of the slice.
+		inline const char_type*
+		data() const noexcept {
+			return this->_buffer.get() + this->_offset;
+		}
+
+		/// Returns the first byte of the slice for writing.
+		inline char_type*
+		data() noexcept {
+			return this->_buffer.get() + this->_offset;
+		}
+
+		inline size_type
+		size() const noexcept {
+			return this->_size;
+		}
+
+		inline bool
+		empty() const noexcept {
+			return this->_size == 0;
+		}
+
+		/**
+		\brief Returns \p n bytes starting from \p offset that share
+		the buffer with this slice.
+		\throws std::out_of_range if the bytes are outside the slice
+		*/
+		inline payload_slice
+		slice(size_type offset, size_type n) const {
+			if (offset > this->_size || n > this->_size - offset) {
+				throw std::out_of_range("bad payload slice");
+			}
+			payload_slice result(*this);
+			result._offset += offset;
+			result._size = n;
+			return result;
+		}
+
+		/// Returns the number of slices that share the buffer.
+		inline long
+		use_count() const noexcept {
+			return this->_buffer.use_count();
+		}
+
+		/// Release the buffer.
+		inline void
+		clear() noexcept {
+			this->_buffer.reset();
+			this->_offset = 0;
+			this->_size = 0;
+		}
+
+	};
+
+}
+
+#endif // vim:filetype=cpp
@@ -0,0 +1,252 @@
+#ifndef BSCHEDULER_KERNEL_RING_FILDESBUF_HH
+#define BSCHEDULER_KERNEL_RING_FILDESBUF_HH
+
+#include <algorithm>
+#include <streambuf>
+#include <type_traits>
+
+#include <unistdx/base/packetbuf>
+#include <unistdx/io/fildesbuf>
+
+#include <bscheduler/base/mirrored_memory.hh>
+
+namespace bsc {
+
+	/**
+	\brief File descriptor buffer with the get area in mirrored memory
+	(\link mirrored_memory\endlink).
+	\details
+	The get area is a ring: the bytes that were read wrap around the end
+	of the memory region, but are still contiguous thanks to the second
+	mapping. Hence \link compact\endlink only moves the beginning of
+	the get area instead of moving unread bytes to the beginning
+	of the buffer.
+
+	The get area grows only when the packet does not fit into it
+	(\link reserve\endlink). Large packets are read directly into
+	the reserved space with as few reads as the file descriptor
+	allows, and are not moved inside the buffer afterwards. The payload
+	of foreign kernels is still copied from the ring into
+	\link payload_slice\endlink, because the kernel outlives the packet
+	and the ring is reused for the next packets. The put area is inherited
+	from \c sys::basic_fildesbuf.
+	*/
+	template <class Ch, class Tr, class Fd>
+	class basic_ring_fildesbuf: public sys::basic_fildesbuf<Ch,Tr,Fd> {
+
+	public:
+		typedef sys::basic_fildesbuf<Ch,Tr,Fd> base_type;
+		using typename base_type::char_type;
+		using typename base_type::traits_type;
+		using typename base_type::int_type;
+		typedef Fd fd_type;
+
+		static_assert(
+			std::is_same<char_type,char>::value,
+			"mirrored memory stores bytes"
+		);
+
+	private:
+		typedef std::is_base_of<std::basic_streambuf<Ch,Tr>,Fd> is_streambuf;
+
+	private:
+		mirrored_memory _gbuf;
+		/// The number of flushes that wrote data to the file descriptor.
+		size_t _nwrites = 0;
+
+	public:
+
+		/// The initial size of the get area.
+		static constexpr const size_t default_capacity = 4096*4;
+
+		explicit
+		basic_ring_fildesbuf(size_t capacity=default_capacity):
+		_gbuf(capacity) {
+			char_type* first = this->_gbuf.data();
+			this->setg(first, first, first);
+		}
+
+		virtual ~basic_ring_fildesbuf() = default;
+
+		basic_ring_fildesbuf(basic_ring_fildesbuf&&) = delete;
+		basic_ring_fildesbuf(const basic_ring_fildesbuf&) = delete;
+		basic_ring_fildesbuf& operator=(basic_ring_fildesbuf&&) = delete;
+		basic_ring_fildesbuf& operator=(const basic_ring_fildesbuf&) = delete;
+
+		/// Replace the file descriptor, unread bytes are kept.
+		void
+		setfd(fd_type&& rhs) {
+			char_type* first = this->eback();
+			char_type* cur = this->gptr();
+			char_type* last = this->egptr();
+			base_type::setfd(std::move(rhs));
+			this->setg(first, cur, last);
+		}
+
+		/**
+		\brief Read as many bytes as the file descriptor has.
+		\details
+		The get area grows, if it is full.
+		\return the number of bytes read
+		*/
+		std::streamsize
+		pubfill() {
+			std::streamsize total = 0;
+			while (true) {
+				if (this->free_space() == 0) {
+					this->grow(2*this->capacity());
+				}
+				const size_t m = this->free_space();
+				const std::streamsize n = this->read(this->egptr(), m);
+				if (n <= 0) {
+					break;
+				}
+				this->setg(this->eback(), this->gptr(), this->egptr() + n);
+				total += n;
+				if (size_t(n) < m) {
+					// short read: the file descriptor is drained
+					break;
+				}
+			}
+			return total;
+		}
+
+		/**
+		\brief Discard bytes that were read.
+		\details
+		Unlike \c sys::basic_fildesbuf::compact, unread bytes
+		stay where they are: the get area starts from the current position,
+		and all pointers are moved back to the first mapping.
+		*/
+		void
+		compact() noexcept {
+			char_type* first = this->gptr();
+			char_type* last = this->egptr();
+			char_type* data = this->_gbuf.data();
+			const size_t n = this->_gbuf.size();
+			if (first >= data + n) {
+				first -= n;
+				last -= n;
+			}
+			this->setg(first, first, last);
+		}
+
+		/**
+		\brief Make sure that \p n bytes starting from the current position
+		fit into the get area.
+		\details
+		Reserved space is filled by subsequent calls to \link pubfill\endlink.
+		Pointers are preserved relative to the beginning of the get area.
+		*/
+		void
+		reserve(size_t n) {
+			const size_t required = (this->gptr() - this->eback()) + n;
+			if (required > this->capacity()) {
+				this->grow(std::max(required, 2*this->capacity()));
+			}
+		}
+
+		/**
+		\brief Write the put area.
+		\details
+		Hides \c sys::basic_fildesbuf::pubflush to count the flushes
+		that wrote data (\link num_writes\endlink).
+		*/
+		void
+		pubflush() {
+			const size_t n = this->unflushed();
+			base_type::pubflush();
+			if (this->unflushed() != n) {
+				++this->_nwrites;
+			}
+		}
+
+		/// Returns the number of flushes that wrote data to the file descriptor.
+		inline size_t
+		num_writes() const noexcept {
+			return this->_nwrites;
+		}
+
+		/// Returns the number of bytes in the put area that were not written yet.
+		inline size_t
+		unflushed() const noexcept {
+			return this->pptr() - this->pbase();
+		}
+
+		/// Returns the maximal number of bytes in the get area.
+		inline size_t
+		capacity() const noexcept {
+			return this->_gbuf.size();
+		}
+
+	protected:
+
+		/// Write the put area and read into the ring.
+		int
+		sync() override {
+			this->pubflush();
+			this->pubfill();
+			return 0;
+		}
+
+		int_type
+		underflow() override {
+			if (this->gptr() == this->egptr()) {
+				this->pubfill();
+			}
+			return this->gptr() == this->egptr()
+				? traits_type::eof()
+				: traits_type::to_int_type(*this->gptr());
+		}
+
+	private:
+
+		inline size_t
+		free_space() const noexcept {
+			return this->capacity() - (this->egptr() - this->eback());
+		}
+
+		void
+		grow(size_t n) {
+			mirrored_memory tmp(n);
+			char_type* old = this->eback();
+			const size_t cur = this->gptr() - old;
+			const size_t size = this->egptr() - old;
+			traits_type::copy(tmp.data(), old, size);
+			this->_gbuf = std::move(tmp);
+			char_type* first = this->_gbuf.data();
+			this->setg(first, first + cur, first + size);
+		}
+
+		inline std::streamsize
+		read(char_type* s, std::streamsize n) {
+			return this->read(s, n, is_streambuf());
+		}
+
+		inline std::streamsize
+		read(char_type* s, std::streamsize n, std::true_type) {
+			return this->fd().sgetn(s, n);
+		}
+
+		inline std::streamsize
+		read(char_type* s, std::streamsize n, std::false_type) {
+			return this->fd().read(s, n);
+		}
+
+	};
+
+	/// Packet buffers with fixed get area do not reserve space for packets.
+	template <class Ch, class Tr>
+	inline void
+	reserve_ipacket(sys::basic_packetbuf<Ch,Tr>&, size_t) noexcept {}
+
+	/// Reserve space for the whole packet in the get area.
+	template <class Ch, class Tr, class Fd>
+	inline void
+	reserve_ipacket(basic_ring_fildesbuf<Ch,Tr,Fd>& buf, size_t n) {
+		buf.reserve(n);
+	}
+
+}
+
+#endif // vim:filetype=cpp
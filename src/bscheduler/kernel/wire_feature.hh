@@ -0,0 +1,115 @@
+#ifndef BSCHEDULER_KERNEL_WIRE_FEATURE_HH
+#define BSCHEDULER_KERNEL_WIRE_FEATURE_HH
+
+#include <cstdint>
+
+namespace bsc {
+
+	/**
+	\brief Optional features of the wire format.
+	\details
+	Features are negotiated per connection. Each side lists the features
+	it reads in the handshake packet (see \link kernel_protocol\endlink),
+	and the other side uses only the listed features. Peers that do not
+	send the handshake list nothing and receive packets in the original
+	format.
+	*/
+	class wire_feature {
+
+	public:
+		typedef std::uint32_t flag_type;
+
+	private:
+		flag_type _flag = 0;
+
+	public:
+		enum flag_enum: flag_type {
+			/// Packet payload may be compressed.
+			compression = 1,
+			/**
+			Integers in kernel headers and ids are written as variable-length
+			quantities (7 bits per byte, least significant group first),
+			and kernel ids as differences from the neighbouring ids
+			(see \link write_varint\endlink).
+			*/
+			compact_encoding = 2,
+			/**
+			Kernels with the same header are written in one packet
+			as size-prefixed records after the header of the batch.
+			*/
+			batches = 4,
+			/// The load of the sending node is written in hierarchy kernels.
+			node_load = 8,
+			/// Kernels carry their priority class.
+			priority = 16,
+			/**
+			Features that add fields to kernels. They are used whenever
+			both sides read them, and packets that have these fields are
+			marked in the packet header.
+			*/
+			fields = node_load | priority,
+			/// All features that this version reads.
+			all = compression | compact_encoding | batches | node_load | priority
+		};
+
+		wire_feature() = default;
+
+		wire_feature(const wire_feature&) = default;
+
+		inline
+		wire_feature(flag_type rhs) noexcept:
+		_flag(rhs)
+		{}
+
+		inline
+		operator flag_type() const noexcept {
+			return this->_flag;
+		}
+
+		inline wire_feature&
+		operator|=(wire_feature rhs) noexcept {
+			this->_flag |= flag_type(rhs);
+			return *this;
+		}
+
+		inline wire_feature&
+		operator&=(wire_feature rhs) noexcept {
+			this->_flag &= flag_type(rhs);
+			return *this;
+		}
+
+	};
+
+	#define MAKE_UNARY(op) \
+	inline wire_feature \
+	operator op(wire_feature rhs) noexcept { \
+		return op wire_feature::flag_type(rhs); \
+	}
+
+	#define MAKE_BINARY(op, return_type) \
+	inline return_type \
+	operator op(wire_feature lhs, wire_feature rhs) noexcept { \
+		return wire_feature::flag_type(lhs) op wire_feature::flag_type(rhs); \
+	} \
+	inline return_type \
+	operator op(wire_feature::flag_enum lhs, wire_feature rhs) noexcept { \
+		return wire_feature::flag_type(lhs) op wire_feature::flag_type(rhs); \
+	} \
+	inline return_type \
+	operator op(wire_feature lhs, wire_feature::flag_enum rhs) noexcept { \
+		return wire_feature::flag_type(lhs) op wire_feature::flag_type(rhs); \
+	}
+
+	MAKE_UNARY(~)
+	MAKE_BINARY(|, wire_feature)
+	MAKE_BINARY(&, wire_feature)
+	MAKE_BINARY(^, wire_feature)
+	MAKE_BINARY(==, bool)
+	MAKE_BINARY(!=, bool)
+
+	#undef MAKE_UNARY
+	#undef MAKE_BINARY
+
+}
+
+#endif // vim:filetype=cpp
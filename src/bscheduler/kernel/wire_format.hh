@@ -0,0 +1,90 @@
+#ifndef BSCHEDULER_KERNEL_WIRE_FORMAT_HH
+#define BSCHEDULER_KERNEL_WIRE_FORMAT_HH
+
+#include <cstdint>
+
+#include <unistdx/net/pstream>
+
+#include <bscheduler/base/error.hh>
+#include <bscheduler/kernel/kernelbuf.hh>
+#include <bscheduler/kernel/wire_feature.hh>
+
+namespace bsc {
+
+	/// Returns true, if the packet that is being written to \p out uses feature \p f.
+	inline bool
+	writes_feature(sys::pstream& out, wire_feature f) {
+		kernelbuf_base* buf = dynamic_cast<kernelbuf_base*>(out.rdbuf());
+		return buf && (buf->opacket_features() & f);
+	}
+
+	/// Returns true, if the packet that is being read from \p in uses feature \p f.
+	inline bool
+	reads_feature(sys::pstream& in, wire_feature f) {
+		kernelbuf_base* buf = dynamic_cast<kernelbuf_base*>(in.rdbuf());
+		return buf && (buf->ipacket_features() & f);
+	}
+
+	/// Returns true, if the kernel is written to \p out in compact encoding.
+	inline bool
+	writes_compact(sys::pstream& out) {
+		return writes_feature(out, wire_feature::compact_encoding);
+	}
+
+	/// Returns true, if the kernel is read from \p in in compact encoding.
+	inline bool
+	reads_compact(sys::pstream& in) {
+		return reads_feature(in, wire_feature::compact_encoding);
+	}
+
+	/// Maps small negative numbers to small unsigned numbers.
+	inline constexpr std::uint64_t
+	zigzag_encode(std::int64_t x) noexcept {
+		return (std::uint64_t(x) << 1) ^ std::uint64_t(x >> 63);
+	}
+
+	inline constexpr std::int64_t
+	zigzag_decode(std::uint64_t x) noexcept {
+		return std::int64_t(x >> 1) ^ -std::int64_t(x & 1);
+	}
+
+	inline void
+	write_varint(sys::pstream& out, std::uint64_t x) {
+		char buf[10];
+		int n = 0;
+		while (x >= 0x80) {
+			buf[n++] = char((x & 0x7f) | 0x80);
+			x >>= 7;
+		}
+		buf[n++] = char(x);
+		out.write(buf, n);
+	}
+
+	inline std::uint64_t
+	read_varint(sys::pstream& in) {
+		std::uint64_t result = 0;
+		for (int shift=0; shift<64; shift+=7) {
+			std::uint8_t b = 0;
+			in >> b;
+			result |= std::uint64_t(b & 0x7f) << shift;
+			if (!(b & 0x80)) {
+				return result;
+			}
+		}
+		BSCHEDULER_THROW(error, "bad varint");
+	}
+
+	/// Write \p value as a signed difference from \p base.
+	inline void
+	write_delta(sys::pstream& out, std::uint64_t base, std::uint64_t value) {
+		write_varint(out, zigzag_encode(std::int64_t(base - value)));
+	}
+
+	inline std::uint64_t
+	read_delta(sys::pstream& in, std::uint64_t base) {
+		return base - std::uint64_t(zigzag_decode(read_varint(in)));
+	}
+
+}
+
+#endif // vim:filetype=cpp
@@ -24,6 +24,10 @@
 #define BSCHEDULER_ENV_APPLICATION_ID "BSCHEDULER_APPLICATION_ID"
 #define BSCHEDULER_ENV_PIPE_IN "BSCHEDULER_PIPE_IN"
 #define BSCHEDULER_ENV_PIPE_OUT "BSCHEDULER_PIPE_OUT"
+#define BSCHEDULER_ENV_SHM "BSCHEDULER_SHM"
+#define BSCHEDULER_ENV_SHM_PARENT_EVENT "BSCHEDULER_SHM_PARENT_EVENT"
+#define BSCHEDULER_ENV_SHM_CHILD_EVENT "BSCHEDULER_SHM_CHILD_EVENT"
+#define BSCHEDULER_ENV_SHM_LIFELINE "BSCHEDULER_SHM_LIFELINE"
 #define BSCHEDULER_ENV_SLAVE "BSCHEDULER_MASTER"
 
 namespace {
@@ -69,6 +73,10 @@ namespace {
 	bsc::application_type this_app = get_appliction_id();
 	sys::fd_type this_pipe_in = get_pipe_fd(BSCHEDULER_ENV_PIPE_IN);
 	sys::fd_type this_pipe_out = get_pipe_fd(BSCHEDULER_ENV_PIPE_OUT);
+	sys::fd_type this_shm = get_pipe_fd(BSCHEDULER_ENV_SHM);
+	sys::fd_type this_parent_event = get_pipe_fd(BSCHEDULER_ENV_SHM_PARENT_EVENT);
+	sys::fd_type this_child_event = get_pipe_fd(BSCHEDULER_ENV_SHM_CHILD_EVENT);
+	sys::fd_type this_lifeline = get_pipe_fd(BSCHEDULER_ENV_SHM_LIFELINE);
 	bool this_is_master = get_master();
 
 	template <class T>
@@ -169,6 +177,30 @@ bsc::this_application
 	return this_pipe_out;
 }
 
+sys::fd_type
+bsc::this_application
+::get_shm_fd() noexcept {
+	return this_shm;
+}
+
+sys::fd_type
+bsc::this_application
+::get_parent_event_fd() noexcept {
+	return this_parent_event;
+}
+
+sys::fd_type
+bsc::this_application
+::get_child_event_fd() noexcept {
+	return this_child_event;
+}
+
+sys::fd_type
+bsc::this_application
+::get_shm_lifeline_fd() noexcept {
+	return this_lifeline;
+}
+
 bool
 bsc::this_application
 ::is_master() noexcept {
@@ -199,15 +231,7 @@ _env(env) {
 int
 bsc::application
 ::execute(const sys::two_way_pipe& pipe) const {
-	sys::argstream args, env;
-	for (const std::string& a : this->_args) {
-		args.append(a);
-	}
-	for (const std::string& a : this->_env) {
-		env.append(a);
-	}
-	// pass application ID
-	env.append(generate_env(BSCHEDULER_ENV_APPLICATION_ID, this->_id));
+	sys::argstream env;
 	// pass in/out file descriptors
 	env.append(generate_env(BSCHEDULER_ENV_PIPE_IN, pipe.child_in().fd()));
 	env.append(
@@ -216,6 +240,48 @@ bsc::application
 			pipe.child_out().fd()
 		)
 	);
+	return this->do_execute(env);
+}
+
+int
+bsc::application
+::execute(const shm_channel& channel) const {
+	sys::argstream env;
+	// pass shared memory and event file descriptors
+	env.append(generate_env(BSCHEDULER_ENV_SHM, channel.memory_fd()));
+	env.append(
+		generate_env(
+			BSCHEDULER_ENV_SHM_PARENT_EVENT,
+			channel.parent_event_fd()
+		)
+	);
+	env.append(
+		generate_env(
+			BSCHEDULER_ENV_SHM_CHILD_EVENT,
+			channel.child_event_fd()
+		)
+	);
+	env.append(
+		generate_env(
+			BSCHEDULER_ENV_SHM_LIFELINE,
+			channel.child_lifeline_fd()
+		)
+	);
+	return this->do_execute(env);
+}
+
+int
+bsc::application
+::do_execute(sys::argstream& env) const {
+	sys::argstream args;
+	for (const std::string& a : this->_args) {
+		args.append(a);
+	}
+	for (const std::string& a : this->_env) {
+		env.append(a);
+	}
+	// pass application ID
+	env.append(generate_env(BSCHEDULER_ENV_APPLICATION_ID, this->_id));
 	// pass role
 	if (this->is_slave()) {
 		env.append(generate_env(BSCHEDULER_ENV_SLAVE, 1));
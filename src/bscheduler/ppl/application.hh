@@ -10,6 +10,8 @@
 #include <unistdx/ipc/identity>
 #include <unistdx/net/pstream>
 
+#include <bscheduler/base/shm_ring.hh>
+
 namespace bsc {
 
 	typedef uint64_t application_type;
@@ -114,6 +116,10 @@ namespace bsc {
 		int
 		execute(const sys::two_way_pipe& pipe) const;
 
+		/// Execute the application connected to the parent with shared memory rings.
+		int
+		execute(const shm_channel& channel) const;
+
 		void
 		write(sys::pstream& out) const;
 
@@ -126,6 +132,11 @@ namespace bsc {
 		friend void
 		swap(application& lhs, application& rhs);
 
+	private:
+
+		int
+		do_execute(sys::argstream& env) const;
+
 	};
 
 	std::ostream&
@@ -158,6 +169,20 @@ namespace bsc {
 		sys::fd_type
 		get_output_fd() noexcept;
 
+		/// Returns shared memory file descriptor, or -1 if pipes are used.
+		sys::fd_type
+		get_shm_fd() noexcept;
+
+		sys::fd_type
+		get_parent_event_fd() noexcept;
+
+		sys::fd_type
+		get_child_event_fd() noexcept;
+
+		/// Returns the socket that is closed when the daemon exits.
+		sys::fd_type
+		get_shm_lifeline_fd() noexcept;
+
 		bool
 		is_master() noexcept;
 
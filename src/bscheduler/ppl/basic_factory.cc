@@ -3,6 +3,9 @@
 #include <unistdx/util/system>
 
 #include <bscheduler/config.hh>
+#include <bscheduler/kernel/kernel_allocator.hh>
+
+thread_local unsigned bsc::this_thread::inline_depth = 0;
 
 namespace {
 
@@ -26,6 +29,17 @@ namespace {
 		stop_all(args ...);
 	}
 
+	#if defined(BSCHEDULER_NUMA)
+	unsigned
+	total_cpus(const std::vector<bsc::numa_node>& nodes) {
+		size_t n = 0;
+		for (const bsc::numa_node& node : nodes) {
+			n += node.cpus.size();
+		}
+		return std::max(size_t(1), n);
+	}
+	#endif
+
 	inline void
 	wait_all() {}
 
@@ -44,6 +58,21 @@ bsc::Factory<T>
 #if defined(BSCHEDULER_SUBMIT) || defined(BSCHEDULER_PROFILE_NODE_DISCOVERY)
 _upstream(1),
 _downstream(1) {
+#elif defined(BSCHEDULER_NUMA)
+_nodes(::bsc::numa_nodes()),
+_upstream(_nodes),
+_downstream(total_cpus(_nodes)) {
+	// one single-threaded downstream pipeline per processor,
+	// bound to the node of the processor
+	size_t i = 0;
+	for (numa_node_id node=0; node<this->_nodes.size(); ++node) {
+		this->_offsets.emplace_back(i);
+		for (size_t j=0; j<this->_nodes[node].cpus.size(); ++j) {
+			this->_downstream[i].set_numa_node(this->_nodes[node], node);
+			++i;
+		}
+	}
+	this->_offsets.emplace_back(i);
 #else
 _upstream(sys::thread_concurrency()),
 _downstream(_upstream.concurrency()) {
@@ -158,6 +187,28 @@ bsc::Factory<T>
 	!defined(BSCHEDULER_PROFILE_NODE_DISCOVERY)
 	this->_child.print_state(out);
 	#endif
+	#if defined(BSCHEDULER_KERNEL_POOL)
+	this->log("kernel allocator _", get_kernel_allocator().stats());
+	#endif
+	#if defined(BSCHEDULER_DAEMON)
+	this->log("nic writes _", this->_parent.get_write_stats());
+	#endif
+	this->log(
+		"queue high water marks: upstream _, downstream _, timer _",
+		this->_upstream.high_water_mark(),
+		this->_downstream.high_water_mark(),
+		this->_timer.high_water_mark()
+	);
+	this->log(
+		"downstream kernels: inlined _, queued _",
+		this->num_inlined(),
+		this->num_queued()
+	);
+	#if defined(BSCHEDULER_NUMA)
+	for (const numa_node& node : this->_nodes) {
+		this->log("numa _", node);
+	}
+	#endif
 }
 
 template class bsc::Factory<BSCHEDULER_KERNEL_TYPE>;
@@ -7,13 +7,22 @@
 #define BSCHEDULER_APPLICATION
 #endif
 
+#include <atomic>
 #include <iosfwd>
+#include <vector>
 
 #include <bscheduler/config.hh>
+#include <bscheduler/base/numa.hh>
+#include <bscheduler/kernel/act.hh>
 #include <bscheduler/ppl/basic_pipeline.hh>
 #include <bscheduler/ppl/io_pipeline.hh>
 #include <bscheduler/ppl/multi_pipeline.hh>
 #include <bscheduler/ppl/parallel_pipeline.hh>
+#if defined(BSCHEDULER_WORK_STEALING)
+#include <bscheduler/ppl/work_stealing_pipeline.hh>
+#elif defined(BSCHEDULER_LOCK_FREE_PIPELINE)
+#include <bscheduler/ppl/lock_free_pipeline.hh>
+#endif
 #if defined(BSCHEDULER_DAEMON) || defined(BSCHEDULER_SUBMIT)
 #include <bscheduler/ppl/socket_pipeline.hh>
 #include <unistdx/net/socket>
@@ -27,19 +36,53 @@
 #endif
 #include <bscheduler/ppl/application.hh>
 #include <bscheduler/ppl/basic_router.hh>
+#if defined(BSCHEDULER_TIMING_WHEEL)
+#include <bscheduler/ppl/timing_wheel_pipeline.hh>
+#else
 #include <bscheduler/ppl/timer_pipeline.hh>
+#endif
 
 namespace bsc {
 
+	/// What \link Factory::send\endlink does when the upstream queue is full.
+	enum class send_policy {
+		/// Wait until the queue has free space.
+		block,
+		/// Execute the kernel in the calling thread.
+		run_inline
+	};
+
+	namespace this_thread {
+
+		/// The number of nested \c react calls executed inline.
+		extern thread_local unsigned inline_depth;
+
+	}
+
 	template <class T>
 	class Factory: public pipeline_base {
 
 	public:
 		typedef T kernel_type;
+		#if defined(BSCHEDULER_WORK_STEALING)
+		typedef work_stealing_pipeline<T> cpu_pipeline_type;
+		#elif defined(BSCHEDULER_LOCK_FREE_PIPELINE)
+		typedef lock_free_pipeline<T> cpu_pipeline_type;
+		#else
 		typedef parallel_pipeline<T> cpu_pipeline_type;
+		#endif
+		#if defined(BSCHEDULER_TIMING_WHEEL)
+		typedef timing_wheel_pipeline<T, basic_router<T>> timer_pipeline_type;
+		#else
 		typedef timer_pipeline<T> timer_pipeline_type;
+		#endif
+		#if defined(BSCHEDULER_NUMA)
+		typedef Multi_pipeline<T,cpu_pipeline_type> upstream_pipeline_type;
+		#else
+		typedef cpu_pipeline_type upstream_pipeline_type;
+		#endif
 		typedef io_pipeline<T> io_pipeline_type;
-		typedef Multi_pipeline<T> downstream_pipeline_type;
+		typedef Multi_pipeline<T,cpu_pipeline_type> downstream_pipeline_type;
 		#if defined(BSCHEDULER_APPLICATION)
 		typedef child_process_pipeline<T, basic_router<T>>
 		    parent_pipeline_type;
@@ -59,7 +102,13 @@ namespace bsc {
 		#endif
 
 	private:
-		cpu_pipeline_type _upstream;
+		#if defined(BSCHEDULER_NUMA)
+		std::vector<numa_node> _nodes;
+		/// The first downstream pipeline of each node.
+		std::vector<size_t> _offsets;
+		std::atomic<size_t> _nextnode{0};
+		#endif
+		upstream_pipeline_type _upstream;
 		downstream_pipeline_type _downstream;
 		timer_pipeline_type _timer;
 		#if !defined(BSCHEDULER_PROFILE_NODE_DISCOVERY)
@@ -71,6 +120,11 @@ namespace bsc {
 		child_pipeline_type _child;
 		external_pipeline_type _external;
 		#endif
+		send_policy _policy = send_policy::block;
+		/// Maximal number of nested inline \c react calls (0 disables them).
+		unsigned _max_inline_depth = 0;
+		std::atomic<size_t> _ninlined{0};
+		std::atomic<size_t> _nqueued{0};
 
 	public:
 		Factory();
@@ -82,24 +136,94 @@ namespace bsc {
 
 		Factory(Factory&&) = delete;
 
+		/**
+		\brief Send the kernel to the pipeline that corresponds to its state.
+		\details
+		Scheduled kernels go to the timer pipeline, kernels that return
+		to their principals go to downstream pipelines and all other kernels
+		go to the upstream pipeline. If the upstream queue is full,
+		the kernel is either executed in the calling thread, or the thread waits
+		until the queue has free space, depending on \link send_policy\endlink.
+		Threads of the upstream pipeline never wait, because
+		this would block the very threads that drain the queue.
+		*/
 		inline void
 		send(kernel_type* k) {
 			if (k->scheduled()) {
 				this->_timer.send(k);
 			} else if (k->moves_downstream()) {
-				const size_t i = k->hash();
-				const size_t n = this->_downstream.size();
-				this->_downstream[i%n].send(k);
+				this->send_downstream(k);
 			} else {
-				this->_upstream.send(k);
+				cpu_pipeline_type& ppl = this->upstream_for(k);
+				if (ppl.capacity() == 0) {
+					ppl.send(k);
+				} else if (this->_policy == send_policy::run_inline ||
+				           ppl.owns_this_thread()) {
+					if (!ppl.try_send(k)) {
+						::bsc::act(k);
+					}
+				} else {
+					ppl.send(k);
+				}
 			}
 		}
 
+		/**
+		\brief Send the kernel unless the upstream queue is full.
+		\return false, if the kernel was not sent
+		*/
+		inline bool
+		try_send(kernel_type* k) {
+			if (k->scheduled() || k->moves_downstream()) {
+				this->send(k);
+				return true;
+			}
+			return this->upstream_for(k).try_send(k);
+		}
+
+		inline void
+		set_send_policy(send_policy rhs) noexcept {
+			this->_policy = rhs;
+		}
+
+		inline send_policy
+		policy() const noexcept {
+			return this->_policy;
+		}
+
+		inline void
+		set_max_inline_depth(unsigned rhs) noexcept {
+			this->_max_inline_depth = rhs;
+		}
+
+		inline unsigned
+		max_inline_depth() const noexcept {
+			return this->_max_inline_depth;
+		}
+
+		/// The number of downstream kernels that were processed inline.
+		inline size_t
+		num_inlined() const noexcept {
+			return this->_ninlined.load(std::memory_order_relaxed);
+		}
+
+		/// The number of downstream kernels that were sent to the queue.
+		inline size_t
+		num_queued() const noexcept {
+			return this->_nqueued.load(std::memory_order_relaxed);
+		}
+
 		inline void
 		send_remote(kernel_type* k) {
 			this->_parent.send(k);
 		}
 
+		/// Returns the number of kernels waiting in upstream queues.
+		inline size_t
+		num_upstream_kernels() const {
+			return this->_upstream.num_kernels();
+		}
+
 		inline void
 		send_timer(kernel_type* k) {
 			this->_timer.send(k);
@@ -110,6 +234,14 @@ namespace bsc {
 			this->_timer.send(k, n);
 		}
 
+		#if defined(BSCHEDULER_TIMING_WHEEL)
+		/// Returns scheduled kernel with the specified id or nullptr.
+		inline kernel_type*
+		cancel_timer(typename kernel_type::id_type id) {
+			return this->_timer.cancel(id);
+		}
+		#endif
+
 		#if defined(BSCHEDULER_DAEMON) && \
 		!defined(BSCHEDULER_PROFILE_NODE_DISCOVERY)
 		inline void
@@ -172,6 +304,26 @@ namespace bsc {
 
 		#endif
 
+		inline upstream_pipeline_type&
+		upstream() noexcept {
+			return this->_upstream;
+		}
+
+		inline const upstream_pipeline_type&
+		upstream() const noexcept {
+			return this->_upstream;
+		}
+
+		inline downstream_pipeline_type&
+		downstream() noexcept {
+			return this->_downstream;
+		}
+
+		inline const downstream_pipeline_type&
+		downstream() const noexcept {
+			return this->_downstream;
+		}
+
 		inline timer_pipeline_type&
 		timer() noexcept {
 			return this->_timer;
@@ -194,6 +346,128 @@ namespace bsc {
 		void
 		print_state(std::ostream& out);
 
+		#if defined(BSCHEDULER_NUMA)
+		/// Returns NUMA nodes to which pipelines are bound.
+		inline const std::vector<numa_node>&
+		numa_nodes() const noexcept {
+			return this->_nodes;
+		}
+		#endif
+
+	private:
+
+		#if defined(BSCHEDULER_NUMA)
+		/**
+		\brief Returns the upstream pipeline of the kernel's NUMA node.
+		\details
+		This is the node of the sending thread, or the node where
+		the kernel was created, if the sender is not bound to any node.
+		*/
+		inline cpu_pipeline_type&
+		upstream_for(kernel_type* k) {
+			numa_node_id node = this_thread::numa_node;
+			if (node == no_numa_node) {
+				node = k->numa_node();
+			}
+			const size_t n = this->_upstream.size();
+			if (node >= n) {
+				node = this->_nextnode++ % n;
+			}
+			return this->_upstream[node];
+		}
+
+		/**
+		Downstream kernels go to the node of their principal, and then
+		to the pipeline chosen by principal hash as usual, so that all
+		\c react calls of the principal are executed by the same thread.
+		*/
+		inline cpu_pipeline_type&
+		downstream_for(kernel_type* k) {
+			const size_t i = k->hash();
+			const numa_node_id node =
+				k->isset(kernel_flag::principal_is_id)
+				? no_numa_node
+				: k->principal()->numa_node();
+			if (node < this->_nodes.size()) {
+				const size_t first = this->_offsets[node];
+				const size_t n = this->_offsets[node+1] - first;
+				return this->_downstream[first + i%n];
+			}
+			const size_t n = this->_downstream.size();
+			return this->_downstream[i%n];
+		}
+		#else
+		inline cpu_pipeline_type&
+		upstream_for(kernel_type*) noexcept {
+			return this->_upstream;
+		}
+
+		inline cpu_pipeline_type&
+		downstream_for(kernel_type* k) {
+			const size_t i = k->hash();
+			const size_t n = this->_downstream.size();
+			return this->_downstream[i%n];
+		}
+		#endif
+
+		/**
+		\brief Send the kernel to the downstream pipeline of its principal.
+		\details
+		If the calling thread is the only thread of this pipeline,
+		no other \c react call of the principal can run concurrently,
+		and the kernel may be processed in place instead of making
+		a round trip through the queue. The kernel is queued as usual, if
+		\arg the fast path is disabled (\link max_inline_depth\endlink is zero,
+		the default) or the depth of nested calls reaches the limit;
+		\arg the kernel or its principal is being processed by the current
+		thread (e.g. the kernel calls \c commit in its own \c react),
+		because the kernel may be deleted or the principal re-entered
+		while the caller is still running;
+		\arg the queue is not empty, because the kernel would overtake
+		the kernels that were sent before it.
+
+		Hence a kernel that returns itself to its parent is never inlined:
+		either it is committed from \c act in an upstream thread, or from its
+		own \c react, where the parent would delete it before \c react
+		returns. Only new kernels that are sent downstream from \c react
+		(e.g. results that go to the grandparent) take the fast path.
+		The fast path is disabled by default, because the sender waits until
+		\c react of the principal returns and the stack grows with every
+		nested call.
+		*/
+		inline void
+		send_downstream(kernel_type* k) {
+			cpu_pipeline_type& ppl = this->downstream_for(k);
+			if (this->may_inline(k, ppl)) {
+				this->_ninlined.fetch_add(1, std::memory_order_relaxed);
+				++this_thread::inline_depth;
+				try {
+					::bsc::act(k);
+				} catch (...) {
+					--this_thread::inline_depth;
+					throw;
+				}
+				--this_thread::inline_depth;
+			} else {
+				this->_nqueued.fetch_add(1, std::memory_order_relaxed);
+				ppl.send(k);
+			}
+		}
+
+		inline bool
+		may_inline(kernel_type* k, cpu_pipeline_type& ppl) const {
+			if (this_thread::inline_depth >= this->_max_inline_depth ||
+			    k->isset(kernel_flag::principal_is_id) ||
+			    ppl.concurrency() != 1 || !ppl.owns_this_thread()) {
+				return false;
+			}
+			if (this_thread::is_active(k) ||
+			    this_thread::is_active(k->principal())) {
+				return false;
+			}
+			return ppl.num_kernels() == 0;
+		}
+
 	};
 
 	typedef Factory<BSCHEDULER_KERNEL_TYPE> factory_type;
@@ -214,6 +488,13 @@ namespace bsc {
 		factory.send_remote(rhs);
 	}
 
+	template <class T>
+	size_t
+	basic_router<T>
+	::local_load() {
+		return factory.num_upstream_kernels();
+	}
+
 	#if defined(BSCHEDULER_DAEMON) && \
 	!defined(BSCHEDULER_PROFILE_NODE_DISCOVERY)
 	template <class T>
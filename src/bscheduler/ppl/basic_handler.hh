@@ -1,17 +1,68 @@
 #ifndef BSCHEDULER_PPL_BASIC_HANDLER_HH
 #define BSCHEDULER_PPL_BASIC_HANDLER_HH
 
-#include <iosfwd>
+#include <cstdint>
+#include <ostream>
+#include <vector>
 
 #include <unistdx/io/epoll_event>
-#include <unistdx/io/poller>
 
 #include <bscheduler/ppl/pipeline_base.hh>
+#include <bscheduler/ppl/socket_poller.hh>
 
 namespace bsc {
 
+	/// Write counters of one event loop.
+	struct write_stats {
+		/// The number of kernels written to the buffers of handlers.
+		size_t nkernels = 0;
+		/// The number of buffer flushes that wrote data to file descriptors.
+		size_t nwrites = 0;
+		/// The number of flushes that were deferred to coalesce writes.
+		size_t ndeferred = 0;
+
+		inline double
+		writes_per_kernel() const noexcept {
+			return this->nkernels == 0 ? 0.0 : double(this->nwrites) / this->nkernels;
+		}
+
+	};
+
+	inline std::ostream&
+	operator<<(std::ostream& out, const write_stats& rhs) {
+		return out << "kernels=" << rhs.nkernels
+			<< ",writes=" << rhs.nwrites
+			<< ",deferred=" << rhs.ndeferred
+			<< ",writes-per-kernel=" << rhs.writes_per_kernel();
+	}
+
+	/**
+	\brief File descriptors of handlers that have unflushed data.
+	\details
+	Each event loop has one list, handlers add themselves to it
+	when they write to their buffers, so that the loop flushes only
+	these handlers. Handlers are identified by file descriptors,
+	so that removed handlers are skipped.
+	*/
+	struct dirty_handler_list {
+		std::vector<sys::fd_type> fds;
+		/// The number of the current loop iteration.
+		std::uint64_t iteration = 0;
+		write_stats stats;
+	};
+
 	class basic_handler: public pipeline_base {
 
+	private:
+		dirty_handler_list* _dirtylist = nullptr;
+		sys::fd_type _dirtyfd = -1;
+		bool _dirty = false;
+		/// The time of the first write after the last flush.
+		time_point _dirtysince = time_point(duration::zero());
+		/// The loop iterations of the last two writes.
+		std::uint64_t _lastwrite = 0;
+		std::uint64_t _prevwrite = 0;
+
 	public:
 
 		virtual void
@@ -19,9 +70,84 @@ namespace bsc {
 			this->consume_pipe(ev.fd());
 		}
 
+		/// Returns the number of bytes that were written to the buffer, but not flushed.
+		virtual size_t
+		buffered_bytes() const {
+			return 0;
+		}
+
+		/// Called by the pipeline that polls file descriptor \p fd of the handler.
+		inline void
+		set_dirty_list(dirty_handler_list* list, sys::fd_type fd) {
+			this->_dirtylist = list;
+			this->_dirtyfd = fd;
+			// flush the data that was written before the handler was added
+			this->_dirty = false;
+			this->mark_dirty(0);
+		}
+
+		/**
+		\brief Tell the event loop that the buffer needs to be flushed.
+		\param nkernels the number of kernels that were written
+		*/
+		inline void
+		mark_dirty(size_t nkernels=1) {
+			dirty_handler_list* list = this->_dirtylist;
+			if (!list) {
+				return;
+			}
+			if (nkernels != 0) {
+				list->stats.nkernels += nkernels;
+				if (this->_lastwrite != list->iteration) {
+					this->_prevwrite = this->_lastwrite;
+					this->_lastwrite = list->iteration;
+				}
+			}
+			if (!this->_dirty) {
+				this->_dirty = true;
+				this->_dirtysince = clock_type::now();
+				list->fds.emplace_back(this->_dirtyfd);
+			}
+		}
+
+		inline bool
+		is_dirty() const noexcept {
+			return this->_dirty;
+		}
+
+		inline time_point
+		dirty_since() const noexcept {
+			return this->_dirtysince;
+		}
+
+		/**
+		\brief Returns true, if kernels were written in the current
+		and the previous loop iteration, i.e. the connection is busy.
+		*/
+		inline bool
+		is_busy() const noexcept {
+			return this->_dirtylist && this->_prevwrite != 0 &&
+				this->_lastwrite == this->_dirtylist->iteration &&
+				this->_prevwrite + 1 == this->_lastwrite;
+		}
+
+		/// Add \p n flushes that wrote data to the counters of the event loop.
+		inline void
+		count_writes(size_t n) noexcept {
+			if (this->_dirtylist) {
+				this->_dirtylist->stats.nwrites += n;
+			}
+		}
+
+		/// Called by the pipeline after the buffer is flushed.
+		inline void
+		clear_dirty() noexcept {
+			this->_dirty = false;
+		}
+
 		/// Called when the handler is removed from the poller.
 		virtual void
-		remove(sys::event_poller& poller) {}
+		remove(socket_poller& poller) {}
 
 		/// Flush dirty buffers (if needed).
 		virtual void
@@ -1,5 +1,7 @@
 #include "basic_pipeline.hh"
 
+#include <bscheduler/kernel/act.hh>
+
 #include <future>
 
 #include <unistdx/base/log_message>
@@ -23,3 +25,7 @@ int
 bsc::wait_and_return() {
 	return return_value.get_future().get();
 }
+
+thread_local const bsc::pipeline_base* bsc::this_thread::pipeline = nullptr;
+
+thread_local const bsc::active_kernel* bsc::this_thread::active_kernels = nullptr;
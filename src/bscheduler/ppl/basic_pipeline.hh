@@ -1,7 +1,9 @@
 #ifndef BSCHEDULER_PPL_BASIC_PIPELINE_HH
 #define BSCHEDULER_PPL_BASIC_PIPELINE_HH
 
+#include <atomic>
 #include <cassert>
+#include <condition_variable>
 #include <queue>
 #include <thread>
 #include <vector>
@@ -12,10 +14,15 @@
 #include <unistdx/ipc/thread_semaphore>
 #include <unistdx/util/system>
 
+#include <bscheduler/config.hh>
 #include <bscheduler/base/container_traits.hh>
+#include <bscheduler/base/intrusive_queue.hh>
+#include <bscheduler/base/multilevel_queue.hh>
+#include <bscheduler/base/numa.hh>
 #include <bscheduler/base/queue_popper.hh>
 #include <bscheduler/base/queue_pusher.hh>
 #include <bscheduler/base/thread_name.hh>
+#include <bscheduler/kernel/kernel_priority.hh>
 #include <bscheduler/kernel/kernel_type.hh>
 #include <bscheduler/ppl/pipeline_base.hh>
 #include <bscheduler/ppl/thread_context.hh>
@@ -28,9 +35,30 @@ namespace bsc {
 	int
 	wait_and_return();
 
+	namespace this_thread {
+
+		/// The pipeline that owns the current thread or nullptr.
+		extern thread_local const pipeline_base* pipeline;
+
+	}
+
+	/// Default type of kernel queue for all pipelines.
+	#if defined(BSCHEDULER_INTRUSIVE_QUEUES)
+	template <class T>
+	using kernel_queue = intrusive_queue<T>;
+	#else
+	template <class T>
+	using kernel_queue = std::queue<T*>;
+	#endif
+
+	/// Kernel queue with a separate sub-queue for each priority class.
+	template <class T>
+	using kernel_priority_queue =
+		multilevel_queue<kernel_queue<T>,num_kernel_priorities>;
+
 	template<
 		class T,
-		class Kernels=std::queue<T*>,
+		class Kernels=kernel_queue<T>,
 		class Traits=queue_traits<Kernels>,
 		class Threads=std::vector<std::thread>,
 		class Mutex=sys::spin_mutex,
@@ -57,6 +85,15 @@ namespace bsc {
 		thread_pool _threads;
 		mutable mutex_type _mutex;
 		mutable sem_type _semaphore;
+		/// Senders wait on this condition while the queue is full.
+		mutable std::condition_variable_any _notfull;
+		/// The maximal number of kernels in the queue (0 means unbounded).
+		size_t _capacity = 0;
+		/// The maximal number of kernels that were in the queue at once.
+		std::atomic<size_t> _high_water_mark{0};
+		/// The node to which pipeline threads are bound.
+		numa_node _node;
+		numa_node_id _node_index = no_numa_node;
 
 	public:
 		basic_pipeline() = default;
@@ -66,7 +103,8 @@ namespace bsc {
 		_kernels(),
 		_threads(std::max(1u, concurrency)),
 		_mutex(),
-		_semaphore()
+		_semaphore(),
+		_notfull()
 		{}
 
 		inline
@@ -74,7 +112,12 @@ namespace bsc {
 		_kernels(std::move(rhs._kernels)),
 		_threads(std::move(rhs._threads)),
 		_mutex(),
-		_semaphore()
+		_semaphore(),
+		_notfull(),
+		_capacity(rhs._capacity),
+		_high_water_mark(rhs._high_water_mark.load()),
+		_node(std::move(rhs._node)),
+		_node_index(rhs._node_index)
 		{}
 
 		inline
@@ -90,16 +133,50 @@ namespace bsc {
 		basic_pipeline&
 		operator=(const basic_pipeline&) = delete;
 
+		/**
+		\brief Push the kernel to the queue.
+		\details
+		If the queue has limited capacity, waits until it is not full.
+		*/
 		void
 		send(kernel_type* k) {
 			#ifndef NDEBUG
 			this->log("send _", *k);
 			#endif
 			lock_type lock(this->_mutex);
+			if (this->_capacity != 0) {
+				this->_notfull.wait(lock, [this] () {
+					return !this->full() || this->has_stopped();
+				});
+			}
+			traits_type::push(this->_kernels, k);
+			this->update_high_water_mark();
+			this->_semaphore.notify_one();
+		}
+
+		/**
+		\brief Push the kernel to the queue, if it is not full.
+		\return false, if the queue is full and the kernel was not sent
+		*/
+		bool
+		try_send(kernel_type* k) {
+			lock_type lock(this->_mutex);
+			if (this->full()) {
+				return false;
+			}
 			traits_type::push(this->_kernels, k);
+			this->update_high_water_mark();
 			this->_semaphore.notify_one();
+			return true;
 		}
 
+		/**
+		\brief Push \p n kernels to the queue.
+		\details
+		If the queue has limited capacity, waits until there is free space
+		for each kernel. Pipeline's own threads do not wait, since nobody
+		else would drain the queue.
+		*/
 		void
 		send(kernel_type** kernels, size_t n) {
 			lock_type lock(this->_mutex);
@@ -112,8 +189,20 @@ namespace bsc {
 				)
 			);
 			#endif
-			std::copy_n(kernels, n, queue_pusher(this->_kernels));
-			this->_semaphore.notify_one();
+			if (this->_capacity == 0 || this->owns_this_thread()) {
+				std::copy_n(kernels, n, queue_pusher(this->_kernels));
+				this->update_high_water_mark();
+				this->_semaphore.notify_one();
+				return;
+			}
+			for (size_t i=0; i<n; ++i) {
+				this->_notfull.wait(lock, [this] () {
+					return !this->full() || this->has_stopped();
+				});
+				traits_type::push(this->_kernels, kernels[i]);
+				this->update_high_water_mark();
+				this->_semaphore.notify_one();
+			}
 		}
 
 		void
@@ -127,8 +216,16 @@ namespace bsc {
 							sys::this_process::set_name(this->_name);
 						} catch (...) {
 						}
+						if (this->_node_index != no_numa_node) {
+							try {
+								pin_this_thread(this->_node, this->_node_index);
+							} catch (const std::exception& err) {
+								this->log_error(err);
+							}
+						}
 					    this_thread::name = this->_name;
 					    this_thread::number = thread_no;
+					    this_thread::pipeline = this;
 					    this->run(&this_thread::context);
 					}
 				      );
@@ -144,6 +241,7 @@ namespace bsc {
 			for (size_t i=0; i<nthreads; ++i) {
 				this->_semaphore.notify_one();
 			}
+			this->_notfull.notify_all();
 		}
 
 		void
@@ -163,6 +261,59 @@ namespace bsc {
 			return this->_threads.size();
 		}
 
+		/**
+		\brief Bind pipeline threads to the processors of the node \p rhs.
+		\details
+		\p index is the index of the node in the array returned by
+		\link numa_nodes\endlink. Must be called before \link start\endlink.
+		*/
+		inline void
+		set_numa_node(const numa_node& rhs, numa_node_id index) {
+			this->_node = rhs;
+			this->_node_index = index;
+		}
+
+		/// Returns the index of the node to which threads are bound.
+		inline numa_node_id
+		numa_node_index() const noexcept {
+			return this->_node_index;
+		}
+
+		/**
+		\brief Limit the number of kernels in the queue.
+		\details
+		Zero means unbounded queue (the default).
+		Must be called before \link start\endlink.
+		*/
+		inline void
+		set_capacity(size_t rhs) noexcept {
+			this->_capacity = rhs;
+		}
+
+		inline size_t
+		capacity() const noexcept {
+			return this->_capacity;
+		}
+
+		/// Returns the maximal number of kernels that were in the queue at once.
+		inline size_t
+		high_water_mark() const noexcept {
+			return this->_high_water_mark.load(std::memory_order_relaxed);
+		}
+
+		/// Returns the number of kernels in the queue.
+		inline size_t
+		num_kernels() const {
+			lock_type lock(this->_mutex);
+			return this->_kernels.size();
+		}
+
+		/// Returns true, if the calling thread is one of the pipeline's threads.
+		inline bool
+		owns_this_thread() const noexcept {
+			return this_thread::pipeline == this;
+		}
+
 	protected:
 
 		inline void
@@ -170,6 +321,34 @@ namespace bsc {
 			this->setstate(pipeline_state::stopped);
 		}
 
+		/// Returns true, if the queue has limited capacity and is full.
+		inline bool
+		full() const {
+			return this->_capacity != 0 &&
+				this->_kernels.size() >= this->_capacity;
+		}
+
+		/// Wake up senders after kernels were removed from the queue.
+		inline void
+		notify_not_full() {
+			if (this->_capacity != 0) {
+				this->_notfull.notify_all();
+			}
+		}
+
+		inline void
+		update_high_water_mark() noexcept {
+			this->update_high_water_mark(this->_kernels.size());
+		}
+
+		/// Update high-water mark with the current number of kernels \p n.
+		inline void
+		update_high_water_mark(size_t n) noexcept {
+			if (n > this->_high_water_mark.load(std::memory_order_relaxed)) {
+				this->_high_water_mark.store(n, std::memory_order_relaxed);
+			}
+		}
+
 		virtual void
 		do_run() = 0;
 
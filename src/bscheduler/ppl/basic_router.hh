@@ -17,6 +17,10 @@ namespace bsc {
 		static void
 		send_remote(T*);
 
+		/// Returns the number of kernels waiting for execution on this node.
+		static size_t
+		local_load();
+
 		static void
 		forward(foreign_kernel* hdr);
 
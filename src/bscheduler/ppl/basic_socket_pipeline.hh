@@ -15,7 +15,6 @@
 //#include <unistdx/base/simple_lock>
 //#include <unistdx/base/spin_mutex>
 #include <unistdx/io/fildesbuf>
-#include <unistdx/io/poller>
 #include <unistdx/net/pstream>
 
 #include <bscheduler/base/container_traits.hh>
@@ -23,11 +22,12 @@
 #include <bscheduler/kernel/kstream.hh>
 #include <bscheduler/ppl/basic_handler.hh>
 #include <bscheduler/ppl/basic_pipeline.hh>
+#include <bscheduler/ppl/socket_poller.hh>
 
 namespace bsc {
 
 	template<class T,
-	         class Kernels=std::queue<T*>,
+	         class Kernels=kernel_queue<T>,
 	         class Traits=queue_traits<Kernels>,
 	         class Threads=std::vector<std::thread>>
 	using Proxy_pipeline_base = basic_pipeline<T, Kernels, Traits, Threads,
@@ -35,7 +35,7 @@ namespace bsc {
 	                                           std::unique_lock<std::
 	                                                            recursive_mutex>,
 //		sys::recursive_spin_mutex, sys::simple_lock<sys::recursive_spin_mutex>,
-	                                           sys::event_poller>;
+	                                           socket_poller>;
 
 	template<class T>
 	class basic_socket_pipeline: public Proxy_pipeline_base<T> {
@@ -58,7 +58,7 @@ namespace bsc {
 		using typename base_pipeline::sem_type;
 		using typename base_pipeline::kernel_pool;
 
-	private:
+	protected:
 		typedef static_lock<mutex_type, mutex_type> static_lock_type;
 
 	private:
@@ -68,11 +68,22 @@ namespace bsc {
 		handler_container_type _handlers;
 		duration _start_timeout = duration::zero();
 
+	private:
+		dirty_handler_list _dirty;
+		/// The maximal delay of coalesced writes (zero disables coalescing).
+		duration _write_latency = duration::zero();
+		/// The buffer with this many bytes is flushed without delay.
+		size_t _write_threshold = 0;
+		/// The time point when the first deferred write must be flushed.
+		time_point _write_deadline = time_point::max();
+
 	public:
 
 		basic_socket_pipeline(basic_socket_pipeline&& rhs) noexcept:
 		base_pipeline(std::move(rhs)),
-		_start_timeout(rhs._start_timeout) { }
+		_start_timeout(rhs._start_timeout),
+		_write_latency(rhs._write_latency),
+		_write_threshold(rhs._write_threshold) { }
 
 		basic_socket_pipeline():
 		base_pipeline(1u) {
@@ -101,6 +112,72 @@ namespace bsc {
 			return &this->_mutex;
 		}
 
+		/**
+		\brief Select the system interface that waits for events.
+		\details
+		Falls back to \c epoll, if \c io_uring is not supported by the kernel.
+		The backend does not affect how handlers read and write data
+		(see \link socket_poller\endlink).
+		Must be called before \link start\endlink.
+		\return the backend that is actually used
+		*/
+		io_backend
+		set_io_backend(io_backend rhs) {
+			lock_type lock(this->_mutex);
+			const sys::fd_type old_fd = this->poller().pipe_in();
+			if (!this->poller().set_backend(rhs)) {
+				this->log(
+					"_ is not supported, falling back to _",
+					rhs,
+					this->poller().backend()
+				);
+			}
+			// the notification pipe belongs to the backend
+			const sys::fd_type new_fd = this->poller().pipe_in();
+			auto result = this->_handlers.find(old_fd);
+			if (new_fd != old_fd && result != this->_handlers.end()) {
+				event_handler_ptr ptr = result->second;
+				this->_handlers.erase(result);
+				this->_handlers.emplace(new_fd, ptr);
+			}
+			return this->poller().backend();
+		}
+
+		/**
+		\brief Coalesce writes to busy connections.
+		\details
+		By default all buffers that were written to in the loop iteration
+		are flushed at the end of the iteration. With non-zero \p latency
+		the buffer of the connection that is written to in consecutive
+		iterations is flushed only when it has at least \p threshold bytes
+		(zero means no threshold) or when its oldest unflushed kernel
+		is \p latency old, so that several iterations share one system call.
+		Writes to idle connections are never delayed.
+		*/
+		inline void
+		set_write_coalescing(const duration& latency, size_t threshold) {
+			lock_type lock(this->_mutex);
+			this->_write_latency = latency;
+			this->_write_threshold = threshold;
+		}
+
+		inline duration
+		write_latency() const noexcept {
+			return this->_write_latency;
+		}
+
+		inline size_t
+		write_threshold() const noexcept {
+			return this->_write_threshold;
+		}
+
+		/// Returns write counters of this event loop.
+		inline write_stats
+		get_write_stats() {
+			lock_type lock(this->_mutex);
+			return this->_dirty.stats;
+		}
+
 	protected:
 
 		inline sem_type&
@@ -121,6 +198,7 @@ namespace bsc {
 			// N.B. we have two file descriptors (for the pipe)
 			// in the process handler, so do not use emplace here
 			this->log("add _, ev=_", *ptr, ev);
+			ptr->set_dirty_list(&this->_dirty, ev.fd());
 			this->_handlers[ev.fd()] = ptr;
 			this->poller().insert(ev);
 		}
@@ -157,23 +235,29 @@ namespace bsc {
 			static_lock_type lock(&this->_mutex, this->_othermutex);
 			while (!this->has_stopped()) {
 				bool timeout = false;
+				time_point tp = this->_write_deadline;
 				if (this->_start_timeout > duration::zero()) {
 					handler_const_iterator result =
 						this->handler_with_min_start_time_point();
 					if (result != this->_handlers.end()) {
 						timeout = true;
-						const time_point tp = result->second->start_time_point()
-						                      + this->_start_timeout;
-						this->poller().wait_until(lock, tp);
+						tp = std::min(
+							tp,
+							result->second->start_time_point() + this->_start_timeout
+						);
 					}
 				}
-				if (!timeout) {
+				if (tp != time_point::max()) {
+					this->poller().wait_until(lock, tp);
+				} else {
 					this->poller().wait(lock);
 				}
+				++this->_dirty.iteration;
 				this->process_kernels();
 				this->handle_events();
 				this->flush_buffers(timeout);
 			}
+			this->log("writes _", this->_dirty.stats);
 		}
 
 		void
@@ -197,7 +281,8 @@ namespace bsc {
 
 		void
 		flush_buffers(bool timeout) {
-			const time_point now = timeout
+			const bool coalesce = this->_write_latency != duration::zero();
+			const time_point now = timeout || coalesce
 			                       ? clock_type::now()
 								   : time_point(duration::zero());
 			handler_const_iterator first = this->_handlers.begin();
@@ -212,10 +297,47 @@ namespace bsc {
 					h.remove(this->poller());
 					first = this->_handlers.erase(first);
 				} else {
-					first->second->flush();
 					++first;
 				}
 			}
+			// flush only the handlers that were written to
+			this->_write_deadline = time_point::max();
+			std::vector<sys::fd_type>& fds = this->_dirty.fds;
+			size_t n = 0;
+			for (size_t i=0; i<fds.size(); ++i) {
+				auto result = this->_handlers.find(fds[i]);
+				if (result == this->_handlers.end()) {
+					continue;
+				}
+				handler_type& h = *result->second;
+				if (!h.is_dirty()) {
+					continue;
+				}
+				if (coalesce && this->may_defer(h, now)) {
+					++this->_dirty.stats.ndeferred;
+					this->_write_deadline = std::min(
+						this->_write_deadline,
+						h.dirty_since() + this->_write_latency
+					);
+				} else {
+					h.flush();
+					if (h.buffered_bytes() == 0) {
+						h.clear_dirty();
+						continue;
+					}
+					// the rest is written in the next iteration
+				}
+				fds[n++] = fds[i];
+			}
+			fds.resize(n);
+		}
+
+		bool
+		may_defer(const handler_type& h, const time_point& now) const {
+			return h.is_busy() &&
+				h.dirty_since() + this->_write_latency > now &&
+				(this->_write_threshold == 0 ||
+				 h.buffered_bytes() < this->_write_threshold);
 		}
 
 		handler_const_iterator
@@ -262,6 +384,8 @@ namespace bsc {
 							err.what()
 						);
 					}
+					// the handler may have written replies
+					h.mark_dirty(0);
 					if (!ev) {
 						this->log("remove _ (bad event _)", h, ev);
 						h.remove(this->poller());
@@ -60,9 +60,36 @@ bsc::child_process_pipeline<K,R>
 //	this->emplace_notify_handler(
 //		std::make_shared<child_notify_handler<K,R>>(*this)
 //	);
+	sys::fd_type shm = this_application::get_shm_fd();
+	sys::fd_type parent_event = this_application::get_parent_event_fd();
+	sys::fd_type child_event = this_application::get_child_event_fd();
 	sys::fd_type in = this_application::get_input_fd();
 	sys::fd_type out = this_application::get_output_fd();
-	if (in != -1 && out != -1) {
+	if (shm != -1 && parent_event != -1 && child_event != -1) {
+		this->_parent =
+			std::make_shared<event_handler_type>(
+				shm_channel(
+					shm,
+					parent_event,
+					child_event,
+					shm_channel::role_type::child,
+					this_application::get_shm_lifeline_fd()
+				)
+			);
+		this->_parent->setstate(pipeline_state::starting);
+		this->_parent->set_name(this->name());
+		this->emplace_handler(
+			sys::epoll_event(this->_parent->in(), sys::event::in),
+			this->_parent
+		);
+		if (this->_parent->lifeline() != -1) {
+			// hang up when the daemon exits
+			this->emplace_handler(
+				sys::epoll_event(this->_parent->lifeline(), sys::event::in),
+				this->_parent
+			);
+		}
+	} else if (in != -1 && out != -1) {
 		this->_parent =
 			std::make_shared<event_handler_type>(sys::pipe(in, out));
 		this->_parent->setstate(pipeline_state::starting);
@@ -22,6 +22,11 @@ namespace bsc {
 			owns_application = 4,
 			has_source = 8,
 			has_destination = 16,
+			batch = 32,
+			/// Application ID is zero and is omitted (compact encoding only).
+			zero_application = 64,
+			/// Header carries the load of the sending node.
+			has_load = 128,
 		};
 
 		kernel_header_flag() = default;
@@ -17,6 +17,15 @@ namespace bsc {
 			prepend_application = 2,
 			save_upstream_kernels = 4,
 			save_downstream_kernels = 8,
+			/// Write kernels with the same header in one packet,
+			/// if the other side reads batches.
+			coalesce_kernels = 16,
+			/// Attach the load of this node to each packet.
+			attach_load = 32,
+			/// Pass received broadcast kernels to the pipeline that relays them.
+			relay_broadcast_kernels = 64,
+			/// Answer the handshake of the other side, but never send it first.
+			passive_negotiation = 128,
 		};
 
 		kernel_proto_flag() = default;
@@ -2,16 +2,22 @@
 #define BSCHEDULER_PPL_KERNEL_PROTOCOL_HH
 
 #include <algorithm>
-#include <deque>
+#include <cstdint>
 #include <memory>
+#include <sstream>
+#include <string>
 
 #include <unistdx/base/delete_each>
+#include <unistdx/io/fildesbuf>
 #include <unistdx/ipc/process>
 
+#include <bscheduler/base/indexed_queue.hh>
 #include <bscheduler/base/queue_popper.hh>
 #include <bscheduler/kernel/foreign_kernel.hh>
+#include <bscheduler/kernel/kernel_frame.hh>
 #include <bscheduler/kernel/kernel_header.hh>
 #include <bscheduler/kernel/kernel_instance_registry.hh>
+#include <bscheduler/kernel/kernelbuf.hh>
 #include <bscheduler/kernel/kstream.hh>
 #include <bscheduler/ppl/application.hh>
 #include <bscheduler/ppl/kernel_proto_flag.hh>
@@ -22,8 +28,8 @@ namespace bsc {
 		class T,
 		class Router,
 		class Forward=bits::no_forward<Router>,
-		class Kernels=std::deque<T*>,
-		class Traits=deque_traits<Kernels>>
+		class Kernels=indexed_queue<T>,
+		class Traits=queue_traits<Kernels>>
 	class kernel_protocol {
 
 	public:
@@ -32,6 +38,7 @@ namespace bsc {
 		typedef Forward forward_type;
 		typedef Kernels pool_type;
 		typedef Traits traits_type;
+		typedef kernel_frame<T> frame_type;
 
 	private:
 		typedef kstream<T> stream_type;
@@ -41,6 +48,21 @@ namespace bsc {
 		typedef sys::opacket_guard<stream_type> opacket_guard;
 		typedef std::unique_ptr<application> application_ptr;
 		typedef typename pool_type::iterator kernel_iterator;
+		typedef sys::basic_fildesbuf<char,std::char_traits<char>,std::stringbuf>
+			memory_fildesbuf;
+		typedef basic_kernelbuf<memory_fildesbuf> memory_kernelbuf;
+		typedef ::bsc::kernel_type::id_type type_id_type;
+
+		/// Batches are closed when the packet reaches this size.
+		enum: size_t { max_batch_size = 64*1024 };
+
+		/// Identifies the handshake packet.
+		enum: std::uint32_t { handshake_magic = 0x62736331 };
+
+		/// Payload size of the handshake packet after the header.
+		enum: size_t {
+			handshake_size = sizeof(type_id_type) + 2*sizeof(std::uint32_t)
+		};
 
 	private:
 		kernel_proto_flag _flags = kernel_proto_flag(0);
@@ -55,6 +77,23 @@ namespace bsc {
 		forward_type _forward;
 		id_type _counter = 0;
 		const char* _name = "proto";
+		/// Payload of the last compressed packet.
+		std::string _inflated;
+		/// Whether the packet with a batch of kernels is being written.
+		bool _batch_open = false;
+		/// Application of the kernels in the batch.
+		application_type _batch_app = 0;
+		/// Whether the kernels in the batch have source and destination.
+		bool _batch_has_src_and_dest = false;
+		/// Source of the kernels in the batch.
+		sys::socket_address _batch_src;
+		/// Destination of the kernels in the batch.
+		sys::socket_address _batch_dst;
+		/// The load of this node that is attached to outgoing packets.
+		std::uint32_t _load = 0;
+		/// The last load received from the other side.
+		std::uint32_t _peer_load = 0;
+		bool _has_peer_load = false;
 
 	public:
 
@@ -106,39 +145,75 @@ namespace bsc {
 		void
 		forward(foreign_kernel* k, stream_type& ostr) {
 			bool delete_kernel = this->save_kernel(k);
+			this->negotiate(ostr);
+			this->end_batch(ostr);
 			ostr.begin_packet();
-			ostr << k->header();
+			this->write_parent_in_original_format(*k, ostr);
+			this->write_header(k->header(), ostr);
 			ostr << *k;
+			this->compress_packet(ostr);
 			ostr.end_packet();
 			if (delete_kernel) {
 				delete k;
 			}
 		}
 
+		/**
+		\brief Write the frame that was serialized in advance.
+		\details
+		The frame is written in a separate packet in the encoding that
+		was negotiated for the stream, if the frame has it,
+		and in fixed-width encoding otherwise. The header is written
+		by \link write_header\endlink as for any other kernel. The payload
+		that was compressed in advance is used, if the stream compresses
+		packets and the header has no fields of this connection.
+		*/
+		void
+		send_frame(const frame_type& frame, stream_type& stream) {
+			this->negotiate(stream);
+			this->end_batch(stream);
+			kernelbuf_base* buf = dynamic_cast<kernelbuf_base*>(stream.rdbuf());
+			opacket_guard g(stream);
+			stream.begin_packet();
+			bool compact = false;
+			if (buf) {
+				compact = (buf->opacket_features() & wire_feature::compact_encoding) &&
+					frame.has_compact();
+				buf->set_opacket_features(
+					compact ? wire_feature::compact_encoding : wire_feature()
+				);
+			}
+			const std::string& compressed = frame.compressed_payload(compact);
+			if (!compressed.empty() && buf && buf->compresses() &&
+			    !this->attaches_load_to(stream)) {
+				stream.write(compressed.data(), compressed.size());
+				buf->set_opacket_compressed();
+			} else {
+				this->write_header(frame.header(), stream);
+				const std::string& payload = frame.payload(compact);
+				stream.write(payload.data(), payload.size());
+				this->compress_packet(stream);
+			}
+			stream.end_packet();
+		}
+
+		/**
+		\brief Write the batch of kernels that is being accumulated, if any.
+		\details
+		Must be called before the buffer of the stream is flushed.
+		*/
+		inline void
+		flush(stream_type& stream) {
+			this->end_batch(stream);
+		}
+
 		void
 		receive_kernels(stream_type& stream) noexcept {
 			while (stream.read_packet()) {
 				try {
-					if (kernel_type* k = this->read_kernel(stream)) {
-						bool ok = this->receive_kernel(k);
-						if (!ok) {
-							#ifndef NDEBUG
-							this->log("no principal found for _", *k);
-							#endif
-							k->principal(k->parent());
-							this->send(k, stream);
-						} else {
-							router_type::send_local(k);
-						}
-					}
-				} catch (const kernel_error& err) {
-					log_read_error(err);
-				} catch (const error& err) {
-					log_read_error(err);
-				} catch (const std::exception& err) {
-					log_read_error(err.what());
+					this->read_packet(stream, stream);
 				} catch (...) {
-					log_read_error("<unknown>");
+					this->log_read_error();
 				}
 			}
 		}
@@ -151,15 +226,39 @@ namespace bsc {
 			}
 		}
 
+		/**
+		\brief Recover the kernel that was not written to the other side.
+		\details
+		The kernel is processed in the same way as the kernels
+		in the buffers of the closed connection (see \link recover_kernels\endlink).
+		*/
+		void
+		recover_unsent_kernel(kernel_type* k) noexcept {
+			try {
+				this->recover_kernel(k);
+			} catch (const std::exception& err) {
+				this->log("failed to recover kernel _", *k);
+				delete k;
+			}
+		}
+
 	private:
 
 		// send {{{
 		void
 		write_kernel(kernel_type* k, stream_type& stream) noexcept {
 			try {
+				this->negotiate(stream);
+				if (kernelbuf_base* buf = this->batch_buffer(*k, stream)) {
+					this->write_batched_kernel(*k, stream, *buf);
+					return;
+				}
+				this->end_batch(stream);
 				opacket_guard g(stream);
 				stream.begin_packet();
+				this->write_parent_in_original_format(*k, stream);
 				this->do_write_kernel(*k, stream);
+				this->compress_packet(stream);
 				stream.end_packet();
 			} catch (const kernel_error& err) {
 				log_write_error(err);
@@ -177,10 +276,209 @@ namespace bsc {
 			if (this->has_src_and_dest()) {
 				k.header().prepend_source_and_destination();
 			}
-			stream << k.header();
+			this->write_header(k.header(), stream);
 			stream << k;
 		}
 
+		/**
+		\brief Write the packet in the original format, if the kernel
+		carries its parent.
+		\details
+		The parent of a foreign kernel is stored in the payload in the format
+		of the connection from which the kernel came, and can not be
+		re-encoded, when the kernel is relayed to a connection with
+		different features. Writing such packets in fixed-width encoding
+		without optional fields everywhere keeps the payload valid
+		on any connection.
+		*/
+		inline void
+		write_parent_in_original_format(const kernel_type& k, stream_type& stream) {
+			if (!k.carries_parent()) {
+				return;
+			}
+			if (kernelbuf_base* buf = dynamic_cast<kernelbuf_base*>(stream.rdbuf())) {
+				buf->set_opacket_features(wire_feature());
+			}
+		}
+
+		/**
+		\brief Write the header with the load of this node attached, if enabled.
+		\details
+		The load is attached only if the other side reads it.
+		*/
+		inline void
+		write_header(const kernel_header& hdr, stream_type& stream) {
+			if (this->attaches_load_to(stream)) {
+				hdr.write_header(stream, this->_load);
+			} else {
+				stream << hdr;
+			}
+		}
+
+		/// Returns true, if the load of this node is attached to the headers.
+		inline bool
+		attaches_load_to(stream_type& stream) const {
+			if (!this->attaches_load()) {
+				return false;
+			}
+			kernelbuf_base* buf = dynamic_cast<kernelbuf_base*>(stream.rdbuf());
+			return buf && (buf->peer_features() & wire_feature::node_load);
+		}
+
+		/**
+		\brief Returns the buffer of the stream, if the kernel may be
+		written as a part of a batch, and null pointer otherwise.
+		\details
+		Kernels are batched only after the other side has listed batches
+		in its handshake. Kernels that carry application object or their
+		parent are always written in separate packets.
+		*/
+		inline kernelbuf_base*
+		batch_buffer(kernel_type& k, stream_type& stream) {
+			if (!this->coalesces_kernels() || k.header().has_application() ||
+			    k.carries_parent()) {
+				return nullptr;
+			}
+			kernelbuf_base* buf = dynamic_cast<kernelbuf_base*>(stream.rdbuf());
+			if (!buf || !(buf->peer_features() & wire_feature::batches)) {
+				return nullptr;
+			}
+			return buf;
+		}
+
+		/**
+		\brief Append the kernel to the batch of kernels with the same header.
+		\details
+		The header is written once at the beginning of the packet,
+		and each kernel is written as a size-prefixed record.
+		The batch is closed, when a kernel with different header
+		is written, the packet becomes too large or on flush.
+		*/
+		void
+		write_batched_kernel(
+			kernel_type& k,
+			stream_type& stream,
+			kernelbuf_base& buf
+		) {
+			if (this->has_src_and_dest()) {
+				k.header().prepend_source_and_destination();
+			}
+			if (this->_batch_open && !this->fits_batch(k.header())) {
+				this->end_batch(stream);
+			}
+			if (!this->_batch_open) {
+				this->begin_batch(k.header(), stream);
+			}
+			buf.begin_record();
+			try {
+				stream << k;
+			} catch (...) {
+				buf.cancel_record();
+				throw;
+			}
+			buf.end_record();
+			if (buf.opacket_size() >= max_batch_size) {
+				this->end_batch(stream);
+			}
+		}
+
+		inline bool
+		fits_batch(const kernel_header& hdr) const noexcept {
+			return hdr.app() == this->_batch_app &&
+				hdr.has_source_and_destination() == this->_batch_has_src_and_dest &&
+				(!this->_batch_has_src_and_dest ||
+				 (hdr.from() == this->_batch_src && hdr.to() == this->_batch_dst));
+		}
+
+		void
+		begin_batch(const kernel_header& hdr, stream_type& stream) {
+			kernel_header batch;
+			batch.setapp(hdr.app());
+			if (hdr.has_source_and_destination()) {
+				batch.from(hdr.from());
+				batch.to(hdr.to());
+				batch.prepend_source_and_destination();
+			}
+			batch.set_batch();
+			stream.begin_packet();
+			this->write_header(batch, stream);
+			this->_batch_open = true;
+			this->_batch_app = hdr.app();
+			this->_batch_has_src_and_dest = hdr.has_source_and_destination();
+			this->_batch_src = hdr.from();
+			this->_batch_dst = hdr.to();
+		}
+
+		void
+		end_batch(stream_type& stream) {
+			if (!this->_batch_open) {
+				return;
+			}
+			this->_batch_open = false;
+			this->compress_packet(stream);
+			stream.end_packet();
+		}
+
+		/// Start the negotiation, if this side uses optional features.
+		inline void
+		negotiate(stream_type& stream) {
+			if (this->negotiates_passively()) {
+				return;
+			}
+			kernelbuf_base* buf = dynamic_cast<kernelbuf_base*>(stream.rdbuf());
+			if (buf && !buf->handshake_sent() &&
+			    (buf->features() | this->features())) {
+				this->write_handshake(stream, *buf);
+			}
+		}
+
+		/// Returns the features that are used by the protocol itself.
+		inline wire_feature
+		features() const noexcept {
+			wire_feature result;
+			if (this->coalesces_kernels()) {
+				result |= wire_feature::batches;
+			}
+			if (this->attaches_load()) {
+				result |= wire_feature::node_load;
+			}
+			return result;
+		}
+
+		/**
+		\brief Write the list of features that this side reads.
+		\details
+		The handshake looks like a kernel of type zero, that is never
+		registered, and is written in the original format, so that the peers
+		that do not negotiate features log an error and skip the packet.
+		*/
+		void
+		write_handshake(stream_type& stream, kernelbuf_base& buf) {
+			this->end_batch(stream);
+			opacket_guard g(stream);
+			stream.begin_packet();
+			buf.set_opacket_features(wire_feature());
+			kernel_header hdr;
+			if (this->has_other_application()) {
+				// the other side reads the handshake as its own kernel
+				hdr.setapp(this->other_application_id());
+			}
+			stream << hdr;
+			stream << type_id_type(0);
+			stream << std::uint32_t(handshake_magic);
+			stream << wire_feature::flag_type(wire_feature::all);
+			stream.end_packet();
+			buf.set_handshake_sent(true);
+		}
+
+		inline void
+		compress_packet(stream_type& stream) {
+			kernelbuf_base* buf = dynamic_cast<kernelbuf_base*>(stream.rdbuf());
+			if (buf) {
+				buf->compress_opacket();
+			}
+		}
+
 		bool
 		kernel_goes_in_upstream_buffer(const kernel_type* rhs) noexcept {
 			return this->saves_upstream_kernels() &&
@@ -196,13 +494,134 @@ namespace bsc {
 		// }}}
 
 		// receive {{{
-		kernel_type*
-		read_kernel(stream_type& stream) {
+		/**
+		\brief Read all kernels from the current packet of \p in.
+		\details
+		Kernels without principal are sent back to \p out.
+		*/
+		void
+		read_packet(stream_type& in, stream_type& out) {
+			kernelbuf_base* buf = dynamic_cast<kernelbuf_base*>(in.rdbuf());
+			if (buf && buf->ipacket_is_compressed()) {
+				this->read_compressed_packet(in, out, *buf);
+				return;
+			}
 			// eats remaining bytes on exception
-			ipacket_guard g(stream.rdbuf());
+			ipacket_guard g(in.rdbuf());
 			foreign_kernel* hdr = new foreign_kernel;
+			in >> hdr->header();
+			if (hdr->header().has_load()) {
+				this->_peer_load = hdr->header().load();
+				this->_has_peer_load = true;
+				hdr->header().unset_load();
+			}
+			if (hdr->header().is_batch()) {
+				std::unique_ptr<foreign_kernel> batch(hdr);
+				this->read_batch(in, out, batch->header());
+				return;
+			}
+			if (this->is_handshake(hdr->header(), in)) {
+				delete hdr;
+				this->read_handshake(in, out);
+				return;
+			}
+			sys::packetbuf* pbuf = in.rdbuf();
+			const size_t size = pbuf->ipayload_end() - pbuf->ipayload_cur();
+			if (kernel_type* k = this->read_kernel(in, hdr, size)) {
+				this->accept_kernel(k, out);
+			}
+		}
+
+		inline bool
+		is_handshake(const kernel_header& hdr, stream_type& in) const {
+			sys::packetbuf* buf = in.rdbuf();
+			const char* first = buf->ipayload_cur();
+			return !hdr.has_application() &&
+				size_t(buf->ipayload_end() - first) == handshake_size &&
+				std::all_of(
+					first,
+					first + sizeof(type_id_type),
+					[] (char ch) { return ch == 0; }
+				);
+		}
+
+		/**
+		\brief Record the features that the other side reads.
+		\details
+		The handshake is answered with the handshake of this side,
+		if it has not been written yet.
+		*/
+		void
+		read_handshake(stream_type& in, stream_type& out) {
+			type_id_type type = 0;
+			std::uint32_t magic = 0;
+			wire_feature::flag_type features = 0;
+			in >> type >> magic >> features;
+			if (magic != handshake_magic) {
+				BSCHEDULER_THROW(error, "bad handshake");
+			}
+			kernelbuf_base* buf = dynamic_cast<kernelbuf_base*>(out.rdbuf());
+			if (!buf) {
+				return;
+			}
+			#ifndef NDEBUG
+			this->log("handshake _ from _", features, this->_endpoint);
+			#endif
+			buf->set_peer_features(features);
+			if (!buf->handshake_sent()) {
+				this->write_handshake(out, *buf);
+			}
+		}
+
+		/**
+		\brief Read size-prefixed kernels that share the header \p batch.
+		\details
+		The kernel that failed to be read is skipped, the rest of
+		the kernels are read as usual.
+		*/
+		void
+		read_batch(stream_type& in, stream_type& out, const kernel_header& batch) {
+			if (batch.has_application()) {
+				BSCHEDULER_THROW(error, "bad batch header");
+			}
+			sys::packetbuf* buf = in.rdbuf();
+			while (buf->ipayload_cur() != buf->ipayload_end()) {
+				std::uint32_t size = 0;
+				in >> size;
+				const char* first = buf->ipayload_cur();
+				if (size > size_t(buf->ipayload_end() - first)) {
+					BSCHEDULER_THROW(error, "bad batch record");
+				}
+				try {
+					foreign_kernel* hdr = new foreign_kernel;
+					hdr->setapp(batch.app());
+					if (batch.has_source_and_destination()) {
+						hdr->from(batch.from());
+						hdr->to(batch.to());
+						hdr->prepend_source_and_destination();
+					}
+					if (kernel_type* k = this->read_kernel(in, hdr, size)) {
+						this->accept_kernel(k, out);
+					}
+				} catch (...) {
+					this->log_read_error();
+				}
+				// skip the rest of the record
+				const char* last = first + size;
+				if (buf->ipayload_cur() > last) {
+					BSCHEDULER_THROW(error, "bad batch record");
+				}
+				char tmp[256];
+				while (buf->ipayload_cur() != last) {
+					in.read(tmp, std::min<size_t>(sizeof(tmp), last - buf->ipayload_cur()));
+				}
+			}
+		}
+
+		/// Read the kernel that occupies \p size bytes after the header \p hdr.
+		kernel_type*
+		read_kernel(stream_type& in, foreign_kernel* hdr, size_t size) {
 			kernel_type* k = nullptr;
-			stream >> hdr->header();
 			if (this->has_other_application()) {
 				hdr->setapp(this->other_application_id());
 				hdr->aptr(this->_otheraptr);
@@ -215,10 +634,10 @@ namespace bsc {
 			this->log("recv _", hdr->header());
 			#endif
 			if (hdr->app() != this->_thisapp) {
-				stream >> *hdr;
+				hdr->read(in, size);
 				this->_forward(hdr);
 			} else {
-				stream >> k;
+				in >> k;
 				k->setapp(hdr->app());
 				if (hdr->has_source_and_destination()) {
 					k->from(hdr->from());
@@ -234,6 +653,48 @@ namespace bsc {
 			return k;
 		}
 
+		/// Decompress the packet into memory buffer and read kernels from it.
+		void
+		read_compressed_packet(
+			stream_type& in,
+			stream_type& out,
+			kernelbuf_base& buf
+		) {
+			ipacket_guard g(in.rdbuf());
+			buf.decompress_ipacket(this->_inflated);
+			memory_kernelbuf mbuf;
+			mbuf.setfd(std::stringbuf{});
+			stream_type mstream(&mbuf);
+			mstream.begin_packet();
+			mstream.write(this->_inflated.data(), this->_inflated.size());
+			mstream.end_packet();
+			mstream.sync();
+			if (!mstream.read_packet()) {
+				BSCHEDULER_THROW(error, "bad compressed packet");
+			}
+			mbuf.set_ipacket_features(buf.ipacket_features());
+			this->read_packet(mstream, out);
+		}
+
+		void
+		accept_kernel(kernel_type* k, stream_type& out) {
+			if (this->relays_broadcast_kernels() && k->moves_everywhere()) {
+				// the kernel is relayed to other nodes and then sent local
+				router_type::send_remote(k);
+				return;
+			}
+			bool ok = this->receive_kernel(k);
+			if (!ok) {
+				#ifndef NDEBUG
+				this->log("no principal found for _", *k);
+				#endif
+				k->principal(k->parent());
+				this->send(k, out);
+			} else {
+				router_type::send_local(k);
+			}
+		}
+
 		bool
 		receive_kernel(kernel_type* k) {
 			bool ok = true;
@@ -290,13 +751,9 @@ namespace bsc {
 			}
 		}
 
-		kernel_iterator
+		inline kernel_iterator
 		find_kernel(kernel_type* k, pool_type& pool) {
-			return std::find_if(
-				pool.begin(),
-				pool.end(),
-				[k] (kernel_type* rhs) { return rhs->id() == k->id(); }
-			);
+			return pool.find(k->id());
 		}
 		// }}}
 
@@ -407,6 +864,22 @@ namespace bsc {
 			this->log("read error _", err);
 		}
 
+		/// Log the exception that is being handled.
+		void
+		log_read_error() noexcept {
+			try {
+				throw;
+			} catch (const kernel_error& err) {
+				log_read_error(err);
+			} catch (const error& err) {
+				log_read_error(err);
+			} catch (const std::exception& err) {
+				log_read_error(err.what());
+			} catch (...) {
+				log_read_error("<unknown>");
+			}
+		}
+
 		template <class ... Args>
 		inline void
 		log(const Args& ... args) {
@@ -456,6 +929,53 @@ namespace bsc {
 			return this->_flags & kernel_proto_flag::save_downstream_kernels;
 		}
 
+		/// Returns true, if kernels with the same header are sent in one packet,
+		/// when the other side reads batches.
+		inline bool
+		coalesces_kernels() const noexcept {
+			return this->_flags & kernel_proto_flag::coalesce_kernels;
+		}
+
+		/// Returns true, if the handshake is never sent first.
+		inline bool
+		negotiates_passively() const noexcept {
+			return this->_flags & kernel_proto_flag::passive_negotiation;
+		}
+
+		inline bool
+		relays_broadcast_kernels() const noexcept {
+			return this->_flags & kernel_proto_flag::relay_broadcast_kernels;
+		}
+
+		inline bool
+		attaches_load() const noexcept {
+			return this->_flags & kernel_proto_flag::attach_load;
+		}
+
+		/// Set the load of this node that is attached to outgoing packets.
+		inline void
+		set_load(std::uint32_t rhs) noexcept {
+			this->_load = rhs;
+		}
+
+		/// Returns true, if the other side attached its load to any packet.
+		inline bool
+		has_peer_load() const noexcept {
+			return this->_has_peer_load;
+		}
+
+		/// Returns the last load that was received from the other side.
+		inline std::uint32_t
+		peer_load() const noexcept {
+			return this->_peer_load;
+		}
+
+		/// Returns the number of sent kernels that have not returned yet.
+		inline size_t
+		num_upstream_kernels() const noexcept {
+			return this->_upstream.size();
+		}
+
 		inline bool
 		has_other_application() const noexcept {
 			return this->_otheraptr;
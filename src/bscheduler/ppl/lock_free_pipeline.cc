@@ -0,0 +1,80 @@
+#include "lock_free_pipeline.hh"
+#include "config.hh"
+
+#include <bscheduler/kernel/act.hh>
+#include <unistdx/util/backtrace>
+
+#include <thread>
+
+namespace {
+
+	template <class T>
+	inline void
+	act_and_print_backtrace(T* k) {
+		try {
+			::bsc::act(k);
+		} catch (...) {
+			sys::backtrace(2);
+			throw;
+		}
+	}
+
+}
+
+template <class T>
+void
+bsc::lock_free_pipeline<T>::send(kernel_type* k) {
+	#ifndef NDEBUG
+	this->log("send _", *k);
+	#endif
+	if (!this->full() && traits_type::try_push(this->_kernels, k)) {
+		this->update_high_water_mark();
+		this->_semaphore.notify_one();
+	} else if (this->owns_this_thread()) {
+		act_and_print_backtrace(k);
+	} else {
+		while (this->full() && !this->has_stopped()) {
+			std::this_thread::yield();
+		}
+		traits_type::push(this->_kernels, k);
+		this->update_high_water_mark();
+		this->_semaphore.notify_one();
+	}
+}
+
+template <class T>
+bool
+bsc::lock_free_pipeline<T>::try_send(kernel_type* k) {
+	if (this->full() || !traits_type::try_push(this->_kernels, k)) {
+		return false;
+	}
+	this->update_high_water_mark();
+	this->_semaphore.notify_one();
+	return true;
+}
+
+template <class T>
+void
+bsc::lock_free_pipeline<T>::send(kernel_type** kernels, size_t n) {
+	for (size_t i=0; i<n; ++i) {
+		this->send(kernels[i]);
+	}
+}
+
+template <class T>
+void
+bsc::lock_free_pipeline<T>::do_run() {
+	lock_type lock(this->_mutex);
+	kernel_type* k = nullptr;
+	while (!this->has_stopped()) {
+		if (traits_type::try_pop(this->_kernels, k)) {
+			act_and_print_backtrace(k);
+		} else {
+			this->_semaphore.wait(lock, [this] () {
+				return this->has_stopped() || !this->_kernels.empty();
+			});
+		}
+	}
+}
+
+template class bsc::lock_free_pipeline<BSCHEDULER_KERNEL_TYPE>;
@@ -0,0 +1,99 @@
+#ifndef BSCHEDULER_PPL_LOCK_FREE_PIPELINE_HH
+#define BSCHEDULER_PPL_LOCK_FREE_PIPELINE_HH
+
+#include <bscheduler/base/futex_semaphore.hh>
+#include <bscheduler/base/mpmc_queue.hh>
+#include <bscheduler/base/null_mutex.hh>
+#include <bscheduler/ppl/basic_pipeline.hh>
+
+namespace bsc {
+
+	namespace bits {
+
+		template <class T>
+		using lock_free_pipeline_base = basic_pipeline<
+			T,
+			mpmc_queue<T*>,
+			queue_traits<mpmc_queue<T*>>,
+			std::vector<std::thread>,
+			null_mutex,
+			sys::simple_lock<null_mutex>,
+			futex_semaphore
+		>;
+
+	}
+
+	/**
+	\brief Parallel pipeline with lock-free bounded kernel queue.
+	\details
+	Producers and consumers access the queue without a mutex, idle
+	threads sleep on a futex. When the queue is full, the kernel sent
+	from one of the pipeline's own threads is executed in place
+	(otherwise all threads may wait for each other), and the sender
+	from any other thread waits until there is free space in the queue.
+	*/
+	template<class T>
+	class lock_free_pipeline: public bits::lock_free_pipeline_base<T> {
+
+	public:
+		typedef bits::lock_free_pipeline_base<T> base_pipeline;
+		using typename base_pipeline::kernel_type;
+		using typename base_pipeline::kernel_pool;
+		using typename base_pipeline::lock_type;
+		using typename base_pipeline::traits_type;
+
+	public:
+
+		inline
+		lock_free_pipeline(lock_free_pipeline&& rhs) noexcept:
+		base_pipeline(std::move(rhs))
+		{}
+
+		inline
+		lock_free_pipeline():
+		lock_free_pipeline(1u)
+		{}
+
+		inline explicit
+		lock_free_pipeline(
+			unsigned concurrency,
+			size_t capacity=kernel_pool::default_capacity()
+		):
+		base_pipeline(concurrency) {
+			this->_kernels = kernel_pool(capacity);
+		}
+
+		lock_free_pipeline(const lock_free_pipeline&) = delete;
+
+		lock_free_pipeline&
+		operator=(const lock_free_pipeline&) = delete;
+
+		~lock_free_pipeline() = default;
+
+		void
+		send(kernel_type* k);
+
+		void
+		send(kernel_type** kernels, size_t n);
+
+		/**
+		\brief Push the kernel to the queue, if it is not full.
+		\details
+		The size of the ring is set in the constructor and is the hard
+		upper bound. The limit set with \link set_capacity\endlink
+		is checked before the kernel is pushed and may be exceeded
+		by concurrent senders.
+		*/
+		bool
+		try_send(kernel_type* k);
+
+	protected:
+
+		void
+		do_run() override;
+
+	};
+
+}
+
+#endif // vim:filetype=cpp
@@ -1,8 +1,11 @@
 #include "multi_pipeline.hh"
 #include "config.hh"
 
-template <class T>
-bsc::Multi_pipeline<T>::Multi_pipeline(unsigned npipelines):
+#include <bscheduler/ppl/lock_free_pipeline.hh>
+#include <bscheduler/ppl/work_stealing_pipeline.hh>
+
+template <class T, class P>
+bsc::Multi_pipeline<T,P>::Multi_pipeline(unsigned npipelines):
 _pipelines(npipelines) {
 	unsigned num = 0;
 	for (base_pipeline& ppl : this->_pipelines) {
@@ -11,18 +14,62 @@ _pipelines(npipelines) {
 	}
 }
 
-template <class T>
+template <class T, class P>
+bsc::Multi_pipeline<T,P>::Multi_pipeline(const std::vector<numa_node>& nodes) {
+	this->_pipelines.reserve(nodes.size());
+	unsigned num = 0;
+	numa_node_id index = 0;
+	for (const numa_node& node : nodes) {
+		const unsigned concurrency = std::max(size_t(1), node.cpus.size());
+		this->_pipelines.emplace_back(concurrency);
+		base_pipeline& ppl = this->_pipelines.back();
+		ppl.set_number(num);
+		ppl.set_numa_node(node, index);
+		num += concurrency;
+		++index;
+	}
+}
+
+template <class T, class P>
 void
-bsc::Multi_pipeline<T>::set_name(const char* rhs) {
+bsc::Multi_pipeline<T,P>::set_name(const char* rhs) {
 	for (base_pipeline& ppl : this->_pipelines) {
 		ppl.set_name(rhs);
 	}
 }
 
 
-template <class T>
+template <class T, class P>
+void
+bsc::Multi_pipeline<T,P>::set_capacity(size_t rhs) {
+	for (base_pipeline& ppl : this->_pipelines) {
+		ppl.set_capacity(rhs);
+	}
+}
+
+template <class T, class P>
+size_t
+bsc::Multi_pipeline<T,P>::high_water_mark() const noexcept {
+	size_t result = 0;
+	for (const base_pipeline& ppl : this->_pipelines) {
+		result = std::max(result, ppl.high_water_mark());
+	}
+	return result;
+}
+
+template <class T, class P>
+size_t
+bsc::Multi_pipeline<T,P>::num_kernels() const {
+	size_t result = 0;
+	for (const base_pipeline& ppl : this->_pipelines) {
+		result += ppl.num_kernels();
+	}
+	return result;
+}
+
+template <class T, class P>
 void
-bsc::Multi_pipeline<T>::start() {
+bsc::Multi_pipeline<T,P>::start() {
 	this->setstate(pipeline_state::starting);
 	for (base_pipeline& ppl : this->_pipelines) {
 		ppl.start();
@@ -30,9 +77,9 @@ bsc::Multi_pipeline<T>::start() {
 	this->setstate(pipeline_state::started);
 }
 
-template <class T>
+template <class T, class P>
 void
-bsc::Multi_pipeline<T>::stop() {
+bsc::Multi_pipeline<T,P>::stop() {
 	this->setstate(pipeline_state::stopping);
 	for (base_pipeline& ppl : this->_pipelines) {
 		ppl.stop();
@@ -40,13 +87,18 @@ bsc::Multi_pipeline<T>::stop() {
 	this->setstate(pipeline_state::stopped);
 }
 
-template <class T>
+template <class T, class P>
 void
-bsc::Multi_pipeline<T>::wait() {
+bsc::Multi_pipeline<T,P>::wait() {
 	for (base_pipeline& ppl : this->_pipelines) {
 		ppl.wait();
 	}
 }
 
 template class bsc::Multi_pipeline<BSCHEDULER_KERNEL_TYPE>;
-
+template class bsc::Multi_pipeline<
+		BSCHEDULER_KERNEL_TYPE,
+		bsc::work_stealing_pipeline<BSCHEDULER_KERNEL_TYPE>>;
+template class bsc::Multi_pipeline<
+		BSCHEDULER_KERNEL_TYPE,
+		bsc::lock_free_pipeline<BSCHEDULER_KERNEL_TYPE>>;
@@ -1,18 +1,19 @@
 #ifndef BSCHEDULER_PPL_MULTI_PIPELINE_HH
 #define BSCHEDULER_PPL_MULTI_PIPELINE_HH
 
+#include <bscheduler/base/numa.hh>
 #include <bscheduler/ppl/basic_pipeline.hh>
 #include <bscheduler/ppl/parallel_pipeline.hh>
 #include <vector>
 
 namespace bsc {
 
-	template <class T>
+	template <class T, class Pipeline=parallel_pipeline<T>>
 	class Multi_pipeline: public pipeline_base {
 
 	public:
 		typedef T kernel_type;
-		typedef parallel_pipeline<T> base_pipeline;
+		typedef Pipeline base_pipeline;
 
 	private:
 		std::vector<base_pipeline> _pipelines;
@@ -20,6 +21,14 @@ namespace bsc {
 	public:
 		explicit
 		Multi_pipeline(unsigned npipelines);
+
+		/**
+		One pipeline per NUMA node with as many threads as there are
+		processors in the node. Threads are bound to their node.
+		*/
+		explicit
+		Multi_pipeline(const std::vector<numa_node>& nodes);
+
 		Multi_pipeline(const Multi_pipeline&) = delete;
 		Multi_pipeline(Multi_pipeline&&) = default;
 		virtual ~Multi_pipeline() = default;
@@ -42,6 +51,18 @@ namespace bsc {
 		void
 		set_name(const char* rhs);
 
+		/// Limit the number of kernels in the queue of each pipeline.
+		void
+		set_capacity(size_t rhs);
+
+		/// Returns the maximal high-water mark of all pipelines.
+		size_t
+		high_water_mark() const noexcept;
+
+		/// Returns the total number of kernels in the queues of all pipelines.
+		size_t
+		num_kernels() const;
+
 		void
 		start();
 
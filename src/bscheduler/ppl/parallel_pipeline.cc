@@ -7,21 +7,56 @@
 template <class T>
 void
 bsc::parallel_pipeline<T>::do_run() {
+	std::vector<kernel_type*> batch;
+	batch.reserve(this->_batch_size);
 	lock_type lock(this->_mutex);
-	this->_semaphore.wait(lock, [this,&lock] () {
+	this->_semaphore.wait(lock, [this,&lock,&batch] () {
 		while (!this->_kernels.empty()) {
-			kernel_type* k = traits_type::front(this->_kernels);
-			traits_type::pop(this->_kernels);
-			sys::unlock_guard<lock_type> g(lock);
+			const size_t n = this->fair_share();
+			for (size_t i=0; i<n; ++i) {
+				batch.push_back(traits_type::front(this->_kernels));
+				traits_type::pop(this->_kernels);
+			}
+			this->notify_not_full();
+			if (this->_batch_size > 1 && !this->_kernels.empty()) {
+				// let other threads process the rest of the queue
+				this->_semaphore.notify_one();
+			}
+			size_t i = 0;
 			try {
-				::bsc::act(k);
+				sys::unlock_guard<lock_type> g(lock);
+				for (; i<batch.size(); ++i) {
+					::bsc::act(batch[i]);
+				}
 			} catch (...) {
+				// the lock is held again here: return the rest
+				// of the batch to the front of the queue, so that it is
+				// not leaked and precedes the kernels that were queued later
+				batch.erase(batch.begin(), batch.begin()+i+1);
+				while (!this->_kernels.empty()) {
+					batch.push_back(traits_type::front(this->_kernels));
+					traits_type::pop(this->_kernels);
+				}
+				for (kernel_type* k : batch) {
+					traits_type::push(this->_kernels, k);
+				}
+				batch.clear();
 				sys::backtrace(2);
 				throw;
 			}
+			batch.clear();
 		}
 		return this->has_stopped();
 	});
 }
 
+template <class T>
+size_t
+bsc::parallel_pipeline<T>::fair_share() const {
+	const size_t size = this->_kernels.size();
+	const size_t nthreads = this->concurrency();
+	const size_t share = (size + nthreads - 1) / nthreads;
+	return std::min(this->_batch_size, share);
+}
+
 template class bsc::parallel_pipeline<BSCHEDULER_KERNEL_TYPE>;
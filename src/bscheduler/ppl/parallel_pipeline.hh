@@ -1,22 +1,39 @@
 #ifndef BSCHEDULER_PPL_PARALLEL_PIPELINE_HH
 #define BSCHEDULER_PPL_PARALLEL_PIPELINE_HH
 
+#include <algorithm>
+#include <vector>
+
 #include "basic_pipeline.hh"
 
 namespace bsc {
 
+	/**
+	\brief Pipeline that executes kernels in a pool of threads.
+	\details
+	Kernels are executed in the order of their priority classes
+	(\link kernel_priority_queue\endlink).
+	*/
 	template<class T>
-	class parallel_pipeline: public basic_pipeline<T> {
+	class parallel_pipeline:
+	public basic_pipeline<T,kernel_priority_queue<T>> {
 
 	public:
-		typedef basic_pipeline<T> base_pipeline;
+		typedef basic_pipeline<T,kernel_priority_queue<T>> base_pipeline;
 		using typename base_pipeline::kernel_type;
 		using typename base_pipeline::lock_type;
 		using typename base_pipeline::traits_type;
 
+	private:
+		/// The maximal number of kernels removed from the queue at once.
+		size_t _batch_size = 1;
+
+	public:
+
 		inline
 		parallel_pipeline(parallel_pipeline&& rhs) noexcept:
-		base_pipeline(std::move(rhs))
+		base_pipeline(std::move(rhs)),
+		_batch_size(rhs._batch_size)
 		{}
 
 		inline
@@ -33,11 +50,34 @@ namespace bsc {
 		parallel_pipeline& operator=(const parallel_pipeline&) = delete;
 		~parallel_pipeline() = default;
 
+		/**
+		\brief Set the maximal number of kernels that a thread
+		removes from the queue under a single lock.
+		\details
+		A thread never takes more than its fair share of the queue
+		(the queue size divided by the number of threads), so that
+		other threads are not starved.
+		*/
+		inline void
+		set_batch_size(size_t rhs) noexcept {
+			this->_batch_size = std::max(size_t(1), rhs);
+		}
+
+		inline size_t
+		batch_size() const noexcept {
+			return this->_batch_size;
+		}
+
 	protected:
 
 		void
 		do_run() override;
 
+	private:
+
+		size_t
+		fair_share() const;
+
 	};
 
 }
@@ -0,0 +1,151 @@
+#ifndef BSCHEDULER_PPL_PROCESS_CHANNEL_HH
+#define BSCHEDULER_PPL_PROCESS_CHANNEL_HH
+
+#include <cerrno>
+#include <streambuf>
+
+#include <unistd.h>
+
+#include <unistdx/base/bad_call>
+#include <unistdx/io/fildes_pair>
+
+#include <bscheduler/base/shm_ring.hh>
+
+namespace bsc {
+
+	/**
+	\brief Connection between the daemon and application process.
+	\details
+	The data goes either through a pair of pipes or through
+	shared memory rings (\link shm_channel\endlink). The class is
+	a stream buffer, so that it can be used as the file descriptor
+	type of \c sys::basic_fildesbuf.
+	*/
+	class process_channel: public std::streambuf {
+
+	public:
+		typedef sys::fd_type fd_type;
+
+	private:
+		sys::fildes_pair _pipe;
+		shm_channel _shm;
+
+	public:
+
+		process_channel() = default;
+
+		inline explicit
+		process_channel(sys::fildes_pair&& pipe):
+		_pipe(std::move(pipe))
+		{}
+
+		inline explicit
+		process_channel(shm_channel&& shm):
+		_shm(std::move(shm))
+		{}
+
+		inline
+		process_channel(process_channel&& rhs):
+		std::streambuf(rhs),
+		_pipe(std::move(rhs._pipe)),
+		_shm(std::move(rhs._shm))
+		{}
+
+		inline process_channel&
+		operator=(process_channel&& rhs) {
+			std::streambuf::operator=(rhs);
+			this->_pipe = std::move(rhs._pipe);
+			this->_shm = std::move(rhs._shm);
+			return *this;
+		}
+
+		/// Returns true, if the data goes through shared memory.
+		inline bool
+		uses_shared_memory() const noexcept {
+			return this->_shm.is_open();
+		}
+
+		/// Returns the file descriptor to poll for incoming data.
+		inline fd_type
+		in() const noexcept {
+			return this->uses_shared_memory()
+				? this->_shm.doorbell()
+				: this->_pipe.in().fd();
+		}
+
+		/**
+		\brief Returns the file descriptor to poll for free space.
+		\details
+		Returns -1 for shared memory channel, because free space
+		is signalled by the same file descriptor as incoming data.
+		*/
+		inline fd_type
+		out() const noexcept {
+			return this->uses_shared_memory() ? -1 : this->_pipe.out().fd();
+		}
+
+		/**
+		\brief Returns the file descriptor that becomes readable
+		with end-of-file, when the other process exits.
+		\details
+		Returns -1 for pipes, because pipes themselves hang up.
+		*/
+		inline fd_type
+		lifeline() const noexcept {
+			return this->uses_shared_memory() ? this->_shm.lifeline() : -1;
+		}
+
+		inline void
+		validate() {
+			if (!this->uses_shared_memory()) {
+				this->_pipe.in().validate();
+				this->_pipe.out().validate();
+			}
+		}
+
+		inline void
+		close() {
+			if (this->uses_shared_memory()) {
+				this->_shm.close();
+			} else {
+				this->_pipe.close();
+			}
+		}
+
+	protected:
+
+		std::streamsize
+		xsgetn(char_type* s, std::streamsize n) override {
+			if (this->uses_shared_memory()) {
+				return this->_shm.read(s, n);
+			}
+			return check(::read(this->_pipe.in().fd(), s, n));
+		}
+
+		std::streamsize
+		xsputn(const char_type* s, std::streamsize n) override {
+			if (this->uses_shared_memory()) {
+				return this->_shm.write(s, n);
+			}
+			return check(::write(this->_pipe.out().fd(), s, n));
+		}
+
+	private:
+
+		/// Returns zero, if the pipe is not ready.
+		static std::streamsize
+		check(ssize_t ret) {
+			if (ret == -1) {
+				if (errno == EAGAIN || errno == EWOULDBLOCK) {
+					return 0;
+				}
+				throw sys::bad_call();
+			}
+			return ret;
+		}
+
+	};
+
+}
+
+#endif // vim:filetype=cpp
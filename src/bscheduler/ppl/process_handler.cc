@@ -14,6 +14,14 @@ bsc::process_handler<K,R>
 	if (this->is_starting()) {
 		this->setstate(pipeline_state::started);
 	}
+	if (event.fd() == this->lifeline()) {
+		// the other process has exited, read the kernels
+		// that it left in the ring
+		this->_packetbuf->pubfill();
+		this->_proto.receive_kernels(this->_stream);
+		this->setstate(pipeline_state::stopped);
+		return;
+	}
 	if (event.in()) {
 		this->_packetbuf->pubfill();
 		if (this->_packetbuf->is_safe_to_compact()) {
@@ -46,7 +54,7 @@ bsc::process_handler<K,R>
 template <class K, class R>
 void
 bsc::process_handler<K,R>
-::remove(sys::event_poller& poller) {
+::remove(socket_poller& poller) {
 	try {
 		poller.erase(this->in());
 	} catch (const sys::bad_call& err) {
@@ -54,11 +62,16 @@ bsc::process_handler<K,R>
 			throw;
 		}
 	}
-	try {
-		poller.erase(this->out());
-	} catch (const sys::bad_call& err) {
-		if (err.errc() != std::errc::no_such_file_or_directory) {
-			throw;
+	for (sys::fd_type fd : {this->out(), this->lifeline()}) {
+		if (fd == -1) {
+			continue;
+		}
+		try {
+			poller.erase(fd);
+		} catch (const sys::bad_call& err) {
+			if (err.errc() != std::errc::no_such_file_or_directory) {
+				throw;
+			}
 		}
 	}
 	this->setstate(pipeline_state::stopped);
@@ -5,15 +5,16 @@
 #include <iosfwd>
 
 #include <unistdx/io/fildes_pair>
-#include <unistdx/io/fildesbuf>
 #include <unistdx/io/poller>
 #include <unistdx/ipc/process>
 
 #include <bscheduler/kernel/kstream.hh>
+#include <bscheduler/kernel/ring_fildesbuf.hh>
 #include <bscheduler/ppl/application.hh>
 #include <bscheduler/ppl/basic_handler.hh>
 #include <bscheduler/ppl/kernel_protocol.hh>
 #include <bscheduler/ppl/pipeline_base.hh>
+#include <bscheduler/ppl/process_channel.hh>
 
 namespace bsc {
 
@@ -25,11 +26,12 @@ namespace bsc {
 		typedef R router_type;
 
 	private:
-		typedef sys::basic_fildesbuf<char, std::char_traits<char>, sys::fildes_pair>
+		typedef basic_ring_fildesbuf<char, std::char_traits<char>, process_channel>
 			fildesbuf_type;
 		typedef basic_kernelbuf<fildesbuf_type> kernelbuf_type;
 		typedef std::unique_ptr<kernelbuf_type> kernelbuf_ptr;
 		typedef kstream<K> stream_type;
+		typedef kernel_frame<K> frame_type;
 		typedef kernel_protocol<K,R,bits::forward_to_parent<R>>
 			protocol_type;
 
@@ -62,10 +64,33 @@ namespace bsc {
 		_role(role_type::parent)
 		{
 			this->_proto.set_other_application(&this->_application);
-			this->_proto.setf(kernel_proto_flag::prepend_source_and_destination);
-			this->_packetbuf->setfd(sys::fildes_pair(std::move(pipe)));
-			this->_packetbuf->fd().in().validate();
-			this->_packetbuf->fd().out().validate();
+			this->_proto.setf(
+				kernel_proto_flag::prepend_source_and_destination
+			);
+			this->_packetbuf->setfd(
+				process_channel(sys::fildes_pair(std::move(pipe)))
+			);
+			this->_packetbuf->fd().validate();
+		}
+
+		/// Called from parent process.
+		process_handler(
+			sys::pid_type&& child,
+			shm_channel&& channel,
+			const application& app
+		):
+		_childpid(child),
+		_packetbuf(new kernelbuf_type),
+		_stream(_packetbuf.get()),
+		_proto(),
+		_application(app),
+		_role(role_type::parent)
+		{
+			this->_proto.set_other_application(&this->_application);
+			this->_proto.setf(
+				kernel_proto_flag::prepend_source_and_destination
+			);
+			this->_packetbuf->setfd(process_channel(std::move(channel)));
 		}
 
 		/// Called from child process.
@@ -80,9 +105,32 @@ namespace bsc {
 		{
 			this->_proto.setf(
 				kernel_proto_flag::prepend_source_and_destination |
-				kernel_proto_flag::save_upstream_kernels
+				kernel_proto_flag::save_upstream_kernels |
+				kernel_proto_flag::coalesce_kernels |
+				kernel_proto_flag::passive_negotiation
+			);
+			this->_packetbuf->setfd(
+				process_channel(sys::fildes_pair(std::move(pipe)))
 			);
-			this->_packetbuf->setfd(sys::fildes_pair(std::move(pipe)));
+		}
+
+		/// Called from child process.
+		explicit
+		process_handler(shm_channel&& channel):
+		_childpid(sys::this_process::id()),
+		_packetbuf(new kernelbuf_type),
+		_stream(_packetbuf.get()),
+		_proto(),
+		_application(),
+		_role(role_type::child)
+		{
+			this->_proto.setf(
+				kernel_proto_flag::prepend_source_and_destination |
+				kernel_proto_flag::save_upstream_kernels |
+				kernel_proto_flag::coalesce_kernels |
+				kernel_proto_flag::passive_negotiation
+			);
+			this->_packetbuf->setfd(process_channel(std::move(channel)));
 		}
 
 		virtual
@@ -109,6 +157,13 @@ namespace bsc {
 		void
 		send(kernel_type* k) {
 			this->_proto.send(k, this->_stream);
+			this->mark_dirty();
+		}
+
+		inline void
+		send(const frame_type& frame) {
+			this->_proto.send_frame(frame, this->_stream);
+			this->mark_dirty();
 		}
 
 		void
@@ -116,16 +171,24 @@ namespace bsc {
 
 		void
 		flush() override {
+			const size_t nwrites = this->_packetbuf->num_writes();
+			this->_proto.flush(this->_stream);
 			if (this->_packetbuf->dirty()) {
 				this->_packetbuf->pubflush();
 			}
+			this->count_writes(this->_packetbuf->num_writes() - nwrites);
+		}
+
+		size_t
+		buffered_bytes() const override {
+			return this->_packetbuf->unflushed();
 		}
 
 		void
 		write(std::ostream& out) const override;
 
 		void
-		remove(sys::event_poller& poller) override;
+		remove(socket_poller& poller) override;
 
 		void
 		forward(foreign_kernel* k) {
@@ -133,6 +196,24 @@ namespace bsc {
 			// to child process
 			k->aptr(nullptr);
 			this->_proto.forward(k, this->_stream);
+			this->mark_dirty();
+		}
+
+		/**
+		\brief Write kernels with the same header in one packet.
+		\details
+		Called in parent process. The child process answers the handshake
+		and batches kernels only after the parent has started the negotiation,
+		so that the kernels of applications and daemons of different versions
+		are not batched.
+		*/
+		inline void
+		set_batch_kernels(bool rhs) noexcept {
+			if (rhs) {
+				this->_proto.setf(kernel_proto_flag::coalesce_kernels);
+			} else {
+				this->_proto.unsetf(kernel_proto_flag::coalesce_kernels);
+			}
 		}
 
 		inline void
@@ -148,12 +229,19 @@ namespace bsc {
 
 		inline sys::fd_type
 		in() const noexcept {
-			return this->_packetbuf->fd().in().fd();
+			return this->_packetbuf->fd().in();
 		}
 
+		/// Returns -1, if the data goes through shared memory.
 		inline sys::fd_type
 		out() const noexcept {
-			return this->_packetbuf->fd().out().fd();
+			return this->_packetbuf->fd().out();
+		}
+
+		/// Returns -1, if the data goes through pipes.
+		inline sys::fd_type
+		lifeline() const noexcept {
+			return this->_packetbuf->fd().lifeline();
 		}
 
 	};
@@ -37,66 +37,136 @@ typename bsc::process_pipeline<K,R>::app_iterator
 bsc::process_pipeline<K,R>
 ::do_add(const application& app) {
 	app.allow_root(this->_allowroot);
+	if (this->_ring_capacity != 0) {
+		shm_channel channel;
+		try {
+			channel = shm_channel::create(this->_ring_capacity);
+		} catch (const std::exception& err) {
+			this->log("shared memory is not available, using pipes: _", err.what());
+		}
+		if (channel.is_open()) {
+			return this->do_add(app, std::move(channel));
+		}
+	}
 	sys::two_way_pipe data_pipe;
 	const sys::process& p = _procs.emplace(
 		[&app,this,&data_pipe] () {
-		    try {
-		        data_pipe.close_in_child();
-		        data_pipe.validate();
+			return this->execute(app, [&app,&data_pipe] () {
+				data_pipe.close_in_child();
+				data_pipe.validate();
 				data_pipe.child_in().unsetf(sys::fd_flag::fd_close_on_exec);
 				data_pipe.child_out().unsetf(sys::fd_flag::fd_close_on_exec);
-		        return app.execute(data_pipe);
-			} catch (const std::exception& err) {
-		        this->log(
-					"failed to execute _: _",
-					app.filename(),
-					err.what()
-		        );
-		        // make address sanitizer happy
-				#if defined(__SANITIZE_ADDRESS__)
-		        sys::this_process::execute_command("false");
-				return 1;
-				#else
-		        return 1;
-				#endif
-			} catch (...) {
-		        this->log(
-					"failed to execute _: _",
-					app.filename(),
-					"<unknown error>"
-		        );
-		        // make address sanitizer happy
-				#if defined(__SANITIZE_ADDRESS__)
-		        sys::this_process::execute_command("false");
-				return 1;
-				#else
-		        return 1;
-				#endif
-			}
+				return app.execute(data_pipe);
+			});
 		}
-	                        );
+	);
 	data_pipe.close_in_parent();
 	data_pipe.validate();
-	sys::fd_type parent_in = data_pipe.parent_in().fd();
-	sys::fd_type parent_out = data_pipe.parent_out().fd();
-	auto child =
+	return this->add_handler(
+		app,
+		p,
 		std::make_shared<event_handler_type>(
 			p.id(),
 			std::move(data_pipe),
 			app
+		)
+	);
+}
+
+template <class K, class R>
+typename bsc::process_pipeline<K,R>::app_iterator
+bsc::process_pipeline<K,R>
+::do_add(const application& app, shm_channel&& channel) {
+	const sys::process& p = _procs.emplace(
+		[&app,this,&channel] () {
+			return this->execute(app, [&app,&channel] () {
+				channel.unset_close_on_exec();
+				return app.execute(channel);
+			});
+		}
+	);
+	channel.close_in_parent();
+	return this->add_handler(
+		app,
+		p,
+		std::make_shared<event_handler_type>(
+			p.id(),
+			std::move(channel),
+			app
+		)
+	);
+}
+
+template <class K, class R>
+template <class Execute>
+int
+bsc::process_pipeline<K,R>
+::execute(const application& app, Execute execute) {
+	try {
+		return execute();
+	} catch (const std::exception& err) {
+		this->log(
+			"failed to execute _: _",
+			app.filename(),
+			err.what()
+		);
+		// make address sanitizer happy
+		#if defined(__SANITIZE_ADDRESS__)
+		sys::this_process::execute_command("false");
+		return 1;
+		#else
+		return 1;
+		#endif
+	} catch (...) {
+		this->log(
+			"failed to execute _: _",
+			app.filename(),
+			"<unknown error>"
 		);
+		// make address sanitizer happy
+		#if defined(__SANITIZE_ADDRESS__)
+		sys::this_process::execute_command("false");
+		return 1;
+		#else
+		return 1;
+		#endif
+	}
+}
+
+template <class K, class R>
+typename bsc::process_pipeline<K,R>::app_iterator
+bsc::process_pipeline<K,R>
+::add_handler(
+	const application& app,
+	const sys::process& p,
+	const event_handler_ptr& child
+) {
 	child->set_name(this->_name);
+	child->set_batch_kernels(this->_batch_kernels);
 	this->log(
-		"executing app=_,credentials=_:_,role=_,pid=_",
+		"executing app=_,credentials=_:_,role=_,pid=_,shm=_",
 		app.id(),
 		app.uid(),
 		app.gid(),
 		app.role(),
-		p.id()
+		p.id(),
+		child->out() == -1
 	);
 	auto result = this->_apps.emplace(app.id(), child);
-	this->emplace_handler(sys::epoll_event(parent_in, sys::event::in), child);
-	this->emplace_handler(sys::epoll_event(parent_out, sys::event::out), child);
+	this->emplace_handler(sys::epoll_event(child->in(), sys::event::in), child);
+	if (child->out() != -1) {
+		this->emplace_handler(
+			sys::epoll_event(child->out(), sys::event::out),
+			child
+		);
+	}
+	if (child->lifeline() != -1) {
+		// hang up when the child exits
+		this->emplace_handler(
+			sys::epoll_event(child->lifeline(), sys::event::in),
+			child
+		);
+	}
 	return result.first;
 }
 
@@ -104,8 +174,10 @@ template <class K, class R>
 void
 bsc::process_pipeline<K,R>
 ::forward(foreign_kernel* hdr) {
-	// do not lock here as static_lock locks both mutexes
+	// the mutexes are recursive: the threads of both pipelines
+	// already hold them, socket pipeline shards do not
 	assert(this->other_mutex());
+	static_lock_type lock(&this->_mutex, this->other_mutex());
 	app_iterator result = this->find_by_app_id(hdr->app());
 	if (result == this->_apps.end()) {
 		if (const application* a = hdr->aptr()) {
@@ -144,11 +216,14 @@ bsc::process_pipeline<K,R>
 ::process_kernel(kernel_type* k) {
 	typedef typename map_type::value_type value_type;
 	if (k->moves_everywhere()) {
+		// serialize once for all applications
+		std::unique_ptr<kernel_type> ptr(k);
+		const kernel_frame<K> frame(*k, true, false);
 		std::for_each(
 			this->_apps.begin(),
 			this->_apps.end(),
-			[k] (value_type& rhs) {
-			    rhs.second->send(k);
+			[&frame] (value_type& rhs) {
+			    rhs.second->send(frame);
 			}
 		);
 	} else {
@@ -196,8 +271,11 @@ bsc::process_pipeline<K,R>
 	app_iterator result = this->find_by_process_id(p.id());
 	if (result != this->_apps.end()) {
 		this->log("app exited: app=_,_", result->first, status);
-//		result->second->close();
+		// the thread of the pipeline reads the rest of the data,
+		// removes the handler from the poller and closes it
+		result->second->setstate(pipeline_state::stopped);
 		this->_apps.erase(result);
+		this->poller().notify_one();
 	}
 }
 
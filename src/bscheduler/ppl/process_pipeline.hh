@@ -23,6 +23,7 @@ namespace bsc {
 		using typename base_pipeline::queue_popper;
 		using typename base_pipeline::lock_type;
 		using typename base_pipeline::mutex_type;
+		using typename base_pipeline::static_lock_type;
 		typedef process_handler<K,R> event_handler_type;
 		typedef std::shared_ptr<event_handler_type> event_handler_ptr;
 		typedef std::unordered_map<application_type,event_handler_ptr> map_type;
@@ -37,6 +38,10 @@ namespace bsc {
 		sys::process_group _procs;
 		/// Allow process execution as superuser/supergroup.
 		bool _allowroot = false;
+		/// The size of shared memory rings (0 means pipes).
+		size_t _ring_capacity = 0;
+		/// Whether kernels with the same header are written in one packet.
+		bool _batch_kernels = false;
 
 	public:
 
@@ -68,6 +73,40 @@ namespace bsc {
 			this->_allowroot = rhs;
 		}
 
+		/**
+		\brief Connect new applications with shared memory rings
+		of \p rhs bytes in each direction.
+		\details
+		Pipes are used, if the capacity is zero (the default) or
+		shared memory is not available.
+		*/
+		inline void
+		set_ring_capacity(size_t rhs) noexcept {
+			this->_ring_capacity = rhs;
+		}
+
+		inline size_t
+		ring_capacity() const noexcept {
+			return this->_ring_capacity;
+		}
+
+		/**
+		\brief Write kernels with the same header in one packet
+		to new applications.
+		\details
+		The application batches kernels to this side as well.
+		Disabled by default.
+		*/
+		inline void
+		set_batch_kernels(bool rhs) noexcept {
+			this->_batch_kernels = rhs;
+		}
+
+		inline bool
+		batch_kernels() const noexcept {
+			return this->_batch_kernels;
+		}
+
 		void
 		print_state(std::ostream& out);
 
@@ -81,6 +120,21 @@ namespace bsc {
 		app_iterator
 		do_add(const application& app);
 
+		app_iterator
+		do_add(const application& app, shm_channel&& channel);
+
+		/// Execute the application in the child process.
+		template <class Execute>
+		int
+		execute(const application& app, Execute execute);
+
+		app_iterator
+		add_handler(
+			const application& app,
+			const sys::process& p,
+			const event_handler_ptr& child
+		);
+
 		void
 		process_kernel(kernel_type* k);
 
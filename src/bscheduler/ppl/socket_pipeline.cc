@@ -1,20 +1,37 @@
 #include "socket_pipeline.hh"
 
 #include <algorithm>
+#include <atomic>
 #include <cassert>
+#include <deque>
+#include <istream>
+#include <limits>
+#include <mutex>
+#include <ostream>
 #include <stdexcept>
+#include <string>
+
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/ioctl.h>
+#include <sys/socket.h>
+#include <linux/sockios.h>
 
 #include <unistdx/base/make_object>
 #include <unistdx/net/socket>
 
 #include <bscheduler/config.hh>
 #include <bscheduler/kernel/kernel_instance_registry.hh>
+#include <bscheduler/kernel/ring_fildesbuf.hh>
 #include <bscheduler/ppl/basic_router.hh>
 #include <bscheduler/ppl/kernel_protocol.hh>
 #include <bscheduler/ppl/socket_pipeline_event.hh>
 
 namespace {
 
+	/// The number of broadcast kernel ids that are remembered to drop duplicates.
+	constexpr const size_t max_broadcasts = 4096;
+
 	template <class kernel, class Server>
 	void
 	set_kernel_id(kernel* k, Server& srv) {
@@ -155,7 +172,7 @@ namespace bsc {
 		}
 
 		void
-		remove(sys::event_poller& poller) override {
+		remove(socket_poller& poller) override {
 			poller.erase(this->fd());
 			this->_ppl.remove_server(this->_ifaddr);
 		}
@@ -177,7 +194,7 @@ namespace bsc {
 		typedef pipeline_base base_pipeline;
 		typedef K kernel_type;
 		typedef char Ch;
-		typedef sys::basic_fildesbuf<Ch, std::char_traits<Ch>, sys::socket>
+		typedef basic_ring_fildesbuf<Ch, std::char_traits<Ch>, sys::socket>
 		    fildesbuf_type;
 		typedef basic_kernelbuf<fildesbuf_type> kernelbuf_type;
 		typedef std::unique_ptr<kernelbuf_type> kernelbuf_ptr;
@@ -189,6 +206,16 @@ namespace bsc {
 		typedef sys::pid_type app_type;
 		typedef socket_pipeline<K,S,R> this_type;
 		typedef typename this_type::weight_type weight_type;
+		typedef kernel_frame<K> frame_type;
+
+	private:
+		/// Kernel that waits in the bulk lane, exactly one pointer is set.
+		struct bulk_kernel {
+			kernel_type* kernel;
+			foreign_kernel* hdr;
+		};
+
+	public:
 
 		static_assert(
 			std::is_move_constructible<stream_type>::value,
@@ -202,24 +229,61 @@ namespace bsc {
 		protocol_type _proto;
 		/// The number of nodes "behind" this one in the hierarchy.
 		weight_type _weight = 1;
+		/// The number of kernels in flight. Other threads read it
+		/// instead of the upstream buffer of the protocol.
+		std::atomic<size_t> _nupstream{0};
+		/// The number of kernels queued in the thread that owns the client.
+		std::atomic<size_t> _npending{0};
+		/// The load that was reported by the other side.
+		std::atomic<size_t> _peerload{0};
+		/// The index of the shard that owns the client.
+		size_t _shard = 0;
+		/// Kernels of normal and low priority that were not written yet.
+		std::deque<bulk_kernel> _bulk;
+		/// The maximal number of unflushed bytes that bulk kernels may occupy.
+		size_t _bulklimit = 0;
+		/// The number of bytes in the socket buffer that were not sent yet.
+		size_t _unsent = 0;
 		this_type& _ppl;
 
 	public:
 		remote_client() = default;
 
-		remote_client(socket_type&& sock, sys::socket_address vaddr, this_type& ppl):
+		remote_client(
+			socket_type&& sock,
+			sys::socket_address vaddr,
+			size_t shard,
+			this_type& ppl
+		):
 		_vaddr(vaddr),
 		_packetbuf(new kernelbuf_type),
 		_stream(_packetbuf.get()),
 		_proto(),
+		_shard(shard),
+		_bulklimit(ppl.bulk_output_limit()),
 		_ppl(ppl) {
 			this->_proto.setf(
 				kernel_proto_flag::prepend_application |
 				kernel_proto_flag::save_upstream_kernels |
 				kernel_proto_flag::save_downstream_kernels
 			);
+			if (ppl.batch_kernels()) {
+				this->_proto.setf(kernel_proto_flag::coalesce_kernels);
+			}
+			if (ppl.routing() == routing_policy::least_loaded) {
+				this->_proto.setf(kernel_proto_flag::attach_load);
+			}
+			if (ppl.relays_broadcasts()) {
+				this->_proto.setf(kernel_proto_flag::relay_broadcast_kernels);
+			}
 			this->_proto.set_endpoint(this->_vaddr);
 			this->_packetbuf->setfd(std::move(sock));
+			this->_packetbuf->set_compression_threshold(
+				ppl.compression_threshold()
+			);
+			this->_packetbuf->set_max_packet_size(ppl.max_packet_size());
+			this->_packetbuf->set_compact_encoding(ppl.compact_encoding());
+			this->limit_unsent_bytes();
 		}
 
 		remote_client&
@@ -238,18 +302,99 @@ namespace bsc {
 			// from which they must be recovered with recover_kernels().
 			sys::epoll_event ev {socket().fd(), sys::event::in};
 			this->handle(ev);
+			// put queued kernels into the buffers of the protocol
+			while (!this->_bulk.empty()) {
+				this->write_bulk_kernel();
+			}
 			// recover kernels from upstream and downstream buffer
 			this->_proto.recover_kernels(ev.err());
 		}
 
+		/**
+		\brief Send the kernel to the other side.
+		\details
+		Kernels with high priority (probes, hierarchy updates and other
+		control kernels) are written immediately. Other kernels are queued,
+		if the output buffer already has \link socket_pipeline::bulk_output_limit\endlink
+		bytes or other kernels are queued, and are written by \link flush\endlink
+		as the buffer is drained. This way control kernels overtake
+		bulk kernels that were not serialized yet.
+		*/
 		void
 		send(kernel_type* k) {
-			this->_proto.send(k, this->_stream);
+			if (this->must_queue(k->priority())) {
+				this->enqueue({k, nullptr});
+			} else {
+				this->do_send(k);
+			}
 		}
 
+		/// Forward the kernel to the other side with the same rules as \link send\endlink.
 		void
 		forward(foreign_kernel* hdr) {
-			this->_proto.forward(hdr, this->_stream);
+			if (this->must_queue(hdr->priority())) {
+				this->enqueue({nullptr, hdr});
+			} else {
+				this->do_forward(hdr);
+			}
+		}
+
+		inline void
+		send(const frame_type& frame) {
+			this->_proto.send_frame(frame, this->_stream);
+			this->mark_dirty();
+		}
+
+		/**
+		Recover the kernel that was sent to the client after it had stopped,
+		as if it was written before the connection was closed.
+		*/
+		inline void
+		recover(kernel_type* k) noexcept {
+			this->_proto.recover_unsent_kernel(k);
+		}
+
+		/// Returns the number of kernels that were sent to the client
+		/// and have not returned yet.
+		inline size_t
+		num_outstanding() const noexcept {
+			return this->_nupstream.load(std::memory_order_relaxed) +
+				this->_npending.load(std::memory_order_relaxed);
+		}
+
+		/// Returns the number of outstanding kernels plus the load of the other side.
+		inline size_t
+		load() const noexcept {
+			return this->num_outstanding() +
+				this->_peerload.load(std::memory_order_relaxed);
+		}
+
+		inline void
+		peer_load(size_t rhs) noexcept {
+			this->_peerload.store(rhs, std::memory_order_relaxed);
+		}
+
+		/// Returns true, if the client has \p capacity kernels in flight.
+		inline bool
+		full(size_t capacity) const noexcept {
+			return capacity != 0 &&
+				this->_nupstream.load(std::memory_order_relaxed) +
+				this->_npending.load(std::memory_order_relaxed) >= capacity;
+		}
+
+		inline void
+		add_pending() noexcept {
+			++this->_npending;
+		}
+
+		inline void
+		remove_pending() noexcept {
+			--this->_npending;
+		}
+
+		inline size_t
+		shard() const noexcept {
+			return this->_shard;
 		}
 
 		void
@@ -263,14 +408,47 @@ namespace bsc {
 				}
 				this->_packetbuf->pubfill();
 				this->_proto.receive_kernels(this->_stream);
+				this->update_num_upstream_kernels();
+				if (this->_proto.has_peer_load()) {
+					this->peer_load(this->_proto.peer_load());
+				}
 			}
 		}
 
 		void
 		flush() override {
+			const size_t nwrites = this->_packetbuf->num_writes();
+			this->_proto.flush(this->_stream);
 			if (this->_packetbuf->dirty()) {
 				this->_packetbuf->pubflush();
 			}
+			this->update_unsent_bytes();
+			// refill the buffers up to the limit
+			if (!this->_bulk.empty()) {
+				while (!this->_bulk.empty() &&
+				       this->pending_bytes() < this->_bulklimit) {
+					this->write_bulk_kernel();
+				}
+				this->_proto.flush(this->_stream);
+				if (this->_packetbuf->dirty()) {
+					this->_packetbuf->pubflush();
+				}
+				this->update_unsent_bytes();
+			}
+			this->count_writes(this->_packetbuf->num_writes() - nwrites);
+		}
+
+		/// Queued kernels count as the full buffer.
+		size_t
+		buffered_bytes() const override {
+			const size_t n = this->_packetbuf->unflushed();
+			return this->_bulk.empty() ? n : std::max(n, this->_bulklimit);
+		}
+
+		/// Returns the number of kernels in the bulk lane.
+		inline size_t
+		num_queued() const noexcept {
+			return this->_bulk.size();
 		}
 
 		inline const socket_type&
@@ -285,8 +463,11 @@ namespace bsc {
 
 		void
 		socket(sys::socket&& rhs) {
+			this->_proto.flush(this->_stream);
 			this->_packetbuf->pubsync();
 			this->_packetbuf->setfd(socket_type(std::move(rhs)));
+			// the other side may be a different build
+			this->_packetbuf->reset_negotiation();
 		}
 
 		inline weight_type
@@ -326,6 +507,14 @@ namespace bsc {
 				int(this->state()),
 				"weight",
 				this->weight(),
+				"upstream",
+				this->_nupstream.load(),
+				"load",
+				this->load(),
+				"shard",
+				this->_shard,
+				"queued",
+				this->_bulk.size(),
 				"remaining",
 				this->_packetbuf->remaining(),
 				"available",
@@ -334,11 +523,325 @@ namespace bsc {
 		}
 
 		void
-		remove(sys::event_poller& poller) override {
+		remove(socket_poller& poller) override {
+			// the client may be removed on bad event without being stopped
+			this->setstate(pipeline_state::stopped);
 			poller.erase(this->_packetbuf->fd().fd());
 			this->_ppl.remove_client(this->vaddr());
 		}
 
+	private:
+
+		inline bool
+		must_queue(kernel_priority priority) const noexcept {
+			return this->_bulklimit != 0 &&
+				priority != kernel_priority::high &&
+				(!this->_bulk.empty() ||
+				 this->pending_bytes() >= this->_bulklimit);
+		}
+
+		/// Bytes that were written to the client, but were not sent yet.
+		inline size_t
+		pending_bytes() const noexcept {
+			return this->_packetbuf->unflushed() + this->_unsent;
+		}
+
+		inline void
+		enqueue(const bulk_kernel& k) {
+			this->_bulk.emplace_back(k);
+			this->add_pending();
+			this->mark_dirty();
+		}
+
+		void
+		write_bulk_kernel() {
+			bulk_kernel k = this->_bulk.front();
+			this->_bulk.pop_front();
+			this->remove_pending();
+			if (k.kernel) {
+				this->do_send(k.kernel);
+			} else {
+				this->do_forward(k.hdr);
+			}
+		}
+
+		void
+		do_send(kernel_type* k) {
+			this->update_load();
+			this->_proto.send(k, this->_stream);
+			this->update_num_upstream_kernels();
+			this->mark_dirty();
+		}
+
+		void
+		do_forward(foreign_kernel* hdr) {
+			this->update_load();
+			this->_proto.forward(hdr, this->_stream);
+			this->update_num_upstream_kernels();
+			this->mark_dirty();
+		}
+
+		/**
+		Wake up the poller for writing only when the socket buffer has
+		less than \link socket_pipeline::bulk_output_limit\endlink
+		unsent bytes. This does not limit the buffer: \c write still
+		fills it up to \c SO_SNDBUF, the limit is enforced by
+		\link update_unsent_bytes\endlink. Errors are ignored:
+		the option is not supported by UNIX domain sockets and old kernels.
+		*/
+		void
+		limit_unsent_bytes() noexcept {
+			#if defined(TCP_NOTSENT_LOWAT)
+			if (this->_bulklimit == 0) {
+				return;
+			}
+			int value = static_cast<int>(std::min<size_t>(
+				this->_bulklimit,
+				std::numeric_limits<int>::max()
+			));
+			::setsockopt(
+				this->socket().fd(),
+				IPPROTO_TCP,
+				TCP_NOTSENT_LOWAT,
+				&value,
+				sizeof(value)
+			);
+			#endif
+		}
+
+		/**
+		Query the number of unsent bytes in the socket buffer, so that
+		bulk kernels are not written while the socket buffer holds
+		the limit, otherwise control kernels wait behind them anyway.
+		Unacknowledged bytes are not counted, they are already on the wire.
+		On error (UNIX domain sockets) only the output buffer is counted.
+		*/
+		void
+		update_unsent_bytes() noexcept {
+			this->_unsent = 0;
+			#if defined(SIOCOUTQNSD)
+			if (this->_bulklimit == 0) {
+				return;
+			}
+			int n = 0;
+			if (::ioctl(this->socket().fd(), SIOCOUTQNSD, &n) == 0 && n > 0) {
+				this->_unsent = static_cast<size_t>(n);
+			}
+			#endif
+		}
+
+		/**
+		Attach the load of this node to the outgoing packets. Kernels that
+		were sent to the other side are excluded: it counts them itself.
+		*/
+		inline void
+		update_load() noexcept {
+			if (!this->_proto.attaches_load()) {
+				return;
+			}
+			const size_t total = this->_ppl.load();
+			const size_t own = this->_nupstream.load(std::memory_order_relaxed);
+			const size_t load = total > own ? total - own : 0;
+			this->_proto.set_load(static_cast<std::uint32_t>(std::min<size_t>(
+				load,
+				std::numeric_limits<std::uint32_t>::max()
+			)));
+		}
+
+		/**
+		Wake up the main thread when the client drops below its capacity,
+		otherwise the kernels that were deferred because all clients had
+		been full wait for an unrelated event.
+		*/
+		inline void
+		update_num_upstream_kernels() noexcept {
+			const size_t n = this->_proto.num_upstream_kernels();
+			const size_t old =
+				this->_nupstream.exchange(n, std::memory_order_relaxed);
+			const size_t capacity = this->_ppl.client_capacity();
+			if (capacity != 0 && n < old) {
+				const size_t pending =
+					this->_npending.load(std::memory_order_relaxed);
+				if (old + pending >= capacity && n + pending < capacity) {
+					this->_ppl.retry_deferred_kernels();
+				}
+			}
+		}
+
+	};
+
+	/**
+	\brief Event loop that owns a subset of socket pipeline clients.
+	\details
+	The shard reads from and writes to its clients in its own thread.
+	Other threads pass kernels and new clients via the inbox that is
+	protected by separate mutex, which is never held while locking
+	other mutexes. Clients are stopped only by the shard: kernels that
+	were sent to the stopped client or remained in the inbox after
+	the shard had stopped are recovered in the same way as the kernels
+	in the buffers of the closed connection.
+	*/
+	template <class K, class S, class R>
+	class socket_shard: public basic_socket_pipeline<K> {
+
+	public:
+		typedef basic_socket_pipeline<K> base_pipeline;
+		typedef R router_type;
+		typedef remote_client<K,S,R> client_type;
+		typedef std::shared_ptr<client_type> client_ptr;
+		typedef std::shared_ptr<const kernel_frame<K>> frame_ptr;
+		using typename base_pipeline::kernel_type;
+		using typename base_pipeline::duration;
+
+	private:
+		struct message {
+			client_ptr client;
+			kernel_type* kernel;
+			foreign_kernel* hdr;
+			/// Broadcast kernel that is shared by all shards.
+			frame_ptr frame;
+		};
+		typedef std::vector<message> message_container;
+		typedef std::vector<client_ptr> client_container;
+
+	private:
+		std::mutex _inmutex;
+		client_container _newclients;
+		client_container _stoppedclients;
+		message_container _messages;
+
+	public:
+
+		explicit
+		socket_shard(const duration& start_timeout) {
+			this->set_start_timeout(start_timeout);
+		}
+
+		~socket_shard() {
+			// the pipeline may have sent kernels after the shard had stopped
+			this->recover_messages();
+		}
+
+		/// Poll the client in this shard.
+		void
+		add_client(const client_ptr& client) {
+			std::lock_guard<std::mutex> lock(this->_inmutex);
+			this->_newclients.emplace_back(client);
+			this->poller().notify_one();
+		}
+
+		/// Stop the client in the thread of this shard.
+		void
+		stop_client(const client_ptr& client) {
+			std::lock_guard<std::mutex> lock(this->_inmutex);
+			this->_stoppedclients.emplace_back(client);
+			this->poller().notify_one();
+		}
+
+		void
+		send(const client_ptr& client, kernel_type* k) {
+			this->push({client, k, nullptr, nullptr});
+		}
+
+		void
+		send(const client_ptr& client, const frame_ptr& frame) {
+			this->push({client, nullptr, nullptr, frame});
+		}
+
+		void
+		forward(const client_ptr& client, foreign_kernel* hdr) {
+			this->push({client, nullptr, hdr, nullptr});
+		}
+
+	private:
+
+		void
+		push(message&& m) {
+			std::lock_guard<std::mutex> lock(this->_inmutex);
+			this->_messages.emplace_back(std::move(m));
+			this->poller().notify_one();
+		}
+
+		void
+		do_run() override {
+			base_pipeline::do_run();
+			this->recover_messages();
+		}
+
+		void
+		process_kernels() override {
+			client_container clients;
+			client_container stopped;
+			message_container messages;
+			{
+				std::lock_guard<std::mutex> lock(this->_inmutex);
+				clients.swap(this->_newclients);
+				stopped.swap(this->_stoppedclients);
+				messages.swap(this->_messages);
+			}
+			for (const client_ptr& client : clients) {
+				this->emplace_handler(
+					sys::epoll_event(client->socket().fd(), sys::event::inout),
+					client
+				);
+			}
+			// the clients are removed from the poller in this iteration
+			for (const client_ptr& client : stopped) {
+				client->setstate(pipeline_state::stopped);
+			}
+			for (message& m : messages) {
+				if (m.client->has_stopped()) {
+					this->recover(m);
+					continue;
+				}
+				try {
+					if (m.hdr) {
+						m.client->forward(m.hdr);
+					} else if (m.frame) {
+						m.client->send(*m.frame);
+					} else {
+						m.client->remove_pending();
+						m.client->send(m.kernel);
+					}
+				} catch (const std::exception& err) {
+					this->log_error(err);
+					if (m.kernel) {
+						m.kernel->from(m.kernel->to());
+						m.kernel->return_to_parent(
+							exit_code::no_upstream_servers_available
+						);
+						router_type::send_local(m.kernel);
+					}
+				}
+			}
+		}
+
+		/// Recover the kernels that remain in the inbox.
+		void
+		recover_messages() {
+			message_container messages;
+			{
+				std::lock_guard<std::mutex> lock(this->_inmutex);
+				messages.swap(this->_messages);
+				this->_newclients.clear();
+				this->_stoppedclients.clear();
+			}
+			for (message& m : messages) {
+				this->recover(m);
+			}
+		}
+
+		/// Broadcast kernels are not recovered.
+		void
+		recover(message& m) {
+			if (m.hdr) {
+				m.client->recover(m.hdr);
+			} else if (m.kernel) {
+				m.client->remove_pending();
+				m.client->recover(m.kernel);
+			}
+		}
+
 	};
 
 	/*
@@ -367,6 +870,29 @@ namespace bsc {
 
 }
 
+std::ostream&
+bsc::operator<<(std::ostream& out, routing_policy rhs) {
+	switch (rhs) {
+		case routing_policy::round_robin: out << "round_robin"; break;
+		case routing_policy::least_loaded: out << "least_loaded"; break;
+	}
+	return out;
+}
+
+std::istream&
+bsc::operator>>(std::istream& in, routing_policy& rhs) {
+	std::string s;
+	in >> s;
+	if (s == "round_robin") {
+		rhs = routing_policy::round_robin;
+	} else if (s == "least_loaded") {
+		rhs = routing_policy::least_loaded;
+	} else {
+		throw std::invalid_argument("bad routing policy");
+	}
+	return in;
+}
+
 template <class T, class S, class R>
 bsc::socket_pipeline<T,S,R>
 ::socket_pipeline() {
@@ -374,6 +900,103 @@ bsc::socket_pipeline<T,S,R>
 	this->set_start_timeout(seconds(7));
 }
 
+template <class T, class S, class R>
+bsc::socket_pipeline<T,S,R>
+::~socket_pipeline() = default;
+
+template <class T, class S, class R>
+void
+bsc::socket_pipeline<T,S,R>
+::set_num_shards(unsigned n) {
+	this->_shards.clear();
+	for (unsigned i=1; i<n; ++i) {
+		shard_ptr shard(new shard_type(this->_start_timeout));
+		shard->set_name(this->_name);
+		shard->set_number(i);
+		shard->set_io_backend(this->poller().backend());
+		shard->set_write_coalescing(
+			this->write_latency(),
+			this->write_threshold()
+		);
+		this->_shards.emplace_back(std::move(shard));
+	}
+}
+
+template <class T, class S, class R>
+bsc::io_backend
+bsc::socket_pipeline<T,S,R>
+::set_io_backend(io_backend rhs) {
+	const io_backend result = base_pipeline::set_io_backend(rhs);
+	for (shard_ptr& shard : this->_shards) {
+		shard->set_io_backend(result);
+	}
+	return result;
+}
+
+template <class T, class S, class R>
+void
+bsc::socket_pipeline<T,S,R>
+::set_write_coalescing(const duration& latency, size_t threshold) {
+	base_pipeline::set_write_coalescing(latency, threshold);
+	for (shard_ptr& shard : this->_shards) {
+		shard->set_write_coalescing(latency, threshold);
+	}
+}
+
+template <class T, class S, class R>
+bsc::write_stats
+bsc::socket_pipeline<T,S,R>
+::get_write_stats() {
+	write_stats result = base_pipeline::get_write_stats();
+	for (shard_ptr& shard : this->_shards) {
+		const write_stats s = shard->get_write_stats();
+		result.nkernels += s.nkernels;
+		result.nwrites += s.nwrites;
+		result.ndeferred += s.ndeferred;
+	}
+	return result;
+}
+
+template <class T, class S, class R>
+bsc::write_stats
+bsc::socket_pipeline<T,S,R>
+::get_write_stats(unsigned shard) {
+	if (shard == 0) {
+		return base_pipeline::get_write_stats();
+	}
+	return this->_shards.at(shard-1)->get_write_stats();
+}
+
+template <class T, class S, class R>
+void
+bsc::socket_pipeline<T,S,R>
+::start() {
+	base_pipeline::start();
+	for (shard_ptr& shard : this->_shards) {
+		shard->start();
+	}
+}
+
+template <class T, class S, class R>
+void
+bsc::socket_pipeline<T,S,R>
+::stop() {
+	base_pipeline::stop();
+	for (shard_ptr& shard : this->_shards) {
+		shard->stop();
+	}
+}
+
+template <class T, class S, class R>
+void
+bsc::socket_pipeline<T,S,R>
+::wait() {
+	base_pipeline::wait();
+	for (shard_ptr& shard : this->_shards) {
+		shard->wait();
+	}
+}
+
 template <class T, class S, class R>
 void
 bsc::socket_pipeline<T,S,R>
@@ -402,6 +1025,8 @@ template <class T, class S, class R>
 void
 bsc::socket_pipeline<T,S,R>
 ::remove_client(const sys::socket_address& vaddr) {
+	// shards call this method without holding the mutex
+	lock_type lock(this->_mutex);
 	client_iterator result = _clients.find(vaddr);
 	if (result != this->_clients.end()) {
 		this->remove_client(result);
@@ -422,7 +1047,7 @@ bsc::socket_pipeline<T,S,R>
 	if (result == this->_iterator) {
 		this->advance_client_iterator();
 	}
-	result->second->setstate(pipeline_state::stopped);
+	// the client is removed by the thread that owns it after it has stopped
 	this->_clients.erase(result);
 	fire_event_kernels<router_type>(
 		socket_pipeline_event::remove_client,
@@ -460,18 +1085,25 @@ template <class T, class S, class R>
 void
 bsc::socket_pipeline<T,S,R>
 ::forward(foreign_kernel* hdr) {
-	// do not lock here as static_lock locks both mutexes
+	// the mutexes are recursive: the threads of both pipelines
+	// already hold them, shards do not
 	assert(this->other_mutex());
+	static_lock_type lock(&this->_mutex, this->other_mutex());
 	assert(hdr->is_foreign());
 	if (hdr->to()) {
 		event_handler_ptr ptr = this->find_or_create_client(hdr->to());
 		#ifndef NDEBUG
 		this->log("fwd _ to _", *hdr, hdr->to());
 		#endif
-		ptr->forward(hdr);
+		this->forward_to(ptr, hdr);
 		this->_semaphore.notify_one();
 	} else {
-		if (this->end_reached() && hdr->moves_upstream() && hdr->carries_parent()) {
+		if (this->_policy == routing_policy::least_loaded) {
+			this->find_least_loaded_client(
+				!(hdr->moves_upstream() && hdr->carries_parent())
+			);
+		} else if (this->end_reached() && hdr->moves_upstream() &&
+			hdr->carries_parent()) {
 			this->find_next_client();
 			if (this->end_reached()) {
 				this->log(
@@ -490,7 +1122,7 @@ bsc::socket_pipeline<T,S,R>
 			#ifndef NDEBUG
 			this->log("fwd _ to _", *hdr, this->current_client().vaddr());
 			#endif
-			this->current_client().forward(hdr);
+			this->forward_to(this->_iterator->second, hdr);
 			this->find_next_client();
 			this->_semaphore.notify_one();
 		}
@@ -569,7 +1201,8 @@ template <class T, class S, class R>
 void
 bsc::socket_pipeline<T,S,R>
 ::find_next_client() {
-	if (this->_clients.empty()) {
+	if (this->_clients.empty() ||
+		this->_policy != routing_policy::round_robin) {
 		return;
 	}
 	client_iterator old_iterator = this->_iterator;
@@ -597,6 +1230,51 @@ bsc::socket_pipeline<T,S,R>
 	} while (old_iterator != this->_iterator);
 }
 
+template <class T, class S, class R>
+bool
+bsc::socket_pipeline<T,S,R>
+::find_least_loaded_client(bool localhost) {
+	client_iterator best = this->_clients.end();
+	size_t best_load = this->_localload;
+	weight_type best_weight = 1;
+	bool found = localhost;
+	bool full = false;
+	for (auto it=this->_clients.begin(); it!=this->_clients.end(); ++it) {
+		const client_type& client = *it->second;
+		if (!client.has_started()) {
+			continue;
+		}
+		if (client.full(this->_client_capacity)) {
+			full = true;
+			continue;
+		}
+		const size_t load = client.load();
+		const weight_type weight = std::max(client.weight(), weight_type(1));
+		// compare load per node without division
+		if (!found || load*best_weight < best_load*weight) {
+			best = it;
+			best_load = load;
+			best_weight = weight;
+			found = true;
+		}
+	}
+	this->_iterator = best;
+	this->_weightcnt = 0;
+	return found || !full;
+}
+
+template <class T, class S, class R>
+void
+bsc::socket_pipeline<T,S,R>
+::update_load() {
+	this->_localload = router_type::local_load();
+	size_t total = this->_localload;
+	for (const auto& pair : this->_clients) {
+		total += pair.second->num_outstanding();
+	}
+	this->_load.store(total, std::memory_order_relaxed);
+}
+
 template <class T, class S, class R>
 void
 bsc::socket_pipeline<T,S,R>
@@ -619,12 +1297,18 @@ void
 bsc::socket_pipeline<T,S,R>
 ::process_kernels() {
 //	lock_type lock(this->_mutex);
+	if (this->_policy == routing_policy::least_loaded) {
+		this->update_load();
+	}
+	std::vector<kernel_type*> deferred;
 	std::for_each(
 		queue_popper(this->_kernels),
 		queue_popper_end(this->_kernels),
-		[this] (kernel_type* k) {
+		[this,&deferred] (kernel_type* k) {
 		    try {
-		        this->process_kernel(k);
+		        if (!this->process_kernel(k)) {
+		            deferred.push_back(k);
+				}
 			} catch (const std::exception& err) {
 		        this->log_error(err);
 		        k->from(k->to());
@@ -633,10 +1317,30 @@ bsc::socket_pipeline<T,S,R>
 			}
 		}
 	);
+	// retry when some kernels return from the clients
+	for (kernel_type* k : deferred) {
+		this->_kernels.push(k);
+	}
+	this->_ndeferred = std::max(this->_ndeferred, deferred.size());
 }
 
 template <class T, class S, class R>
-void
+bool
+bsc::socket_pipeline<T,S,R>
+::skip_full_clients() {
+	const size_t n = this->_clients.size() + 1;
+	for (size_t i=0; i<n; ++i) {
+		if (this->end_reached() ||
+		    !this->current_client().full(this->_client_capacity)) {
+			return true;
+		}
+		this->find_next_client();
+	}
+	return false;
+}
+
+template <class T, class S, class R>
+bool
 bsc::socket_pipeline<T,S,R>
 ::process_kernel(kernel_type* k) {
 	// short circuit local server
@@ -652,24 +1356,29 @@ bsc::socket_pipeline<T,S,R>
 	   }
 	 */
 	if (k->moves_everywhere()) {
-		for (auto& pair : _clients) {
-			pair.second->send(k);
-		}
-		// delete broadcast kernel
-		delete k;
+		this->broadcast(k);
 	} else if (k->moves_upstream() && k->to() == sys::socket_address()) {
+		const bool localhost = this->_uselocalhost && !k->carries_parent();
+		if (this->_policy == routing_policy::least_loaded) {
+			if (!this->find_least_loaded_client(localhost)) {
+				return false;
+			}
+		} else if (!this->skip_full_clients()) {
+			return false;
+		}
 		bool success = false;
-		if (this->_uselocalhost && !k->carries_parent()) {
+		if (localhost) {
 			if (this->end_reached()) {
 				// include localhost in round-robin
 				// (short-circuit kernels when no upstream servers
 				// are available)
 				router_type::send_local(k);
+				++this->_localload;
 			} else {
 				success = true;
 			}
 		} else {
-			if (this->_clients.empty()) {
+			if (this->end_reached()) {
 				k->return_to_parent(exit_code::no_upstream_servers_available);
 				router_type::send_local(k);
 			} else {
@@ -678,7 +1387,7 @@ bsc::socket_pipeline<T,S,R>
 		}
 		if (success) {
 			ensure_identity(k, this->_iterator->second->vaddr());
-			this->_iterator->second->send(k);
+			this->send_to(this->_iterator->second, k);
 		}
 		this->find_next_client();
 	} else if (k->moves_downstream() and not k->from()) {
@@ -691,10 +1400,115 @@ bsc::socket_pipeline<T,S,R>
 		if (not k->to()) {
 			k->to(k->from());
 		}
+		event_handler_ptr client = this->find_or_create_client(k->to());
+		if (!k->moves_downstream() && client->full(this->_client_capacity)) {
+			return false;
+		}
 		if (k->moves_somewhere()) {
 			ensure_identity(k, k->to());
 		}
-		this->find_or_create_client(k->to())->send(k);
+		this->send_to(client, k);
+	}
+	return true;
+}
+
+template <class T, class S, class R>
+void
+bsc::socket_pipeline<T,S,R>
+::send_to(const event_handler_ptr& client, kernel_type* k) {
+	if (client->shard() == 0) {
+		client->send(k);
+	} else {
+		client->add_pending();
+		this->_shards[client->shard()-1]->send(client, k);
+	}
+}
+
+template <class T, class S, class R>
+void
+bsc::socket_pipeline<T,S,R>
+::send_to(const event_handler_ptr& client, const frame_ptr& frame) {
+	if (client->shard() == 0) {
+		client->send(*frame);
+	} else {
+		this->_shards[client->shard()-1]->send(client, frame);
+	}
+}
+
+template <class T, class S, class R>
+void
+bsc::socket_pipeline<T,S,R>
+::broadcast(kernel_type* k) {
+	std::unique_ptr<kernel_type> ptr(k);
+	// the kernel came from other node via relaying client
+	const sys::socket_address src = this->_relay ? k->from() : sys::socket_address();
+	const bool received = static_cast<bool>(src);
+	bool send = !received;
+	if (this->_relay) {
+		if (!received && !k->has_id() && !this->_servers.empty()) {
+			set_kernel_id(k, *this->_servers.front());
+		}
+		if (k->has_id()) {
+			if (!this->remember_broadcast(k->id())) {
+				#ifndef NDEBUG
+				this->log("drop duplicate broadcast _", *k);
+				#endif
+				return;
+			}
+			send = true;
+		}
+	}
+	if (send) {
+		try {
+			// the frame is compressed once for all clients
+			frame_ptr frame = std::make_shared<frame_type>(
+				*k,
+				false,
+				this->_compact_encoding,
+				this->_compression_threshold
+			);
+			for (auto& pair : this->_clients) {
+				if (pair.first == src) {
+					continue;
+				}
+				if (this->_relay && this->_links.count(pair.first) == 0) {
+					// relayed kernels go only along the hierarchy
+					continue;
+				}
+				this->send_to(pair.second, frame);
+			}
+		} catch (const std::exception& err) {
+			this->log_error(err);
+		}
+	}
+	if (received) {
+		router_type::send_local(ptr.release());
+	}
+}
+
+template <class T, class S, class R>
+bool
+bsc::socket_pipeline<T,S,R>
+::remember_broadcast(id_type id) {
+	if (!this->_broadcasts.insert(id).second) {
+		return false;
+	}
+	this->_broadcast_order.push_back(id);
+	if (this->_broadcast_order.size() > max_broadcasts) {
+		this->_broadcasts.erase(this->_broadcast_order.front());
+		this->_broadcast_order.pop_front();
+	}
+	return true;
+}
+
+template <class T, class S, class R>
+void
+bsc::socket_pipeline<T,S,R>
+::forward_to(const event_handler_ptr& client, foreign_kernel* hdr) {
+	if (client->shard() == 0) {
+		client->forward(hdr);
+	} else {
+		this->_shards[client->shard()-1]->forward(client, hdr);
 	}
 }
 
@@ -749,16 +1563,23 @@ bsc::socket_pipeline<T,S,R>
 	if (vaddr.family() != sys::family_type::unix) {
 		sock.set_user_timeout(this->_socket_timeout);
 	}
+	// the first thread routes all kernels, hence it gets connections last
+	const size_t shard = ++this->_nassigned % this->num_shards();
 	event_handler_ptr s =
 		std::make_shared<event_handler_type>(
 			std::move(sock),
 			vaddr,
+			shard,
 			*this
 		);
 	s->setstate(pipeline_state::starting);
 	s->set_name(this->_name);
 	this->emplace_client(vaddr, s);
-	this->emplace_handler(sys::epoll_event(fd, sys::event::inout), s);
+	if (shard == 0) {
+		this->emplace_handler(sys::epoll_event(fd, sys::event::inout), s);
+	} else {
+		this->_shards[shard-1]->add_client(s);
+	}
 	fire_event_kernels<router_type>(
 		socket_pipeline_event::add_client,
 		vaddr
@@ -773,7 +1594,18 @@ bsc::socket_pipeline<T,S,R>
 	lock_type lock(this->_mutex);
 	client_iterator result = this->_clients.find(addr);
 	if (result != this->_clients.end()) {
-		result->second->setstate(pipeline_state::stopped);
+		this->stop_client(result->second);
+	}
+}
+
+template <class T, class S, class R>
+void
+bsc::socket_pipeline<T,S,R>
+::stop_client(const event_handler_ptr& client) {
+	if (client->shard() == 0) {
+		client->setstate(pipeline_state::stopped);
+	} else {
+		this->_shards[client->shard()-1]->stop_client(client);
 	}
 }
 
@@ -791,6 +1623,29 @@ bsc::socket_pipeline<T,S,R>
 	}
 }
 
+template <class T, class S, class R>
+void
+bsc::socket_pipeline<T,S,R>
+::set_client_load(const sys::socket_address& addr, size_t load) {
+	lock_type lock(this->_mutex);
+	client_iterator result = this->_clients.find(addr);
+	if (result != this->_clients.end()) {
+		result->second->peer_load(load);
+	}
+}
+
+template <class T, class S, class R>
+void
+bsc::socket_pipeline<T,S,R>
+::set_hierarchy_link(const sys::socket_address& addr, bool rhs) {
+	lock_type lock(this->_mutex);
+	if (rhs) {
+		this->_links.insert(addr);
+	} else {
+		this->_links.erase(addr);
+	}
+}
+
 template <class T, class S, class R>
 void
 bsc::socket_pipeline<T,S,R>
@@ -804,6 +1659,15 @@ bsc::socket_pipeline<T,S,R>
 	for (const client_pair& val : this->_clients) {
 		this->log("client _, handler _", val.first, *val.second);
 	}
+	this->log(
+		"queue high water mark _, max. deferred kernels _, shards _, "
+		"routing _, load _",
+		this->high_water_mark(),
+		this->_ndeferred,
+		this->num_shards(),
+		this->_policy,
+		this->load()
+	);
 }
 
 template class bsc::socket_pipeline<
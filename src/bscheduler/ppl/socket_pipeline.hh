@@ -1,8 +1,12 @@
 #ifndef BSCHEDULER_PPL_SOCKET_PIPELINE_HH
 #define BSCHEDULER_PPL_SOCKET_PIPELINE_HH
 
+#include <atomic>
+#include <deque>
 #include <iosfwd>
+#include <memory>
 #include <unordered_map>
+#include <unordered_set>
 #include <vector>
 
 #include <unistdx/base/log_message>
@@ -10,6 +14,7 @@
 #include <unistdx/net/socket_address>
 #include <unistdx/net/interface_address>
 
+#include <bscheduler/kernel/kernel_frame.hh>
 #include <bscheduler/kernel/kernel_instance_registry.hh>
 #include <bscheduler/kernel/kstream.hh>
 #include <bscheduler/ppl/basic_socket_pipeline.hh>
@@ -17,6 +22,20 @@
 
 namespace bsc {
 
+	/// How upstream kernels are distributed between clients and localhost.
+	enum class routing_policy {
+		/// Weighted round-robin, the weight is the number of nodes behind a client.
+		round_robin,
+		/// The client with the smallest load per node.
+		least_loaded
+	};
+
+	std::ostream&
+	operator<<(std::ostream& out, routing_policy rhs);
+
+	std::istream&
+	operator>>(std::istream& in, routing_policy& rhs);
+
 	template <class K, class S, class R>
 	class local_server;
 
@@ -26,6 +45,9 @@ namespace bsc {
 	template <class K, class S, class R>
 	class socket_notify_handler;
 
+	template <class K, class S, class R>
+	class socket_shard;
+
 	template<class K, class S, class R>
 	class socket_pipeline: public basic_socket_pipeline<K> {
 
@@ -47,6 +69,7 @@ namespace bsc {
 		using typename base_pipeline::duration;
 
 	private:
+		using typename base_pipeline::static_lock_type;
 		typedef remote_client_type event_handler_type;
 		typedef std::shared_ptr<event_handler_type> event_handler_ptr;
 		typedef sys::ipaddr_traits<addr_type> traits_type;
@@ -63,6 +86,11 @@ namespace bsc {
 		typedef event_handler_type client_type;
 		typedef event_handler_ptr client_ptr;
 		typedef uint32_t weight_type;
+		typedef socket_shard<K,S,R> shard_type;
+		typedef std::unique_ptr<shard_type> shard_ptr;
+		typedef std::vector<shard_ptr> shard_container_type;
+		typedef kernel_frame<K> frame_type;
+		typedef std::shared_ptr<const frame_type> frame_ptr;
 
 	private:
 		server_container_type _servers;
@@ -77,12 +105,45 @@ namespace bsc {
 		std::chrono::milliseconds _socket_timeout = std::chrono::seconds(7);
 		id_type _counter = 0;
 		bool _uselocalhost = true;
+		/// The maximal number of kernels in flight per client (0 means unbounded).
+		size_t _client_capacity = 0;
+		/// The maximal number of kernels deferred at once because of full clients.
+		size_t _ndeferred = 0;
+		/// Minimal size of compressed packets (0 disables compression).
+		size_t _compression_threshold = 0;
+		/// Maximal size of decompressed incoming packets.
+		size_t _max_packet_size = size_t(1) << 26;
+		/// Whether kernels are written in compact encoding.
+		bool _compact_encoding = false;
+		/// Whether kernels with the same header are written in one packet.
+		bool _batch_kernels = false;
+		/// Event loops of all threads except the first one.
+		shard_container_type _shards;
+		/// The number of clients that were assigned to the shards.
+		size_t _nassigned = 0;
+		routing_policy _policy = routing_policy::round_robin;
+		/// The number of kernels waiting for execution on this node
+		/// including the ones that were sent there in this loop iteration.
+		size_t _localload = 0;
+		/// The number of kernels queued or in flight on this node.
+		std::atomic<size_t> _load{0};
+		/// Whether received broadcast kernels are relayed to other clients.
+		bool _relay = false;
+		/// The principal and subordinates of this node.
+		std::unordered_set<sys::socket_address> _links;
+		/// Identifiers of recently relayed broadcast kernels.
+		std::unordered_set<id_type> _broadcasts;
+		/// The same identifiers in the order of arrival.
+		std::deque<id_type> _broadcast_order;
+		/// The maximal number of unflushed bytes per client
+		/// before kernels are queued (0 disables the queue).
+		size_t _bulk_limit = 4096*64;
 
 	public:
 
 		socket_pipeline();
 
-		~socket_pipeline() = default;
+		~socket_pipeline();
 
 		socket_pipeline(const socket_pipeline&) = delete;
 
@@ -106,6 +167,20 @@ namespace bsc {
 		void
 		set_client_weight(const sys::socket_address& addr, weight_type new_weight);
 
+		/// Set the load that was reported by the node behind the client.
+		void
+		set_client_load(const sys::socket_address& addr, size_t load);
+
+		/**
+		\brief Mark the node as the principal or a subordinate
+		of this node, or remove the mark.
+		\details
+		Relayed broadcast kernels are sent to the marked nodes only.
+		The mark does not depend on the connection to the node.
+		*/
+		void
+		set_hierarchy_link(const sys::socket_address& addr, bool rhs);
+
 		void
 		add_server(const ifaddr_type& rhs) {
 			this->add_server(
@@ -145,6 +220,218 @@ namespace bsc {
 			this->_uselocalhost = b;
 		}
 
+		/**
+		\brief Limit the number of kernels that were sent to a client
+		and have not returned yet.
+		\details
+		Upstream kernels for clients that reached the limit stay in the queue
+		until some kernels return. Zero means no limit (the default).
+		*/
+		inline void
+		set_client_capacity(size_t rhs) noexcept {
+			this->_client_capacity = rhs;
+		}
+
+		inline size_t
+		client_capacity() const noexcept {
+			return this->_client_capacity;
+		}
+
+		/**
+		\brief Compress packets with payload of at least \p rhs bytes.
+		\details
+		Packets are compressed only after the other side has listed
+		compression in its handshake, so that peers that do not negotiate
+		features receive uncompressed packets. The other side decompresses
+		packets regardless of its own threshold. Zero disables compression
+		(the default). Applies to new connections.
+		*/
+		inline void
+		set_compression_threshold(size_t rhs) noexcept {
+			this->_compression_threshold = rhs;
+		}
+
+		inline size_t
+		compression_threshold() const noexcept {
+			return this->_compression_threshold;
+		}
+
+		/**
+		\brief Reject compressed packets that decompress into more
+		than \p rhs bytes.
+		\details
+		Packets that are larger than this limit are sent uncompressed.
+		Applies to new connections.
+		*/
+		inline void
+		set_max_packet_size(size_t rhs) noexcept {
+			this->_max_packet_size = rhs;
+		}
+
+		inline size_t
+		max_packet_size() const noexcept {
+			return this->_max_packet_size;
+		}
+
+		/**
+		\brief Write kernel headers and ids in compact encoding.
+		\details
+		Compact encoding is used only after the other side has listed it
+		in its handshake, so that old peers keep receiving fixed-width fields.
+		Packets with kernels that carry their parent are always written
+		in fixed-width encoding. Applies to new connections.
+		*/
+		inline void
+		set_compact_encoding(bool rhs) noexcept {
+			this->_compact_encoding = rhs;
+		}
+
+		inline bool
+		compact_encoding() const noexcept {
+			return this->_compact_encoding;
+		}
+
+		/**
+		\brief Write kernels with the same header in one packet.
+		\details
+		Kernels are batched only after the other side has listed batches
+		in its handshake, so that old peers receive one kernel per packet.
+		Disabled by default. Applies to new connections.
+		*/
+		inline void
+		set_batch_kernels(bool rhs) noexcept {
+			this->_batch_kernels = rhs;
+		}
+
+		inline bool
+		batch_kernels() const noexcept {
+			return this->_batch_kernels;
+		}
+
+		/**
+		\brief Select how upstream kernels are distributed.
+		\details
+		With \c least_loaded policy each kernel goes to the client
+		with the smallest load divided by the number of nodes behind the client,
+		or to localhost, if its queue is shorter. The load of a client is
+		the number of kernels in flight to it plus the load that the other side
+		reported in the last packet or hierarchy message. Nodes with this policy
+		attach their load to packets for the nodes that listed
+		\link wire_feature::node_load\endlink in their handshake; other nodes
+		are ranked by the number of kernels in flight only.
+		Must be called before \link start\endlink.
+		*/
+		inline void
+		set_routing_policy(routing_policy rhs) noexcept {
+			this->_policy = rhs;
+		}
+
+		inline routing_policy
+		routing() const noexcept {
+			return this->_policy;
+		}
+
+		/**
+		\brief Relay broadcast kernels to all nodes of the cluster.
+		\details
+		Each broadcast kernel is serialized once per node and is written
+		to the principal and subordinates of this node
+		(\link set_hierarchy_link\endlink) except the one it came from.
+		This relays the kernel down and up the hierarchy tree with
+		the number of sends per node proportional to the fanout; other
+		connections (e.g. to the nodes that are being probed) do not receive
+		it. Duplicates are recognized by the kernel id and dropped.
+		Received broadcast kernels are executed locally as before.
+		Without relaying broadcast kernels are written to all clients.
+		Must be called before \link start\endlink.
+		*/
+		inline void
+		set_relay_broadcasts(bool rhs) noexcept {
+			this->_relay = rhs;
+		}
+
+		inline bool
+		relays_broadcasts() const noexcept {
+			return this->_relay;
+		}
+
+		/**
+		\brief Let control kernels overtake bulk kernels on each connection.
+		\details
+		Kernels with normal and low priority are serialized only when
+		the output buffer of the client has less than \p rhs bytes,
+		the rest wait in the queue of the client. Kernels with high priority
+		(probes and hierarchy updates) bypass the queue, hence they wait
+		for at most \p rhs bytes plus one bulk kernel to be written.
+		Unsent bytes in the socket buffer count towards the limit
+		(\c SIOCOUTQNSD), and \c TCP_NOTSENT_LOWAT delays the wakeup
+		for writing until they drop below it.
+		Zero disables the queue. Must be called before \link start\endlink.
+		*/
+		inline void
+		set_bulk_output_limit(size_t rhs) noexcept {
+			this->_bulk_limit = rhs;
+		}
+
+		inline size_t
+		bulk_output_limit() const noexcept {
+			return this->_bulk_limit;
+		}
+
+		/// Returns the number of kernels queued or in flight on this node.
+		inline size_t
+		load() const noexcept {
+			return this->_load.load(std::memory_order_relaxed);
+		}
+
+		/**
+		\brief Serve connections with \p n event-loop threads.
+		\details
+		Each thread has its own poller and owns a subset of connections
+		(shard): new connections are assigned to the shards in round-robin
+		order starting from the second thread. The first thread also owns
+		listening sockets and routes all kernels, passing them to the thread
+		that owns the destination connection. Must be called before
+		\link start\endlink.
+		*/
+		void
+		set_num_shards(unsigned n);
+
+		/**
+		\brief Select the backend that waits for events in the first thread
+		and all shards.
+		\details
+		Reads and writes are plain system calls with either backend.
+		*/
+		io_backend
+		set_io_backend(io_backend rhs);
+
+		/// Coalesce writes in the first thread and all shards.
+		void
+		set_write_coalescing(const duration& latency, size_t threshold);
+
+		/// Returns write counters of all threads.
+		write_stats
+		get_write_stats();
+
+		/// Returns write counters of the thread with index \p shard.
+		write_stats
+		get_write_stats(unsigned shard);
+
+		inline unsigned
+		num_shards() const noexcept {
+			return this->_shards.size() + 1;
+		}
+
+		void
+		start();
+
+		void
+		stop();
+
+		void
+		wait();
+
 		void
 		remove_server(const ifaddr_type& interface_address);
 
@@ -178,6 +465,18 @@ namespace bsc {
 		void
 		find_next_client();
 
+		/**
+		\brief Point the iterator to the least loaded client that is not full,
+		or to the end for localhost.
+		\return false, if all clients are full and localhost is not allowed
+		*/
+		bool
+		find_least_loaded_client(bool localhost);
+
+		/// Sample the load of this node once per loop iteration.
+		void
+		update_load();
+
 		inline bool
 		end_reached() const noexcept {
 			return this->_iterator == this->_clients.end();
@@ -218,9 +517,47 @@ namespace bsc {
 		void
 		process_kernels() override;
 
-		void
+		/// Returns false, if the kernel can not be sent yet.
+		bool
 		process_kernel(kernel_type* k);
 
+		/// Send the kernel from the thread that owns the client.
+		void
+		send_to(const event_handler_ptr& client, kernel_type* k);
+
+		void
+		send_to(const event_handler_ptr& client, const frame_ptr& frame);
+
+		/// Serialize the kernel once and send it to all clients.
+		void
+		broadcast(kernel_type* k);
+
+		/// Returns false, if the broadcast kernel has already been relayed.
+		bool
+		remember_broadcast(id_type id);
+
+		void
+		forward_to(const event_handler_ptr& client, foreign_kernel* hdr);
+
+		/// Stop the client from the thread that owns it.
+		void
+		stop_client(const event_handler_ptr& client);
+
+		/// Advance round-robin iterator to the first client that is not full.
+		bool
+		skip_full_clients();
+
+		/**
+		\brief Route the kernels that were deferred because of full clients.
+		\details
+		Called by the clients from any thread when they drop below
+		their capacity.
+		*/
+		inline void
+		retry_deferred_kernels() {
+			this->poller().notify_one();
+		}
+
 		event_handler_ptr
 		find_or_create_client(const sys::socket_address& addr);
 
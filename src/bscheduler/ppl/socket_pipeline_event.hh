@@ -29,7 +29,11 @@ namespace bsc {
 		sys::socket_address _endpoint;
 
 	public:
-		socket_pipeline_kernel() = default;
+		inline
+		socket_pipeline_kernel() {
+			this->priority(kernel_priority::high);
+		}
+
 		socket_pipeline_kernel(const socket_pipeline_kernel&) = default;
 
 		inline
@@ -39,6 +43,7 @@ namespace bsc {
 		):
 		_event(event),
 		_ifaddr(interface_address) {
+			this->priority(kernel_priority::high);
 			assert(
 				event == socket_pipeline_event::add_server ||
 				event == socket_pipeline_event::remove_server
@@ -53,6 +58,7 @@ namespace bsc {
 		_event(event),
 		_endpoint(socket_address)
 		{
+			this->priority(kernel_priority::high);
 			assert(
 				event == socket_pipeline_event::add_client ||
 				event == socket_pipeline_event::remove_client
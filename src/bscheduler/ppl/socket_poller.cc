@@ -0,0 +1,295 @@
+#include "socket_poller.hh"
+
+#include <cerrno>
+#include <istream>
+#include <ostream>
+#include <stdexcept>
+#include <string>
+
+#include <fcntl.h>
+#include <sys/epoll.h>
+#include <unistd.h>
+
+#include <unistdx/base/bad_call>
+#include <unistdx/base/check>
+#include <unistdx/base/log_message>
+
+namespace {
+
+	/// The maximal number of submissions in one batch.
+	constexpr const unsigned ring_size = 256;
+
+	/// User data of poll removal requests.
+	constexpr const std::uint64_t remove_tag = ~std::uint64_t(0);
+
+	/// Poll requests are identified by the file descriptor and its generation
+	/// (zero for the notification pipe).
+	inline std::uint64_t
+	make_user_data(int fd, std::uint32_t generation) noexcept {
+		return (std::uint64_t(generation) << 32) | std::uint32_t(fd);
+	}
+
+	inline int
+	user_data_fd(std::uint64_t x) noexcept {
+		return int(std::uint32_t(x));
+	}
+
+	inline std::uint32_t
+	user_data_generation(std::uint64_t x) noexcept {
+		return std::uint32_t(x >> 32);
+	}
+
+	inline std::uint32_t
+	poll_events(const sys::epoll_event& ev) noexcept {
+		std::uint32_t events = EPOLLRDHUP;
+		if (ev.in()) {
+			events |= EPOLLIN;
+		}
+		if (ev.out()) {
+			events |= EPOLLOUT;
+		}
+		return events;
+	}
+
+}
+
+std::ostream&
+bsc::operator<<(std::ostream& out, io_backend rhs) {
+	switch (rhs) {
+		case io_backend::epoll: out << "epoll"; break;
+		case io_backend::io_uring: out << "io_uring"; break;
+	}
+	return out;
+}
+
+std::istream&
+bsc::operator>>(std::istream& in, io_backend& rhs) {
+	std::string s;
+	in >> s;
+	if (s == "epoll") {
+		rhs = io_backend::epoll;
+	} else if (s == "io_uring") {
+		rhs = io_backend::io_uring;
+	} else {
+		throw std::invalid_argument("bad io backend");
+	}
+	return in;
+}
+
+bsc::socket_poller
+::~socket_poller() {
+	this->close_ring();
+}
+
+bool
+bsc::socket_poller
+::set_backend(io_backend rhs) {
+	if (rhs == this->_backend) {
+		return true;
+	}
+	if (rhs == io_backend::io_uring) {
+		if (!this->open_ring()) {
+			return false;
+		}
+		for (const auto& pair : this->_entries) {
+			this->_epoll.erase(pair.first);
+			this->add_change(pair.first, pair.second, true);
+		}
+	} else {
+		this->close_ring();
+		for (const auto& pair : this->_entries) {
+			this->_epoll.insert(pair.second.event);
+		}
+	}
+	this->_backend = rhs;
+	return true;
+}
+
+bool
+bsc::socket_poller
+::open_ring() {
+	try {
+		io_uring ring(ring_size);
+		// multishot poll and wait timeout
+		#if defined(IORING_FEAT_RSRC_TAGS) && defined(IORING_FEAT_EXT_ARG)
+		const unsigned required = IORING_FEAT_RSRC_TAGS | IORING_FEAT_EXT_ARG;
+		#else
+		const unsigned required = ~0u;
+		#endif
+		if (!ring.has_features(required)) {
+			return false;
+		}
+		UNISTDX_CHECK(::pipe2(this->_pipe, O_NONBLOCK | O_CLOEXEC));
+		this->_ring = std::move(ring);
+	} catch (const sys::bad_call& err) {
+		sys::log_message("poller", "io_uring: _", err.what());
+		return false;
+	}
+	this->_changes.push_back({
+		this->_pipe[0],
+		EPOLLIN,
+		make_user_data(this->_pipe[0], 0),
+		true
+	});
+	return true;
+}
+
+void
+bsc::socket_poller
+::close_ring() noexcept {
+	this->_ring.close();
+	this->_changes.clear();
+	for (fd_type& fd : this->_pipe) {
+		if (fd != -1) {
+			::close(fd);
+			fd = -1;
+		}
+	}
+}
+
+void
+bsc::socket_poller
+::insert(const event_type& ev) {
+	entry e{ev, ++this->_generation, 0, 0, 0};
+	if (e.generation == 0) {
+		// zero is reserved for the notification pipe
+		e.generation = ++this->_generation;
+	}
+	auto result = this->_entries.find(ev.fd());
+	if (result != this->_entries.end()) {
+		this->erase(ev.fd());
+	}
+	this->_entries.emplace(ev.fd(), e);
+	if (this->_backend == io_backend::epoll) {
+		this->_epoll.insert(ev);
+	} else {
+		this->add_change(ev.fd(), e, true);
+		// the thread may wait for events with the old set of file descriptors
+		this->notify_one();
+	}
+}
+
+void
+bsc::socket_poller
+::erase(fd_type fd) {
+	auto result = this->_entries.find(fd);
+	if (result == this->_entries.end()) {
+		return;
+	}
+	if (this->_backend == io_backend::epoll) {
+		this->_epoll.erase(fd);
+	} else {
+		this->add_change(fd, result->second, false);
+	}
+	this->_entries.erase(result);
+}
+
+void
+bsc::socket_poller
+::notify_one() noexcept {
+	if (this->_backend == io_backend::epoll) {
+		this->_epoll.notify_one();
+	} else {
+		const char ch = 0;
+		// the pipe is full only if the thread has not consumed
+		// previous notifications yet, so errors are ignored
+		ssize_t ret = ::write(this->_pipe[1], &ch, 1);
+		static_cast<void>(ret);
+	}
+}
+
+void
+bsc::socket_poller
+::copy_epoll_events() {
+	this->_events.assign(this->_epoll.begin(), this->_epoll.end());
+}
+
+void
+bsc::socket_poller
+::add_change(fd_type fd, const entry& e, bool add) {
+	this->_changes.push_back({
+		fd,
+		poll_events(e.event),
+		make_user_data(fd, e.generation),
+		add
+	});
+}
+
+void
+bsc::socket_poller
+::prepare_changes() {
+	for (const change& c : this->_changes) {
+		while (!(c.add
+			? this->_ring.prepare_poll(c.fd, c.events, c.user_data, true)
+			: this->_ring.prepare_poll_remove(c.user_data, remove_tag))) {
+			// the queue is full, submit without waiting
+			this->_ring.submit();
+		}
+	}
+	this->_changes.clear();
+}
+
+void
+bsc::socket_poller
+::collect_ring_events() {
+	++this->_iteration;
+	this->_events.clear();
+	this->_ring.for_each_completion(
+		[this] (const io_uring::completion_type& cqe) {
+			this->process_completion(cqe);
+		}
+	);
+}
+
+void
+bsc::socket_poller
+::process_completion(const io_uring::completion_type& cqe) {
+	if (cqe.user_data == remove_tag) {
+		return;
+	}
+	const fd_type fd = user_data_fd(cqe.user_data);
+	const std::uint32_t generation = user_data_generation(cqe.user_data);
+	const bool more = cqe.flags & IORING_CQE_F_MORE;
+	if (generation == 0) {
+		// notification pipe
+		if (!more) {
+			this->_changes.push_back({fd, EPOLLIN, cqe.user_data, true});
+		}
+		this->_events.emplace_back(fd, sys::event::in);
+		return;
+	}
+	auto result = this->_entries.find(fd);
+	if (result == this->_entries.end() ||
+		result->second.generation != generation) {
+		// the file descriptor was removed or replaced
+		return;
+	}
+	if (cqe.res < 0) {
+		if (cqe.res == -ECANCELED) {
+			this->add_change(fd, result->second, true);
+		} else {
+			this->add_event(fd, result->second, EPOLLERR);
+		}
+		return;
+	}
+	if (!more) {
+		// multishot poll was terminated by the kernel
+		this->add_change(fd, result->second, true);
+	}
+	this->add_event(fd, result->second, std::uint32_t(cqe.res));
+}
+
+void
+bsc::socket_poller
+::add_event(fd_type fd, entry& e, std::uint32_t events) {
+	if (e.iteration == this->_iteration) {
+		// merge events for the same file descriptor, like epoll does
+		e.revents |= events;
+		this->_events[e.index] = event_type(fd, sys::event(e.revents));
+	} else {
+		e.iteration = this->_iteration;
+		e.index = this->_events.size();
+		e.revents = events;
+		this->_events.emplace_back(fd, sys::event(events));
+	}
+}
@@ -0,0 +1,223 @@
+#ifndef BSCHEDULER_PPL_SOCKET_POLLER_HH
+#define BSCHEDULER_PPL_SOCKET_POLLER_HH
+
+#include <chrono>
+#include <cstdint>
+#include <iosfwd>
+#include <unordered_map>
+#include <vector>
+
+#include <time.h>
+
+#include <unistdx/io/epoll_event>
+#include <unistdx/io/poller>
+
+#include <bscheduler/base/io_uring.hh>
+
+namespace bsc {
+
+	/// System interface that waits for events on file descriptors.
+	enum class io_backend {
+		epoll,
+		io_uring
+	};
+
+	std::ostream&
+	operator<<(std::ostream& out, io_backend rhs);
+
+	std::istream&
+	operator>>(std::istream& in, io_backend& rhs);
+
+	/**
+	\brief Event poller with the backend that is selected at run time.
+	\details
+	The interface is the same as for \c sys::event_poller. The \c epoll
+	backend delegates all calls to \c sys::event_poller. The \c io_uring
+	backend polls each file descriptor with multishot poll request
+	(that is edge-triggered like \c epoll) and passes all changes
+	to the set of polled file descriptors to the kernel in a single batch
+	together with the wait for events, i.e. one system call per loop
+	iteration.
+
+	Only waiting for events goes through \c io_uring. Handlers still read
+	and write their buffers with \c read and \c write system calls, and no
+	buffers are registered with the ring, so the number of system calls
+	per transferred byte is the same for both backends.
+	*/
+	class socket_poller {
+
+	public:
+		typedef sys::epoll_event event_type;
+		typedef std::vector<event_type> event_container;
+		typedef event_container::const_iterator const_iterator;
+		typedef sys::fd_type fd_type;
+
+	private:
+		typedef io_uring::user_data_type user_data_type;
+
+		struct entry {
+			event_type event;
+			std::uint32_t generation;
+			/// The loop iteration that produced the last event.
+			std::uint64_t iteration;
+			/// The position of the last event in the event container.
+			size_t index;
+			/// Events that were returned in the last loop iteration.
+			std::uint32_t revents;
+		};
+
+		struct change {
+			fd_type fd;
+			std::uint32_t events;
+			user_data_type user_data;
+			bool add;
+		};
+
+		typedef std::unordered_map<fd_type,entry> entry_container;
+		typedef std::vector<change> change_container;
+
+	private:
+		io_backend _backend = io_backend::epoll;
+		sys::event_poller _epoll;
+		io_uring _ring;
+		/// Notification pipe of \c io_uring backend.
+		fd_type _pipe[2] = {-1, -1};
+		/// All polled file descriptors.
+		entry_container _entries;
+		/// Changes that were not submitted to \c io_uring yet.
+		change_container _changes;
+		event_container _events;
+		std::uint32_t _generation = 0;
+		std::uint64_t _iteration = 0;
+
+	public:
+
+		socket_poller() = default;
+
+		~socket_poller();
+
+		socket_poller(const socket_poller&) = delete;
+
+		socket_poller&
+		operator=(const socket_poller&) = delete;
+
+		/**
+		\brief Switch to \p rhs backend and move all polled file descriptors to it.
+		\return false, if the backend is not supported by the kernel
+		and the old one is kept
+		*/
+		bool
+		set_backend(io_backend rhs);
+
+		inline io_backend
+		backend() const noexcept {
+			return this->_backend;
+		}
+
+		void
+		insert(const event_type& ev);
+
+		void
+		erase(fd_type fd);
+
+		template <class Lock>
+		void
+		wait(Lock& lock) {
+			if (this->_backend == io_backend::epoll) {
+				this->_epoll.wait(lock);
+				this->copy_epoll_events();
+			} else {
+				this->wait_ring(lock, nullptr);
+			}
+		}
+
+		template <class Lock, class Clock, class Duration>
+		void
+		wait_until(
+			Lock& lock,
+			const std::chrono::time_point<Clock,Duration>& tp
+		) {
+			if (this->_backend == io_backend::epoll) {
+				this->_epoll.wait_until(lock, tp);
+				this->copy_epoll_events();
+			} else {
+				using namespace std::chrono;
+				const auto now = Clock::now();
+				const auto ns = tp > now
+					? duration_cast<nanoseconds>(tp - now).count()
+					: 0;
+				::timespec timeout{};
+				timeout.tv_sec = ns / 1000000000L;
+				timeout.tv_nsec = ns % 1000000000L;
+				this->wait_ring(lock, &timeout);
+			}
+		}
+
+		/// Wake up the thread that waits for events.
+		void
+		notify_one() noexcept;
+
+		/// Returns the file descriptor of notification pipe.
+		inline fd_type
+		pipe_in() const noexcept {
+			return this->_backend == io_backend::epoll
+				? this->_epoll.pipe_in()
+				: this->_pipe[0];
+		}
+
+		inline const_iterator
+		begin() const noexcept {
+			return this->_events.begin();
+		}
+
+		inline const_iterator
+		end() const noexcept {
+			return this->_events.end();
+		}
+
+	private:
+
+		template <class Lock>
+		void
+		wait_ring(Lock& lock, const ::timespec* timeout) {
+			this->prepare_changes();
+			lock.unlock();
+			try {
+				this->_ring.submit(1, timeout);
+			} catch (...) {
+				lock.lock();
+				throw;
+			}
+			lock.lock();
+			this->collect_ring_events();
+		}
+
+		void
+		copy_epoll_events();
+
+		bool
+		open_ring();
+
+		void
+		close_ring() noexcept;
+
+		void
+		add_change(fd_type fd, const entry& e, bool add);
+
+		void
+		prepare_changes();
+
+		void
+		collect_ring_events();
+
+		void
+		process_completion(const io_uring::completion_type& cqe);
+
+		void
+		add_event(fd_type fd, entry& e, std::uint32_t events);
+
+	};
+
+}
+
+#endif // vim:filetype=cpp
@@ -0,0 +1,43 @@
+#include "timing_wheel_pipeline.hh"
+
+#include <vector>
+
+#include <bscheduler/config.hh>
+#include <bscheduler/base/queue_pusher.hh>
+#include <bscheduler/kernel/foreign_kernel.hh>
+#include <bscheduler/ppl/basic_router.hh>
+
+template <class T, class R>
+void
+bsc::timing_wheel_pipeline<T,R>::do_run() {
+	typedef typename kernel_type::clock_type clock_type;
+	typedef typename kernel_type::time_point time_point;
+	std::vector<kernel_type*> due;
+	lock_type lock(this->_mutex);
+	while (!this->has_stopped()) {
+		this->_wheel.advance(clock_type::now(), std::back_inserter(due));
+		if (!due.empty()) {
+			lock.unlock();
+			for (kernel_type* k : due) {
+				k->at(time_point(duration::zero()));
+				router_type::send_local(k);
+			}
+			due.clear();
+			lock.lock();
+			continue;
+		}
+		this->_changed = false;
+		auto pred = [this] () { return this->has_stopped() || this->_changed; };
+		if (this->_wheel.empty()) {
+			this->_semaphore.wait(lock, pred);
+		} else {
+			this->_semaphore.wait_until(lock, this->_wheel.next_expiry(), pred);
+		}
+	}
+	// kernels are deleted by the base class
+	this->_wheel.clear(queue_pusher(this->_kernels));
+}
+
+template class bsc::timing_wheel_pipeline<
+	BSCHEDULER_KERNEL_TYPE,
+	bsc::basic_router<BSCHEDULER_KERNEL_TYPE>>;
@@ -0,0 +1,107 @@
+#ifndef BSCHEDULER_PPL_TIMING_WHEEL_PIPELINE_HH
+#define BSCHEDULER_PPL_TIMING_WHEEL_PIPELINE_HH
+
+#include <chrono>
+
+#include <bscheduler/base/timing_wheel.hh>
+#include <bscheduler/ppl/basic_pipeline.hh>
+
+namespace bsc {
+
+	/**
+	\brief Timer pipeline based on \link timing_wheel\endlink.
+	\details
+	Scheduled kernels are inserted in the wheel in \f$O(1)\f$. When
+	kernels are due, the timer thread resets their schedule and sends
+	them to the local pipelines via the router instead of executing them
+	itself, so that long \c act() calls do not delay other timers.
+	Kernels with ids can be cancelled.
+	*/
+	template<class T, class Router>
+	class timing_wheel_pipeline: public basic_pipeline<T> {
+
+	public:
+		typedef basic_pipeline<T> base_pipeline;
+		typedef Router router_type;
+		using typename base_pipeline::kernel_type;
+		using typename base_pipeline::lock_type;
+		typedef timing_wheel<T> wheel_type;
+		typedef typename wheel_type::duration duration;
+		typedef typename wheel_type::id_type id_type;
+
+	private:
+		wheel_type _wheel;
+		/// Set when kernels are added or removed.
+		bool _changed = false;
+
+	public:
+
+		inline
+		timing_wheel_pipeline(timing_wheel_pipeline&& rhs) noexcept:
+		base_pipeline(std::move(rhs)),
+		_wheel(std::move(rhs._wheel))
+		{}
+
+		inline
+		timing_wheel_pipeline():
+		timing_wheel_pipeline(std::chrono::milliseconds(1))
+		{}
+
+		/// Construct the pipeline with timer resolution \p tick.
+		inline explicit
+		timing_wheel_pipeline(duration tick):
+		base_pipeline(1u),
+		_wheel(tick)
+		{}
+
+		timing_wheel_pipeline(const timing_wheel_pipeline&) = delete;
+
+		timing_wheel_pipeline&
+		operator=(const timing_wheel_pipeline&) = delete;
+
+		~timing_wheel_pipeline() = default;
+
+		void
+		send(kernel_type* k) {
+			#ifndef NDEBUG
+			this->log("send _", *k);
+			#endif
+			lock_type lock(this->_mutex);
+			this->_wheel.insert(k);
+			this->update_high_water_mark(this->_wheel.size());
+			this->_changed = true;
+			this->_semaphore.notify_one();
+		}
+
+		void
+		send(kernel_type** kernels, size_t n) {
+			lock_type lock(this->_mutex);
+			for (size_t i=0; i<n; ++i) {
+				this->_wheel.insert(kernels[i]);
+			}
+			this->update_high_water_mark(this->_wheel.size());
+			this->_changed = true;
+			this->_semaphore.notify_one();
+		}
+
+		/**
+		\brief Remove scheduled kernel with the specified id.
+		\return the kernel or nullptr, if it was not found or has
+		already been sent to the local pipelines
+		*/
+		kernel_type*
+		cancel(id_type id) {
+			lock_type lock(this->_mutex);
+			return this->_wheel.remove(id);
+		}
+
+	protected:
+
+		void
+		do_run() override;
+
+	};
+
+}
+
+#endif // vim:filetype=cpp
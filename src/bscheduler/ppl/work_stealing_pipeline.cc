@@ -0,0 +1,123 @@
+#include "work_stealing_pipeline.hh"
+#include "config.hh"
+
+#include <bscheduler/kernel/act.hh>
+#include <unistdx/util/backtrace>
+
+template <class T>
+bsc::work_stealing_pipeline<T>::~work_stealing_pipeline() {
+	// move kernels that were not executed to the shared queue,
+	// so that base class destructor deletes them
+	for (deque_ptr& d : this->_deques) {
+		if (d) {
+			this->return_kernels(*d);
+		}
+	}
+}
+
+template <class T>
+void
+bsc::work_stealing_pipeline<T>::run(Thread_context* context) {
+	_thisindex = this->_nstarted++;
+	base_pipeline::run(context);
+}
+
+template <class T>
+void
+bsc::work_stealing_pipeline<T>::do_run() {
+	deque_type& local = this->local_deque();
+	engine_type rng(_thisindex + 1);
+	kernel_type* k = nullptr;
+	while (!this->has_stopped()) {
+		if (local.pop(k) || this->pop_shared(k) || this->steal(k, rng)) {
+			try {
+				::bsc::act(k);
+			} catch (...) {
+				sys::backtrace(2);
+				throw;
+			}
+		} else {
+			this->wait_for_kernels();
+		}
+	}
+	this->return_kernels(local);
+}
+
+template <class T>
+bool
+bsc::work_stealing_pipeline<T>::pop_shared(kernel_type*& k) {
+	lock_type lock(this->_mutex);
+	bool success = false;
+	if (!this->_kernels.empty()) {
+		k = traits_type::front(this->_kernels);
+		traits_type::pop(this->_kernels);
+		this->notify_not_full();
+		success = true;
+	}
+	return success;
+}
+
+template <class T>
+bool
+bsc::work_stealing_pipeline<T>::steal(kernel_type*& k, engine_type& rng) {
+	const size_t n = this->_deques.size();
+	if (n < 2) {
+		return false;
+	}
+	const size_t first = rng() % n;
+	for (size_t i=0; i<n; ++i) {
+		const size_t victim = (first + i) % n;
+		if (victim != _thisindex && this->_deques[victim]->steal(k)) {
+			return true;
+		}
+	}
+	return false;
+}
+
+template <class T>
+bool
+bsc::work_stealing_pipeline<T>::has_stealable_kernels() const noexcept {
+	for (const deque_ptr& d : this->_deques) {
+		if (!d->empty()) {
+			return true;
+		}
+	}
+	return false;
+}
+
+template <class T>
+void
+bsc::work_stealing_pipeline<T>::wait_for_kernels() {
+	lock_type lock(this->_mutex);
+	++this->_nidle;
+	// pairs with the fence in notify_idle_thread()
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+	this->_semaphore.wait(lock, [this] () {
+		return this->has_stopped() ||
+			!this->_kernels.empty() ||
+			this->has_stealable_kernels();
+	});
+	--this->_nidle;
+}
+
+template <class T>
+void
+bsc::work_stealing_pipeline<T>::notify_idle_thread() {
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+	if (this->_nidle.load(std::memory_order_relaxed) != 0) {
+		lock_type lock(this->_mutex);
+		this->_semaphore.notify_one();
+	}
+}
+
+template <class T>
+void
+bsc::work_stealing_pipeline<T>::return_kernels(deque_type& rhs) {
+	kernel_type* k = nullptr;
+	lock_type lock(this->_mutex);
+	while (rhs.pop(k)) {
+		traits_type::push(this->_kernels, k);
+	}
+}
+
+template class bsc::work_stealing_pipeline<BSCHEDULER_KERNEL_TYPE>;
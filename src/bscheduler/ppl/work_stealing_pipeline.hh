@@ -0,0 +1,168 @@
+#ifndef BSCHEDULER_PPL_WORK_STEALING_PIPELINE_HH
+#define BSCHEDULER_PPL_WORK_STEALING_PIPELINE_HH
+
+#include <atomic>
+#include <memory>
+#include <random>
+#include <vector>
+
+#include <bscheduler/base/work_stealing_deque.hh>
+#include <bscheduler/ppl/basic_pipeline.hh>
+
+namespace bsc {
+
+	/**
+	\brief Parallel pipeline with per-thread work-stealing deques.
+	\details
+	Kernels sent from one of the pipeline's own threads are pushed to
+	the thread-local deque and are executed in LIFO order, so that
+	recently spawned children run first and on the same core.
+	Kernels sent from other threads go to the shared queue inherited
+	from \link basic_pipeline\endlink. Idle threads steal kernels from
+	the deques of randomly chosen victims.
+	*/
+	template<class T>
+	class work_stealing_pipeline: public basic_pipeline<T> {
+
+	public:
+		typedef basic_pipeline<T> base_pipeline;
+		using typename base_pipeline::kernel_type;
+		using typename base_pipeline::lock_type;
+		using typename base_pipeline::traits_type;
+		typedef work_stealing_deque<kernel_type*> deque_type;
+
+	private:
+		typedef std::unique_ptr<deque_type> deque_ptr;
+		typedef std::vector<deque_ptr> deque_container;
+		typedef std::minstd_rand engine_type;
+
+	private:
+		deque_container _deques;
+		/// The number of threads waiting for kernels.
+		std::atomic<unsigned> _nidle {0};
+		/// The number of threads that have already started.
+		std::atomic<unsigned> _nstarted {0};
+
+		static thread_local unsigned _thisindex;
+
+	public:
+
+		inline
+		work_stealing_pipeline(work_stealing_pipeline&& rhs) noexcept:
+		base_pipeline(std::move(rhs)),
+		_deques(std::move(rhs._deques))
+		{}
+
+		inline
+		work_stealing_pipeline():
+		work_stealing_pipeline(1u)
+		{}
+
+		inline explicit
+		work_stealing_pipeline(unsigned concurrency):
+		base_pipeline(concurrency) {
+			for (unsigned i=0; i<this->concurrency(); ++i) {
+				this->_deques.emplace_back(new deque_type);
+			}
+		}
+
+		work_stealing_pipeline(const work_stealing_pipeline&) = delete;
+
+		work_stealing_pipeline&
+		operator=(const work_stealing_pipeline&) = delete;
+
+		~work_stealing_pipeline();
+
+		void
+		send(kernel_type* k) {
+			if (this->owns_this_thread()) {
+				#ifndef NDEBUG
+				this->log("send _", *k);
+				#endif
+				this->local_deque().push(k);
+				this->notify_idle_thread();
+			} else {
+				base_pipeline::send(k);
+			}
+		}
+
+		/// Kernels sent from the pipeline's own threads are never rejected.
+		bool
+		try_send(kernel_type* k) {
+			if (this->owns_this_thread()) {
+				this->send(k);
+				return true;
+			}
+			return base_pipeline::try_send(k);
+		}
+
+		void
+		send(kernel_type** kernels, size_t n) {
+			if (this->owns_this_thread()) {
+				deque_type& local = this->local_deque();
+				for (size_t i=0; i<n; ++i) {
+					local.push(kernels[i]);
+				}
+				this->notify_idle_thread();
+			} else {
+				base_pipeline::send(kernels, n);
+			}
+		}
+
+		/**
+		\brief Returns the number of kernels in the shared queue and
+		in the deques of all threads.
+		\details
+		The sizes of the deques are approximate, if the threads are running.
+		*/
+		inline size_t
+		num_kernels() const {
+			size_t result = base_pipeline::num_kernels();
+			for (const deque_ptr& d : this->_deques) {
+				result += d->size();
+			}
+			return result;
+		}
+
+	protected:
+
+		void
+		do_run() override;
+
+		void
+		run(Thread_context* context) override;
+
+	private:
+
+		inline deque_type&
+		local_deque() noexcept {
+			return *this->_deques[_thisindex];
+		}
+
+		bool
+		pop_shared(kernel_type*& k);
+
+		bool
+		steal(kernel_type*& k, engine_type& rng);
+
+		bool
+		has_stealable_kernels() const noexcept;
+
+		void
+		wait_for_kernels();
+
+		void
+		notify_idle_thread();
+
+		void
+		return_kernels(deque_type& rhs);
+
+	};
+
+	template <class T>
+	thread_local unsigned
+	work_stealing_pipeline<T>::_thisindex = 0;
+
+}
+
+#endif // vim:filetype=cpp
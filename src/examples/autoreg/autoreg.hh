@@ -7,6 +7,8 @@
 
 #include <unistdx/base/make_object>
 
+#include <bscheduler/kernel/array_io.hh>
+
 #include "domain.hh"
 #include "grid.hh"
 #include "mapreduce.hh"
@@ -18,22 +20,14 @@ namespace std {
 	template<class T>
 	sys::pstream&
 	operator<<(sys::pstream& out, const std::valarray<T>& rhs) {
-		out << uint32_t(rhs.size());
-		for (size_t i=0; i<rhs.size(); ++i) {
-			out << rhs[i];
-		}
+		bsc::write_array(out, rhs);
 		return out;
 	}
 
 	template<class T>
 	sys::pstream&
 	operator>>(sys::pstream& in, std::valarray<T>& rhs) {
-		uint32_t n = 0;
-		in >> n;
-		rhs.resize(n);
-		for (size_t i=0; i<rhs.size(); ++i) {
-			in >> rhs[i];
-		}
+		bsc::read_array(in, rhs);
 		return in;
 	}
 
@@ -1,6 +1,8 @@
 #ifndef EXAMPLES_AUTOREG_VECTOR_N_HH
 #define EXAMPLES_AUTOREG_VECTOR_N_HH
 
+#include <bscheduler/kernel/array_io.hh>
+
 namespace autoreg {
 
 	template <class T, size_t n>
@@ -156,13 +158,13 @@ namespace autoreg {
 
 		friend sys::pstream&
 		operator<<(sys::pstream& out, const Vector& rhs) {
-			for (size_t i=0; i<n; ++i) out << rhs.coord[i];
+			bsc::write_array(out, rhs.coord, n);
 			return out;
 		}
 
 		friend sys::pstream&
 		operator>>(sys::pstream& in, Vector& rhs) {
-			for (size_t i=0; i<n; ++i) in >> rhs.coord[i];
+			bsc::read_array(in, rhs.coord, n);
 			return in;
 		}
 
@@ -373,6 +375,22 @@ namespace autoreg {
 		return in;
 	}
 
+	/// Write \p count vectors as one array of coordinates.
+	template <class T, size_t n>
+	void
+	write_array(sys::pstream& out, const Vector<T, n>* data, size_t count) {
+		static_assert(sizeof(Vector<T, n>) == n*sizeof(T), "bad vector layout");
+		bsc::write_array(out, data->begin(), count*n);
+	}
+
+	/// Read \p count vectors as one array of coordinates.
+	template <class T, size_t n>
+	void
+	read_array(sys::pstream& in, Vector<T, n>* data, size_t count) {
+		static_assert(sizeof(Vector<T, n>) == n*sizeof(T), "bad vector layout");
+		bsc::read_array(in, data->begin(), count*n);
+	}
+
 }
 
 #endif // vim:filetype=cpp
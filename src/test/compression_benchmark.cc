@@ -0,0 +1,266 @@
+#include <chrono>
+#include <cmath>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <unistdx/io/fildesbuf>
+
+#include <bscheduler/kernel/kernel.hh>
+#include <bscheduler/kernel/kernel_type_registry.hh>
+#include <bscheduler/kernel/kernelbuf.hh>
+#include <bscheduler/kernel/kstream.hh>
+#include <bscheduler/kernel/ring_fildesbuf.hh>
+
+namespace {
+
+	typedef std::chrono::steady_clock clock_type;
+
+	/// Kernel with a piece of the surface similar to the output of autoreg example.
+	struct Surface_kernel: public bsc::kernel {
+
+		std::vector<float> _data;
+
+		void
+		write(sys::pstream& out) const override {
+			bsc::kernel::write(out);
+			out << uint32_t(this->_data.size());
+			out.write(
+				reinterpret_cast<const char*>(this->_data.data()),
+				this->_data.size()*sizeof(float)
+			);
+		}
+
+		void
+		read(sys::pstream& in) override {
+			bsc::kernel::read(in);
+			uint32_t n = 0;
+			in >> n;
+			this->_data.resize(n);
+			in.read(reinterpret_cast<char*>(this->_data.data()), n*sizeof(float));
+		}
+
+	};
+
+	std::vector<float>
+	make_data(const std::string& kind, size_t n) {
+		std::vector<float> result(n);
+		std::default_random_engine rng;
+		if (kind == "noise") {
+			std::uniform_real_distribution<float> dist(-1.f, 1.f);
+			for (float& x : result) {
+				x = dist(rng);
+			}
+		} else {
+			std::normal_distribution<float> noise(0.f, 0.01f);
+			for (size_t i=0; i<n; ++i) {
+				const float x = float(std::sin(i*0.001) + noise(rng));
+				result[i] = std::round(x*1024.f) / 1024.f;
+			}
+		}
+		return result;
+	}
+
+	/// Socket as stream buffer, zero means that the socket is not ready.
+	class Socket_channel: public std::streambuf {
+
+	private:
+		int _fd = -1;
+
+	public:
+
+		Socket_channel() = default;
+
+		inline explicit
+		Socket_channel(int fd):
+		_fd(fd)
+		{}
+
+		inline
+		Socket_channel(Socket_channel&& rhs):
+		std::streambuf(rhs),
+		_fd(rhs._fd)
+		{ rhs._fd = -1; }
+
+		inline Socket_channel&
+		operator=(Socket_channel&& rhs) {
+			std::swap(this->_fd, rhs._fd);
+			return *this;
+		}
+
+		~Socket_channel() {
+			if (this->_fd != -1) {
+				::close(this->_fd);
+			}
+		}
+
+		inline int
+		fd() const noexcept {
+			return this->_fd;
+		}
+
+	protected:
+
+		std::streamsize
+		xsgetn(char_type* s, std::streamsize n) override {
+			ssize_t ret = ::read(this->_fd, s, n);
+			return ret == -1 ? 0 : ret;
+		}
+
+		std::streamsize
+		xsputn(const char_type* s, std::streamsize n) override {
+			ssize_t ret = ::write(this->_fd, s, n);
+			return ret == -1 ? 0 : ret;
+		}
+
+	};
+
+	typedef bsc::basic_ring_fildesbuf<char, std::char_traits<char>, Socket_channel>
+		fildesbuf_type;
+	typedef bsc::basic_kernelbuf<fildesbuf_type> buffer_type;
+	typedef sys::basic_fildesbuf<char, std::char_traits<char>, std::stringbuf>
+		memory_fildesbuf;
+	typedef bsc::basic_kernelbuf<memory_fildesbuf> memory_kernelbuf;
+	typedef bsc::kstream<bsc::kernel> stream_type;
+
+	/// Returns connected pair of TCP sockets on the loopback interface.
+	bool
+	connect_loopback(int& client, int& server) {
+		int listener = ::socket(AF_INET, SOCK_STREAM, 0);
+		::sockaddr_in addr{};
+		addr.sin_family = AF_INET;
+		addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+		::socklen_t len = sizeof(addr);
+		if (listener == -1 ||
+		    ::bind(listener, reinterpret_cast<::sockaddr*>(&addr), len) == -1 ||
+		    ::listen(listener, 1) == -1 ||
+		    ::getsockname(listener, reinterpret_cast<::sockaddr*>(&addr), &len) == -1) {
+			return false;
+		}
+		client = ::socket(AF_INET, SOCK_STREAM, 0);
+		if (client == -1 ||
+		    ::connect(client, reinterpret_cast<::sockaddr*>(&addr), len) == -1) {
+			return false;
+		}
+		server = ::accept(listener, nullptr, nullptr);
+		::close(listener);
+		return server != -1;
+	}
+
+	void
+	send_kernels(int fd, size_t threshold, const Surface_kernel& k, size_t n) {
+		buffer_type buffer;
+		buffer.setfd(Socket_channel(fd));
+		buffer.set_compression_threshold(threshold);
+		// the receiver reads compressed packets
+		buffer.set_peer_features(bsc::wire_feature::compression);
+		stream_type stream(&buffer);
+		for (size_t i=0; i<n; ++i) {
+			stream.begin_packet();
+			stream << k;
+			buffer.compress_opacket();
+			stream.end_packet();
+			while (buffer.dirty()) {
+				buffer.pubflush();
+			}
+		}
+	}
+
+	/// Returns the number of bytes that were received.
+	size_t
+	receive_kernels(int fd, size_t n) {
+		buffer_type buffer;
+		buffer.setfd(Socket_channel(fd));
+		stream_type stream(&buffer);
+		std::string inflated;
+		size_t nbytes = 0;
+		size_t nreceived = 0;
+		while (nreceived != n) {
+			if (buffer.is_safe_to_compact()) {
+				buffer.compact();
+			}
+			const std::streamsize m = buffer.pubfill();
+			if (m == 0) {
+				::pollfd pfd{fd, POLLIN, 0};
+				::poll(&pfd, 1, -1);
+				continue;
+			}
+			nbytes += m;
+			while (nreceived != n && stream.read_packet()) {
+				stream_type::ipacket_guard g(&buffer);
+				bsc::kernel* k = nullptr;
+				if (buffer.ipacket_is_compressed()) {
+					// read the kernel from memory as kernel_protocol does
+					buffer.decompress_ipacket(inflated);
+					memory_kernelbuf mbuf;
+					mbuf.setfd(std::stringbuf{});
+					stream_type mstream(&mbuf);
+					mstream.begin_packet();
+					mstream.write(inflated.data(), inflated.size());
+					mstream.end_packet();
+					mstream.sync();
+					mstream.read_packet();
+					mstream >> k;
+				} else {
+					stream >> k;
+				}
+				delete k;
+				++nreceived;
+			}
+		}
+		return nbytes;
+	}
+
+}
+
+/*
+Throughput of kernels with 1 MiB of floating point data sent over
+TCP loopback connection with and without compression. The time includes
+serialisation, compression, transfer, decompression and deserialisation.
+Compression pays off on the links that are slower than the effective
+bandwidth of the codec reported by lz-codec benchmark; the loopback
+is faster than most real links, so this is the worst case.
+*/
+int
+main(int argc, char* argv[]) {
+	const std::string kind = argc > 1 ? argv[1] : "surface";
+	const size_t nkernels = 200;
+	bsc::register_type<Surface_kernel>();
+	Surface_kernel k;
+	k._data = make_data(kind, 1 << 18);
+	const size_t payload = k._data.size()*sizeof(float);
+	for (size_t threshold : {size_t(0), size_t(1024)}) {
+		int client = -1, server = -1;
+		if (!connect_loopback(client, server)) {
+			std::cerr << "unable to connect" << std::endl;
+			return 1;
+		}
+		::fcntl(server, F_SETFL, ::fcntl(server, F_GETFL) | O_NONBLOCK);
+		size_t nbytes = 0;
+		const auto t0 = clock_type::now();
+		std::thread receiver([&] () { nbytes = receive_kernels(server, nkernels); });
+		send_kernels(client, threshold, k, nkernels);
+		receiver.join();
+		using namespace std::chrono;
+		const double t = duration_cast<duration<double>>(clock_type::now()-t0).count();
+		const double mb = double(payload*nkernels) / (1024*1024);
+		std::cout << "data=" << kind
+			<< " compression=" << (threshold == 0 ? "off" : "on")
+			<< std::fixed << std::setprecision(2)
+			<< " wire-ratio=" << double(payload*nkernels) / nbytes
+			<< std::setprecision(0)
+			<< " mb-per-second=" << mb / t
+			<< std::endl;
+	}
+	return 0;
+}
@@ -0,0 +1,124 @@
+#include <algorithm>
+#include <chrono>
+#include <deque>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+#include <bscheduler/base/indexed_queue.hh>
+
+namespace {
+
+	struct Saved_kernel {
+
+		typedef unsigned long id_type;
+
+		inline id_type
+		id() const noexcept {
+			return this->_id;
+		}
+
+		inline bool
+		has_id() const noexcept {
+			return this->_id != 0;
+		}
+
+		id_type _id;
+
+	};
+
+	typedef std::chrono::steady_clock clock_type;
+
+	/**
+	Fill the queue with \p window kernels that are in flight, then
+	return them in random order and replace each returned kernel
+	with a new one (as kernel_protocol does).
+	*/
+	template <class Find, class Erase, class Pool>
+	double
+	measure_throughput(
+		Pool& pool,
+		size_t window,
+		size_t nreturns,
+		Find find,
+		Erase erase
+	) {
+		std::vector<Saved_kernel> kernels(window);
+		Saved_kernel::id_type counter = 0;
+		for (Saved_kernel& k : kernels) {
+			k._id = ++counter;
+			pool.push_back(&k);
+		}
+		std::default_random_engine rng;
+		std::uniform_int_distribution<size_t> dist(0, window-1);
+		const auto t0 = clock_type::now();
+		for (size_t i=0; i<nreturns; ++i) {
+			Saved_kernel& k = kernels[dist(rng)];
+			auto pos = find(pool, k.id());
+			if (pos == pool.end()) {
+				std::cerr << "kernel not found" << std::endl;
+				return 0;
+			}
+			erase(pool, pos);
+			k._id = ++counter;
+			pool.push_back(&k);
+		}
+		const auto t1 = clock_type::now();
+		using namespace std::chrono;
+		const double seconds = duration_cast<duration<double>>(t1-t0).count();
+		return double(nreturns) / seconds;
+	}
+
+	struct Indexed_pool: public bsc::indexed_queue<Saved_kernel> {
+		inline void
+		push_back(Saved_kernel* k) {
+			this->push(k);
+		}
+	};
+
+	typedef std::deque<Saved_kernel*> deque_pool;
+
+}
+
+int
+main(int argc, char* argv[]) {
+	const size_t window = argc > 1 ? std::stoul(argv[1]) : 100000;
+	const size_t nreturns = 100000;
+	Indexed_pool indexed;
+	const double indexed_throughput = measure_throughput(
+		indexed,
+		window,
+		nreturns,
+		[] (Indexed_pool& pool, Saved_kernel::id_type id) {
+			return pool.find(id);
+		},
+		[] (Indexed_pool& pool, Indexed_pool::iterator pos) {
+			pool.erase(pos);
+		}
+	);
+	// the deque is too slow for large windows
+	const size_t deque_returns = std::max(size_t(1), nreturns*1000/window);
+	deque_pool deque;
+	const double deque_throughput = measure_throughput(
+		deque,
+		window,
+		std::min(nreturns, deque_returns),
+		[] (deque_pool& pool, Saved_kernel::id_type id) {
+			return std::find_if(
+				pool.begin(),
+				pool.end(),
+				[id] (Saved_kernel* rhs) { return rhs->id() == id; }
+			);
+		},
+		[] (deque_pool& pool, deque_pool::iterator pos) {
+			pool.erase(pos);
+		}
+	);
+	std::cout << "window=" << window << std::fixed << std::setprecision(0)
+		<< " indexed-queue-returns-per-second=" << indexed_throughput
+		<< " deque-returns-per-second=" << deque_throughput
+		<< std::endl;
+	return 0;
+}
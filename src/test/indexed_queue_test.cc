@@ -0,0 +1,118 @@
+#include <algorithm>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include <bscheduler/base/container_traits.hh>
+#include <bscheduler/base/indexed_queue.hh>
+#include <bscheduler/base/queue_popper.hh>
+
+struct Item {
+
+	typedef int id_type;
+
+	inline id_type
+	id() const noexcept {
+		return this->_id;
+	}
+
+	inline bool
+	has_id() const noexcept {
+		return this->_id != 0;
+	}
+
+	id_type _id;
+	int value;
+
+};
+
+typedef bsc::indexed_queue<Item> queue_type;
+
+TEST(IndexedQueue, PushPop) {
+	std::vector<Item> items;
+	for (int i=0; i<10; ++i) {
+		items.push_back(Item{i, i});
+	}
+	queue_type queue;
+	EXPECT_TRUE(queue.empty());
+	for (Item& x : items) {
+		queue.push(&x);
+	}
+	EXPECT_EQ(items.size(), queue.size());
+	for (int i=0; i<int(items.size()); ++i) {
+		ASSERT_FALSE(queue.empty());
+		EXPECT_EQ(i, queue.front()->value);
+		queue.pop();
+	}
+	EXPECT_TRUE(queue.empty());
+}
+
+TEST(IndexedQueue, FindErase) {
+	std::vector<Item> items;
+	for (int i=0; i<100; ++i) {
+		items.push_back(Item{i+1, i});
+	}
+	queue_type queue;
+	for (Item& x : items) {
+		queue.push(&x);
+	}
+	EXPECT_TRUE(queue.find(1000) == queue.end());
+	// remove every other element
+	for (int i=0; i<100; i+=2) {
+		auto pos = queue.find(i+1);
+		ASSERT_TRUE(pos != queue.end());
+		EXPECT_EQ(i, (*pos)->value);
+		queue.erase(pos);
+		EXPECT_TRUE(queue.find(i+1) == queue.end());
+	}
+	EXPECT_EQ(50u, queue.size());
+	// the rest is in insertion order
+	std::vector<int> actual, expected;
+	for (int i=1; i<100; i+=2) {
+		expected.push_back(i);
+	}
+	for (Item* x : queue) {
+		actual.push_back(x->value);
+	}
+	EXPECT_EQ(expected, actual);
+}
+
+TEST(IndexedQueue, DuplicateIds) {
+	std::vector<Item> items{{1, 0}, {0, 1}, {1, 2}, {0, 3}, {1, 4}};
+	queue_type queue;
+	for (Item& x : items) {
+		queue.push(&x);
+	}
+	// elements without ids are not indexed
+	EXPECT_TRUE(queue.find(0) == queue.end());
+	for (int expected : {0, 2, 4}) {
+		auto pos = queue.find(1);
+		ASSERT_TRUE(pos != queue.end());
+		EXPECT_EQ(expected, (*pos)->value);
+		queue.erase(pos);
+	}
+	EXPECT_TRUE(queue.find(1) == queue.end());
+	EXPECT_EQ(2u, queue.size());
+}
+
+TEST(IndexedQueue, QueuePopper) {
+	std::vector<Item> items;
+	for (int i=0; i<10; ++i) {
+		items.push_back(Item{i+1, i});
+	}
+	queue_type queue;
+	for (Item& x : items) {
+		queue.push(&x);
+	}
+	typedef bsc::queue_pop_iterator<queue_type,bsc::queue_traits<queue_type>>
+		popper;
+	std::vector<int> actual;
+	std::for_each(
+		popper(queue),
+		popper(),
+		[&actual] (Item* x) { actual.push_back(x->value); }
+	);
+	EXPECT_TRUE(queue.empty());
+	EXPECT_EQ(10u, actual.size());
+	EXPECT_TRUE(std::is_sorted(actual.begin(), actual.end()));
+}
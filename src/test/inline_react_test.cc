@@ -0,0 +1,150 @@
+#include <bscheduler/api.hh>
+#include <bscheduler/base/error_handler.hh>
+
+#include <mutex>
+
+#include <gtest/gtest.h>
+
+using namespace bsc;
+
+namespace {
+
+	/// Set while \c Middle::react runs on the current thread.
+	thread_local bool in_middle_react = false;
+
+	/// Serialises numbering and sending of kernels returning to \c Root.
+	std::mutex send_mutex;
+	uint64_t last_sent = 0;
+
+	/// All kernels share the same principal id to make them
+	/// end up in the same downstream pipeline.
+	const kernel::id_type shared_id = 1;
+
+}
+
+struct Ordered: public bsc::kernel {
+
+	uint64_t seq = 0;
+
+	/// Number the kernel and return it to the parent atomically,
+	/// so that the numbers follow the order of sending.
+	void
+	return_in_order() {
+		std::lock_guard<std::mutex> lock(send_mutex);
+		this->seq = ++last_sent;
+		commit<Local>(this);
+	}
+
+};
+
+struct Ping: public Ordered {
+
+	void
+	act() override {
+		this->return_in_order();
+	}
+
+};
+
+struct Report: public Ordered {};
+
+struct Leaf: public bsc::kernel {
+
+	void
+	act() override {
+		commit<Local>(this);
+	}
+
+};
+
+struct Middle: public bsc::kernel {
+
+	Middle(kernel* root, size_t nleaves):
+	_root(root),
+	_nleaves(nleaves)
+	{ this->id(shared_id); }
+
+	void
+	act() override {
+		for (size_t i=0; i<this->_nleaves; ++i) {
+			upstream<Local>(this, new Leaf);
+		}
+	}
+
+	void
+	react(bsc::kernel*) override {
+		in_middle_react = true;
+		Report* r = new Report;
+		r->parent(this->_root);
+		r->return_in_order();
+		if (++this->_nreturned == this->_nleaves) {
+			// the parent must not react (and delete this kernel)
+			// until this method returns
+			commit<Local>(this);
+		}
+		in_middle_react = false;
+	}
+
+private:
+
+	kernel* _root;
+	size_t _nleaves;
+	size_t _nreturned = 0;
+
+};
+
+struct Root: public bsc::kernel {
+
+	Root(size_t nleaves, size_t npings):
+	_nleaves(nleaves),
+	_npings(npings)
+	{ this->id(shared_id); }
+
+	void
+	act() override {
+		upstream<Local>(this, new Middle(this, this->_nleaves));
+		for (size_t i=0; i<this->_npings; ++i) {
+			upstream<Local>(this, new Ping);
+		}
+	}
+
+	void
+	react(bsc::kernel* child) override {
+		EXPECT_FALSE(in_middle_react)
+			<< "parent reacts while the child is still in react";
+		if (Ordered* k = dynamic_cast<Ordered*>(child)) {
+			EXPECT_GT(k->seq, this->_last_seq)
+				<< "inlined kernel overtook queued kernels";
+			this->_last_seq = k->seq;
+			++this->_nordered;
+		} else {
+			++this->_nmiddle;
+		}
+		if (this->_nmiddle == 1 &&
+		    this->_nordered == this->_nleaves + this->_npings) {
+			commit<Local>(this);
+		}
+	}
+
+private:
+
+	size_t _nleaves;
+	size_t _npings;
+	size_t _nordered = 0;
+	size_t _nmiddle = 0;
+	uint64_t _last_seq = 0;
+
+};
+
+TEST(InlineReact, CommitInReactAndOrder) {
+	bsc::install_error_handler();
+	factory.set_max_inline_depth(16);
+	factory_guard g;
+	send<Local>(new Root(1000, 1000));
+	EXPECT_EQ(0, bsc::wait_and_return());
+	// reports are sent from Middle::react and may be inlined,
+	// Middle returns itself to Root via the queue
+	// (Root::react checks that it does not run inside Middle::react)
+	EXPECT_GT(factory.num_inlined(), 0u);
+	EXPECT_GT(factory.num_queued(), 0u);
+}
@@ -0,0 +1,97 @@
+#include <algorithm>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include <bscheduler/base/intrusive_queue.hh>
+#include <bscheduler/base/queue_popper.hh>
+
+struct Node {
+
+	inline Node*
+	next() const noexcept {
+		return this->_next;
+	}
+
+	inline void
+	next(Node* rhs) noexcept {
+		this->_next = rhs;
+	}
+
+	int value = 0;
+	Node* _next = nullptr;
+
+};
+
+typedef bsc::intrusive_queue<Node> queue_type;
+
+std::vector<Node>
+make_nodes(int n) {
+	std::vector<Node> nodes(n);
+	for (int i=0; i<n; ++i) {
+		nodes[i].value = i;
+	}
+	return nodes;
+}
+
+TEST(IntrusiveQueue, PushPop) {
+	std::vector<Node> nodes = make_nodes(10);
+	queue_type queue;
+	EXPECT_TRUE(queue.empty());
+	for (Node& n : nodes) {
+		queue.push(&n);
+	}
+	EXPECT_EQ(nodes.size(), queue.size());
+	for (int i=0; i<int(nodes.size()); ++i) {
+		ASSERT_FALSE(queue.empty());
+		EXPECT_EQ(i, queue.front()->value);
+		queue.pop();
+	}
+	EXPECT_TRUE(queue.empty());
+	EXPECT_EQ(0u, queue.size());
+}
+
+TEST(IntrusiveQueue, MoveFrontToAnotherQueue) {
+	std::vector<Node> nodes = make_nodes(10);
+	queue_type queue, other;
+	for (Node& n : nodes) {
+		queue.push(&n);
+	}
+	// the element is pushed to another queue before it is popped
+	std::for_each(
+		bsc::queue_popper(queue),
+		bsc::queue_popper_end(queue),
+		[&other] (Node* n) { other.push(n); }
+	);
+	EXPECT_TRUE(queue.empty());
+	ASSERT_EQ(nodes.size(), other.size());
+	for (int i=0; i<int(nodes.size()); ++i) {
+		EXPECT_EQ(i, other.front()->value);
+		other.pop();
+	}
+}
+
+TEST(IntrusiveQueue, PushFrontToTheSameQueue) {
+	std::vector<Node> nodes = make_nodes(3);
+	queue_type queue;
+	for (Node& n : nodes) {
+		queue.push(&n);
+	}
+	std::vector<int> result;
+	for (int i=0; i<5; ++i) {
+		Node* n = queue.front();
+		result.push_back(n->value);
+		queue.push(n);
+		queue.pop();
+	}
+	EXPECT_EQ(std::vector<int>({0,1,2,0,1}), result);
+	EXPECT_EQ(3u, queue.size());
+	queue_type single;
+	single.push(&nodes[0]);
+	single.push(single.front());
+	single.pop();
+	ASSERT_EQ(1u, single.size());
+	EXPECT_EQ(&nodes[0], single.front());
+	single.pop();
+	EXPECT_TRUE(single.empty());
+}
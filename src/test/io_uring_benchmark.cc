@@ -0,0 +1,206 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <bscheduler/base/io_uring.hh>
+
+namespace {
+
+	typedef std::chrono::steady_clock clock_type;
+
+	const size_t nconnections = 4;
+	const size_t buffer_size = 64*1024;
+	const size_t nbytes = size_t(256)*1024*1024;
+
+	void
+	check(bool success, const char* what) {
+		if (!success) {
+			std::perror(what);
+			std::exit(1);
+		}
+	}
+
+	/// Connect \link nconnections\endlink pairs of sockets over loopback.
+	void
+	connect_all(std::vector<int>& readers, std::vector<int>& writers) {
+		int server = ::socket(AF_INET, SOCK_STREAM, 0);
+		check(server != -1, "socket");
+		::sockaddr_in addr{};
+		addr.sin_family = AF_INET;
+		addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+		::socklen_t len = sizeof(addr);
+		check(::bind(server, (::sockaddr*)&addr, len) == 0, "bind");
+		check(::getsockname(server, (::sockaddr*)&addr, &len) == 0, "getsockname");
+		check(::listen(server, nconnections) == 0, "listen");
+		for (size_t i=0; i<nconnections; ++i) {
+			int w = ::socket(AF_INET, SOCK_STREAM, 0);
+			check(w != -1, "socket");
+			check(::connect(w, (::sockaddr*)&addr, len) == 0, "connect");
+			int r = ::accept4(server, nullptr, nullptr, SOCK_NONBLOCK);
+			check(r != -1, "accept");
+			writers.push_back(w);
+			readers.push_back(r);
+		}
+		::close(server);
+	}
+
+	/// Write \link nbytes\endlink to each socket with blocking writes.
+	void
+	write_all(const std::vector<int>& writers) {
+		std::vector<char> buf(buffer_size, 'x');
+		std::vector<size_t> offsets(writers.size());
+		size_t nfinished = 0;
+		while (nfinished != writers.size()) {
+			for (size_t i=0; i<writers.size(); ++i) {
+				if (offsets[i] == nbytes) {
+					continue;
+				}
+				const size_t n = std::min(buf.size(), nbytes - offsets[i]);
+				ssize_t ret = ::write(writers[i], buf.data(), n);
+				check(ret != -1, "write");
+				offsets[i] += ret;
+				if (offsets[i] == nbytes) {
+					::shutdown(writers[i], SHUT_WR);
+					++nfinished;
+				}
+			}
+		}
+	}
+
+	/// Edge-triggered epoll and one read per buffer.
+	size_t
+	read_epoll(const std::vector<int>& readers) {
+		size_t nsyscalls = 0;
+		int epfd = ::epoll_create1(0);
+		check(epfd != -1, "epoll_create1");
+		for (size_t i=0; i<readers.size(); ++i) {
+			::epoll_event ev{};
+			ev.events = EPOLLIN | EPOLLRDHUP | EPOLLET;
+			ev.data.u64 = i;
+			check(::epoll_ctl(epfd, EPOLL_CTL_ADD, readers[i], &ev) == 0, "epoll_ctl");
+		}
+		std::vector<std::vector<char>> buffers(
+			readers.size(),
+			std::vector<char>(buffer_size)
+		);
+		std::vector<::epoll_event> events(readers.size());
+		size_t nfinished = 0;
+		while (nfinished != readers.size()) {
+			int n = ::epoll_wait(epfd, events.data(), events.size(), -1);
+			++nsyscalls;
+			for (int j=0; j<n; ++j) {
+				const size_t i = events[j].data.u64;
+				ssize_t ret;
+				while ((ret = ::read(readers[i], buffers[i].data(), buffer_size)) > 0) {
+					++nsyscalls;
+				}
+				++nsyscalls;
+				if (ret == 0) {
+					++nfinished;
+				}
+			}
+		}
+		::close(epfd);
+		return nsyscalls;
+	}
+
+	/**
+	Multishot poll and one read per buffer, as in socket pipelines
+	with \c io_backend=io_uring. One-shot polls are re-armed, if the kernel
+	does not support multishot poll.
+	*/
+	size_t
+	read_io_uring(const std::vector<int>& readers) {
+		size_t nsyscalls = 0;
+		bsc::io_uring ring(2*nconnections);
+		const std::uint32_t events = POLLIN | POLLRDHUP;
+		for (size_t i=0; i<readers.size(); ++i) {
+			ring.prepare_poll(readers[i], events, i, true);
+		}
+		std::vector<char> buffer(buffer_size);
+		size_t nfinished = 0;
+		while (nfinished != readers.size()) {
+			ring.submit(1);
+			++nsyscalls;
+			ring.for_each_completion(
+				[&] (const bsc::io_uring::completion_type& cqe) {
+					const size_t i = cqe.user_data;
+					ssize_t ret;
+					while ((ret = ::read(readers[i], buffer.data(), buffer_size)) > 0) {
+						++nsyscalls;
+					}
+					++nsyscalls;
+					if (ret == 0) {
+						++nfinished;
+						return;
+					}
+					bool more = false;
+					#if defined(IORING_CQE_F_MORE)
+					more = cqe.flags & IORING_CQE_F_MORE;
+					#endif
+					if (!more) {
+						ring.prepare_poll(readers[i], events, i, true);
+					}
+				}
+			);
+		}
+		return nsyscalls;
+	}
+
+}
+
+/*
+Throughput of the reading side of several loopback TCP connections
+for epoll and io_uring backends of socket poller. Both backends
+only wait for events, data is read with plain read calls.
+*/
+int
+main(int argc, char* argv[]) {
+	const std::string backend = argc > 1 ? argv[1] : "io_uring";
+	if (backend != "epoll") {
+		try {
+			bsc::io_uring ring(1);
+		} catch (const std::exception& err) {
+			std::cerr << "io_uring is not supported: " << err.what() << std::endl;
+			return 0;
+		}
+	}
+	std::vector<int> readers, writers;
+	connect_all(readers, writers);
+	std::thread writer([&writers] () { write_all(writers); });
+	const auto t0 = clock_type::now();
+	const size_t nsyscalls = backend == "epoll"
+		? read_epoll(readers)
+		: read_io_uring(readers);
+	using namespace std::chrono;
+	const auto dt = duration_cast<duration<double>>(clock_type::now() - t0);
+	writer.join();
+	const double mb = double(nconnections*nbytes) / (1024*1024);
+	std::cout << "backend=" << backend << std::fixed << std::setprecision(0)
+		<< " mb-per-second=" << mb / dt.count()
+		<< std::setprecision(2)
+		<< " syscalls-per-mb=" << nsyscalls / mb
+		<< std::endl;
+	for (int fd : readers) {
+		::close(fd);
+	}
+	for (int fd : writers) {
+		::close(fd);
+	}
+	return 0;
+}
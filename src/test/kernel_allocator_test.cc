@@ -0,0 +1,163 @@
+#include <algorithm>
+#include <thread>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include <bscheduler/base/numa.hh>
+#include <bscheduler/kernel/kernel.hh>
+#include <bscheduler/kernel/kernel_allocator.hh>
+
+TEST(KernelAllocator, AllocateDeallocate) {
+	bsc::kernel_allocator& a = bsc::get_kernel_allocator();
+	const size_t nlarge = a.stats().nlarge;
+	std::vector<void*> blocks;
+	for (size_t n=1; n<=bsc::kernel_allocator::max_block_size; n += 7) {
+		void* ptr = a.allocate(n);
+		ASSERT_NE(nullptr, ptr);
+		EXPECT_EQ(0u, size_t(ptr) % bsc::kernel_allocator::alignment);
+		std::fill_n(static_cast<char*>(ptr), n, char(n));
+		blocks.push_back(ptr);
+	}
+	void* large = a.allocate(bsc::kernel_allocator::max_block_size+1);
+	ASSERT_NE(nullptr, large);
+	size_t n = 1;
+	for (void* ptr : blocks) {
+		EXPECT_TRUE(std::all_of(
+			static_cast<char*>(ptr),
+			static_cast<char*>(ptr)+n,
+			[n] (char ch) { return ch == char(n); }
+		));
+		a.deallocate(ptr, n);
+		n += 7;
+	}
+	a.deallocate(large, bsc::kernel_allocator::max_block_size+1);
+	// reuse the block from thread cache
+	void* ptr = a.allocate(100);
+	void* ptr2 = a.allocate(100);
+	a.deallocate(ptr, 100);
+	EXPECT_EQ(ptr, a.allocate(100));
+	a.deallocate(ptr, 100);
+	a.deallocate(ptr2, 100);
+	EXPECT_EQ(nlarge+1, a.stats().nlarge);
+}
+
+TEST(KernelAllocator, CrossThreadDeallocation) {
+	bsc::kernel_allocator& a = bsc::get_kernel_allocator();
+	const size_t nblocks = 10000;
+	const size_t size = 64;
+	std::vector<void*> blocks(nblocks);
+	const bsc::kernel_allocator_stats old = a.stats();
+	std::thread producer([&] () {
+		for (void*& ptr : blocks) {
+			ptr = a.allocate(size);
+		}
+	});
+	producer.join();
+	std::thread consumer([&] () {
+		for (void* ptr : blocks) {
+			a.deallocate(ptr, size);
+		}
+	});
+	consumer.join();
+	bsc::kernel_allocator_stats s = a.stats();
+	EXPECT_EQ(nblocks, s.nallocations - old.nallocations);
+	EXPECT_EQ(nblocks, s.ndeallocations - old.ndeallocations);
+	EXPECT_GT(s.nbatches, old.nbatches);
+	// blocks returned by the consumer are reused
+	std::thread third([&] () {
+		for (void*& ptr : blocks) {
+			ptr = a.allocate(size);
+		}
+		for (void* ptr : blocks) {
+			a.deallocate(ptr, size);
+		}
+	});
+	third.join();
+	EXPECT_EQ(s.nslabs, a.stats().nslabs);
+}
+
+TEST(KernelAllocator, NodeLocalCentralLists) {
+	bsc::kernel_allocator& a = bsc::get_kernel_allocator();
+	const size_t nblocks = 1000;
+	const size_t size = 48;
+	std::vector<void*> blocks(nblocks);
+	const bsc::kernel_allocator_stats old = a.stats();
+	std::thread producer([&] () {
+		bsc::this_thread::numa_node = 1;
+		for (void*& ptr : blocks) {
+			ptr = a.allocate(size);
+		}
+	});
+	producer.join();
+	std::thread consumer([&] () {
+		bsc::this_thread::numa_node = 2;
+		for (void* ptr : blocks) {
+			a.deallocate(ptr, size);
+		}
+	});
+	consumer.join();
+	const bsc::kernel_allocator_stats s = a.stats();
+	// every block goes back to the node of the producer
+	EXPECT_EQ(nblocks, s.nremote - old.nremote);
+	// the node of the consumer does not reuse them
+	std::thread other_node([&] () {
+		bsc::this_thread::numa_node = 2;
+		void* ptr = a.allocate(size);
+		EXPECT_EQ(
+			blocks.end(),
+			std::find(blocks.begin(), blocks.end(), ptr)
+		);
+		a.deallocate(ptr, size);
+	});
+	other_node.join();
+	EXPECT_EQ(s.nslabs+1, a.stats().nslabs);
+	// the node of the producer does
+	std::thread same_node([&] () {
+		bsc::this_thread::numa_node = 1;
+		for (void*& ptr : blocks) {
+			ptr = a.allocate(size);
+		}
+		for (void* ptr : blocks) {
+			a.deallocate(ptr, size);
+		}
+	});
+	same_node.join();
+	EXPECT_EQ(s.nslabs+1, a.stats().nslabs);
+}
+
+struct Small_kernel: public bsc::kernel {
+	char data[16];
+};
+
+struct Large_kernel: public bsc::kernel {
+	char data[bsc::kernel_allocator::max_block_size];
+};
+
+TEST(KernelAllocator, KernelSubclass) {
+	bsc::kernel_allocator& a = bsc::get_kernel_allocator();
+	const size_t nkernels = 100;
+	const bsc::kernel_allocator_stats old = a.stats();
+	// thread exit adds the counters of the thread cache
+	std::thread t([&] () {
+		std::vector<bsc::kernel*> kernels;
+		for (size_t i=0; i<nkernels; ++i) {
+			kernels.push_back(new Small_kernel);
+			EXPECT_EQ(
+				0u,
+				size_t(kernels.back()) % bsc::kernel_allocator::alignment
+			);
+		}
+		// deleted through the pointer to the base class
+		for (bsc::kernel* k : kernels) {
+			delete k;
+		}
+		delete new Large_kernel;
+	});
+	t.join();
+	const bsc::kernel_allocator_stats s = a.stats();
+	const size_t expected = bsc::kernel_pool_enabled() ? nkernels : 0;
+	EXPECT_EQ(expected, s.nallocations - old.nallocations) << s;
+	EXPECT_EQ(expected, s.ndeallocations - old.ndeallocations) << s;
+	EXPECT_EQ(bsc::kernel_pool_enabled() ? 1u : 0u, s.nlarge - old.nlarge) << s;
+}
@@ -0,0 +1,491 @@
+#include <memory>
+#include <stdexcept>
+#include <streambuf>
+#include <string>
+#include <vector>
+
+#include <unistdx/io/fildesbuf>
+
+#include <bscheduler/kernel/kernel.hh>
+#include <bscheduler/kernel/kernel_type_registry.hh>
+#include <bscheduler/kernel/kernelbuf.hh>
+#include <bscheduler/kernel/kstream.hh>
+#include <bscheduler/ppl/kernel_protocol.hh>
+
+#include <gtest/gtest.h>
+
+namespace {
+
+	/// Kernel with compressible payload.
+	struct Payload_kernel: public bsc::kernel {
+
+		std::string _data;
+
+		Payload_kernel() = default;
+
+		explicit
+		Payload_kernel(size_t n):
+		_data(n, 'x')
+		{}
+
+		void
+		write(sys::pstream& out) const override {
+			bsc::kernel::write(out);
+			out << uint32_t(this->_data.size());
+			out.write(this->_data.data(), this->_data.size());
+		}
+
+		void
+		read(sys::pstream& in) override {
+			bsc::kernel::read(in);
+			uint32_t n = 0;
+			in >> n;
+			this->_data.resize(n);
+			in.read(&this->_data[0], n);
+		}
+
+	};
+
+	/// Kernel that fails in the middle of writing.
+	struct Broken_kernel: public Payload_kernel {
+
+		using Payload_kernel::Payload_kernel;
+
+		void
+		write(sys::pstream& out) const override {
+			Payload_kernel::write(out);
+			throw std::runtime_error("broken kernel");
+		}
+
+	};
+
+	/// Kernel that is written, but fails to be read.
+	struct Unreadable_kernel: public Payload_kernel {
+
+		using Payload_kernel::Payload_kernel;
+
+		void
+		read(sys::pstream& in) override {
+			Payload_kernel::read(in);
+			throw std::runtime_error("unreadable kernel");
+		}
+
+	};
+
+	/// Collects received kernels.
+	struct Test_router {
+
+		static std::vector<std::unique_ptr<bsc::kernel>> kernels;
+
+		static void
+		send_local(bsc::kernel* k) {
+			kernels.emplace_back(k);
+		}
+
+		static void
+		send_remote(bsc::kernel* k) {
+			kernels.emplace_back(k);
+		}
+
+		static void
+		forward_parent(bsc::foreign_kernel* k) {
+			delete k;
+		}
+
+	};
+
+	std::vector<std::unique_ptr<bsc::kernel>> Test_router::kernels;
+
+	/// One end of in-memory connection.
+	class Channel: public std::streambuf {
+
+	private:
+		std::shared_ptr<std::string> _in;
+		std::shared_ptr<std::string> _out;
+
+	public:
+
+		Channel() = default;
+
+		Channel(
+			std::shared_ptr<std::string> in,
+			std::shared_ptr<std::string> out
+		):
+		_in(in),
+		_out(out)
+		{}
+
+		/// Returns the number of bytes that were written and not read yet.
+		inline size_t
+		unread() const noexcept {
+			return this->_out->size();
+		}
+
+		/// Returns the bytes that were written and not read yet.
+		inline const std::string&
+		output() const noexcept {
+			return *this->_out;
+		}
+
+	protected:
+
+		std::streamsize
+		xsgetn(char_type* s, std::streamsize n) override {
+			const size_t m = std::min(size_t(n), this->_in->size());
+			this->_in->copy(s, m);
+			this->_in->erase(0, m);
+			return m;
+		}
+
+		std::streamsize
+		xsputn(const char_type* s, std::streamsize n) override {
+			this->_out->append(s, n);
+			return n;
+		}
+
+	};
+
+	typedef sys::basic_fildesbuf<char, std::char_traits<char>, Channel>
+		fildesbuf_type;
+	typedef bsc::basic_kernelbuf<fildesbuf_type> buffer_type;
+	typedef bsc::kstream<bsc::kernel> stream_type;
+	typedef bsc::kernel_protocol<bsc::kernel,Test_router> protocol_type;
+
+	struct Endpoint {
+
+		buffer_type buffer;
+		stream_type stream{&buffer};
+		protocol_type proto;
+
+		/// Write the kernel without flushing the buffer.
+		inline void
+		post(bsc::kernel* k) {
+			this->proto.send(k, this->stream);
+		}
+
+		inline void
+		flush() {
+			this->proto.flush(this->stream);
+			this->buffer.pubflush();
+		}
+
+		inline void
+		send(bsc::kernel* k) {
+			this->post(k);
+			this->flush();
+		}
+
+		inline void
+		receive() {
+			this->buffer.pubfill();
+			this->proto.receive_kernels(this->stream);
+		}
+
+	};
+
+	/// Connect two endpoints with in-memory channel.
+	void
+	connect(Endpoint& a, Endpoint& b) {
+		auto ab = std::make_shared<std::string>();
+		auto ba = std::make_shared<std::string>();
+		a.buffer.setfd(Channel(ba, ab));
+		b.buffer.setfd(Channel(ab, ba));
+	}
+
+	/// Returns new kernel that goes upstream and is deleted after it is sent.
+	template <class Kernel=Payload_kernel>
+	Kernel*
+	new_kernel(size_t n) {
+		static Payload_kernel parent;
+		Kernel* k = new Kernel(n);
+		k->parent(&parent);
+		return k;
+	}
+
+	/// Returns true, if the first packet in \p s is marked as compact.
+	bool
+	is_compact(const std::string& s) {
+		// the most significant byte of the size in network byte order
+		return static_cast<unsigned char>(s.at(0)) & 0x40;
+	}
+
+	/// Returns the number of packets in \p s.
+	size_t
+	count_packets(const std::string& s) {
+		size_t n = 0;
+		for (size_t i=0; i+4 <= s.size(); ++n) {
+			uint32_t size = 0;
+			for (size_t j=0; j<4; ++j) {
+				size = (size << 8) | static_cast<unsigned char>(s[i+j]);
+			}
+			// strip compressed, compact and fields bits
+			i += size & 0x1fffffff;
+		}
+		return n;
+	}
+
+	/// Returns the data of the received kernel with index \p i.
+	const std::string&
+	received_data(size_t i) {
+		return dynamic_cast<Payload_kernel&>(*Test_router::kernels.at(i))._data;
+	}
+
+	/// Exchange handshakes between the endpoints.
+	void
+	negotiate(Endpoint& a, Endpoint& b) {
+		a.send(new_kernel(16));
+		b.receive();
+		b.buffer.pubflush();
+		a.receive();
+	}
+
+	void
+	register_types() {
+		static bool registered = false;
+		if (!registered) {
+			bsc::register_type<Payload_kernel>();
+			bsc::register_type<Broken_kernel>();
+			bsc::register_type<Unreadable_kernel>();
+			registered = true;
+		}
+	}
+
+}
+
+TEST(KernelProtocol, Handshake) {
+	register_types();
+	Test_router::kernels.clear();
+	Endpoint a, b;
+	connect(a, b);
+	a.buffer.set_compression_threshold(1);
+	// the first kernel is sent uncompressed after the handshake
+	a.send(new_kernel(4096));
+	EXPECT_TRUE(a.buffer.handshake_sent());
+	EXPECT_FALSE(a.buffer.compresses());
+	const size_t uncompressed = a.buffer.fd().unread();
+	b.receive();
+	ASSERT_EQ(1u, Test_router::kernels.size());
+	EXPECT_EQ(
+		bsc::wire_feature::flag_type(bsc::wire_feature::all),
+		bsc::wire_feature::flag_type(b.buffer.peer_features())
+	);
+	EXPECT_TRUE(b.buffer.handshake_sent());
+	// the reply is written without kernels
+	b.buffer.pubflush();
+	a.receive();
+	EXPECT_EQ(1u, Test_router::kernels.size());
+	EXPECT_TRUE(a.buffer.compresses());
+	EXPECT_FALSE(b.buffer.compresses());
+	// the next kernel is compressed
+	a.send(new_kernel(4096));
+	EXPECT_LT(a.buffer.fd().unread(), uncompressed / 4);
+	b.receive();
+	ASSERT_EQ(2u, Test_router::kernels.size());
+	Payload_kernel* k = dynamic_cast<Payload_kernel*>(Test_router::kernels[1].get());
+	ASSERT_NE(nullptr, k);
+	EXPECT_EQ(std::string(4096, 'x'), k->_data);
+}
+
+TEST(KernelProtocol, DecompressedSizeIsLimited) {
+	register_types();
+	Test_router::kernels.clear();
+	Endpoint a, b;
+	connect(a, b);
+	a.buffer.set_compression_threshold(1);
+	b.buffer.set_max_packet_size(1024);
+	negotiate(a, b);
+	ASSERT_EQ(1u, Test_router::kernels.size());
+	ASSERT_TRUE(a.buffer.compresses());
+	// the packet is skipped before the memory is allocated
+	a.send(new_kernel(4096));
+	b.receive();
+	EXPECT_EQ(1u, Test_router::kernels.size());
+	a.send(new_kernel(100));
+	b.receive();
+	ASSERT_EQ(2u, Test_router::kernels.size());
+	EXPECT_EQ(std::string(100, 'x'), received_data(1));
+}
+
+TEST(KernelProtocol, NoHandshakeWithoutFeatures) {
+	register_types();
+	Test_router::kernels.clear();
+	Endpoint a, b;
+	connect(a, b);
+	a.send(new_kernel(16));
+	EXPECT_FALSE(a.buffer.handshake_sent());
+	b.receive();
+	ASSERT_EQ(1u, Test_router::kernels.size());
+	EXPECT_FALSE(b.buffer.handshake_sent());
+	EXPECT_EQ(0u, bsc::wire_feature::flag_type(b.buffer.peer_features()));
+}
+
+TEST(KernelProtocol, ParentIsWrittenInFixedEncoding) {
+	register_types();
+	Test_router::kernels.clear();
+	Endpoint a, b;
+	connect(a, b);
+	a.buffer.set_compact_encoding(true);
+	negotiate(a, b);
+	ASSERT_TRUE(a.buffer.compacts());
+	a.send(new_kernel(16));
+	EXPECT_TRUE(is_compact(a.buffer.fd().output()));
+	b.receive();
+	// the parent may be relayed to a connection with different encoding
+	Payload_kernel parent(16);
+	parent.id(1000);
+	Payload_kernel* k = new_kernel(16);
+	parent.carry_parent(k);
+	k->id(1001);
+	a.send(k);
+	EXPECT_FALSE(is_compact(a.buffer.fd().output()));
+	b.receive();
+	ASSERT_EQ(3u, Test_router::kernels.size());
+	bsc::kernel* result = Test_router::kernels.back().get();
+	EXPECT_EQ(1001u, result->id());
+	ASSERT_TRUE(result->carries_parent());
+	ASSERT_NE(nullptr, result->parent());
+	EXPECT_EQ(1000u, result->parent()->id());
+	EXPECT_EQ(std::string(16, 'x'), dynamic_cast<Payload_kernel*>(result->parent())->_data);
+	delete result->parent();
+}
+
+TEST(KernelProtocol, NoBatchesBeforeHandshake) {
+	register_types();
+	Test_router::kernels.clear();
+	Endpoint a, b;
+	connect(a, b);
+	a.proto.setf(bsc::kernel_proto_flag::coalesce_kernels);
+	// the other side has not listed batches yet
+	for (size_t i=0; i<3; ++i) {
+		a.post(new_kernel(16));
+	}
+	a.flush();
+	EXPECT_TRUE(a.buffer.handshake_sent());
+	EXPECT_EQ(4u, count_packets(a.buffer.fd().output()));
+	b.receive();
+	EXPECT_EQ(3u, Test_router::kernels.size());
+}
+
+TEST(KernelProtocol, Batch) {
+	register_types();
+	Test_router::kernels.clear();
+	Endpoint a, b;
+	connect(a, b);
+	a.proto.setf(bsc::kernel_proto_flag::coalesce_kernels);
+	negotiate(a, b);
+	ASSERT_TRUE(a.buffer.peer_features() & bsc::wire_feature::batches);
+	const size_t n = 10;
+	for (size_t i=0; i<n; ++i) {
+		a.post(new_kernel(16+i));
+	}
+	a.flush();
+	EXPECT_EQ(1u, count_packets(a.buffer.fd().output()));
+	b.receive();
+	ASSERT_EQ(n+1, Test_router::kernels.size());
+	for (size_t i=0; i<n; ++i) {
+		EXPECT_EQ(std::string(16+i, 'x'), received_data(i+1));
+	}
+}
+
+TEST(KernelProtocol, PartlyWrittenBatch) {
+	register_types();
+	Test_router::kernels.clear();
+	Endpoint a, b;
+	connect(a, b);
+	a.proto.setf(bsc::kernel_proto_flag::coalesce_kernels);
+	negotiate(a, b);
+	a.post(new_kernel(1));
+	// the record of the kernel that failed to be written is removed
+	a.post(new_kernel<Broken_kernel>(100));
+	a.post(new_kernel(2));
+	// the record of the kernel that failed to be read is skipped
+	a.post(new_kernel<Unreadable_kernel>(100));
+	a.post(new_kernel(3));
+	a.flush();
+	EXPECT_EQ(1u, count_packets(a.buffer.fd().output()));
+	b.receive();
+	ASSERT_EQ(4u, Test_router::kernels.size());
+	EXPECT_EQ(std::string(1, 'x'), received_data(1));
+	EXPECT_EQ(std::string(2, 'x'), received_data(2));
+	EXPECT_EQ(std::string(3, 'x'), received_data(3));
+}
+
+TEST(KernelProtocol, LoadIsAttachedAfterHandshake) {
+	register_types();
+	Test_router::kernels.clear();
+	Endpoint a, b;
+	connect(a, b);
+	a.proto.setf(bsc::kernel_proto_flag::attach_load);
+	a.proto.set_load(7);
+	// the other side may not read the load
+	a.send(new_kernel(16));
+	EXPECT_TRUE(a.buffer.handshake_sent());
+	b.receive();
+	EXPECT_FALSE(b.proto.has_peer_load());
+	b.buffer.pubflush();
+	a.receive();
+	EXPECT_EQ(
+		bsc::wire_feature::flag_type(bsc::wire_feature::fields),
+		bsc::wire_feature::flag_type(a.buffer.field_features())
+	);
+	a.send(new_kernel(16));
+	b.receive();
+	ASSERT_TRUE(b.proto.has_peer_load());
+	EXPECT_EQ(7u, b.proto.peer_load());
+	EXPECT_EQ(2u, Test_router::kernels.size());
+}
+
+TEST(KernelProtocol, PriorityIsSentAfterHandshake) {
+	register_types();
+	Test_router::kernels.clear();
+	Endpoint a, b;
+	connect(a, b);
+	// any feature starts the negotiation
+	a.buffer.set_compact_encoding(true);
+	Payload_kernel* k = new_kernel(16);
+	k->priority(bsc::kernel_priority::high);
+	a.send(k);
+	b.receive();
+	ASSERT_EQ(1u, Test_router::kernels.size());
+	EXPECT_EQ(bsc::kernel_priority::normal, Test_router::kernels[0]->priority());
+	b.buffer.pubflush();
+	a.receive();
+	k = new_kernel(16);
+	k->priority(bsc::kernel_priority::high);
+	a.send(k);
+	b.receive();
+	ASSERT_EQ(2u, Test_router::kernels.size());
+	EXPECT_EQ(bsc::kernel_priority::high, Test_router::kernels[1]->priority());
+}
+
+TEST(KernelProtocol, FrameIsCompressedOnce) {
+	register_types();
+	Test_router::kernels.clear();
+	Endpoint a, b;
+	connect(a, b);
+	a.buffer.set_compression_threshold(1);
+	negotiate(a, b);
+	ASSERT_TRUE(a.buffer.compresses());
+	Payload_kernel k(4096);
+	k.id(1);
+	const bsc::kernel_frame<bsc::kernel> frame(k, false, false, 1);
+	ASSERT_FALSE(frame.compressed_payload(false).empty());
+	a.proto.send_frame(frame, a.stream);
+	a.flush();
+	EXPECT_LT(a.buffer.fd().unread(), 4096u / 4);
+	b.receive();
+	ASSERT_EQ(2u, Test_router::kernels.size());
+	EXPECT_EQ(std::string(4096, 'x'), received_data(1));
+	EXPECT_FALSE(b.proto.has_peer_load());
+	// the header with the load of this node is written by each connection
+	a.proto.setf(bsc::kernel_proto_flag::attach_load);
+	a.proto.set_load(3);
+	a.proto.send_frame(frame, a.stream);
+	a.flush();
+	EXPECT_LT(a.buffer.fd().unread(), 4096u / 4);
+	b.receive();
+	ASSERT_EQ(3u, Test_router::kernels.size());
+	EXPECT_EQ(std::string(4096, 'x'), received_data(2));
+	ASSERT_TRUE(b.proto.has_peer_load());
+	EXPECT_EQ(3u, b.proto.peer_load());
+}
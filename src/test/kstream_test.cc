@@ -1,6 +1,11 @@
+#include <limits>
+
 #include <unistdx/io/fildesbuf>
 
+#include <bscheduler/kernel/kernel_frame.hh>
 #include <bscheduler/kernel/kstream.hh>
+#include <bscheduler/kernel/ring_fildesbuf.hh>
+#include <bscheduler/kernel/wire_format.hh>
 #include <bscheduler/ppl/basic_pipeline.hh>
 
 #include "datum.hh"
@@ -129,6 +134,61 @@ private:
 
 };
 
+/// Writes arrays in bulk and element by element, reads only in bulk.
+struct Array_kernel: public bsc::kernel {
+
+	Array_kernel():
+	_doubles(10000),
+	_shorts(1001),
+	_bytes(7) {
+		for (double& x : _doubles) { rnd(x); }
+		for (uint16_t& x : _shorts) { rnd(x); }
+		for (size_t i=0; i<_bytes.size(); ++i) { _bytes[i] = int8_t(i*37); }
+	}
+
+	void
+	write(sys::pstream& out) const override {
+		bsc::kernel::write(out);
+		bsc::write_array(out, _doubles);
+		out << uint32_t(_shorts.size());
+		for (uint16_t x : _shorts) {
+			out << x;
+		}
+		bsc::write_array(out, _bytes.data(), _bytes.size());
+	}
+
+	void
+	read(sys::pstream& in) override {
+		bsc::kernel::read(in);
+		bsc::read_array(in, _doubles);
+		bsc::read_array(in, _shorts);
+		bsc::read_array(in, _bytes.data(), _bytes.size());
+	}
+
+	bool
+	operator==(const Array_kernel& rhs) const noexcept {
+		return _doubles == rhs._doubles && _shorts == rhs._shorts &&
+			_bytes == rhs._bytes;
+	}
+
+	bool
+	operator!=(const Array_kernel& rhs) const noexcept {
+		return !operator==(rhs);
+	}
+
+	friend std::ostream&
+	operator<<(std::ostream& out, const Array_kernel& rhs) {
+		return out << rhs._doubles.size() << ' ' << rhs._shorts.size();
+	}
+
+private:
+
+	std::vector<double> _doubles;
+	std::vector<uint16_t> _shorts;
+	std::vector<int8_t> _bytes;
+
+};
+
 struct Dummy_kernel: public bsc::kernel {};
 
 typedef Big_kernel<100> Big_kernel_type;
@@ -143,6 +203,7 @@ register_all() {
 		bsc::register_type<Kernel_that_reads_more_than_writes>();
 		bsc::register_type<Dummy_kernel>();
 		bsc::register_type<Big_kernel_type>();
+		bsc::register_type<Array_kernel>();
 		bsc::register_type({
 			[] (sys::pstream& in) {
 				Kernel_that_carries_its_parent* k = new Kernel_that_carries_its_parent(0);
@@ -170,7 +231,8 @@ TYPED_TEST_CASE(
 		Kernel_that_writes_more_than_reads,
 		Kernel_that_reads_more_than_writes,
 		Kernel_that_carries_its_parent,
-		Big_kernel_type
+		Big_kernel_type,
+		Array_kernel
 	)
 );
 
@@ -212,3 +274,322 @@ TYPED_TEST(KernelStreamTest, IO) {
 		}
 	}
 }
+
+TEST(KernelStream, Records) {
+	typedef bsc::kernel kernel_type;
+	typedef std::stringbuf sink_type;
+	typedef sys::basic_fildesbuf<char, std::char_traits<char>, sink_type>
+		fildesbuf_type;
+	typedef bsc::basic_kernelbuf<fildesbuf_type> buffer_type;
+	typedef bsc::kstream<kernel_type> stream_type;
+	typedef typename stream_type::ipacket_guard ipacket_guard;
+	register_all();
+	const size_t count = 10;
+	std::vector<Good_kernel> expected(count);
+	buffer_type buffer;
+	buffer.setfd(sink_type{});
+	stream_type stream(&buffer);
+	stream.begin_packet();
+	for (size_t i=0; i<count; ++i) {
+		buffer.begin_record();
+		stream << expected[i];
+		buffer.end_record();
+		// cancelled records are not written
+		buffer.begin_record();
+		stream << expected[i];
+		buffer.cancel_record();
+	}
+	stream.end_packet();
+	stream.sync();
+	ASSERT_TRUE(static_cast<bool>(stream.read_packet()));
+	ipacket_guard g(&buffer);
+	for (size_t i=0; i<count; ++i) {
+		uint32_t size = 0;
+		stream >> size;
+		const char* first = buffer.ipayload_cur();
+		kernel_type* k = nullptr;
+		stream >> k;
+		EXPECT_EQ(size, uint32_t(buffer.ipayload_cur() - first));
+		Good_kernel* tmp = dynamic_cast<Good_kernel*>(k);
+		ASSERT_NE(nullptr, tmp);
+		EXPECT_EQ(expected[i], *tmp) << "i=" << i;
+		delete tmp;
+	}
+	EXPECT_EQ(buffer.ipayload_end(), buffer.ipayload_cur());
+}
+
+TEST(KernelStream, CompactEncoding) {
+	typedef bsc::kernel kernel_type;
+	typedef std::stringbuf sink_type;
+	typedef sys::basic_fildesbuf<char, std::char_traits<char>, sink_type>
+		fildesbuf_type;
+	typedef bsc::basic_kernelbuf<fildesbuf_type> buffer_type;
+	typedef bsc::kstream<kernel_type> stream_type;
+	typedef typename stream_type::ipacket_guard ipacket_guard;
+	register_all();
+	Good_kernel parent;
+	parent.id(1000);
+	Good_kernel expected;
+	expected.id(1001);
+	expected.parent(&parent);
+	expected.set_principal_id(1000);
+	expected.setapp(0);
+	buffer_type buffer;
+	buffer.setfd(sink_type{});
+	buffer.set_compact_encoding(true);
+	stream_type stream(&buffer);
+	size_t sizes[2] = {};
+	const bsc::wire_feature compact = bsc::wire_feature::compact_encoding;
+	// compact encoding is used only after the other side has listed it
+	for (size_t i=0; i<2; ++i) {
+		if (i == 1) {
+			buffer.set_peer_features(compact);
+		}
+		stream.begin_packet();
+		EXPECT_EQ(i == 1, bool(buffer.opacket_features() & compact));
+		stream << expected.header();
+		stream << expected;
+		sizes[i] = buffer.opacket_size();
+		stream.end_packet();
+		stream.sync();
+		ASSERT_TRUE(static_cast<bool>(stream.read_packet()));
+		EXPECT_EQ(i == 1, bool(buffer.ipacket_features() & compact));
+		ipacket_guard g(&buffer);
+		bsc::kernel_header hdr;
+		stream >> hdr;
+		EXPECT_EQ(0u, hdr.app());
+		kernel_type* k = nullptr;
+		stream >> k;
+		Good_kernel* tmp = dynamic_cast<Good_kernel*>(k);
+		ASSERT_NE(nullptr, tmp);
+		EXPECT_EQ(expected, *tmp);
+		EXPECT_EQ(1001u, tmp->id());
+		EXPECT_EQ(1000u, tmp->parent_id());
+		EXPECT_EQ(1000u, tmp->principal_id());
+		EXPECT_EQ(buffer.ipayload_end(), buffer.ipayload_cur());
+		delete tmp;
+	}
+	EXPECT_LT(sizes[1] + 20, sizes[0]);
+}
+
+TEST(KernelStream, FieldMask) {
+	typedef bsc::kernel kernel_type;
+	typedef std::stringbuf sink_type;
+	typedef sys::basic_fildesbuf<char, std::char_traits<char>, sink_type>
+		fildesbuf_type;
+	typedef bsc::basic_kernelbuf<fildesbuf_type> buffer_type;
+	typedef bsc::kstream<kernel_type> stream_type;
+	typedef typename stream_type::ipacket_guard ipacket_guard;
+	using bsc::wire_feature;
+	register_all();
+	Good_kernel expected;
+	expected.id(1001);
+	expected.priority(bsc::kernel_priority::high);
+	buffer_type buffer;
+	buffer.setfd(sink_type{});
+	stream_type stream(&buffer);
+	// the writer uses fewer fields than the reader expects, then none
+	for (size_t i=0; i<2; ++i) {
+		buffer.set_peer_features(wire_feature::priority);
+		stream.begin_packet();
+		if (i == 1) {
+			buffer.set_opacket_features(wire_feature());
+		}
+		stream << expected.header();
+		stream << expected;
+		stream.end_packet();
+		stream.sync();
+		buffer.set_peer_features(wire_feature::fields);
+		ASSERT_TRUE(static_cast<bool>(stream.read_packet()));
+		EXPECT_EQ(
+			i == 0,
+			bool(buffer.ipacket_features() & wire_feature::priority)
+		);
+		EXPECT_FALSE(bool(buffer.ipacket_features() & wire_feature::node_load));
+		ipacket_guard g(&buffer);
+		bsc::kernel_header hdr;
+		stream >> hdr;
+		kernel_type* k = nullptr;
+		stream >> k;
+		Good_kernel* tmp = dynamic_cast<Good_kernel*>(k);
+		ASSERT_NE(nullptr, tmp);
+		EXPECT_EQ(1001u, tmp->id());
+		EXPECT_EQ(
+			i == 0 ? bsc::kernel_priority::high : bsc::kernel_priority::normal,
+			tmp->priority()
+		);
+		EXPECT_EQ(buffer.ipayload_end(), buffer.ipayload_cur());
+		delete tmp;
+	}
+}
+
+TEST(KernelStream, Frame) {
+	typedef bsc::kernel kernel_type;
+	typedef std::stringbuf sink_type;
+	typedef sys::basic_fildesbuf<char, std::char_traits<char>, sink_type>
+		fildesbuf_type;
+	typedef bsc::basic_kernelbuf<fildesbuf_type> buffer_type;
+	typedef bsc::kstream<kernel_type> stream_type;
+	typedef typename stream_type::ipacket_guard ipacket_guard;
+	register_all();
+	Good_kernel expected;
+	expected.id(1001);
+	expected.set_principal_id(1000);
+	const bsc::kernel_frame<kernel_type> frame(expected, false, true);
+	EXPECT_TRUE(frame.has_compact());
+	EXPECT_LT(frame.payload(true).size(), frame.payload(false).size());
+	// the same frame is written to connections with different encodings
+	for (bool compact : {false, true}) {
+		buffer_type buffer;
+		buffer.setfd(sink_type{});
+		stream_type stream(&buffer);
+		stream.begin_packet();
+		buffer.set_opacket_features(
+			compact ? bsc::wire_feature::compact_encoding : bsc::wire_feature()
+		);
+		stream << frame.header();
+		const std::string& payload = frame.payload(compact);
+		stream.write(payload.data(), payload.size());
+		stream.end_packet();
+		stream.sync();
+		ASSERT_TRUE(static_cast<bool>(stream.read_packet()));
+		EXPECT_EQ(
+			compact,
+			bool(buffer.ipacket_features() & bsc::wire_feature::compact_encoding)
+		);
+		ipacket_guard g(&buffer);
+		bsc::kernel_header hdr;
+		stream >> hdr;
+		kernel_type* k = nullptr;
+		stream >> k;
+		Good_kernel* tmp = dynamic_cast<Good_kernel*>(k);
+		ASSERT_NE(nullptr, tmp);
+		EXPECT_EQ(expected, *tmp);
+		EXPECT_EQ(1001u, tmp->id());
+		EXPECT_EQ(1000u, tmp->principal_id());
+		EXPECT_EQ(buffer.ipayload_end(), buffer.ipayload_cur());
+		delete tmp;
+	}
+}
+
+TEST(KernelStream, RingBuffer) {
+	typedef bsc::kernel kernel_type;
+	typedef std::stringbuf sink_type;
+	typedef bsc::basic_ring_fildesbuf<char, std::char_traits<char>, sink_type>
+		fildesbuf_type;
+	typedef bsc::basic_kernelbuf<fildesbuf_type> buffer_type;
+	typedef bsc::kstream<kernel_type> stream_type;
+	typedef typename stream_type::ipacket_guard ipacket_guard;
+	register_all();
+	buffer_type buffer;
+	buffer.setfd(sink_type{});
+	stream_type stream(&buffer);
+	const size_t capacity = buffer.capacity();
+	// small packets wrap around the end of the ring without growing it
+	for (size_t i=0; i<1000; ++i) {
+		Good_kernel expected;
+		stream.begin_packet();
+		stream << expected;
+		stream.end_packet();
+		stream.sync();
+		ASSERT_TRUE(static_cast<bool>(stream.read_packet())) << "i=" << i;
+		{
+			ipacket_guard g(&buffer);
+			kernel_type* k = nullptr;
+			stream >> k;
+			Good_kernel* tmp = dynamic_cast<Good_kernel*>(k);
+			ASSERT_NE(nullptr, tmp);
+			EXPECT_EQ(expected, *tmp) << "i=" << i;
+			delete tmp;
+		}
+		ASSERT_TRUE(buffer.is_safe_to_compact());
+		buffer.compact();
+	}
+	EXPECT_EQ(capacity, buffer.capacity());
+	// the packet that is larger than the ring is read in place
+	Array_kernel big;
+	stream.begin_packet();
+	stream << big;
+	const size_t size = buffer.opacket_size();
+	stream.end_packet();
+	ASSERT_LT(capacity, size);
+	stream.sync();
+	ASSERT_TRUE(static_cast<bool>(stream.read_packet()));
+	EXPECT_LE(size, buffer.capacity());
+	ipacket_guard g(&buffer);
+	kernel_type* k = nullptr;
+	stream >> k;
+	Array_kernel* tmp = dynamic_cast<Array_kernel*>(k);
+	ASSERT_NE(nullptr, tmp);
+	EXPECT_EQ(big, *tmp);
+	delete tmp;
+}
+
+TEST(KernelStream, ArraySizeIsChecked) {
+	typedef bsc::kernel kernel_type;
+	typedef std::stringbuf sink_type;
+	typedef sys::basic_fildesbuf<char, std::char_traits<char>, sink_type>
+		fildesbuf_type;
+	typedef bsc::basic_kernelbuf<fildesbuf_type> buffer_type;
+	typedef bsc::kstream<kernel_type> stream_type;
+	typedef typename stream_type::ipacket_guard ipacket_guard;
+	buffer_type buffer;
+	buffer.setfd(sink_type{});
+	stream_type stream(&buffer);
+	// the size of the array is larger than the packet
+	stream.begin_packet();
+	stream << std::numeric_limits<uint32_t>::max() << uint32_t(1);
+	stream.end_packet();
+	stream.begin_packet();
+	stream << uint32_t(3) << uint16_t(1) << uint16_t(2);
+	stream.end_packet();
+	stream.sync();
+	{
+		ASSERT_TRUE(static_cast<bool>(stream.read_packet()));
+		ipacket_guard g(&buffer);
+		std::vector<double> x;
+		EXPECT_THROW(bsc::read_array(stream, x), bsc::error);
+		EXPECT_TRUE(x.empty());
+	}
+	{
+		ASSERT_TRUE(static_cast<bool>(stream.read_packet()));
+		ipacket_guard g(&buffer);
+		std::valarray<uint16_t> x;
+		EXPECT_THROW(bsc::read_array(stream, x), bsc::error);
+		EXPECT_EQ(0u, x.size());
+	}
+}
+
+TEST(WireFormat, Varint) {
+	typedef std::stringbuf sink_type;
+	typedef sys::basic_fildesbuf<char, std::char_traits<char>, sink_type>
+		fildesbuf_type;
+	typedef bsc::basic_kernelbuf<fildesbuf_type> buffer_type;
+	typedef bsc::kstream<bsc::kernel> stream_type;
+	typedef typename stream_type::ipacket_guard ipacket_guard;
+	const uint64_t values[] = {
+		0, 1, 127, 128, 300, 16383, 16384,
+		uint64_t(1) << 35, std::numeric_limits<uint64_t>::max()
+	};
+	buffer_type buffer;
+	buffer.setfd(sink_type{});
+	stream_type stream(&buffer);
+	stream.begin_packet();
+	for (uint64_t x : values) {
+		bsc::write_varint(stream, x);
+		bsc::write_delta(stream, 1000, x);
+	}
+	stream.end_packet();
+	stream.sync();
+	ASSERT_TRUE(static_cast<bool>(stream.read_packet()));
+	ipacket_guard g(&buffer);
+	for (uint64_t x : values) {
+		EXPECT_EQ(x, bsc::read_varint(stream));
+		EXPECT_EQ(x, bsc::read_delta(stream, 1000));
+	}
+	EXPECT_EQ(buffer.ipayload_end(), buffer.ipayload_cur());
+	EXPECT_EQ(0u, bsc::zigzag_encode(0));
+	EXPECT_EQ(1u, bsc::zigzag_encode(-1));
+	EXPECT_EQ(2u, bsc::zigzag_encode(1));
+	EXPECT_EQ(-64, bsc::zigzag_decode(bsc::zigzag_encode(-64)));
+}
@@ -0,0 +1,88 @@
+#include <chrono>
+#include <cmath>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+#include <bscheduler/base/lz_codec.hh>
+
+namespace {
+
+	typedef std::chrono::steady_clock clock_type;
+
+	/// Smooth surface similar to the output of autoreg example.
+	std::vector<float>
+	make_surface(size_t n) {
+		std::vector<float> result(n);
+		std::default_random_engine rng;
+		std::normal_distribution<float> noise(0.f, 0.01f);
+		for (size_t i=0; i<n; ++i) {
+			const float x = float(std::sin(i*0.001) + noise(rng));
+			// the surface is stored with limited precision
+			result[i] = std::round(x*1024.f) / 1024.f;
+		}
+		return result;
+	}
+
+	std::vector<float>
+	make_noise(size_t n) {
+		std::vector<float> result(n);
+		std::default_random_engine rng;
+		std::uniform_real_distribution<float> dist(-1.f, 1.f);
+		for (float& x : result) {
+			x = dist(rng);
+		}
+		return result;
+	}
+
+	double
+	seconds_since(clock_type::time_point t0) {
+		using namespace std::chrono;
+		return duration_cast<duration<double>>(clock_type::now()-t0).count();
+	}
+
+}
+
+/*
+Compression pays off, when the network bandwidth is lower than
+the effective bandwidth: the amount of original data that goes through
+compression and decompression per second.
+*/
+int
+main(int argc, char* argv[]) {
+	const std::string kind = argc > 1 ? argv[1] : "surface";
+	const size_t nfloats = 1 << 22;
+	const size_t nrounds = 10;
+	const std::vector<float> data =
+		kind == "noise" ? make_noise(nfloats) : make_surface(nfloats);
+	const char* src = reinterpret_cast<const char*>(data.data());
+	const size_t n = data.size()*sizeof(float);
+	std::vector<char> compressed;
+	std::vector<char> decompressed(n);
+	double tcompress = 0, tdecompress = 0;
+	for (size_t i=0; i<nrounds; ++i) {
+		compressed.clear();
+		auto t0 = clock_type::now();
+		bsc::lz::compress(src, n, compressed);
+		tcompress += seconds_since(t0);
+		t0 = clock_type::now();
+		bsc::lz::decompress(
+			compressed.data(),
+			compressed.size(),
+			decompressed.data(),
+			decompressed.size()
+		);
+		tdecompress += seconds_since(t0);
+	}
+	const double mb = double(n*nrounds) / (1024*1024);
+	std::cout << "data=" << kind << std::fixed << std::setprecision(2)
+		<< " ratio=" << double(n) / compressed.size()
+		<< std::setprecision(0)
+		<< " compress-mb-per-second=" << mb / tcompress
+		<< " decompress-mb-per-second=" << mb / tdecompress
+		<< " effective-mb-per-second=" << mb / (tcompress + tdecompress)
+		<< std::endl;
+	return 0;
+}
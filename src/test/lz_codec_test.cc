@@ -0,0 +1,91 @@
+#include <cmath>
+#include <random>
+#include <string>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include <bscheduler/base/error.hh>
+#include <bscheduler/base/lz_codec.hh>
+
+namespace {
+
+	std::string
+	round_trip(const std::string& orig) {
+		std::vector<char> compressed;
+		bsc::lz::compress(orig.data(), orig.size(), compressed);
+		EXPECT_LE(compressed.size(), bsc::lz::max_compressed_size(orig.size()));
+		std::string result(orig.size(), '\0');
+		bsc::lz::decompress(
+			compressed.data(),
+			compressed.size(),
+			&result[0],
+			result.size()
+		);
+		return result;
+	}
+
+}
+
+TEST(LZCodec, Small) {
+	for (const std::string& str : {
+		std::string(),
+		std::string("a"),
+		std::string("abcd"),
+		std::string("abcdabcdabcdabcdabcd"),
+		std::string(1000, 'x'),
+	}) {
+		EXPECT_EQ(str, round_trip(str));
+	}
+}
+
+TEST(LZCodec, Random) {
+	std::default_random_engine rng;
+	std::uniform_int_distribution<int> byte(0, 255);
+	std::uniform_int_distribution<int> alphabet('a', 'd');
+	for (size_t n : {7u, 100u, 4096u, 100000u, 1000000u}) {
+		std::string noise(n, '\0'), text(n, '\0');
+		for (size_t i=0; i<n; ++i) {
+			noise[i] = char(byte(rng));
+			text[i] = char(alphabet(rng));
+		}
+		EXPECT_EQ(noise, round_trip(noise));
+		EXPECT_EQ(text, round_trip(text));
+	}
+}
+
+TEST(LZCodec, FloatArray) {
+	std::vector<float> data(100000);
+	for (size_t i=0; i<data.size(); ++i) {
+		data[i] = float(std::round(std::sin(i*0.01)*100));
+	}
+	std::string orig(reinterpret_cast<const char*>(data.data()),
+		data.size()*sizeof(float));
+	std::vector<char> compressed;
+	bsc::lz::compress(orig.data(), orig.size(), compressed);
+	EXPECT_LT(compressed.size(), orig.size()/2);
+	EXPECT_EQ(orig, round_trip(orig));
+}
+
+TEST(LZCodec, Malformed) {
+	std::string orig(1000, 'x');
+	std::vector<char> compressed;
+	bsc::lz::compress(orig.data(), orig.size(), compressed);
+	std::string result(orig.size(), '\0');
+	EXPECT_THROW(
+		bsc::lz::decompress(compressed.data(), compressed.size()-1,
+			&result[0], result.size()),
+		bsc::error
+	);
+	EXPECT_THROW(
+		bsc::lz::decompress(compressed.data(), compressed.size(),
+			&result[0], result.size()-1),
+		bsc::error
+	);
+	const char bad_offset[] = {char(0x10), 'x', char(0x10), char(0)};
+	EXPECT_THROW(
+		bsc::lz::decompress(bad_offset, sizeof(bad_offset),
+			&result[0], result.size()),
+		bsc::error
+	);
+}
@@ -0,0 +1,90 @@
+#include <algorithm>
+#include <atomic>
+#include <thread>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include <bscheduler/base/futex_semaphore.hh>
+#include <bscheduler/base/mpmc_queue.hh>
+#include <bscheduler/base/null_mutex.hh>
+
+typedef bsc::mpmc_queue<size_t> queue_type;
+typedef bsc::queue_traits<queue_type> traits_type;
+
+struct null_lock {
+	inline explicit null_lock(bsc::null_mutex& m): _mutex(m) {}
+	inline void lock() { this->_mutex.lock(); }
+	inline void unlock() { this->_mutex.unlock(); }
+	bsc::null_mutex& _mutex;
+};
+
+TEST(MPMCQueue, PushPop) {
+	queue_type queue(100);
+	EXPECT_EQ(128u, queue.capacity());
+	EXPECT_TRUE(queue.empty());
+	for (size_t i=0; i<queue.capacity(); ++i) {
+		ASSERT_TRUE(traits_type::try_push(queue, i));
+	}
+	EXPECT_FALSE(traits_type::try_push(queue, 0));
+	EXPECT_EQ(queue.capacity(), queue.size());
+	EXPECT_EQ(0u, traits_type::front(queue));
+	traits_type::pop(queue);
+	size_t x = 0;
+	for (size_t i=1; i<queue.capacity(); ++i) {
+		ASSERT_TRUE(traits_type::try_pop(queue, x));
+		EXPECT_EQ(i, x) << "pop order is not FIFO";
+	}
+	EXPECT_FALSE(traits_type::try_pop(queue, x));
+	EXPECT_TRUE(queue.empty());
+}
+
+TEST(MPMCQueue, ProducersConsumers) {
+	const size_t nelements = 100000;
+	const size_t nproducers = 3;
+	const size_t nconsumers = 3;
+	queue_type queue(64);
+	std::vector<std::atomic<int>> counts(nelements*nproducers);
+	for (std::atomic<int>& c : counts) {
+		c = 0;
+	}
+	std::atomic<size_t> nreceived(0);
+	bsc::null_mutex mutex;
+	bsc::futex_semaphore semaphore;
+	std::vector<std::thread> threads;
+	for (size_t i=0; i<nconsumers; ++i) {
+		threads.emplace_back([&] () {
+			null_lock lock(mutex);
+			size_t x = 0;
+			while (nreceived < counts.size()) {
+				if (queue.try_pop(x)) {
+					++counts[x];
+					if (++nreceived == counts.size()) {
+						semaphore.notify_all();
+					}
+				} else {
+					semaphore.wait(lock, [&] () {
+						return !queue.empty() || nreceived == counts.size();
+					});
+				}
+			}
+		});
+	}
+	for (size_t i=0; i<nproducers; ++i) {
+		threads.emplace_back([&,i] () {
+			for (size_t j=0; j<nelements; ++j) {
+				queue.push(i*nelements + j);
+				semaphore.notify_one();
+			}
+		});
+	}
+	for (std::thread& t : threads) {
+		t.join();
+	}
+	EXPECT_TRUE(queue.empty());
+	EXPECT_TRUE(std::all_of(
+		counts.begin(),
+		counts.end(),
+		[] (const std::atomic<int>& c) { return c == 1; }
+	));
+}
@@ -0,0 +1,71 @@
+#include <queue>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include <bscheduler/base/multilevel_queue.hh>
+
+struct Item {
+
+	inline int
+	priority() const noexcept {
+		return this->level;
+	}
+
+	int level;
+	int value;
+
+};
+
+typedef bsc::multilevel_queue<std::queue<Item*>,3> queue_type;
+
+TEST(MultilevelQueue, HighPriorityFirst) {
+	std::vector<Item> items{{0,0}, {1,1}, {2,2}, {1,3}, {2,4}};
+	queue_type queue;
+	EXPECT_TRUE(queue.empty());
+	for (Item& x : items) {
+		queue.push(&x);
+	}
+	EXPECT_EQ(items.size(), queue.size());
+	EXPECT_EQ(1u, queue.size(0));
+	EXPECT_EQ(2u, queue.size(1));
+	EXPECT_EQ(2u, queue.size(2));
+	std::vector<int> order;
+	while (!queue.empty()) {
+		order.push_back(queue.front()->value);
+		queue.pop();
+	}
+	EXPECT_EQ(std::vector<int>({2,4,1,3,0}), order);
+}
+
+TEST(MultilevelQueue, ClampPriority) {
+	Item x{10,1};
+	Item y{1,2};
+	queue_type queue;
+	queue.push(&y);
+	queue.push(&x);
+	EXPECT_EQ(1u, queue.size(2));
+	EXPECT_EQ(&x, queue.front());
+}
+
+TEST(MultilevelQueue, NoStarvation) {
+	const size_t n = 1000;
+	std::vector<Item> high(n, Item{2,0});
+	std::vector<Item> low(n, Item{0,0});
+	queue_type queue;
+	for (size_t i=0; i<n; ++i) {
+		queue.push(&high[i]);
+		queue.push(&low[i]);
+	}
+	// in each round high priority level dequeues weight(2)
+	// elements and low priority level dequeues weight(0) elements
+	const size_t round = queue_type::weight(2) + queue_type::weight(0);
+	size_t nlow = 0;
+	for (size_t i=0; i<round*10; ++i) {
+		if (queue.front()->level == 0) {
+			++nlow;
+		}
+		queue.pop();
+	}
+	EXPECT_EQ(10u*queue_type::weight(0), nlow);
+}
@@ -0,0 +1,46 @@
+#include <algorithm>
+#include <thread>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include <bscheduler/base/error.hh>
+#include <bscheduler/base/numa.hh>
+
+TEST(NUMA, ParseCpuList) {
+	typedef std::vector<unsigned> vec;
+	EXPECT_EQ(vec(), bsc::parse_cpu_list(""));
+	EXPECT_EQ(vec({0}), bsc::parse_cpu_list("0"));
+	EXPECT_EQ(vec({0,1,2,3}), bsc::parse_cpu_list("0-3"));
+	EXPECT_EQ(vec({0,1,2,3,8,10,11}), bsc::parse_cpu_list("0-3,8,10-11"));
+	EXPECT_EQ(vec({1,2,5}), bsc::parse_cpu_list("5,1-2,2"));
+	EXPECT_THROW(bsc::parse_cpu_list("a"), bsc::error);
+	EXPECT_THROW(bsc::parse_cpu_list("3-1"), bsc::error);
+	EXPECT_THROW(bsc::parse_cpu_list("0;1"), bsc::error);
+}
+
+TEST(NUMA, Nodes) {
+	std::vector<bsc::numa_node> nodes = bsc::numa_nodes();
+	ASSERT_FALSE(nodes.empty());
+	std::vector<unsigned> all;
+	for (const bsc::numa_node& node : nodes) {
+		EXPECT_FALSE(node.empty());
+		all.insert(all.end(), node.cpus.begin(), node.cpus.end());
+	}
+	std::sort(all.begin(), all.end());
+	EXPECT_TRUE(std::adjacent_find(all.begin(), all.end()) == all.end())
+		<< "nodes must not share processors";
+}
+
+TEST(NUMA, PinThisThread) {
+	std::vector<bsc::numa_node> nodes = bsc::numa_nodes();
+	const bsc::numa_node_id index = nodes.size()-1;
+	bsc::numa_node_id result = bsc::no_numa_node;
+	std::thread thr([&] () {
+		bsc::pin_this_thread(nodes.back(), index);
+		result = bsc::this_thread::numa_node;
+	});
+	thr.join();
+	EXPECT_EQ(index, result);
+	EXPECT_EQ(bsc::no_numa_node, bsc::this_thread::numa_node);
+}
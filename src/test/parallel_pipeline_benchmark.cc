@@ -0,0 +1,80 @@
+#include <atomic>
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <bscheduler/kernel/kernel.hh>
+#include <bscheduler/ppl/parallel_pipeline.hh>
+
+namespace {
+
+	std::atomic<size_t> nremaining(0);
+
+	struct Tiny_kernel: public bsc::kernel {
+		void
+		act() override {
+			--nremaining;
+		}
+	};
+
+	typedef bsc::parallel_pipeline<bsc::kernel> pipeline_type;
+	typedef std::chrono::steady_clock clock_type;
+
+	double
+	measure_throughput(
+		size_t batch_size,
+		unsigned nthreads,
+		size_t nkernels,
+		size_t nrounds
+	) {
+		std::vector<std::unique_ptr<bsc::kernel>> owned;
+		std::vector<bsc::kernel*> kernels;
+		for (size_t i=0; i<nkernels; ++i) {
+			owned.emplace_back(new Tiny_kernel);
+			kernels.push_back(owned.back().get());
+		}
+		pipeline_type ppl(nthreads);
+		ppl.set_name("bench");
+		ppl.set_batch_size(batch_size);
+		ppl.start();
+		const auto t0 = clock_type::now();
+		for (size_t i=0; i<nrounds; ++i) {
+			nremaining = nkernels;
+			ppl.send(kernels.data(), kernels.size());
+			while (nremaining != 0) {
+				std::this_thread::yield();
+			}
+		}
+		const auto t1 = clock_type::now();
+		ppl.stop();
+		ppl.wait();
+		using namespace std::chrono;
+		const double seconds = duration_cast<duration<double>>(t1-t0).count();
+		return double(nkernels*nrounds) / seconds;
+	}
+
+}
+
+/*
+Thread context is shared by all pipelines in the process and
+is used only once, so each batch size is measured by a separate
+process.
+*/
+int
+main(int argc, char* argv[]) {
+	const size_t batch_size = argc > 1 ? std::stoul(argv[1]) : 1;
+	const unsigned nthreads = std::max(2u, std::thread::hardware_concurrency());
+	const size_t nkernels = 100000;
+	const size_t nrounds = 20;
+	const double throughput =
+		measure_throughput(batch_size, nthreads, nkernels, nrounds);
+	std::cout << "batch-size=" << batch_size
+		<< " threads=" << nthreads
+		<< " kernels-per-second=" << std::fixed << std::setprecision(0)
+		<< throughput << std::endl;
+	return 0;
+}
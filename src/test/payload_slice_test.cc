@@ -0,0 +1,35 @@
+#include <cstring>
+#include <stdexcept>
+#include <string>
+
+#include <gtest/gtest.h>
+
+#include <bscheduler/kernel/payload_slice.hh>
+
+TEST(PayloadSlice, Empty) {
+	bsc::payload_slice empty;
+	EXPECT_TRUE(empty.empty());
+	EXPECT_EQ(0u, empty.size());
+	EXPECT_TRUE(bsc::payload_slice(0).empty());
+}
+
+TEST(PayloadSlice, Share) {
+	const char str[] = "hello world";
+	bsc::payload_slice orig(sizeof(str)-1);
+	std::memcpy(orig.data(), str, orig.size());
+	bsc::payload_slice copy(orig);
+	EXPECT_EQ(orig.data(), copy.data());
+	EXPECT_EQ(2, orig.use_count());
+	bsc::payload_slice world = orig.slice(6, 5);
+	EXPECT_EQ(3, orig.use_count());
+	EXPECT_EQ(orig.data()+6, world.data());
+	EXPECT_EQ("world", std::string(world.data(), world.size()));
+	orig.clear();
+	copy.clear();
+	EXPECT_EQ(1, world.use_count());
+	EXPECT_EQ("world", std::string(world.data(), world.size()));
+	EXPECT_EQ("or", std::string(world.slice(1, 2).data(), 2));
+	EXPECT_TRUE(world.slice(5, 0).empty());
+	EXPECT_THROW(world.slice(6, 0), std::out_of_range);
+	EXPECT_THROW(world.slice(2, 4), std::out_of_range);
+}
@@ -0,0 +1,181 @@
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <bscheduler/base/shm_ring.hh>
+
+namespace {
+
+	typedef std::chrono::steady_clock clock_type;
+
+	/// Two pipes with the same interface as shared memory channel.
+	struct pipe_channel {
+
+		int _in;
+		int _out;
+
+		size_t
+		write(const char* s, size_t n) {
+			ssize_t ret = ::write(this->_out, s, n);
+			return ret == -1 ? 0 : ret;
+		}
+
+		size_t
+		read(char* s, size_t n) {
+			ssize_t ret = ::read(this->_in, s, n);
+			return ret == -1 ? 0 : ret;
+		}
+
+		void
+		wait_readable() {
+			::pollfd fd{this->_in, POLLIN, 0};
+			::poll(&fd, 1, -1);
+		}
+
+		void
+		wait_writable() {
+			::pollfd fd{this->_out, POLLOUT, 0};
+			::poll(&fd, 1, -1);
+		}
+
+	};
+
+	struct ring_channel {
+
+		bsc::shm_channel _channel;
+
+		size_t
+		write(const char* s, size_t n) {
+			return this->_channel.write(s, n);
+		}
+
+		size_t
+		read(char* s, size_t n) {
+			return this->_channel.read(s, n);
+		}
+
+		/// Both data and free space are signalled by the doorbell.
+		void
+		wait_readable() {
+			::pollfd fd{this->_channel.doorbell(), POLLIN, 0};
+			::poll(&fd, 1, -1);
+			std::uint64_t count = 0;
+			static_cast<void>(::read(fd.fd, &count, sizeof(count)));
+		}
+
+		void
+		wait_writable() {
+			this->wait_readable();
+		}
+
+	};
+
+	template <class Channel>
+	void
+	write_all(Channel& channel, const char* s, size_t n) {
+		size_t offset = 0;
+		while ((offset += channel.write(s + offset, n - offset)) != n) {
+			channel.wait_writable();
+		}
+	}
+
+	template <class Channel>
+	void
+	read_all(Channel& channel, char* s, size_t n) {
+		size_t offset = 0;
+		while ((offset += channel.read(s + offset, n - offset)) != n) {
+			channel.wait_readable();
+		}
+	}
+
+	/// Send each message back (the child process).
+	template <class Channel>
+	void
+	echo(Channel& channel, size_t message_size, size_t nmessages) {
+		std::vector<char> buf(message_size);
+		for (size_t i=0; i<nmessages; ++i) {
+			read_all(channel, buf.data(), buf.size());
+			write_all(channel, buf.data(), buf.size());
+		}
+	}
+
+	/// Returns round-trip time in microseconds.
+	template <class Channel>
+	double
+	ping(Channel& channel, size_t message_size, size_t nmessages) {
+		std::vector<char> buf(message_size);
+		const auto t0 = clock_type::now();
+		for (size_t i=0; i<nmessages; ++i) {
+			write_all(channel, buf.data(), buf.size());
+			read_all(channel, buf.data(), buf.size());
+		}
+		using namespace std::chrono;
+		const auto dt = duration_cast<duration<double,std::micro>>(
+			clock_type::now() - t0
+		);
+		return dt.count() / nmessages;
+	}
+
+	template <class Parent, class Child>
+	void
+	measure(const char* name, Parent& parent, Child make_child) {
+		const size_t small = 64, nsmall = 100000;
+		const size_t large = 1024*1024, nlarge = 500;
+		pid_t pid = ::fork();
+		if (pid == 0) {
+			auto child = make_child();
+			echo(child, small, nsmall);
+			echo(child, large, nlarge);
+			std::_Exit(0);
+		}
+		const double latency = ping(parent, small, nsmall);
+		const double t = ping(parent, large, nlarge) * nlarge;
+		int status = 0;
+		::waitpid(pid, &status, 0);
+		const double mb = 2.0*nlarge*large / (1024*1024);
+		std::cout << "transport=" << name << std::fixed << std::setprecision(2)
+			<< " round-trip-us=" << latency
+			<< std::setprecision(0)
+			<< " mb-per-second=" << mb / (t*1e-6)
+			<< std::endl;
+	}
+
+}
+
+/*
+Round-trip latency of 64-byte messages and bandwidth of 1 MiB messages
+between the parent and the child process that echoes the messages back.
+*/
+int
+main(int argc, char* argv[]) {
+	const std::string transport = argc > 1 ? argv[1] : "shm";
+	if (transport == "pipe") {
+		int down[2], up[2];
+		if (::pipe2(down, O_NONBLOCK) == -1 || ::pipe2(up, O_NONBLOCK) == -1) {
+			std::cerr << "pipe2 failed" << std::endl;
+			return 1;
+		}
+		pipe_channel parent{up[0], down[1]};
+		measure("pipe", parent, [&] () { return pipe_channel{down[0], up[1]}; });
+	} else {
+		ring_channel parent{bsc::shm_channel::create(1024*1024)};
+		measure("shm", parent, [&] () {
+			const bsc::shm_channel& p = parent._channel;
+			return ring_channel{bsc::shm_channel(
+				p.memory_fd(),
+				p.parent_event_fd(),
+				p.child_event_fd(),
+				bsc::shm_channel::role_type::child
+			)};
+		});
+	}
+	return 0;
+}
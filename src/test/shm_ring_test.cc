@@ -0,0 +1,153 @@
+#include <thread>
+#include <vector>
+
+#include <poll.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <gtest/gtest.h>
+
+#include <bscheduler/base/shm_ring.hh>
+
+namespace {
+
+	void
+	wait_for_doorbell(const bsc::shm_channel& channel) {
+		::pollfd fd{channel.doorbell(), POLLIN, 0};
+		::poll(&fd, 1, 1000);
+	}
+
+	/// Write \p n bytes with increasing values, wait for free space if needed.
+	void
+	write_sequence(bsc::shm_channel& channel, size_t n) {
+		std::vector<char> buf(1000);
+		unsigned char value = 0;
+		size_t nwritten = 0;
+		while (nwritten != n) {
+			const size_t m = std::min(buf.size(), n - nwritten);
+			for (size_t i=0; i<m; ++i) {
+				buf[i] = char(value + i);
+			}
+			size_t offset = 0;
+			while (offset != m) {
+				offset += channel.write(buf.data() + offset, m - offset);
+				if (offset != m) {
+					wait_for_doorbell(channel);
+					char tmp[8];
+					// consume the notification
+					static_cast<void>(::read(channel.doorbell(), tmp, sizeof(tmp)));
+				}
+			}
+			value += m;
+			nwritten += m;
+		}
+	}
+
+	/// Returns true, if \p n bytes with increasing values were read.
+	bool
+	read_sequence(bsc::shm_channel& channel, size_t n) {
+		std::vector<char> buf(777);
+		unsigned char expected = 0;
+		size_t nread = 0;
+		while (nread != n) {
+			wait_for_doorbell(channel);
+			size_t m;
+			while ((m = channel.read(buf.data(), buf.size())) != 0) {
+				for (size_t i=0; i<m; ++i) {
+					if ((unsigned char)(buf[i]) != expected) {
+						return false;
+					}
+					++expected;
+				}
+				nread += m;
+			}
+		}
+		return true;
+	}
+
+}
+
+TEST(ShmRing, WrapAround) {
+	bsc::shm_ring_header header;
+	std::vector<char> data(16);
+	bsc::shm_ring ring(&header, data.data(), data.size());
+	ring.reset();
+	bool was_empty = false, notify = false;
+	char buf[16];
+	EXPECT_EQ(10u, ring.write("0123456789", 10, was_empty));
+	EXPECT_TRUE(was_empty);
+	EXPECT_EQ(6u, ring.write("abcdefghij", 10, was_empty));
+	EXPECT_FALSE(was_empty);
+	EXPECT_EQ(0u, ring.free_space());
+	EXPECT_FALSE(ring.wait_for_space());
+	EXPECT_EQ(8u, ring.read(buf, 8, notify));
+	EXPECT_TRUE(notify);
+	EXPECT_EQ("01234567", std::string(buf, 8));
+	EXPECT_EQ(8u, ring.write("ABCDEFGH", 8, was_empty));
+	EXPECT_FALSE(was_empty);
+	EXPECT_EQ(16u, ring.read(buf, 16, notify));
+	EXPECT_FALSE(notify);
+	EXPECT_EQ("89abcdefABCDEFGH", std::string(buf, 16));
+	EXPECT_TRUE(ring.empty());
+	EXPECT_EQ(0u, ring.read(buf, 16, notify));
+}
+
+TEST(ShmRing, Threads) {
+	bsc::shm_channel parent = bsc::shm_channel::create(4096);
+	bsc::shm_channel child(
+		::dup(parent.memory_fd()),
+		::dup(parent.parent_event_fd()),
+		::dup(parent.child_event_fd()),
+		bsc::shm_channel::role_type::child
+	);
+	EXPECT_EQ(parent.capacity(), child.capacity());
+	const size_t n = 10000000;
+	bool success = false;
+	std::thread t([&] () { success = read_sequence(child, n); });
+	write_sequence(parent, n);
+	t.join();
+	EXPECT_TRUE(success);
+}
+
+TEST(ShmRing, Processes) {
+	bsc::shm_channel parent = bsc::shm_channel::create(4096);
+	const size_t n = 10000000;
+	pid_t pid = ::fork();
+	ASSERT_NE(-1, pid);
+	if (pid == 0) {
+		bsc::shm_channel child(
+			::dup(parent.memory_fd()),
+			::dup(parent.parent_event_fd()),
+			::dup(parent.child_event_fd()),
+			bsc::shm_channel::role_type::child
+		);
+		write_sequence(child, n);
+		std::_Exit(0);
+	}
+	EXPECT_TRUE(read_sequence(parent, n));
+	int status = 0;
+	::waitpid(pid, &status, 0);
+	EXPECT_TRUE(WIFEXITED(status));
+	EXPECT_EQ(0, WEXITSTATUS(status));
+}
+
+TEST(ShmRing, Lifeline) {
+	bsc::shm_channel parent = bsc::shm_channel::create(4096);
+	bsc::shm_channel child(
+		::dup(parent.memory_fd()),
+		::dup(parent.parent_event_fd()),
+		::dup(parent.child_event_fd()),
+		bsc::shm_channel::role_type::child,
+		::dup(parent.child_lifeline_fd())
+	);
+	EXPECT_NE(-1, child.lifeline());
+	parent.close_in_parent();
+	EXPECT_EQ(-1, parent.child_lifeline_fd());
+	::pollfd fd{parent.lifeline(), POLLIN, 0};
+	EXPECT_EQ(0, ::poll(&fd, 1, 0));
+	// the parent's end hangs up when the child closes the channel
+	child.close();
+	EXPECT_EQ(1, ::poll(&fd, 1, 1000));
+	char tmp[1];
+	EXPECT_EQ(0, ::read(parent.lifeline(), tmp, sizeof(tmp)));
+}
@@ -0,0 +1,190 @@
+#include <bscheduler/base/error_handler.hh>
+#include <bscheduler/api.hh>
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+#include <unistdx/base/command_line>
+#include <unistdx/base/log_message>
+
+#include "role.hh"
+
+#include <gtest/gtest.h>
+
+/*
+The master saturates the only connection with large kernels of normal
+priority and then sends one kernel of high priority. The slave counts
+large kernels as it reads them from the connection, and the high-priority
+kernel brings back the number of large kernels that were read before it.
+With the bulk lane it overtakes the large kernels that are still queued
+on the master.
+*/
+
+using test::Role;
+using namespace bsc;
+
+const uint32_t NUM_BULK = 64;
+const size_t BULK_SIZE = 1024*1024;
+const sys::port_type PORT = 10200;
+
+Role role = Role::Master;
+
+/// The number of bulk kernels that the slave read from the connection.
+std::atomic<uint32_t> num_bulk_read(0);
+
+struct Bulk: public bsc::kernel {
+
+	Bulk() = default;
+
+	explicit
+	Bulk(size_t n):
+	_data(n)
+	{}
+
+	void
+	act() override {
+		// do not send the data back
+		this->_data.clear();
+		commit<Remote>(this);
+	}
+
+	void
+	write(sys::pstream& out) const override {
+		bsc::kernel::write(out);
+		out << uint32_t(this->_data.size());
+		out.write(this->_data.data(), this->_data.size());
+	}
+
+	void
+	read(sys::pstream& in) override {
+		bsc::kernel::read(in);
+		uint32_t n = 0;
+		in >> n;
+		this->_data.resize(n);
+		in.read(this->_data.data(), n);
+		if (role == Role::Slave) {
+			++num_bulk_read;
+		}
+	}
+
+private:
+	std::vector<char> _data;
+
+};
+
+struct Urgent: public bsc::kernel {
+
+	Urgent() {
+		this->priority(kernel_priority::high);
+	}
+
+	void
+	act() override {
+		commit<Remote>(this);
+	}
+
+	void
+	write(sys::pstream& out) const override {
+		bsc::kernel::write(out);
+		out << this->_nbefore;
+	}
+
+	void
+	read(sys::pstream& in) override {
+		bsc::kernel::read(in);
+		in >> this->_nbefore;
+		if (role == Role::Slave) {
+			this->_nbefore = num_bulk_read;
+		}
+	}
+
+	/// Returns the number of bulk kernels that the slave read before this one.
+	inline uint32_t
+	num_before() const noexcept {
+		return this->_nbefore;
+	}
+
+private:
+	uint32_t _nbefore = 0;
+
+};
+
+struct Main: public bsc::kernel {
+
+	void
+	act() override {
+		for (uint32_t i=0; i<NUM_BULK; ++i) {
+			upstream<Remote>(this, new Bulk(BULK_SIZE));
+		}
+		upstream<Remote>(this, new Urgent);
+	}
+
+	void
+	react(bsc::kernel* child) override {
+		if (Urgent* k = dynamic_cast<Urgent*>(child)) {
+			sys::log_message(
+				"test",
+				"urgent kernel arrived after _/_ bulk kernels",
+				k->num_before(),
+				NUM_BULK
+			);
+			EXPECT_LT(k->num_before(), NUM_BULK/4)
+				<< "high-priority kernel waited behind bulk kernels";
+			this->_urgent = true;
+		}
+		if (++this->_num_returned == NUM_BULK+1) {
+			EXPECT_TRUE(this->_urgent);
+			commit<Local>(this, bsc::exit_code::success);
+		}
+	}
+
+private:
+	uint32_t _num_returned = 0;
+	bool _urgent = false;
+
+};
+
+TEST(SocketPipelinePriority, UrgentKernelOvertakesBulkKernels) {
+	bsc::register_type<Bulk>();
+	bsc::register_type<Urgent>();
+	sys::socket_address principal_endpoint({127,0,0,1}, PORT);
+	sys::socket_address subordinate_endpoint({127,0,0,1}, PORT+1);
+	sys::ipv4_address netmask =
+		sys::ipaddr_traits<sys::ipv4_address>::loopback_mask();
+	// all kernels go to the other side
+	factory.nic().use_localhost(false);
+	if (role == Role::Slave) {
+		factory.nic().set_port(PORT+1);
+		factory.nic().add_server(principal_endpoint, netmask);
+	}
+	if (role == Role::Master) {
+		factory.nic().set_port(PORT);
+		factory.nic().add_server(subordinate_endpoint, netmask);
+		// wait for the child to start
+		using namespace std::this_thread;
+		using namespace std::chrono;
+		sleep_for(milliseconds(1000));
+		factory.nic().add_client(principal_endpoint);
+	}
+	factory_guard g;
+	if (role == Role::Master) {
+		send<Local>(new Main);
+	}
+	EXPECT_EQ(0, bsc::wait_and_return());
+}
+
+int
+main(int argc, char* argv[]) {
+	bsc::install_error_handler();
+	::testing::InitGoogleTest(&argc, argv);
+	sys::this_process::ignore_signal(sys::signal::broken_pipe);
+	sys::input_operator_type options[] = {
+		sys::ignore_first_argument(),
+		sys::make_key_value("role", role),
+		nullptr
+	};
+	sys::parse_arguments(argc, argv, options);
+	return RUN_ALL_TESTS();
+}
@@ -0,0 +1,158 @@
+#include <bscheduler/base/error_handler.hh>
+#include <bscheduler/api.hh>
+
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <set>
+#include <thread>
+#include <utility>
+
+#include <unistdx/base/command_line>
+#include <unistdx/base/log_message>
+
+#include <gtest/gtest.h>
+
+/*
+Three nodes are connected in a ring (0->1, 1->2, 2->0) and relay broadcast
+kernels. The first node broadcasts kernels, other nodes answer each
+broadcast kernel with their own broadcast (echo). Every kernel reaches every
+node twice (once from each neighbour), hence without deduplication nodes
+would echo the same kernel twice and the first node would receive its own
+kernels back.
+
+The fourth node connects to the first one, but the first node does not
+treat it as its principal or subordinate. It must not receive broadcast
+kernels: if it does, it echoes them and the first node counts too many
+echoes.
+*/
+
+using namespace bsc;
+
+const unsigned NUM_NODES = 3;
+/// The node that is connected to the first one outside of the hierarchy.
+const unsigned OUTSIDER = NUM_NODES;
+const unsigned NUM_BROADCASTS = 10;
+const sys::port_type BASE_PORT = 10100;
+
+unsigned node = 0;
+
+std::mutex echo_mutex;
+/// Pairs of node and broadcast kernel id that were echoed.
+std::set<std::pair<unsigned,kernel::id_type>> echoes;
+std::atomic<unsigned> num_echoes(0);
+/// The number of own broadcast kernels that returned to the first node.
+std::atomic<unsigned> num_returned(0);
+
+struct Broadcast: public bsc::kernel {
+
+	Broadcast() = default;
+
+	Broadcast(bool echo, kernel::id_type origin):
+	_node(node),
+	_echo(echo),
+	_origin(origin)
+	{}
+
+	void
+	act() override {
+		if (node == 0) {
+			if (this->_echo) {
+				std::lock_guard<std::mutex> lock(echo_mutex);
+				EXPECT_TRUE(echoes.emplace(this->_node, this->_origin).second)
+					<< "duplicate echo from node " << this->_node;
+				++num_echoes;
+			} else {
+				++num_returned;
+			}
+		} else if (!this->_echo) {
+			send<Remote>(new Broadcast(true, this->id()));
+		}
+		delete this;
+	}
+
+	void
+	write(sys::pstream& out) const override {
+		bsc::kernel::write(out);
+		out << uint32_t(this->_node) << this->_echo << this->_origin;
+	}
+
+	void
+	read(sys::pstream& in) override {
+		bsc::kernel::read(in);
+		uint32_t n = 0;
+		in >> n >> this->_echo >> this->_origin;
+		this->_node = n;
+	}
+
+private:
+	unsigned _node = 0;
+	bool _echo = false;
+	kernel::id_type _origin = 0;
+
+};
+
+inline sys::socket_address
+node_address(unsigned i) {
+	return sys::socket_address({127,0,0,1}, BASE_PORT + i);
+}
+
+TEST(SocketPipelineRelay, Deduplication) {
+	bsc::register_type<Broadcast>();
+	factory.nic().set_port(BASE_PORT + node);
+	factory.nic().add_server(
+		node_address(node),
+		sys::ipaddr_traits<sys::ipv4_address>::loopback_mask()
+	);
+	factory.nic().set_relay_broadcasts(true);
+	if (node == OUTSIDER) {
+		factory.nic().set_hierarchy_link(node_address(0), true);
+	} else {
+		// both neighbours in the ring
+		factory.nic().set_hierarchy_link(node_address((node+1) % NUM_NODES), true);
+		factory.nic().set_hierarchy_link(node_address((node+2) % NUM_NODES), true);
+	}
+	factory_guard g;
+	using namespace std::this_thread;
+	using namespace std::chrono;
+	// wait for the other nodes to start
+	sleep_for(milliseconds(1000));
+	if (node == OUTSIDER) {
+		factory.nic().add_client(node_address(0));
+	} else {
+		factory.nic().add_client(node_address((node+1) % NUM_NODES));
+	}
+	if (node != 0) {
+		bsc::wait_and_return();
+		return;
+	}
+	// wait for the other nodes to connect
+	sleep_for(milliseconds(1000));
+	for (unsigned i=0; i<NUM_BROADCASTS; ++i) {
+		send<Remote>(new Broadcast(false, 0));
+	}
+	const unsigned expected = (NUM_NODES-1)*NUM_BROADCASTS;
+	const auto deadline = steady_clock::now() + seconds(30);
+	while (num_echoes < expected && steady_clock::now() < deadline) {
+		sleep_for(milliseconds(100));
+	}
+	// give duplicates time to arrive
+	sleep_for(milliseconds(500));
+	EXPECT_EQ(expected, num_echoes.load());
+	EXPECT_EQ(0u, num_returned.load());
+	bsc::graceful_shutdown(0);
+}
+
+int
+main(int argc, char* argv[]) {
+	bsc::install_error_handler();
+	::testing::InitGoogleTest(&argc, argv);
+	sys::this_process::ignore_signal(sys::signal::broken_pipe);
+	sys::input_operator_type options[] = {
+		sys::ignore_first_argument(),
+		sys::make_key_value("node", node),
+		nullptr
+	};
+	sys::parse_arguments(argc, argv, options);
+	return RUN_ALL_TESTS();
+}
@@ -2,6 +2,7 @@
 #include <bscheduler/api.hh>
 
 #include <unistdx/base/command_line>
+#include <unistdx/base/log_message>
 
 #include "role.hh"
 #include "datum.hh"
@@ -40,9 +41,19 @@ std::atomic<uint32_t> shutdown_counter(0);
 
 Role role = Role::Master;
 Failure failure = Failure::No;
+unsigned num_shards = 1;
+/// Write coalescing latency in microseconds.
+unsigned write_latency = 0;
+/// Output buffer size after which application kernels are queued.
+size_t bulk_output_limit = 4096*64;
+/// The maximal number of kernels in flight per client.
+size_t client_capacity = 0;
+bsc::io_backend backend = bsc::io_backend::epoll;
 
 using namespace bsc;
 
+routing_policy routing = routing_policy::round_robin;
+
 struct Test_socket: public bsc::kernel {
 
 	Test_socket():
@@ -163,11 +174,30 @@ private:
 TEST(NICServerTest, All) {
 	using bsc::factory;
 	bsc::register_type<Test_socket>();
-	sys::port_type port = 10000 + 2*sys::port_type(failure);
+	sys::port_type port = 10000 + 2*sys::port_type(failure) +
+		4*sys::port_type(num_shards-1) + 8*sys::port_type(routing) +
+		16*sys::port_type(write_latency != 0) +
+		32*sys::port_type(bulk_output_limit < 4096) +
+		64*sys::port_type(backend == io_backend::io_uring) +
+		128*sys::port_type(client_capacity != 0);
 	sys::socket_address principal_endpoint({127,0,0,1}, port);
 	sys::socket_address subordinate_endpoint({127,0,0,1}, port+1);
 	sys::ipv4_address netmask =
 		sys::ipaddr_traits<sys::ipv4_address>::loopback_mask();
+	// falls back to epoll, if io_uring is not supported
+	factory.nic().set_io_backend(backend);
+	factory.nic().set_num_shards(num_shards);
+	factory.nic().set_routing_policy(routing);
+	factory.nic().set_write_coalescing(
+		std::chrono::microseconds(write_latency),
+		4096
+	);
+	factory.nic().set_bulk_output_limit(bulk_output_limit);
+	factory.nic().set_client_capacity(client_capacity);
+	if (client_capacity != 0) {
+		// the only client is full, kernels are deferred until it returns some
+		factory.nic().use_localhost(false);
+	}
 	if (role == Role::Slave) {
 		factory.nic().set_port(port+1);
 		factory.nic().add_server(principal_endpoint, netmask);
@@ -188,6 +218,15 @@ TEST(NICServerTest, All) {
 	}
 
 	int retval = bsc::wait_and_return();
+	const write_stats stats = factory.nic().get_write_stats();
+	EXPECT_NE(0u, stats.nwrites);
+	// every write carries at least one kernel
+	EXPECT_LE(stats.nwrites, stats.nkernels) << stats;
+	if (num_shards > 1) {
+		// the only connection is owned by the second thread
+		EXPECT_NE(0u, factory.nic().get_write_stats(1).nkernels)
+			<< "the shard did not send kernels";
+	}
 
 	if (!(failure == Failure::Slave && role == Role::Slave)) {
 		EXPECT_EQ(0, kernel_count) << "some kernels were not deleted"
@@ -207,6 +246,12 @@ main(int argc, char* argv[]) {
 		sys::ignore_first_argument(),
 		sys::make_key_value("role", role),
 		sys::make_key_value("failure", failure),
+		sys::make_key_value("shards", num_shards),
+		sys::make_key_value("routing", routing),
+		sys::make_key_value("write_latency", write_latency),
+		sys::make_key_value("bulk_output_limit", bulk_output_limit),
+		sys::make_key_value("io_backend", backend),
+		sys::make_key_value("client_capacity", client_capacity),
 		nullptr
 	};
 	sys::parse_arguments(argc, argv, options);
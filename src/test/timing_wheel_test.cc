@@ -0,0 +1,122 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <iterator>
+#include <random>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include <bscheduler/base/timing_wheel.hh>
+
+struct Timer {
+
+	typedef std::chrono::system_clock clock_type;
+	typedef clock_type::time_point time_point;
+	typedef std::uint64_t id_type;
+
+	time_point _at;
+	id_type _id = 0;
+	bool expired = false;
+
+	inline time_point at() const { return this->_at; }
+	inline id_type id() const { return this->_id; }
+	inline bool has_id() const { return this->_id != 0; }
+
+};
+
+typedef bsc::timing_wheel<Timer> wheel_type;
+typedef std::chrono::milliseconds ms;
+
+TEST(TimingWheel, ExpiresInTime) {
+	const Timer::time_point t0 = Timer::clock_type::now();
+	wheel_type wheel(ms(1), t0);
+	std::default_random_engine rng;
+	std::uniform_int_distribution<int> kind(0, 3);
+	std::vector<Timer> timers(10000);
+	for (Timer& t : timers) {
+		int64_t max_offset = 0;
+		switch (kind(rng)) {
+			case 0: max_offset = 255; break;
+			case 1: max_offset = 65535; break;
+			case 2: max_offset = 1<<20; break;
+			default: max_offset = int64_t(1)<<33; break;
+		}
+		std::uniform_int_distribution<int64_t> offset(0, max_offset);
+		t._at = t0 + ms(offset(rng));
+		wheel.insert(&t);
+	}
+	EXPECT_EQ(timers.size(), wheel.size());
+	std::uniform_int_distribution<int64_t> step(1, 5000);
+	Timer::time_point now = t0;
+	std::vector<Timer*> result;
+	size_t nexpired = 0;
+	while (nexpired != timers.size()) {
+		// jump to the expiry time, or make a random step
+		if (step(rng) % 2 == 0) {
+			now = std::max(now + ms(1), wheel.next_expiry());
+		} else {
+			now += ms(step(rng) * (step(rng) % 7 == 0 ? 1000000 : 1));
+		}
+		result.clear();
+		wheel.advance(now, std::back_inserter(result));
+		for (Timer* t : result) {
+			ASSERT_FALSE(t->expired);
+			ASSERT_LE(t->at(), now) << "timer expired too early";
+			t->expired = true;
+		}
+		nexpired += result.size();
+		for (const Timer& t : timers) {
+			if (!t.expired) {
+				ASSERT_GT(t.at(), now) << "timer expired too late";
+			}
+		}
+	}
+	EXPECT_TRUE(wheel.empty());
+}
+
+TEST(TimingWheel, Remove) {
+	const Timer::time_point t0 = Timer::clock_type::now();
+	wheel_type wheel(ms(1), t0);
+	std::vector<Timer> timers(1000);
+	for (size_t i=0; i<timers.size(); ++i) {
+		timers[i]._at = t0 + ms(i*100);
+		timers[i]._id = i+1;
+		wheel.insert(&timers[i]);
+	}
+	for (size_t i=0; i<timers.size(); i+=2) {
+		EXPECT_EQ(&timers[i], wheel.remove(timers[i].id()));
+	}
+	EXPECT_EQ(nullptr, wheel.remove(timers.size()+1));
+	EXPECT_EQ(nullptr, wheel.remove(1));
+	EXPECT_EQ(timers.size()/2, wheel.size());
+	std::vector<Timer*> result;
+	wheel.advance(t0 + ms(timers.size()*100), std::back_inserter(result));
+	EXPECT_EQ(timers.size()/2, result.size());
+	for (Timer* t : result) {
+		EXPECT_EQ(0u, t->id() % 2);
+	}
+	EXPECT_TRUE(wheel.empty());
+	// removal of the kernel that has already expired
+	timers[1]._at = t0;
+	wheel.insert(&timers[1]);
+	EXPECT_EQ(&timers[1], wheel.remove(timers[1].id()));
+	EXPECT_TRUE(wheel.empty());
+}
+
+TEST(TimingWheel, Clear) {
+	const Timer::time_point t0 = Timer::clock_type::now();
+	wheel_type wheel(ms(1), t0);
+	std::vector<Timer> timers(3);
+	timers[0]._at = t0;
+	timers[1]._at = t0 + ms(10);
+	timers[2]._at = t0 + std::chrono::hours(24*365);
+	for (Timer& t : timers) {
+		wheel.insert(&t);
+	}
+	EXPECT_EQ(t0, wheel.next_expiry());
+	std::vector<Timer*> result;
+	wheel.clear(std::back_inserter(result));
+	EXPECT_EQ(timers.size(), result.size());
+	EXPECT_TRUE(wheel.empty());
+}
@@ -0,0 +1,70 @@
+#include <iomanip>
+#include <iostream>
+#include <string>
+
+#include <unistdx/io/fildesbuf>
+
+#include <bscheduler/kernel/kernel.hh>
+#include <bscheduler/kernel/kernel_type_registry.hh>
+#include <bscheduler/kernel/kstream.hh>
+
+namespace {
+
+	/// Control kernel without payload, similar to probe.
+	struct Control_kernel: public bsc::kernel {};
+
+	typedef std::stringbuf sink_type;
+	typedef sys::basic_fildesbuf<char, std::char_traits<char>, sink_type>
+		fildesbuf_type;
+	typedef bsc::basic_kernelbuf<fildesbuf_type> buffer_type;
+	typedef bsc::kstream<bsc::kernel> stream_type;
+
+	/**
+	Returns the average size of the packet with one control kernel
+	including packet size and kernel header. Ids are assigned by the
+	counter as in kernel_protocol.
+	*/
+	double
+	bytes_per_kernel(bool compact, bsc::application_type app, size_t nkernels) {
+		buffer_type buffer;
+		buffer.setfd(sink_type{});
+		buffer.set_compact_encoding(compact);
+		// the loopback peer reads compact encoding
+		buffer.set_peer_features(bsc::wire_feature::compact_encoding);
+		stream_type stream(&buffer);
+		size_t total = 0;
+		Control_kernel parent;
+		parent.id(1);
+		for (size_t i=0; i<nkernels; ++i) {
+			Control_kernel k;
+			k.id(parent.id() + 1 + i);
+			k.parent(&parent);
+			k.principal(&parent);
+			k.setapp(app);
+			stream.begin_packet();
+			stream << k.header();
+			stream << k;
+			total += buffer.opacket_size();
+			stream.end_packet();
+		}
+		return double(total) / nkernels;
+	}
+
+}
+
+int
+main(int argc, char* argv[]) {
+	const std::string app = argc > 1 ? argv[1] : "daemon";
+	bsc::register_type<Control_kernel>();
+	const bsc::application_type id = app == "daemon" ? 0 : 0x9e3779b97f4a7c15UL;
+	const size_t nkernels = 100000;
+	const double fixed = bytes_per_kernel(false, id, nkernels);
+	const double compact = bytes_per_kernel(true, id, nkernels);
+	std::cout << "app=" << app << std::fixed << std::setprecision(1)
+		<< " fixed-bytes-per-kernel=" << fixed
+		<< " compact-bytes-per-kernel=" << compact
+		<< std::setprecision(2)
+		<< " ratio=" << fixed / compact
+		<< std::endl;
+	return 0;
+}
@@ -0,0 +1,79 @@
+#include <algorithm>
+#include <atomic>
+#include <thread>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include <bscheduler/base/work_stealing_deque.hh>
+
+typedef bsc::work_stealing_deque<size_t> deque_type;
+
+TEST(WorkStealingDeque, PushPop) {
+	deque_type deque(1);
+	for (size_t i=0; i<100; ++i) {
+		deque.push(i);
+	}
+	EXPECT_EQ(100u, deque.size());
+	size_t x = 0;
+	for (size_t i=100; i>0; --i) {
+		ASSERT_TRUE(deque.pop(x));
+		EXPECT_EQ(i-1, x) << "pop order is not LIFO";
+	}
+	EXPECT_FALSE(deque.pop(x));
+	EXPECT_TRUE(deque.empty());
+}
+
+TEST(WorkStealingDeque, Steal) {
+	deque_type deque(1);
+	for (size_t i=0; i<100; ++i) {
+		deque.push(i);
+	}
+	size_t x = 0;
+	for (size_t i=0; i<100; ++i) {
+		ASSERT_TRUE(deque.steal(x));
+		EXPECT_EQ(i, x) << "steal order is not FIFO";
+	}
+	EXPECT_FALSE(deque.steal(x));
+}
+
+TEST(WorkStealingDeque, ConcurrentSteal) {
+	const size_t nelements = 100000;
+	const size_t nthieves = 4;
+	deque_type deque(2);
+	std::vector<std::atomic<int>> counts(nelements);
+	for (std::atomic<int>& c : counts) {
+		c = 0;
+	}
+	std::atomic<bool> stopped(false);
+	std::vector<std::thread> thieves;
+	for (size_t i=0; i<nthieves; ++i) {
+		thieves.emplace_back([&] () {
+			size_t x = 0;
+			while (!stopped) {
+				if (deque.steal(x)) {
+					++counts[x];
+				}
+			}
+		});
+	}
+	size_t x = 0;
+	for (size_t i=0; i<nelements; ++i) {
+		deque.push(i);
+		if (i%3 == 0 && deque.pop(x)) {
+			++counts[x];
+		}
+	}
+	while (deque.pop(x)) {
+		++counts[x];
+	}
+	stopped = true;
+	for (std::thread& t : thieves) {
+		t.join();
+	}
+	EXPECT_TRUE(std::all_of(
+		counts.begin(),
+		counts.end(),
+		[] (const std::atomic<int>& c) { return c == 1; }
+	));
+}